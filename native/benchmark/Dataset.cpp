@@ -0,0 +1,105 @@
+#include "Dataset.h"
+#include "index/FlatIndex.h"
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+namespace vectordb {
+namespace bench {
+
+namespace {
+
+// Both formats store every row as an int32 dimension followed by that many 4-byte values
+template <typename T>
+std::vector<T> readVecs(const std::string& path, int maxRows, int* dimension, int* rows) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open dataset file: " + path);
+    }
+
+    int32_t dim = 0;
+    if (!in.read(reinterpret_cast<char*>(&dim), sizeof(dim)) || dim <= 0) {
+        throw std::runtime_error("Corrupted vecs file: " + path);
+    }
+    in.seekg(0, std::ios::end);
+    const int64_t rowBytes = sizeof(int32_t) + static_cast<int64_t>(dim) * sizeof(T);
+    const int64_t fileBytes = in.tellg();
+    if (fileBytes % rowBytes != 0) {
+        throw std::runtime_error("Corrupted vecs file: " + path);
+    }
+    int64_t count = fileBytes / rowBytes;
+    if (maxRows > 0) count = std::min<int64_t>(count, maxRows);
+
+    std::vector<T> data(static_cast<size_t>(count) * dim);
+    in.seekg(0);
+    for (int64_t r = 0; r < count; r++) {
+        int32_t rowDim;
+        in.read(reinterpret_cast<char*>(&rowDim), sizeof(rowDim));
+        if (!in || rowDim != dim) {
+            throw std::runtime_error("Corrupted vecs file: " + path);
+        }
+        in.read(reinterpret_cast<char*>(data.data() + static_cast<size_t>(r) * dim), sizeof(T) * dim);
+    }
+    if (!in) {
+        throw std::runtime_error("Corrupted vecs file: " + path);
+    }
+
+    *dimension = dim;
+    *rows = static_cast<int>(count);
+    return data;
+}
+
+} // namespace
+
+std::vector<float> readFvecs(const std::string& path, int maxRows, int* dimension, int* rows) {
+    return readVecs<float>(path, maxRows, dimension, rows);
+}
+
+std::vector<int> readIvecs(const std::string& path, int maxRows, int* dimension, int* rows) {
+    return readVecs<int>(path, maxRows, dimension, rows);
+}
+
+void computeGroundTruth(Dataset& dataset, int k) {
+    FlatConfig config;
+    config.metric = dataset.metric;
+    FlatIndex flat(dataset.dimension, dataset.nBase, config);
+    std::vector<int> ids(dataset.nBase);
+    for (int i = 0; i < dataset.nBase; i++) ids[i] = i;
+    flat.addBatch(dataset.base.data(), ids.data(), dataset.nBase);
+
+    std::vector<float> distances(static_cast<size_t>(dataset.nQueries) * k);
+    dataset.groundTruth.assign(static_cast<size_t>(dataset.nQueries) * k, -1);
+    flat.searchBatch(dataset.queries.data(), dataset.nQueries, k, dataset.groundTruth.data(), distances.data());
+    dataset.groundTruthK = k;
+}
+
+Dataset syntheticDataset(int nBase, int nQueries, int dimension, Metric metric, unsigned seed) {
+    Dataset dataset;
+    dataset.name = "synthetic";
+    dataset.metric = metric;
+    dataset.dimension = dimension;
+    dataset.nBase = nBase;
+    dataset.nQueries = nQueries;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    dataset.base.resize(static_cast<size_t>(nBase) * dimension);
+    dataset.queries.resize(static_cast<size_t>(nQueries) * dimension);
+    for (auto& v : dataset.base) v = uniform(rng);
+    for (auto& v : dataset.queries) v = uniform(rng);
+    return dataset;
+}
+
+double recallAtK(const int* resultIds, int resultCount, const int* truth, int k) {
+    int hits = 0;
+    const int count = std::min(resultCount, k);
+    for (int i = 0; i < count; i++) {
+        if (std::find(truth, truth + k, resultIds[i]) != truth + k) hits++;
+    }
+    return static_cast<double>(hits) / k;
+}
+
+} // namespace bench
+} // namespace vectordb
@@ -0,0 +1,46 @@
+#pragma once
+#include "compute/DistanceUtils.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace vectordb {
+namespace bench {
+
+/**
+ * 基准测试数据集: 库向量、查询向量与每条查询的真实近邻 (升序，外部 id 即库向量下标)
+ */
+struct Dataset {
+    std::string name;
+    Metric metric = Metric::L2;
+    int dimension = 0;
+    int nBase = 0;
+    int nQueries = 0;
+    int groundTruthK = 0;            // groundTruth 每行的近邻数
+    std::vector<float> base;         // [nBase][dimension]
+    std::vector<float> queries;      // [nQueries][dimension]
+    std::vector<int> groundTruth;    // [nQueries][groundTruthK]
+
+    const float* baseVector(int i) const { return base.data() + static_cast<size_t>(i) * dimension; }
+    const float* query(int q) const { return queries.data() + static_cast<size_t>(q) * dimension; }
+    const int* neighbors(int q) const { return groundTruth.data() + static_cast<size_t>(q) * groundTruthK; }
+};
+
+/**
+ * 读取 fvecs / ivecs (每行: int32 维度 + 维度个 float / int32)，最多 maxRows 行 (<= 0 为全部)
+ * 取大文件的前若干行即可得到 Deep1B 等数据集的子集；格式错误时抛出 std::runtime_error
+ */
+std::vector<float> readFvecs(const std::string& path, int maxRows, int* dimension, int* rows);
+std::vector<int> readIvecs(const std::string& path, int maxRows, int* dimension, int* rows);
+
+// 用 FlatIndex 精确计算每条查询的前 k 个近邻，写入 groundTruth
+void computeGroundTruth(Dataset& dataset, int k);
+
+// 均匀分布的随机数据，供没有数据集文件时做冒烟测试
+Dataset syntheticDataset(int nBase, int nQueries, int dimension, Metric metric, unsigned seed);
+
+// 前 k 个结果与真实前 k 个近邻的交集比例
+double recallAtK(const int* resultIds, int resultCount, const int* truth, int k);
+
+} // namespace bench
+} // namespace vectordb
@@ -0,0 +1,481 @@
+/**
+ * ANN benchmark: sweeps every index type over its build and search parameters and reports
+ * recall@k, QPS, p50/p99 latency, build time and memory per setting.
+ *
+ *   vectordb_bench --dataset=/data/sift/sift --indexes=hnsw,ivf --ef=16,32,64 \
+ *                  --benchmark_out=sift.json --benchmark_out_format=json
+ *
+ * --dataset=PREFIX reads PREFIX_base.fvecs, PREFIX_query.fvecs and PREFIX_groundtruth.ivecs (the
+ * SIFT1M layout; convert GloVe or Deep1B to the same three files), or pass --base / --query / --gt.
+ * --max_base keeps the first N base vectors and recomputes the ground truth; without a dataset the
+ * run uses --synthetic=N,DIM[,QUERIES] random data. --optimize calls VectorIndex::optimize() after
+ * each build (graph reordering for HNSW / HNSWPQ), counted in build_s. The remaining --benchmark_* flags go to Google
+ * Benchmark, whose tools/compare.py diffs the JSON output of two releases.
+ */
+#include "Dataset.h"
+#include "index/HNSWIndex.h"
+#include "index/HNSWPQIndex.h"
+#include "index/IVFIndex.h"
+#include "index/IVFPQIndex.h"
+#include "index/PQIndex.h"
+#include "index/FlatIndex.h"
+#include "index/LSHIndex.h"
+#include "index/AnnoyIndex.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace vectordb;
+using namespace vectordb::bench;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string dataset;
+    std::string basePath;
+    std::string queryPath;
+    std::string groundTruthPath;
+    int maxBase = 0;
+    int maxQueries = 0;
+    std::string metric = "l2";
+    int k = 10;
+    std::vector<std::string> indexes = {"flat", "hnsw", "hnswpq", "ivf", "ivfpq", "pq", "lsh", "annoy"};
+
+    // Build parameters
+    int hnswM = 32;
+    int efConstruction = 64;
+    int nLists = 0;  // 0: 4 * sqrt(nBase)
+    std::vector<int> pqM;  // empty: divisors of the dimension among 8 / 16 / 32
+    std::vector<int> trees = {10, 50};
+    int lshTables = 10;
+    int lshFunctions = 12;
+    bool optimize = false;
+
+    // Search parameters
+    std::vector<int> ef = {16, 32, 64, 128, 256};
+    std::vector<int> nProbes = {1, 2, 4, 8, 16, 32, 64};
+    std::vector<int> lshProbes = {1, 4, 16, 64};
+
+    int syntheticBase = 20000;
+    int syntheticDim = 64;
+    int syntheticQueries = 1000;
+};
+
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+std::vector<int> parseIntList(const std::string& value) {
+    std::vector<int> values;
+    for (const auto& item : splitList(value)) values.push_back(std::stoi(item));
+    return values;
+}
+
+// Consumes our flags and leaves everything else (the --benchmark_* flags) in argv
+Options parseOptions(int* argc, char** argv) {
+    Options options;
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--dataset") options.dataset = value;
+        else if (key == "--base") options.basePath = value;
+        else if (key == "--query") options.queryPath = value;
+        else if (key == "--gt") options.groundTruthPath = value;
+        else if (key == "--max_base") options.maxBase = std::stoi(value);
+        else if (key == "--max_queries") options.maxQueries = std::stoi(value);
+        else if (key == "--metric") options.metric = value;
+        else if (key == "--k") options.k = std::stoi(value);
+        else if (key == "--indexes") options.indexes = splitList(value);
+        else if (key == "--hnsw_m") options.hnswM = std::stoi(value);
+        else if (key == "--ef_construction") options.efConstruction = std::stoi(value);
+        else if (key == "--nlist") options.nLists = std::stoi(value);
+        else if (key == "--pqm") options.pqM = parseIntList(value);
+        else if (key == "--trees") options.trees = parseIntList(value);
+        else if (key == "--lsh_tables") options.lshTables = std::stoi(value);
+        else if (key == "--lsh_functions") options.lshFunctions = std::stoi(value);
+        else if (key == "--optimize") options.optimize = value.empty() || value == "true" || value == "1";
+        else if (key == "--ef") options.ef = parseIntList(value);
+        else if (key == "--nprobe") options.nProbes = parseIntList(value);
+        else if (key == "--lsh_probes") options.lshProbes = parseIntList(value);
+        else if (key == "--synthetic") {
+            auto sizes = parseIntList(value);
+            if (sizes.size() >= 1) options.syntheticBase = sizes[0];
+            if (sizes.size() >= 2) options.syntheticDim = sizes[1];
+            if (sizes.size() >= 3) options.syntheticQueries = sizes[2];
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    return options;
+}
+
+Metric parseMetric(const std::string& name) {
+    if (name == "l2") return Metric::L2;
+    if (name == "ip") return Metric::INNER_PRODUCT;
+    if (name == "cosine" || name == "angular") return Metric::COSINE;
+    throw std::invalid_argument("Unknown metric: " + name);
+}
+
+Dataset loadDataset(const Options& options) {
+    const Metric metric = parseMetric(options.metric);
+    std::string basePath = options.basePath, queryPath = options.queryPath, gtPath = options.groundTruthPath;
+    if (!options.dataset.empty()) {
+        if (basePath.empty()) basePath = options.dataset + "_base.fvecs";
+        if (queryPath.empty()) queryPath = options.dataset + "_query.fvecs";
+        if (gtPath.empty()) gtPath = options.dataset + "_groundtruth.ivecs";
+    }
+
+    if (basePath.empty()) {
+        Dataset dataset = syntheticDataset(options.syntheticBase, options.syntheticQueries,
+                                           options.syntheticDim, metric, 42);
+        computeGroundTruth(dataset, options.k);
+        return dataset;
+    }
+
+    Dataset dataset;
+    dataset.name = options.dataset.empty() ? basePath : options.dataset;
+    dataset.metric = metric;
+    int queryDim = 0;
+    dataset.base = readFvecs(basePath, options.maxBase, &dataset.dimension, &dataset.nBase);
+    dataset.queries = readFvecs(queryPath, options.maxQueries, &queryDim, &dataset.nQueries);
+    if (queryDim != dataset.dimension) {
+        throw std::runtime_error("Query dimension does not match the base vectors");
+    }
+
+    // A ground-truth file only describes the full base set
+    std::ifstream gtFile(gtPath);
+    if (!gtPath.empty() && gtFile && options.maxBase <= 0) {
+        int gtRows = 0;
+        dataset.groundTruth = readIvecs(gtPath, dataset.nQueries, &dataset.groundTruthK, &gtRows);
+        if (gtRows < dataset.nQueries || dataset.groundTruthK < options.k) {
+            throw std::runtime_error("Ground truth has too few rows or neighbors: " + gtPath);
+        }
+    } else {
+        std::fprintf(stderr, "Computing exact ground truth for %d queries over %d vectors\n",
+                     dataset.nQueries, dataset.nBase);
+        computeGroundTruth(dataset, options.k);
+    }
+    return dataset;
+}
+
+size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+struct BuildSpec {
+    std::string type;
+    std::string label;  // benchmark name prefix, e.g. "hnswpq/pqM:16"
+    int param = 0;      // pqM for the PQ family, numTrees for Annoy
+};
+
+struct BuiltIndex {
+    std::string label;
+    std::unique_ptr<VectorIndex> index;
+    double buildSeconds = 0.0;
+    double memoryMB = 0.0;
+};
+
+class Runner {
+public:
+    Runner(const Options& options, const Dataset& dataset) : options_(options), dataset_(dataset) {}
+
+    // The sweep is registered grouped by build, so only one index is alive at a time
+    BuiltIndex& acquire(const BuildSpec& spec) {
+        if (current_.label == spec.label && current_.index) return current_;
+        current_.index.reset();
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+        const size_t before = residentBytes();
+        const auto start = Clock::now();
+        current_.index = build(spec);
+        if (options_.optimize) current_.index->optimize();
+        current_.buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const size_t after = residentBytes();
+        current_.memoryMB = after > before ? (after - before) / (1024.0 * 1024.0) : 0.0;
+        if (auto* hnswpq = dynamic_cast<HNSWPQIndex*>(current_.index.get())) {
+            current_.memoryMB = hnswpq->getMemoryUsage() / (1024.0 * 1024.0);
+        }
+        current_.label = spec.label;
+        return current_;
+    }
+
+    void runQueries(benchmark::State& state, VectorIndex& index, const BuiltIndex& built) {
+        const int k = options_.k;
+        const int nQueries = dataset_.nQueries;
+        std::vector<int> ids(k);
+        std::vector<float> distances(k);
+        std::vector<double> latencies(nQueries);
+
+        double recall = 0.0;
+        double totalSeconds = 0.0;
+        int64_t passes = 0;
+        for (auto _ : state) {
+            for (int q = 0; q < nQueries; q++) {
+                int count = 0;
+                const auto start = Clock::now();
+                index.search(dataset_.query(q), k, ids.data(), distances.data(), &count);
+                latencies[q] = std::chrono::duration<double>(Clock::now() - start).count();
+                if (passes == 0) {
+                    recall += recallAtK(ids.data(), count, dataset_.neighbors(q), k);
+                }
+            }
+            for (double latency : latencies) totalSeconds += latency;
+            passes++;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min(nQueries - 1, static_cast<int>(p * nQueries))] * 1e6;
+        };
+        state.counters["recall"] = recall / nQueries;
+        state.counters["qps"] = static_cast<double>(passes) * nQueries / totalSeconds;
+        state.counters["p50_us"] = percentile(0.50);
+        state.counters["p99_us"] = percentile(0.99);
+        state.counters["build_s"] = built.buildSeconds;
+        state.counters["memory_mb"] = built.memoryMB;
+        state.SetItemsProcessed(passes * nQueries);
+    }
+
+private:
+    const Options& options_;
+    const Dataset& dataset_;
+    BuiltIndex current_;
+
+    int nLists() const {
+        if (options_.nLists > 0) return options_.nLists;
+        return std::max(1, static_cast<int>(4 * std::sqrt(static_cast<double>(dataset_.nBase))));
+    }
+
+    // Codebooks and centroids are trained on a prefix, as large as the trainers will look at
+    int trainingRows() const { return std::min(dataset_.nBase, 100000); }
+
+    std::unique_ptr<VectorIndex> build(const BuildSpec& spec) {
+        const int dim = dataset_.dimension;
+        const int n = dataset_.nBase;
+        std::vector<int> ids(n);
+        for (int i = 0; i < n; i++) ids[i] = i;
+
+        if (spec.type == "flat") {
+            FlatConfig config;
+            config.metric = dataset_.metric;
+            auto index = std::make_unique<FlatIndex>(dim, n, config);
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "hnsw") {
+            HNSWConfig config;
+            config.M = options_.hnswM;
+            config.efConstruction = options_.efConstruction;
+            config.metric = dataset_.metric;
+            auto index = std::make_unique<HNSWIndex>(dim, n, config);
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "hnswpq") {
+            HNSWPQConfig config;
+            config.M = options_.hnswM;
+            config.efConstruction = options_.efConstruction;
+            config.pqM = spec.param;
+            config.metric = dataset_.metric;
+            config.adcSearch = true;
+            auto index = std::make_unique<HNSWPQIndex>(dim, n, config);
+            index->train(trainingRows(), dataset_.base.data());
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "ivf") {
+            IVFConfig config;
+            config.nLists = nLists();
+            config.metric = dataset_.metric;
+            auto index = std::make_unique<IVFIndex>(dim, n, config);
+            index->train(trainingRows(), dataset_.base.data());
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "ivfpq") {
+            IVFPQConfig config;
+            config.nLists = nLists();
+            config.pqM = spec.param;
+            config.metric = dataset_.metric;
+            auto index = std::make_unique<IVFPQIndex>(dim, n, config);
+            index->train(trainingRows(), dataset_.base.data());
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "pq") {
+            PQConfig config;
+            config.M = spec.param;
+            config.metric = dataset_.metric;
+            auto index = std::make_unique<PQIndex>(dim, n, config);
+            index->train(trainingRows(), dataset_.base.data());
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "lsh") {
+            LSHConfig config;
+            config.numHashTables = options_.lshTables;
+            config.numHashFunctions = options_.lshFunctions;
+            auto index = std::make_unique<LSHIndex>(dim, n, config);
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            return index;
+        }
+        if (spec.type == "annoy") {
+            auto index = std::make_unique<AnnoyIndex>(dim, n, spec.param);
+            index->addBatch(dataset_.base.data(), ids.data(), n);
+            index->build();
+            return index;
+        }
+        throw std::invalid_argument("Unknown index type: " + spec.type);
+    }
+};
+
+std::vector<int> defaultPqM(int dimension) {
+    std::vector<int> values;
+    for (int m : {8, 16, 32}) {
+        if (dimension % m == 0) values.push_back(m);
+    }
+    if (values.empty()) {
+        for (int m = std::min(dimension, 16); m >= 1; m--) {
+            if (dimension % m == 0) {
+                values.push_back(m);
+                break;
+            }
+        }
+    }
+    return values;
+}
+
+// One benchmark per (build, search setting); configure applies the search-time knob
+void registerRun(Runner& runner, const BuildSpec& spec, const std::string& name,
+                 std::function<void(VectorIndex&)> configure) {
+    benchmark::RegisterBenchmark(name.c_str(), [&runner, spec, configure](benchmark::State& state) {
+        BuiltIndex& built = runner.acquire(spec);
+        if (configure) configure(*built.index);
+        runner.runQueries(state, *built.index, built);
+    })->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+void registerSweep(Runner& runner, const Options& options, const Dataset& dataset) {
+    const std::vector<int> pqM = options.pqM.empty() ? defaultPqM(dataset.dimension) : options.pqM;
+
+    for (const auto& type : options.indexes) {
+        if ((type == "lsh" || type == "annoy") && dataset.metric != Metric::L2) {
+            std::fprintf(stderr, "Skipping %s: only L2 is supported\n", type.c_str());
+            continue;
+        }
+
+        if (type == "flat") {
+            registerRun(runner, {type, "flat", 0}, "flat", nullptr);
+        } else if (type == "hnsw") {
+            BuildSpec spec{type, "hnsw/M:" + std::to_string(options.hnswM), 0};
+            for (int ef : options.ef) {
+                registerRun(runner, spec, spec.label + "/ef:" + std::to_string(ef),
+                            [ef](VectorIndex& index) { static_cast<HNSWIndex&>(index).setEfSearch(ef); });
+            }
+        } else if (type == "hnswpq") {
+            for (int m : pqM) {
+                BuildSpec spec{type, "hnswpq/pqM:" + std::to_string(m), m};
+                for (int ef : options.ef) {
+                    registerRun(runner, spec, spec.label + "/ef:" + std::to_string(ef),
+                                [ef](VectorIndex& index) { static_cast<HNSWPQIndex&>(index).setEfSearch(ef); });
+                }
+            }
+        } else if (type == "ivf") {
+            BuildSpec spec{type, "ivf", 0};
+            for (int nProbes : options.nProbes) {
+                registerRun(runner, spec, spec.label + "/nprobe:" + std::to_string(nProbes),
+                            [nProbes](VectorIndex& index) { static_cast<IVFIndex&>(index).setNProbes(nProbes); });
+            }
+        } else if (type == "ivfpq") {
+            for (int m : pqM) {
+                BuildSpec spec{type, "ivfpq/pqM:" + std::to_string(m), m};
+                for (int nProbes : options.nProbes) {
+                    registerRun(runner, spec, spec.label + "/nprobe:" + std::to_string(nProbes),
+                                [nProbes](VectorIndex& index) { static_cast<IVFPQIndex&>(index).setNProbes(nProbes); });
+                }
+            }
+        } else if (type == "pq") {
+            for (int m : pqM) {
+                registerRun(runner, {type, "pq/pqM:" + std::to_string(m), m}, "pq/pqM:" + std::to_string(m), nullptr);
+            }
+        } else if (type == "lsh") {
+            BuildSpec spec{type, "lsh/tables:" + std::to_string(options.lshTables), 0};
+            for (int probes : options.lshProbes) {
+                registerRun(runner, spec, spec.label + "/probes:" + std::to_string(probes),
+                            [probes](VectorIndex& index) { static_cast<LSHIndex&>(index).setNumProbes(probes); });
+            }
+        } else if (type == "annoy") {
+            for (int trees : options.trees) {
+                registerRun(runner, {type, "annoy/trees:" + std::to_string(trees), trees},
+                            "annoy/trees:" + std::to_string(trees), nullptr);
+            }
+        } else {
+            throw std::invalid_argument("Unknown index type: " + type);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    Dataset dataset;
+    try {
+        options = parseOptions(&argc, argv);
+        dataset = loadDataset(options);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    benchmark::AddCustomContext("dataset", dataset.name);
+    benchmark::AddCustomContext("metric", options.metric);
+    benchmark::AddCustomContext("dimension", std::to_string(dataset.dimension));
+    benchmark::AddCustomContext("n_base", std::to_string(dataset.nBase));
+    benchmark::AddCustomContext("n_queries", std::to_string(dataset.nQueries));
+    benchmark::AddCustomContext("k", std::to_string(options.k));
+    benchmark::AddCustomContext("optimize", options.optimize ? "true" : "false");
+
+    Runner runner(options, dataset);
+    try {
+        registerSweep(runner, options, dataset);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
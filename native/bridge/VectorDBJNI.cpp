@@ -2,39 +2,87 @@
 #include "index/HNSWIndex.h"
 #include "index/PQIndex.h"
 #include "index/IVFIndex.h"
+#include "index/IVFPQIndex.h"
 #include "index/LSHIndex.h"
 #include "index/AnnoyIndex.h"
-#include <unordered_map>
+#include "index/FlatIndex.h"
+#include "index/ShardedIndex.h"
+#include "index/AsyncIngestIndex.h"
+#include "core/HandleRegistry.h"
+#include "core/SearchStats.h"
 #include <memory>
-#include <mutex>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
 
 using namespace vectordb;
 
-static std::unordered_map<jlong, std::shared_ptr<VectorIndex>> g_indices;
-static std::mutex g_mutex;
-static jlong g_nextHandle = 1;
+// Handles index a fixed slab; lookups take no lock and touch no shared reference count
+static HandleRegistry<VectorIndex> g_indices(1 << 16);
 
-static jlong registerIndex(std::shared_ptr<VectorIndex> index) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    jlong handle = g_nextHandle++;
-    g_indices[handle] = index;
-    return handle;
+static jlong registerIndex(std::unique_ptr<VectorIndex> index) {
+    return g_indices.add(std::move(index));
 }
 
-static std::shared_ptr<VectorIndex> getIndex(jlong handle) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    auto it = g_indices.find(handle);
-    if (it != g_indices.end()) {
-        return it->second;
-    }
-    return nullptr;
+// Only valid while the caller holds an EpochDomain::Guard
+static VectorIndex* getIndex(jlong handle) {
+    return g_indices.get(handle);
+}
+
+// For calls that may block without bound: holding a Guard there would hold off reclaiming every index
+// removed meanwhile, a pin only keeps this one alive
+static HandleRegistry<VectorIndex>::Pinned pinIndex(jlong handle) {
+    EpochDomain::Guard guard;
+    return g_indices.pin(handle);
 }
 
 static void unregisterIndex(jlong handle) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    g_indices.erase(handle);
+    g_indices.remove(handle);
 }
 
+static void throwJava(JNIEnv* env, const char* className, const char* message) {
+    jclass cls = env->FindClass(className);
+    if (cls) env->ThrowNew(cls, message);
+}
+
+// Address of a direct buffer, throws IllegalArgumentException for heap buffers
+template <typename T>
+static T* directAddress(JNIEnv* env, jobject buffer) {
+    void* address = buffer ? env->GetDirectBufferAddress(buffer) : nullptr;
+    if (!address) throwJava(env, "java/lang/IllegalArgumentException", "Expected a direct ByteBuffer");
+    return static_cast<T*>(address);
+}
+
+/**
+ * Per-thread copies of a query and its results. Calls into an index may block behind exclusive
+ * operations (save, compact, optimize) or a full ingest queue, so Java arrays are copied in and
+ * out rather than pinned, which would hold off GC for the whole JVM while waiting.
+ */
+struct QueryBuffers {
+    std::vector<jfloat> query;
+    std::vector<jint> ids;
+    std::vector<jfloat> distances;
+
+    static QueryBuffers& local() {
+        thread_local QueryBuffers buffers;
+        return buffers;
+    }
+
+    // Copies the first dimension floats of array, false with a Java exception pending on failure
+    bool readQuery(JNIEnv* env, jfloatArray array, int dimension) {
+        query.resize(dimension);
+        env->GetFloatArrayRegion(array, 0, dimension, query.data());
+        return !env->ExceptionCheck();
+    }
+
+    void writeResults(JNIEnv* env, int count, jintArray resultIds, jfloatArray resultDistances) const {
+        if (count <= 0) return;
+        env->SetIntArrayRegion(resultIds, 0, count, ids.data());
+        env->SetFloatArrayRegion(resultDistances, 0, count, distances.data());
+    }
+};
+
 // HNSW Index
 JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeHnswIndex_nativeCreateHNSW
   (JNIEnv *env, jclass clazz, jint dimension, jint maxElements, jint M, jint efConstruction, jint ef) {
@@ -43,8 +91,8 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeHnswIndex_nativeCreateHNSW
         config.M = M;
         config.efConstruction = efConstruction;
         config.efSearch = ef;
-        auto index = std::make_shared<HNSWIndex>(dimension, maxElements, config);
-        return registerIndex(index);
+        auto index = std::make_unique<HNSWIndex>(dimension, maxElements, config);
+        return registerIndex(std::move(index));
     } catch (...) {
         return 0;
     }
@@ -57,8 +105,8 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativePqIndex_nativeCreatePQ
         PQConfig config;
         config.M = M;
         config.nBits = nBits;
-        auto index = std::make_shared<PQIndex>(dimension, maxElements, config);
-        return registerIndex(index);
+        auto index = std::make_unique<PQIndex>(dimension, maxElements, config);
+        return registerIndex(std::move(index));
     } catch (...) {
         return 0;
     }
@@ -66,7 +114,8 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativePqIndex_nativeCreatePQ
 
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativePqIndex_nativeTrain
   (JNIEnv *env, jobject obj, jlong handle, jint nSamples, jfloatArray samples) {
-    auto index = std::dynamic_pointer_cast<PQIndex>(getIndex(handle));
+    EpochDomain::Guard guard;
+    auto* index = dynamic_cast<PQIndex*>(getIndex(handle));
     if (index) {
         jfloat* samplesData = env->GetFloatArrayElements(samples, nullptr);
         index->train(nSamples, samplesData);
@@ -81,8 +130,8 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeIvfIndex_nativeCreateIVF
         IVFConfig config;
         config.nLists = nLists;
         config.nProbes = nProbes;
-        auto index = std::make_shared<IVFIndex>(dimension, maxElements, config);
-        return registerIndex(index);
+        auto index = std::make_unique<IVFIndex>(dimension, maxElements, config);
+        return registerIndex(std::move(index));
     } catch (...) {
         return 0;
     }
@@ -90,7 +139,35 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeIvfIndex_nativeCreateIVF
 
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIvfIndex_nativeTrain
   (JNIEnv *env, jobject obj, jlong handle, jint nSamples, jfloatArray samples) {
-    auto index = std::dynamic_pointer_cast<IVFIndex>(getIndex(handle));
+    EpochDomain::Guard guard;
+    auto* index = dynamic_cast<IVFIndex*>(getIndex(handle));
+    if (index) {
+        jfloat* samplesData = env->GetFloatArrayElements(samples, nullptr);
+        index->train(nSamples, samplesData);
+        env->ReleaseFloatArrayElements(samples, samplesData, JNI_ABORT);
+    }
+}
+
+// IVF-PQ Index
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeIvfPqIndex_nativeCreateIVFPQ
+  (JNIEnv *env, jclass clazz, jint dimension, jint maxElements, jint nLists, jint nProbes, jint pqM, jint nBits) {
+    try {
+        IVFPQConfig config;
+        config.nLists = nLists;
+        config.nProbes = nProbes;
+        config.pqM = pqM;
+        config.nBits = nBits;
+        auto index = std::make_unique<IVFPQIndex>(dimension, maxElements, config);
+        return registerIndex(std::move(index));
+    } catch (...) {
+        return 0;
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIvfPqIndex_nativeTrain
+  (JNIEnv *env, jobject obj, jlong handle, jint nSamples, jfloatArray samples) {
+    EpochDomain::Guard guard;
+    auto* index = dynamic_cast<IVFPQIndex*>(getIndex(handle));
     if (index) {
         jfloat* samplesData = env->GetFloatArrayElements(samples, nullptr);
         index->train(nSamples, samplesData);
@@ -102,8 +179,8 @@ JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIvfIndex_nativeTrain
 JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeLshIndex_nativeCreateLSH
   (JNIEnv *env, jclass clazz, jint dimension, jint maxElements, jint numHashTables, jint numHashFunctions) {
     try {
-        auto index = std::make_shared<LSHIndex>(dimension, maxElements, numHashTables, numHashFunctions);
-        return registerIndex(index);
+        auto index = std::make_unique<LSHIndex>(dimension, maxElements, numHashTables, numHashFunctions);
+        return registerIndex(std::move(index));
     } catch (...) {
         return 0;
     }
@@ -113,8 +190,8 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeLshIndex_nativeCreateLSH
 JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAnnoyIndex_nativeCreateAnnoy
   (JNIEnv *env, jclass clazz, jint dimension, jint maxElements, jint numTrees) {
     try {
-        auto index = std::make_shared<AnnoyIndex>(dimension, maxElements, numTrees);
-        return registerIndex(index);
+        auto index = std::make_unique<AnnoyIndex>(dimension, maxElements, numTrees);
+        return registerIndex(std::move(index));
     } catch (...) {
         return 0;
     }
@@ -122,42 +199,316 @@ JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAnnoyIndex_nativeCreateAnnoy
 
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeAnnoyIndex_nativeBuild
   (JNIEnv *env, jobject obj, jlong handle) {
-    auto index = std::dynamic_pointer_cast<AnnoyIndex>(getIndex(handle));
+    EpochDomain::Guard guard;
+    auto* index = dynamic_cast<AnnoyIndex*>(getIndex(handle));
     if (index) {
         index->build();
     }
 }
 
+// Flat Index
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeFlatIndex_nativeCreateFlat
+  (JNIEnv *env, jclass clazz, jint dimension, jint maxElements) {
+    try {
+        auto index = std::make_unique<FlatIndex>(dimension, maxElements);
+        return registerIndex(std::move(index));
+    } catch (...) {
+        return 0;
+    }
+}
+
+// Sharded HNSW Index
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeShardedHnswIndex_nativeCreateShardedHNSW
+  (JNIEnv *env, jclass clazz, jint dimension, jint maxElementsPerShard, jint numShards,
+   jint M, jint efConstruction, jint ef) {
+    try {
+        HNSWConfig config;
+        config.M = M;
+        config.efConstruction = efConstruction;
+        config.efSearch = ef;
+        auto index = std::make_unique<ShardedIndex>(numShards, [&](int) {
+            return std::make_unique<HNSWIndex>(dimension, maxElementsPerShard, config);
+        });
+        return registerIndex(std::move(index));
+    } catch (...) {
+        return 0;
+    }
+}
+
+// Async ingest HNSW Index
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeCreateAsyncHNSW
+  (JNIEnv *env, jclass clazz, jint dimension, jint maxElements, jint M, jint efConstruction, jint ef,
+   jint queueCapacity, jint batchSize) {
+    try {
+        HNSWConfig config;
+        config.M = M;
+        config.efConstruction = efConstruction;
+        config.efSearch = ef;
+        AsyncIngestConfig ingestConfig;
+        ingestConfig.metric = config.metric;
+        ingestConfig.queueCapacity = queueCapacity;
+        ingestConfig.batchSize = batchSize;
+        auto index = std::make_unique<AsyncIngestIndex>(
+            std::make_unique<HNSWIndex>(dimension, maxElements, config), ingestConfig);
+        return registerIndex(std::move(index));
+    } catch (...) {
+        return 0;
+    }
+}
+
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeIngest
+  (JNIEnv *env, jobject obj, jlong handle, jint id, jfloatArray vector) {
+    // A full queue makes ingest wait for the background worker
+    auto pinned = pinIndex(handle);
+    auto* index = dynamic_cast<AsyncIngestIndex*>(pinned.get());
+    if (!index) return 0;
+
+    QueryBuffers& buffers = QueryBuffers::local();
+    if (!buffers.readQuery(env, vector, index->dimension())) return 0;
+    return static_cast<jlong>(index->ingest(id, buffers.query.data()));
+}
+
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeVisibleSequence
+  (JNIEnv *env, jobject obj, jlong handle) {
+    EpochDomain::Guard guard;
+    auto* index = dynamic_cast<AsyncIngestIndex*>(getIndex(handle));
+    return index ? static_cast<jlong>(index->visibleSequence()) : 0;
+}
+
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeWaitVisible
+  (JNIEnv *env, jobject obj, jlong handle, jlong sequence) {
+    auto pinned = pinIndex(handle);
+    auto* index = dynamic_cast<AsyncIngestIndex*>(pinned.get());
+    if (!index) return;
+
+    try {
+        index->waitVisible(static_cast<uint64_t>(sequence));
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+    }
+}
+
 // Common methods
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeAdd
   (JNIEnv *env, jobject obj, jlong handle, jint id, jfloatArray vector) {
-    auto index = getIndex(handle);
-    if (index) {
-        jfloat* vecData = env->GetFloatArrayElements(vector, nullptr);
-        index->add(id, vecData);
-        env->ReleaseFloatArrayElements(vector, vecData, JNI_ABORT);
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return;
+
+    QueryBuffers& buffers = QueryBuffers::local();
+    if (!buffers.readQuery(env, vector, index->dimension())) return;
+    try {
+        index->add(id, buffers.query.data());
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
     }
 }
 
 JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearch
   (JNIEnv *env, jobject obj, jlong handle, jfloatArray query, jint k, jintArray resultIds, jfloatArray resultDistances) {
-    auto index = getIndex(handle);
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
     if (!index) return 0;
 
-    jfloat* queryData = env->GetFloatArrayElements(query, nullptr);
-    jint* idsData = env->GetIntArrayElements(resultIds, nullptr);
-    jfloat* distsData = env->GetFloatArrayElements(resultDistances, nullptr);
+    QueryBuffers& buffers = QueryBuffers::local();
+    if (!buffers.readQuery(env, query, index->dimension())) return 0;
+    buffers.ids.resize(std::max(k, 0));
+    buffers.distances.resize(std::max(k, 0));
 
     int count = 0;
-    index->search(queryData, k, idsData, distsData, &count);
+    try {
+        index->search(buffers.query.data(), k, buffers.ids.data(), buffers.distances.data(), &count);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
+    }
+    buffers.writeResults(env, count, resultIds, resultDistances);
+    return count;
+}
 
-    env->ReleaseFloatArrayElements(query, queryData, JNI_ABORT);
-    env->ReleaseIntArrayElements(resultIds, idsData, 0);
-    env->ReleaseFloatArrayElements(resultDistances, distsData, 0);
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearchFiltered
+  (JNIEnv *env, jobject obj, jlong handle, jfloatArray query, jint k, jlongArray allowedIds, jintArray resultIds, jfloatArray resultDistances) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return 0;
 
+    QueryBuffers& buffers = QueryBuffers::local();
+    if (!buffers.readQuery(env, query, index->dimension())) return 0;
+    buffers.ids.resize(std::max(k, 0));
+    buffers.distances.resize(std::max(k, 0));
+
+    // One bit per id, the words are copied like the query
+    thread_local std::vector<uint64_t> allowed;
+    const jsize words = env->GetArrayLength(allowedIds);
+    allowed.resize(words);
+    env->GetLongArrayRegion(allowedIds, 0, words, reinterpret_cast<jlong*>(allowed.data()));
+    if (env->ExceptionCheck()) return 0;
+
+    BitsetFilter filter(allowed.data(), static_cast<size_t>(words) * 64);
+    int count = 0;
+    try {
+        index->search(buffers.query.data(), k, buffers.ids.data(), buffers.distances.data(), &count, &filter);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
+    }
+    buffers.writeResults(env, count, resultIds, resultDistances);
     return count;
 }
 
+JNIEXPORT jlongArray JNICALL Java_com_vectordb_jni_NativeIndex_nativeRangeSearch
+  (JNIEnv *env, jobject obj, jlong handle, jfloatArray query, jfloat radius) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return nullptr;
+
+    // The hit count is unknown up front, so results come back in a fresh array of
+    // (id << 32 | float bits of the distance)
+    std::vector<jfloat> queryData(index->dimension());
+    env->GetFloatArrayRegion(query, 0, static_cast<jsize>(queryData.size()), queryData.data());
+    if (env->ExceptionCheck()) return nullptr;
+
+    RangeSearchResult result;
+    try {
+        index->rangeSearch(queryData.data(), radius, result);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return nullptr;
+    }
+
+    std::vector<jlong> packed(result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &result.distances[i], sizeof(bits));
+        packed[i] = static_cast<jlong>((static_cast<uint64_t>(static_cast<uint32_t>(result.ids[i])) << 32) | bits);
+    }
+    jlongArray array = env->NewLongArray(static_cast<jsize>(packed.size()));
+    if (array) env->SetLongArrayRegion(array, 0, static_cast<jsize>(packed.size()), packed.data());
+    return array;
+}
+
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeAddDirect
+  (JNIEnv *env, jobject obj, jlong handle, jint id, jobject vectorBuffer) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return;
+
+    const jfloat* vecData = directAddress<jfloat>(env, vectorBuffer);
+    if (!vecData) return;
+    try {
+        index->add(id, vecData);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+    }
+}
+
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearchDirect
+  (JNIEnv *env, jobject obj, jlong handle, jobject queryBuffer, jint k, jobject resultIdsBuffer, jobject resultDistancesBuffer) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return 0;
+
+    const jfloat* queryData = directAddress<jfloat>(env, queryBuffer);
+    jint* idsData = queryData ? directAddress<jint>(env, resultIdsBuffer) : nullptr;
+    jfloat* distsData = idsData ? directAddress<jfloat>(env, resultDistancesBuffer) : nullptr;
+    if (!distsData) return 0;
+
+    int count = 0;
+    try {
+        index->search(queryData, k, idsData, distsData, &count);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
+    }
+    return count;
+}
+
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeIndex_nativeRemove
+  (JNIEnv *env, jobject obj, jlong handle, jint id) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return JNI_FALSE;
+
+    try {
+        return index->remove(id) ? JNI_TRUE : JNI_FALSE;
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return JNI_FALSE;
+    }
+}
+
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeIndex_nativeUpdate
+  (JNIEnv *env, jobject obj, jlong handle, jint id, jfloatArray vector) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return JNI_FALSE;
+
+    QueryBuffers& buffers = QueryBuffers::local();
+    if (!buffers.readQuery(env, vector, index->dimension())) return JNI_FALSE;
+    try {
+        return index->update(id, buffers.query.data()) ? JNI_TRUE : JNI_FALSE;
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return JNI_FALSE;
+    }
+}
+
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeCompact
+  (JNIEnv *env, jobject obj, jlong handle) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return 0;
+
+    try {
+        return index->compact();
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeOptimize
+  (JNIEnv *env, jobject obj, jlong handle) {
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return;
+
+    try {
+        index->optimize();
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+    }
+}
+
+// Returns the effective mode as pageMode | numaMode << 8
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSetMemoryPolicy
+  (JNIEnv *env, jobject obj, jlong handle, jint pageMode, jint numaMode, jint numaNode) {
+    if (pageMode < static_cast<jint>(PageMode::Default) || pageMode > static_cast<jint>(PageMode::Huge1GB) ||
+        numaMode < static_cast<jint>(NumaMode::None) || numaMode > static_cast<jint>(NumaMode::Interleave)) {
+        throwJava(env, "java/lang/IllegalArgumentException", "Unknown page or NUMA mode");
+        return 0;
+    }
+
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
+    if (!index) return 0;
+
+    try {
+        MemoryPolicy policy;
+        policy.pages = static_cast<PageMode>(pageMode);
+        policy.numa = static_cast<NumaMode>(numaMode);
+        policy.numaNode = numaNode;
+        const MemoryPolicy effective = index->setMemoryPolicy(policy);
+        return static_cast<jint>(effective.pages) | (static_cast<jint>(effective.numa) << 8);
+    } catch (const std::logic_error& e) {
+        throwJava(env, "java/lang/IllegalStateException", e.what());
+        return 0;
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
+    }
+}
+
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeDestroy
   (JNIEnv *env, jobject obj, jlong handle) {
     unregisterIndex(handle);
@@ -166,35 +517,77 @@ JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeDestroy
 // Batch operations
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeAddBatch
   (JNIEnv *env, jobject obj, jlong handle, jobject idsBuffer, jobject vectorsBuffer, jint count, jint dimension) {
-    auto index = getIndex(handle);
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
     if (!index) return;
 
-    jint* idsData = static_cast<jint*>(env->GetDirectBufferAddress(idsBuffer));
-    jfloat* vectorsData = static_cast<jfloat*>(env->GetDirectBufferAddress(vectorsBuffer));
+    if (dimension != index->dimension()) {
+        throwJava(env, "java/lang/IllegalArgumentException", "Vector dimension does not match the index");
+        return;
+    }
+    const jint* idsData = directAddress<jint>(env, idsBuffer);
+    const jfloat* vectorsData = idsData ? directAddress<jfloat>(env, vectorsBuffer) : nullptr;
+    if (!vectorsData) return;
 
-    if (auto hnsw = std::dynamic_pointer_cast<HNSWIndex>(index)) {
-        hnsw->addBatch(vectorsData, idsData, count);
-    } else if (auto pq = std::dynamic_pointer_cast<PQIndex>(index)) {
-        pq->addBatch(vectorsData, idsData, count);
-    } else if (auto ivf = std::dynamic_pointer_cast<IVFIndex>(index)) {
-        ivf->addBatch(vectorsData, idsData, count);
+    try {
+        index->addBatch(vectorsData, idsData, count);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
     }
 }
 
 JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearchBatch
   (JNIEnv *env, jobject obj, jlong handle, jobject queriesBuffer, jint nQueries, jint k, jint dimension, jobject resultIdsBuffer, jobject resultDistancesBuffer) {
-    auto index = getIndex(handle);
+    EpochDomain::Guard guard;
+    VectorIndex* index = getIndex(handle);
     if (!index) return 0;
 
-    jfloat* queriesData = static_cast<jfloat*>(env->GetDirectBufferAddress(queriesBuffer));
-    jint* resultIdsData = static_cast<jint*>(env->GetDirectBufferAddress(resultIdsBuffer));
-    jfloat* resultDistsData = static_cast<jfloat*>(env->GetDirectBufferAddress(resultDistancesBuffer));
+    if (dimension != index->dimension()) {
+        throwJava(env, "java/lang/IllegalArgumentException", "Query dimension does not match the index");
+        return 0;
+    }
+    const jfloat* queriesData = directAddress<jfloat>(env, queriesBuffer);
+    jint* resultIdsData = queriesData ? directAddress<jint>(env, resultIdsBuffer) : nullptr;
+    jfloat* resultDistsData = resultIdsData ? directAddress<jfloat>(env, resultDistancesBuffer) : nullptr;
+    if (!resultDistsData) return 0;
 
-    if (auto hnsw = std::dynamic_pointer_cast<HNSWIndex>(index)) {
-        hnsw->searchBatch(queriesData, nQueries, k, resultIdsData, resultDistsData);
-    } else if (auto pq = std::dynamic_pointer_cast<PQIndex>(index)) {
-        pq->searchBatch(queriesData, nQueries, k, resultIdsData, resultDistsData);
+    // Every searchBatch pads missing results with id -1, which the Java side skips
+    try {
+        index->searchBatch(queriesData, nQueries, k, resultIdsData, resultDistsData);
+    } catch (const std::exception& e) {
+        throwJava(env, "java/lang/RuntimeException", e.what());
+        return 0;
     }
 
     return nQueries;
 }
+
+// Search statistics
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeEnabled
+  (JNIEnv *env, jclass clazz) {
+    return searchstats::enabled() ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlongArray JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeSnapshot
+  (JNIEnv *env, jclass clazz) {
+    // Flattened as [queries, sums[NUM_FIELDS], buckets[NUM_FIELDS][NUM_BUCKETS]]
+    const SearchStatsSnapshot snapshot = searchstats::snapshot();
+    constexpr int fields = SearchStatsSnapshot::NUM_FIELDS;
+    constexpr int buckets = SearchStatsSnapshot::NUM_BUCKETS;
+    std::vector<jlong> packed(1 + fields + fields * buckets);
+    packed[0] = static_cast<jlong>(snapshot.queries);
+    for (int f = 0; f < fields; f++) {
+        packed[1 + f] = static_cast<jlong>(snapshot.sums[f]);
+        for (int b = 0; b < buckets; b++) {
+            packed[1 + fields + f * buckets + b] = static_cast<jlong>(snapshot.buckets[f][b]);
+        }
+    }
+    jlongArray array = env->NewLongArray(static_cast<jsize>(packed.size()));
+    if (array) env->SetLongArrayRegion(array, 0, static_cast<jsize>(packed.size()), packed.data());
+    return array;
+}
+
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeReset
+  (JNIEnv *env, jclass clazz) {
+    searchstats::reset();
+}
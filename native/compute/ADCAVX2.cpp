@@ -0,0 +1,87 @@
+#include "ADCUtils.h"
+
+// Compiled with -mavx2 -mfma for this file only, called only after runtime detection
+#if defined(HAVE_AVX2)
+#include <immintrin.h>
+
+namespace vectordb {
+
+float adcDistanceAVX2(const float* distanceTable, const uint8_t* codes, int pqM, int nCentroids) {
+    // Process 8 subspaces at a time using AVX2
+    __m256 sumVec = _mm256_setzero_ps();
+
+    int m = 0;
+    // Process 8 subspaces at a time
+    for (; m + 8 <= pqM; m += 8) {
+        // Load 8 code indices
+        uint32_t idx0 = codes[m];
+        uint32_t idx1 = codes[m + 1];
+        uint32_t idx2 = codes[m + 2];
+        uint32_t idx3 = codes[m + 3];
+        uint32_t idx4 = codes[m + 4];
+        uint32_t idx5 = codes[m + 5];
+        uint32_t idx6 = codes[m + 6];
+        uint32_t idx7 = codes[m + 7];
+
+        // Gather 8 float values from distance table
+        // distanceTable layout: [pqM][nCentroids]
+        const float* tableBase0 = distanceTable + (m + 0) * nCentroids;
+        const float* tableBase1 = distanceTable + (m + 1) * nCentroids;
+        const float* tableBase2 = distanceTable + (m + 2) * nCentroids;
+        const float* tableBase3 = distanceTable + (m + 3) * nCentroids;
+        const float* tableBase4 = distanceTable + (m + 4) * nCentroids;
+        const float* tableBase5 = distanceTable + (m + 5) * nCentroids;
+        const float* tableBase6 = distanceTable + (m + 6) * nCentroids;
+        const float* tableBase7 = distanceTable + (m + 7) * nCentroids;
+
+        // Load the 8 distance values
+        __m256 distVec = _mm256_set_ps(
+            tableBase7[idx7], tableBase6[idx6], tableBase5[idx5], tableBase4[idx4],
+            tableBase3[idx3], tableBase2[idx2], tableBase1[idx1], tableBase0[idx0]
+        );
+
+        sumVec = _mm256_add_ps(sumVec, distVec);
+    }
+
+    // Horizontal sum of sumVec
+    __m128 sumLow = _mm256_castps256_ps128(sumVec);
+    __m128 sumHigh = _mm256_extractf128_ps(sumVec, 1);
+    sumLow = _mm_add_ps(sumLow, sumHigh);
+    sumLow = _mm_hadd_ps(sumLow, sumLow);
+    sumLow = _mm_hadd_ps(sumLow, sumLow);
+    float result = _mm_cvtss_f32(sumLow);
+
+    // Process remaining subspaces
+    for (; m < pqM; m++) {
+        result += distanceTable[m * nCentroids + codes[m]];
+    }
+
+    return result;
+}
+
+void adcDistanceBatchAVX2(const float* distanceTable, const uint8_t* codes,
+                          int nCodes, int pqM, int nCentroids, float* distances) {
+    // Eight codes per register, one lane each; every subspace is a single gather from its table row.
+    // Lanes accumulate subspaces in order, so results match adcDistanceScalar exactly
+    int c = 0;
+    for (; c + 8 <= nCodes; c += 8) {
+        const uint8_t* block = codes + static_cast<size_t>(c) * pqM;
+        __m256 sum = _mm256_setzero_ps();
+        for (int m = 0; m < pqM; m++) {
+            const __m256i idx = _mm256_set_epi32(
+                block[7 * pqM + m], block[6 * pqM + m], block[5 * pqM + m], block[4 * pqM + m],
+                block[3 * pqM + m], block[2 * pqM + m], block[pqM + m], block[m]);
+            sum = _mm256_add_ps(sum, _mm256_i32gather_ps(distanceTable + static_cast<size_t>(m) * nCentroids, idx, 4));
+        }
+        _mm256_storeu_ps(distances + c, sum);
+    }
+
+    // Handle remaining codes
+    for (; c < nCodes; c++) {
+        distances[c] = adcDistanceAVX2(distanceTable, codes + static_cast<size_t>(c) * pqM, pqM, nCentroids);
+    }
+}
+
+} // namespace vectordb
+
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include "DistanceUtils.h"
 
 namespace vectordb {
 
@@ -44,6 +45,29 @@ float adcDistanceAVX2(const float* distanceTable, const uint8_t* codes, int pqM,
 void adcDistanceBatchAVX2(const float* distanceTable, const uint8_t* codes,
                           int nCodes, int pqM, int nCentroids, float* distances);
 
+/**
+ * 构建 ADC 距离表
+ * L2 写入子向量到各聚类中心的平方距离；INNER_PRODUCT/COSINE 写入负内积，
+ * 按子空间累加后即为查询与重建向量的负内积 (COSINE 要求查询和编码前的向量已归一化)
+ * @param query 查询向量 [pqM * subDim]
+ * @param codebooks 码本 [pqM][nCentroids][subDim]
+ * @param table 输出距离表 [pqM][nCentroids]
+ */
+void buildADCTable(Metric metric, const float* query, const float* codebooks,
+                   int pqM, int nCentroids, int subDim, float* table);
+
+/**
+ * 用 GEMM 批量构建多个查询的 ADC 距离表
+ * 每个子空间做一次 [nQueries][subDim] x [nCentroids][subDim]^T 的矩阵乘 (BLAS 可用时走 sgemm)，
+ * L2 再按 ||q||^2 + ||c||^2 - 2 q·c 换算；结果与 buildADCTable 相同 (浮点误差内)
+ * @param queries 查询向量 [nQueries][pqM * subDim]
+ * @param codebookNorms 聚类中心模长平方 [pqM][nCentroids]，只有 L2 使用
+ * @param tables 输出距离表 [nQueries][pqM][nCentroids]
+ */
+void buildADCTables(Metric metric, const float* queries, int nQueries,
+                    const float* codebooks, const float* codebookNorms,
+                    int pqM, int nCentroids, int subDim, float* tables);
+
 /**
  * 获取最优 ADC 距离计算函数
  */
@@ -71,50 +71,53 @@ void computeRowNormsSquared(const float* matrix, size_t rows, size_t cols, float
 #endif
 }
 
-void batchEuclideanDistance(const float* query, const float* vectors,
-                            size_t n, size_t dim, float* distances) {
-    // Compute ||query||^2
-    float queryNormSq = 0.0f;
-    for (size_t i = 0; i < dim; i++) {
-        queryNormSq += query[i] * query[i];
-    }
-
-    // Compute ||vector_i||^2 for each vector
-    std::vector<float> vectorNorms(n);
-    computeRowNormsSquared(vectors, n, dim, vectorNorms.data());
-
-    // Compute 2 * query^T * vectors using matrix multiplication
+void batchInnerProduct(const float* query, const float* vectors,
+                       size_t n, size_t dim, float* dots) {
+#if defined(USE_ACCELERATE) || defined(USE_OPENBLAS)
     // query is [1][dim], vectors is [n][dim], result is [n]
-    std::vector<float> dotProducts(n);
-#if defined(USE_ACCELERATE)
-    cblas_sgemv(CblasRowMajor, CblasNoTrans,
-                static_cast<int>(n), static_cast<int>(dim),
-                2.0f, vectors, static_cast<int>(dim),
-                query, 1,
-                0.0f, dotProducts.data(), 1);
-#elif defined(USE_OPENBLAS)
     cblas_sgemv(CblasRowMajor, CblasNoTrans,
                 static_cast<int>(n), static_cast<int>(dim),
-                2.0f, vectors, static_cast<int>(dim),
+                1.0f, vectors, static_cast<int>(dim),
                 query, 1,
-                0.0f, dotProducts.data(), 1);
+                0.0f, dots, 1);
 #else
     for (size_t i = 0; i < n; i++) {
         float sum = 0.0f;
         for (size_t j = 0; j < dim; j++) {
             sum += vectors[i * dim + j] * query[j];
         }
-        dotProducts[i] = 2.0f * sum;
+        dots[i] = sum;
     }
 #endif
+}
+
+void batchEuclideanDistance(const float* query, const float* vectors,
+                            size_t n, size_t dim, float* distances) {
+    // Compute ||vector_i||^2 for each vector
+    std::vector<float> vectorNorms(n);
+    computeRowNormsSquared(vectors, n, dim, vectorNorms.data());
+    batchEuclideanDistance(query, vectors, vectorNorms.data(), n, dim, distances);
+}
+
+void batchEuclideanDistance(const float* query, const float* vectors, const float* vectorNormsSq,
+                            size_t n, size_t dim, float* distances) {
+    // Compute ||query||^2
+    float queryNormSq = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        queryNormSq += query[i] * query[i];
+    }
+
+    // Compute query^T * vectors, written straight into the output
+    batchInnerProduct(query, vectors, n, dim, distances);
 
     // Compute Euclidean distance: ||q - v||^2 = ||q||^2 + ||v||^2 - 2*q^T*v
     for (size_t i = 0; i < n; i++) {
-        distances[i] = queryNormSq + vectorNorms[i] - dotProducts[i];
+        float dist = queryNormSq + vectorNormsSq[i] - 2.0f * distances[i];
         // Handle numerical errors (can be slightly negative)
-        if (distances[i] < 0.0f && distances[i] > -1e-6f) {
-            distances[i] = 0.0f;
+        if (dist < 0.0f && dist > -1e-6f) {
+            dist = 0.0f;
         }
+        distances[i] = dist;
     }
 }
 
@@ -21,6 +21,23 @@ namespace vectordb {
 void batchEuclideanDistance(const float* query, const float* vectors,
                             size_t n, size_t dim, float* distances);
 
+/**
+ * 批量欧氏距离计算（预计算范数版本）
+ * 与上面相同，但直接使用调用方缓存的 ||v||^2，省去每次扫描时重算
+ * @param vectorNormsSq 向量范数平方 [n]
+ */
+void batchEuclideanDistance(const float* query, const float* vectors, const float* vectorNormsSq,
+                            size_t n, size_t dim, float* distances);
+
+/**
+ * 批量内积计算 (GEMV)
+ * @param query 查询向量 [dim]
+ * @param vectors 向量数组 [n][dim]
+ * @param dots 输出内积 [n]
+ */
+void batchInnerProduct(const float* query, const float* vectors,
+                       size_t n, size_t dim, float* dots);
+
 /**
  * 批量欧氏距离计算（多查询版本）
  * 计算 queries 中每个查询与 vectors 中每个向量的距离
@@ -1,6 +1,7 @@
 #include "DistanceUtils.h"
 
-#if defined(__x86_64__) || defined(_M_X64)
+// Compiled with -mavx2 -mfma -mf16c for this file only, called only after runtime detection
+#if defined(HAVE_AVX2)
 #include <immintrin.h>
 #include <cstdint>
 
@@ -56,6 +57,35 @@ float cosineDistanceAVX2(const float* a, const float* b, size_t dim) {
     return 1.0f - dotProduct;
 }
 
+float dotProductAVX2(const float* a, const float* b, size_t dim) {
+    __m256 dot0 = _mm256_setzero_ps();
+    __m256 dot1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= dim; i += 16) {
+        dot0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), dot0);
+        dot1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), dot1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        dot0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), dot0);
+    }
+    dot0 = _mm256_add_ps(dot0, dot1);
+
+    __m128 dotLow = _mm256_castps256_ps128(dot0);
+    __m128 dotHigh = _mm256_extractf128_ps(dot0, 1);
+    dotLow = _mm_add_ps(dotLow, dotHigh);
+    dotLow = _mm_hadd_ps(dotLow, dotLow);
+    dotLow = _mm_hadd_ps(dotLow, dotLow);
+    float dotProduct = _mm_cvtss_f32(dotLow);
+
+    for (; i < dim; i++) {
+        dotProduct += a[i] * b[i];
+    }
+
+    // Negated so that smaller is closer, like the other distances
+    return -dotProduct;
+}
+
 void batchEuclideanDistanceAVX2(const float* query, const float* vectors,
                                        size_t n, size_t dim, float* distances) {
     const size_t simdWidth = 8;
@@ -88,6 +118,83 @@ void batchEuclideanDistanceAVX2(const float* query, const float* vectors,
     }
 }
 
+static inline float horizontalSum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    return _mm_cvtss_f32(sum);
+}
+
+// 8 codes widened to float and mapped back through the per-dimension range
+static inline __m256 decodeSQ8(const uint8_t* code, const float* vmin, const float* scale) {
+    __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(code)));
+    return _mm256_fmadd_ps(_mm256_cvtepi32_ps(c), _mm256_loadu_ps(scale), _mm256_loadu_ps(vmin));
+}
+
+float sq8EuclideanDistanceAVX2(const float* query, const uint8_t* code,
+                               const float* vmin, const float* scale, size_t dim) {
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(query + i), decodeSQ8(code + i, vmin + i, scale + i));
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+
+    float total = horizontalSum(sum);
+    for (; i < dim; i++) {
+        float diff = query[i] - (vmin[i] + code[i] * scale[i]);
+        total += diff * diff;
+    }
+    return total;
+}
+
+float sq8DotProductAVX2(const float* query, const uint8_t* code,
+                        const float* vmin, const float* scale, size_t dim) {
+    __m256 dot = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        dot = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), decodeSQ8(code + i, vmin + i, scale + i), dot);
+    }
+
+    float total = horizontalSum(dot);
+    for (; i < dim; i++) {
+        total += query[i] * (vmin[i] + code[i] * scale[i]);
+    }
+    return -total;
+}
+
+float fp16EuclideanDistanceAVX2(const float* query, const uint16_t* code, size_t dim) {
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i)));
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(query + i), x);
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+
+    float total = horizontalSum(sum);
+    for (; i < dim; i++) {
+        float diff = query[i] - halfToFloat(code[i]);
+        total += diff * diff;
+    }
+    return total;
+}
+
+float fp16DotProductAVX2(const float* query, const uint16_t* code, size_t dim) {
+    __m256 dot = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i)));
+        dot = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), x, dot);
+    }
+
+    float total = horizontalSum(dot);
+    for (; i < dim; i++) {
+        total += query[i] * halfToFloat(code[i]);
+    }
+    return -total;
+}
+
 } // namespace vectordb
 
 #endif
@@ -0,0 +1,158 @@
+#include "DistanceUtils.h"
+
+// Compiled with -mavx512f -mfma -mf16c for this file only, called only after runtime detection
+#if defined(HAVE_AVX512)
+#include <immintrin.h>
+
+// GCC 12's avx512fintrin.h seeds the passthrough operand of unmasked intrinsics (reductions,
+// conversions, extracts) with _mm512_undefined_*, which -Wuninitialized flags once inlined here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace vectordb {
+
+// Lanes [0, n) of a 16-float register, used for masked tail loads
+static inline __mmask16 tailMask(size_t n) {
+    return static_cast<__mmask16>((1u << n) - 1);
+}
+
+float euclideanDistanceAVX512(const float* a, const float* b, size_t dim) {
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 32 <= dim; i += 32) {
+        __m512 diff0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 diff1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        sum0 = _mm512_fmadd_ps(diff, diff, sum0);
+    }
+    if (i < dim) {
+        // Masked-off lanes load as zero and are never touched in memory
+        const __mmask16 mask = tailMask(dim - i);
+        __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        sum1 = _mm512_fmadd_ps(diff, diff, sum1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+static inline float dotAVX512(const float* a, const float* b, size_t dim) {
+    __m512 dot0 = _mm512_setzero_ps();
+    __m512 dot1 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 32 <= dim; i += 32) {
+        dot0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), dot0);
+        dot1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), dot1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        dot0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), dot0);
+    }
+    if (i < dim) {
+        const __mmask16 mask = tailMask(dim - i);
+        dot1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), dot1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(dot0, dot1));
+}
+
+float dotProductAVX512(const float* a, const float* b, size_t dim) {
+    return -dotAVX512(a, b, dim);
+}
+
+float cosineDistanceAVX512(const float* a, const float* b, size_t dim) {
+    return 1.0f - dotAVX512(a, b, dim);
+}
+
+void batchEuclideanDistanceAVX512(const float* query, const float* vectors,
+                                  size_t n, size_t dim, float* distances) {
+    for (size_t i = 0; i < n; i++) {
+        distances[i] = euclideanDistanceAVX512(query, vectors + i * dim, dim);
+    }
+}
+
+static inline __m512 decodeSQ8(const uint8_t* code, const float* vmin, const float* scale) {
+    __m512i c = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(code)));
+    return _mm512_fmadd_ps(_mm512_cvtepi32_ps(c), _mm512_loadu_ps(scale), _mm512_loadu_ps(vmin));
+}
+
+// Byte-granular masked loads need AVX-512BW, the short tail is finished in scalar code
+float sq8EuclideanDistanceAVX512(const float* query, const uint8_t* code,
+                                 const float* vmin, const float* scale, size_t dim) {
+    __m512 sum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(query + i), decodeSQ8(code + i, vmin + i, scale + i));
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+
+    float total = _mm512_reduce_add_ps(sum);
+    for (; i < dim; i++) {
+        float diff = query[i] - (vmin[i] + code[i] * scale[i]);
+        total += diff * diff;
+    }
+    return total;
+}
+
+float sq8DotProductAVX512(const float* query, const uint8_t* code,
+                          const float* vmin, const float* scale, size_t dim) {
+    __m512 dot = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        dot = _mm512_fmadd_ps(_mm512_loadu_ps(query + i), decodeSQ8(code + i, vmin + i, scale + i), dot);
+    }
+
+    float total = _mm512_reduce_add_ps(dot);
+    for (; i < dim; i++) {
+        total += query[i] * (vmin[i] + code[i] * scale[i]);
+    }
+    return -total;
+}
+
+float fp16EuclideanDistanceAVX512(const float* query, const uint16_t* code, size_t dim) {
+    __m512 sum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 x = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + i)));
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(query + i), x);
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+
+    float total = _mm512_reduce_add_ps(sum);
+    for (; i < dim; i++) {
+        float diff = query[i] - halfToFloat(code[i]);
+        total += diff * diff;
+    }
+    return total;
+}
+
+float fp16DotProductAVX512(const float* query, const uint16_t* code, size_t dim) {
+    __m512 dot = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 x = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + i)));
+        dot = _mm512_fmadd_ps(_mm512_loadu_ps(query + i), x, dot);
+    }
+
+    float total = _mm512_reduce_add_ps(dot);
+    for (; i < dim; i++) {
+        total += query[i] * halfToFloat(code[i]);
+    }
+    return -total;
+}
+
+} // namespace vectordb
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
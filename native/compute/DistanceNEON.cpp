@@ -0,0 +1,70 @@
+#include "DistanceUtils.h"
+
+// NEON is part of the AArch64 baseline, no extra target flags are needed
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+
+namespace vectordb {
+
+float euclideanDistanceNEON(const float* a, const float* b, size_t dim) {
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= dim; i += 8) {
+        float32x4_t diff0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t diff1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        sum0 = vfmaq_f32(sum0, diff0, diff0);
+        sum1 = vfmaq_f32(sum1, diff1, diff1);
+    }
+    for (; i + 4 <= dim; i += 4) {
+        float32x4_t diff = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        sum0 = vfmaq_f32(sum0, diff, diff);
+    }
+
+    float total = vaddvq_f32(vaddq_f32(sum0, sum1));
+    for (; i < dim; i++) {
+        float diff = a[i] - b[i];
+        total += diff * diff;
+    }
+    return total;
+}
+
+static inline float dotNEON(const float* a, const float* b, size_t dim) {
+    float32x4_t dot0 = vdupq_n_f32(0.0f);
+    float32x4_t dot1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= dim; i += 8) {
+        dot0 = vfmaq_f32(dot0, vld1q_f32(a + i), vld1q_f32(b + i));
+        dot1 = vfmaq_f32(dot1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    for (; i + 4 <= dim; i += 4) {
+        dot0 = vfmaq_f32(dot0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+
+    float total = vaddvq_f32(vaddq_f32(dot0, dot1));
+    for (; i < dim; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+float dotProductNEON(const float* a, const float* b, size_t dim) {
+    return -dotNEON(a, b, dim);
+}
+
+float cosineDistanceNEON(const float* a, const float* b, size_t dim) {
+    return 1.0f - dotNEON(a, b, dim);
+}
+
+void batchEuclideanDistanceNEON(const float* query, const float* vectors,
+                                size_t n, size_t dim, float* distances) {
+    for (size_t i = 0; i < n; i++) {
+        distances[i] = euclideanDistanceNEON(query, vectors + i * dim, dim);
+    }
+}
+
+} // namespace vectordb
+
+#endif
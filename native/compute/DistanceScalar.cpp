@@ -1,6 +1,7 @@
 #include "DistanceUtils.h"
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 
 namespace vectordb {
 
@@ -29,12 +30,109 @@ float dotProductScalar(const float* a, const float* b, size_t dim) {
     return -dot;
 }
 
-static void batchEuclideanDistanceScalar(const float* query, const float* vectors,
-                                         size_t n, size_t dim, float* distances) {
+void batchEuclideanDistanceScalar(const float* query, const float* vectors,
+                                  size_t n, size_t dim, float* distances) {
     for (size_t i = 0; i < n; i++) {
         const float* vec = vectors + i * dim;
         distances[i] = euclideanDistanceScalar(query, vec, dim);
     }
 }
 
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    const uint32_t absBits = bits & 0x7fffffffu;
+
+    if (absBits >= 0x7f800000u) {
+        // Inf stays Inf, NaN stays a quiet NaN
+        return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u);
+    }
+    if (absBits >= 0x477ff000u) {
+        // 65520 and above round past the largest half (65504)
+        return sign | 0x7c00u;
+    }
+    if (absBits < 0x38800000u) {
+        // Below 2^-14: half subnormal, value = m * 2^-24
+        if (absBits < 0x33000000u) return sign;
+        const uint32_t exponent = absBits >> 23;
+        const uint32_t mantissa = (absBits & 0x7fffffu) | 0x800000u;
+        const uint32_t shift = 126 - exponent;
+        uint32_t m = mantissa >> shift;
+        const uint32_t rem = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (m & 1u))) m++;
+        return static_cast<uint16_t>(sign | m);
+    }
+
+    // Rebias the exponent from 127 to 15, a mantissa carry rolls into the exponent
+    uint32_t h = (absBits - 0x38000000u) >> 13;
+    const uint32_t rem = absBits & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) h++;
+    return static_cast<uint16_t>(sign | h);
+}
+
+float halfToFloat(uint16_t value) {
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+    uint32_t bits;
+
+    if (exponent == 0x1fu) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal half, normalize into a float
+        int shift = 0;
+        while (!(mantissa & 0x400u)) {
+            mantissa <<= 1;
+            shift++;
+        }
+        bits = sign | (static_cast<uint32_t>(113 - shift) << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+float sq8EuclideanDistanceScalar(const float* query, const uint8_t* code,
+                                 const float* vmin, const float* scale, size_t dim) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        float diff = query[i] - (vmin[i] + code[i] * scale[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float sq8DotProductScalar(const float* query, const uint8_t* code,
+                          const float* vmin, const float* scale, size_t dim) {
+    float dot = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        dot += query[i] * (vmin[i] + code[i] * scale[i]);
+    }
+    return -dot;
+}
+
+float fp16EuclideanDistanceScalar(const float* query, const uint16_t* code, size_t dim) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        float diff = query[i] - halfToFloat(code[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float fp16DotProductScalar(const float* query, const uint16_t* code, size_t dim) {
+    float dot = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        dot += query[i] * halfToFloat(code[i]);
+    }
+    return -dot;
+}
+
 } // namespace vectordb
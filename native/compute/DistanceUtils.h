@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <cmath>
 
 namespace vectordb {
 
@@ -16,6 +17,23 @@ enum class ISA {
     NEON
 };
 
+/**
+ * 距离度量，所有度量下距离都是越小越相似
+ * - L2: 欧氏距离平方
+ * - INNER_PRODUCT: 负内积 (MIPS)
+ * - COSINE: 1 - cos，利用预存模长换算，热循环只有一次点积
+ * 数值会写入索引文件，不可改动已有取值
+ */
+enum class Metric : int32_t {
+    L2 = 0,
+    INNER_PRODUCT = 1,
+    COSINE = 2
+};
+
+inline bool isValidMetric(int32_t value) {
+    return value >= static_cast<int32_t>(Metric::L2) && value <= static_cast<int32_t>(Metric::COSINE);
+}
+
 /**
  * 距离计算函数类型
  */
@@ -26,11 +44,43 @@ using DistanceFunc = float(*)(const float*, const float*, size_t);
  */
 using BatchDistanceFunc = void(*)(const float*, const float*, size_t, size_t, float*);
 
+/**
+ * 量化存储的非对称距离函数: float 查询对量化后的库向量，约定与 float 内核一致
+ * (L2 返回平方距离，内积返回负内积)
+ * - SQ8: 逐维 8 位量化，x[i] = vmin[i] + code[i] * scale[i]
+ * - FP16: IEEE 754 半精度
+ */
+using SQ8DistanceFunc = float(*)(const float* query, const uint8_t* code,
+                                 const float* vmin, const float* scale, size_t dim);
+using FP16DistanceFunc = float(*)(const float* query, const uint16_t* code, size_t dim);
+
 /**
  * 运行时检测当前CPU支持的指令集
+ * 同时检查 CPUID 特性位和操作系统是否保存对应寄存器状态 (XGETBV)
  */
 ISA detectISA();
 
+/**
+ * 一组指令集专用的距离内核
+ * 每组内核在单独的编译单元中以该指令集的编译选项构建，只在运行时检测通过后调用
+ */
+struct DistanceKernels {
+    DistanceFunc euclidean;          // 欧氏距离平方
+    DistanceFunc innerProduct;       // 负内积 (越小越相似)
+    DistanceFunc cosine;             // 1 - 内积 (向量需已归一化)
+    BatchDistanceFunc batchEuclidean;
+    SQ8DistanceFunc sq8Euclidean;
+    SQ8DistanceFunc sq8InnerProduct;  // 负内积
+    FP16DistanceFunc fp16Euclidean;
+    FP16DistanceFunc fp16InnerProduct;  // 负内积
+};
+
+/**
+ * 获取指定指令集的内核表
+ * 该指令集未编译进当前二进制或当前CPU不支持时返回 nullptr；SCALAR 总是可用
+ */
+const DistanceKernels* getDistanceKernels(ISA isa);
+
 /**
  * 获取当前CPU指令集名称字符串
  */
@@ -46,6 +96,66 @@ DistanceFunc getEuclideanDistanceFunc();
  */
 DistanceFunc getCosineDistanceFunc();
 
+/**
+ * 获取最优内积距离计算函数 (返回负内积)
+ */
+DistanceFunc getInnerProductDistanceFunc();
+
+/**
+ * 获取度量对应的最优内核
+ * COSINE 与 INNER_PRODUCT 一样返回负内积内核，调用方再用 cosineFromNegDot 换算
+ */
+DistanceFunc getDistanceFunc(Metric metric);
+
+/**
+ * 获取度量对应的最优量化距离内核，COSINE 同样返回负内积内核
+ */
+SQ8DistanceFunc getSQ8DistanceFunc(Metric metric);
+FP16DistanceFunc getFP16DistanceFunc(Metric metric);
+
+/**
+ * float 与 IEEE 754 半精度互转 (就近舍入到偶数，超出范围饱和为无穷大)
+ */
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+/**
+ * 由负内积和两侧的平方模长得到余弦距离 1 - cos；任一侧为零向量时返回 1
+ */
+inline float cosineFromNegDot(float negDot, float normSqA, float normSqB) {
+    const float denom = std::sqrt(normSqA * normSqB);
+    return denom > 0.0f ? 1.0f + negDot / denom : 1.0f;
+}
+
+/**
+ * 由 GEMM/GEMV 得到的内积换算为度量距离 (L2 用两侧平方模长展开)
+ * COSINE 要求查询已归一化 (queryNormSq 视为 1)，vectorNormSq 为库向量的平方模长
+ */
+inline float distanceFromDot(Metric metric, float dot, float queryNormSq, float vectorNormSq) {
+    switch (metric) {
+        case Metric::INNER_PRODUCT: return -dot;
+        case Metric::COSINE:        return cosineFromNegDot(-dot, 1.0f, vectorNormSq);
+        default: {
+            const float dist = queryNormSq + vectorNormSq - 2.0f * dot;
+            return dist > 0.0f ? dist : 0.0f;
+        }
+    }
+}
+
+/**
+ * 将向量归一化到单位长度写入 out；零向量原样拷贝
+ */
+inline void normalizeVector(const float* vector, size_t dim, float* out) {
+    float normSq = 0.0f;
+    for (size_t i = 0; i < dim; i++) {
+        normSq += vector[i] * vector[i];
+    }
+    const float scale = normSq > 0.0f ? 1.0f / std::sqrt(normSq) : 1.0f;
+    for (size_t i = 0; i < dim; i++) {
+        out[i] = vector[i] * scale;
+    }
+}
+
 /**
  * 获取批量欧氏距离计算函数
  */
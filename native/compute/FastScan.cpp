@@ -0,0 +1,91 @@
+#include "FastScan.h"
+#include "DistanceUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vectordb {
+
+void packFastScanCode(const uint8_t* code, int pqM, size_t index, uint8_t* packed) {
+    const size_t block = index / FASTSCAN_BLOCK;
+    const int slot = static_cast<int>(index % FASTSCAN_BLOCK);
+    uint8_t* base = packed + block * fastScanBlockBytes(pqM) + (slot & 15);
+    const int shift = slot < 16 ? 0 : 4;
+    const uint8_t keep = slot < 16 ? 0xf0 : 0x0f;
+
+    for (int m = 0; m < pqM; m++) {
+        uint8_t& byte = base[static_cast<size_t>(m) * 16];
+        byte = static_cast<uint8_t>((byte & keep) | ((code[m] & 0x0f) << shift));
+    }
+}
+
+void quantizeFastScanLUT(const float* table, int pqM, uint8_t* lut, float* bias, float* scale) {
+    // One shared step keeps the entries additive, each row is shifted by its own minimum
+    float totalBias = 0.0f;
+    float maxRange = 0.0f;
+    for (int m = 0; m < pqM; m++) {
+        const float* row = table + static_cast<size_t>(m) * 16;
+        const auto [lo, hi] = std::minmax_element(row, row + 16);
+        totalBias += *lo;
+        maxRange = std::max(maxRange, *hi - *lo);
+    }
+
+    const float step = maxRange > 0.0f ? maxRange / 255.0f : 1.0f;
+    const float invStep = 1.0f / step;
+    for (int m = 0; m < pqM; m++) {
+        const float* row = table + static_cast<size_t>(m) * 16;
+        const float rowMin = *std::min_element(row, row + 16);
+        for (int c = 0; c < 16; c++) {
+            const float q = std::round((row[c] - rowMin) * invStep);
+            lut[static_cast<size_t>(m) * 16 + c] = static_cast<uint8_t>(std::min(255.0f, q));
+        }
+    }
+    if (pqM & 1) {
+        std::fill(lut + static_cast<size_t>(pqM) * 16, lut + static_cast<size_t>(pqM + 1) * 16, 0);
+    }
+
+    *bias = totalBias;
+    *scale = step;
+}
+
+void fastScanScalar(const uint8_t* packed, size_t nBlocks, int paddedM,
+                    const uint8_t* lut, uint16_t* out) {
+    const size_t blockBytes = static_cast<size_t>(paddedM) * 16;
+    for (size_t b = 0; b < nBlocks; b++) {
+        const uint8_t* block = packed + b * blockBytes;
+        uint16_t* sums = out + b * FASTSCAN_BLOCK;
+        std::fill(sums, sums + FASTSCAN_BLOCK, 0);
+
+        for (int m = 0; m < paddedM; m++) {
+            const uint8_t* codes = block + static_cast<size_t>(m) * 16;
+            const uint8_t* row = lut + static_cast<size_t>(m) * 16;
+            for (int j = 0; j < 16; j++) {
+                sums[j] += row[codes[j] & 0x0f];
+                sums[j + 16] += row[codes[j] >> 4];
+            }
+        }
+    }
+}
+
+#if defined(HAVE_AVX2)
+extern void fastScanAVX2(const uint8_t*, size_t, int, const uint8_t*, uint16_t*);
+#endif
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+extern void fastScanNEON(const uint8_t*, size_t, int, const uint8_t*, uint16_t*);
+#endif
+
+FastScanFunc getFastScanFunc() {
+    static const FastScanFunc func = [] {
+        // Kernel sets resolve to nullptr when the CPU lacks them
+#if defined(HAVE_AVX2)
+        if (getDistanceKernels(ISA::AVX2)) return &fastScanAVX2;
+#endif
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+        if (getDistanceKernels(ISA::NEON)) return &fastScanNEON;
+#endif
+        return &fastScanScalar;
+    }();
+    return func;
+}
+
+} // namespace vectordb
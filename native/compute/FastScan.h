@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace vectordb {
+
+/**
+ * 4 位 PQ 快速扫描 (fast-scan)
+ * 编码按 32 个向量一块打包: 块内每个子空间占 16 字节，字节 j 的低 4 位是第 j 个向量、
+ * 高 4 位是第 j + 16 个向量的编码；子空间数补齐为偶数，补齐的子空间编码与查表值均为 0。
+ * 距离表量化为 uint8 后整张放进寄存器，用字节 shuffle 完成查表，累加为 uint16。
+ */
+
+constexpr int FASTSCAN_BLOCK = 32;
+
+// uint16 累加不溢出的子空间数上限 (255 * 256 < 65536)
+constexpr int FASTSCAN_MAX_M = 256;
+
+// 补齐后的子空间数
+inline int fastScanPaddedM(int pqM) { return (pqM + 1) & ~1; }
+
+// 每个 32 向量块的字节数
+inline size_t fastScanBlockBytes(int pqM) {
+    return static_cast<size_t>(fastScanPaddedM(pqM)) * (FASTSCAN_BLOCK / 2);
+}
+
+/**
+ * 把第 index 个向量的编码 (pqM 个 0~15 的值) 写入打包缓冲区
+ * packed 至少容纳 index / 32 + 1 个块，且新块须预先清零
+ */
+void packFastScanCode(const uint8_t* code, int pqM, size_t index, uint8_t* packed);
+
+/**
+ * 距离表量化
+ * table 为 [pqM][16] 的 float 距离表；lut 输出 [paddedM][16]。
+ * 估计距离 = bias + scale * sum(lut)，误差不超过 pqM * scale / 2
+ */
+void quantizeFastScanLUT(const float* table, int pqM, uint8_t* lut, float* bias, float* scale);
+
+/**
+ * 扫描 nBlocks 个连续的块，out[b * 32 + i] 为第 b 块第 i 个向量的量化距离和
+ */
+using FastScanFunc = void(*)(const uint8_t* packed, size_t nBlocks, int paddedM,
+                             const uint8_t* lut, uint16_t* out);
+
+void fastScanScalar(const uint8_t* packed, size_t nBlocks, int paddedM,
+                    const uint8_t* lut, uint16_t* out);
+
+/**
+ * 获取当前 CPU 上最优的扫描内核 (AVX2 / NEON / 标量)
+ */
+FastScanFunc getFastScanFunc();
+
+} // namespace vectordb
@@ -0,0 +1,51 @@
+#include "FastScan.h"
+
+// Compiled with -mavx2 for this file only, called only after runtime detection
+#if defined(HAVE_AVX2)
+#include <immintrin.h>
+
+namespace vectordb {
+
+// Two subspaces per step: the low lane serves subspace m, the high lane m + 1.
+// Low nibbles index vectors 0-15 and high nibbles 16-31 of the same 16 bytes.
+void fastScanAVX2(const uint8_t* packed, size_t nBlocks, int paddedM,
+                  const uint8_t* lut, uint16_t* out) {
+    const size_t blockBytes = static_cast<size_t>(paddedM) * 16;
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (size_t b = 0; b < nBlocks; b++) {
+        const uint8_t* block = packed + b * blockBytes;
+        __m256i acc0 = _mm256_setzero_si256();  // vectors 0-7
+        __m256i acc1 = _mm256_setzero_si256();  // vectors 8-15
+        __m256i acc2 = _mm256_setzero_si256();  // vectors 16-23
+        __m256i acc3 = _mm256_setzero_si256();  // vectors 24-31
+
+        for (int m = 0; m < paddedM; m += 2) {
+            const __m256i codes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + m * 16));
+            const __m256i table = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lut + m * 16));
+
+            const __m256i lo = _mm256_and_si256(codes, lowMask);
+            const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(codes, 4), lowMask);
+            const __m256i distLo = _mm256_shuffle_epi8(table, lo);
+            const __m256i distHi = _mm256_shuffle_epi8(table, hi);
+
+            acc0 = _mm256_add_epi16(acc0, _mm256_unpacklo_epi8(distLo, zero));
+            acc1 = _mm256_add_epi16(acc1, _mm256_unpackhi_epi8(distLo, zero));
+            acc2 = _mm256_add_epi16(acc2, _mm256_unpacklo_epi8(distHi, zero));
+            acc3 = _mm256_add_epi16(acc3, _mm256_unpackhi_epi8(distHi, zero));
+        }
+
+        // Fold the two subspace halves together
+        uint16_t* sums = out + b * FASTSCAN_BLOCK;
+        __m128i* dst = reinterpret_cast<__m128i*>(sums);
+        _mm_storeu_si128(dst + 0, _mm_add_epi16(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1)));
+        _mm_storeu_si128(dst + 1, _mm_add_epi16(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1)));
+        _mm_storeu_si128(dst + 2, _mm_add_epi16(_mm256_castsi256_si128(acc2), _mm256_extracti128_si256(acc2, 1)));
+        _mm_storeu_si128(dst + 3, _mm_add_epi16(_mm256_castsi256_si128(acc3), _mm256_extracti128_si256(acc3, 1)));
+    }
+}
+
+} // namespace vectordb
+
+#endif
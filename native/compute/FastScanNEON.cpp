@@ -0,0 +1,44 @@
+#include "FastScan.h"
+
+// NEON is part of the AArch64 baseline, no extra target flags are needed
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+
+namespace vectordb {
+
+void fastScanNEON(const uint8_t* packed, size_t nBlocks, int paddedM,
+                  const uint8_t* lut, uint16_t* out) {
+    const size_t blockBytes = static_cast<size_t>(paddedM) * 16;
+    const uint8x16_t lowMask = vdupq_n_u8(0x0f);
+
+    for (size_t b = 0; b < nBlocks; b++) {
+        const uint8_t* block = packed + b * blockBytes;
+        uint16x8_t acc0 = vdupq_n_u16(0);  // vectors 0-7
+        uint16x8_t acc1 = vdupq_n_u16(0);  // vectors 8-15
+        uint16x8_t acc2 = vdupq_n_u16(0);  // vectors 16-23
+        uint16x8_t acc3 = vdupq_n_u16(0);  // vectors 24-31
+
+        for (int m = 0; m < paddedM; m++) {
+            const uint8x16_t codes = vld1q_u8(block + m * 16);
+            const uint8x16_t table = vld1q_u8(lut + m * 16);
+
+            const uint8x16_t distLo = vqtbl1q_u8(table, vandq_u8(codes, lowMask));
+            const uint8x16_t distHi = vqtbl1q_u8(table, vshrq_n_u8(codes, 4));
+
+            acc0 = vaddw_u8(acc0, vget_low_u8(distLo));
+            acc1 = vaddw_u8(acc1, vget_high_u8(distLo));
+            acc2 = vaddw_u8(acc2, vget_low_u8(distHi));
+            acc3 = vaddw_u8(acc3, vget_high_u8(distHi));
+        }
+
+        uint16_t* sums = out + b * FASTSCAN_BLOCK;
+        vst1q_u16(sums, acc0);
+        vst1q_u16(sums + 8, acc1);
+        vst1q_u16(sums + 16, acc2);
+        vst1q_u16(sums + 24, acc3);
+    }
+}
+
+} // namespace vectordb
+
+#endif
@@ -0,0 +1,298 @@
+#include "KMeans.h"
+#include "BatchDistance.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace vectordb {
+
+namespace {
+
+// Upper bound on the [rows][k] dot-product tile, in floats (16 MB)
+constexpr size_t ASSIGN_TILE_FLOATS = size_t(1) << 22;
+
+// Relative perturbation applied when an empty cluster is split off a large one
+constexpr float SPLIT_EPS = 1.0f / 1024.0f;
+
+// First `count` entries of a random permutation of [0, n)
+std::vector<int> sampleDistinct(int n, int count, std::mt19937& rng) {
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    for (int i = 0; i < count; i++) {
+        std::uniform_int_distribution<int> pick(i, n - 1);
+        std::swap(perm[i], perm[pick(rng)]);
+    }
+    perm.resize(count);
+    return perm;
+}
+
+void gatherRows(const float* samples, const std::vector<int>& rows, int dim, float* out) {
+    for (size_t i = 0; i < rows.size(); i++) {
+        const float* row = samples + static_cast<size_t>(rows[i]) * dim;
+        std::copy(row, row + dim, out + i * dim);
+    }
+}
+
+void initRandom(const float* samples, int n, int dim, int k, std::mt19937& rng, float* centroids) {
+    // With fewer samples than centroids the surplus repeats samples and is split apart later
+    std::vector<int> rows = sampleDistinct(n, std::min(n, k), rng);
+    for (int c = 0; c < k; c++) {
+        const float* row = samples + static_cast<size_t>(rows[c % rows.size()]) * dim;
+        std::copy(row, row + dim, centroids + static_cast<size_t>(c) * dim);
+    }
+}
+
+void initPlusPlus(const float* samples, int n, int dim, int k, std::mt19937& rng, float* centroids) {
+    std::uniform_int_distribution<int> first(0, n - 1);
+    const float* row = samples + static_cast<size_t>(first(rng)) * dim;
+    std::copy(row, row + dim, centroids);
+
+    std::vector<float> minDistances(n, std::numeric_limits<float>::max());
+    for (int c = 1; c < k; c++) {
+        const float* prev = centroids + static_cast<size_t>(c - 1) * dim;
+        double total = 0.0;
+#ifdef HAVE_OPENMP
+        #pragma omp parallel for reduction(+:total) schedule(static)
+#endif
+        for (int i = 0; i < n; i++) {
+            const float* sample = samples + static_cast<size_t>(i) * dim;
+            float d = 0.0f;
+            for (int j = 0; j < dim; j++) {
+                const float diff = sample[j] - prev[j];
+                d += diff * diff;
+            }
+            minDistances[i] = std::min(minDistances[i], d);
+            total += minDistances[i];
+        }
+
+        int selected = first(rng);
+        if (total > 0.0) {
+            std::uniform_real_distribution<double> target(0.0, total);
+            double remaining = target(rng);
+            for (int i = 0; i < n; i++) {
+                remaining -= minDistances[i];
+                if (remaining <= 0.0) {
+                    selected = i;
+                    break;
+                }
+            }
+        }
+        row = samples + static_cast<size_t>(selected) * dim;
+        std::copy(row, row + dim, centroids + static_cast<size_t>(c) * dim);
+    }
+}
+
+// Each thread owns a contiguous range of centroids and only accumulates samples assigned to it
+void updateCentroids(const float* samples, int n, int dim, const int* assignments,
+                     int k, float* centroids, std::vector<int>& sizes) {
+    std::fill(sizes.begin(), sizes.end(), 0);
+#ifdef HAVE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+#ifdef HAVE_OPENMP
+        const int nThreads = omp_get_num_threads();
+        const int rank = omp_get_thread_num();
+#else
+        const int nThreads = 1;
+        const int rank = 0;
+#endif
+        const int c0 = static_cast<int>(static_cast<int64_t>(k) * rank / nThreads);
+        const int c1 = static_cast<int>(static_cast<int64_t>(k) * (rank + 1) / nThreads);
+        std::vector<double> sums(static_cast<size_t>(c1 - c0) * dim, 0.0);
+
+        for (int i = 0; i < n; i++) {
+            const int c = assignments[i];
+            if (c < c0 || c >= c1) continue;
+            const float* sample = samples + static_cast<size_t>(i) * dim;
+            double* sum = sums.data() + static_cast<size_t>(c - c0) * dim;
+            for (int d = 0; d < dim; d++) {
+                sum[d] += sample[d];
+            }
+            sizes[c]++;
+        }
+
+        for (int c = c0; c < c1; c++) {
+            if (sizes[c] == 0) continue;  // Left in place, splitEmptyClusters replaces it
+            const double* sum = sums.data() + static_cast<size_t>(c - c0) * dim;
+            float* centroid = centroids + static_cast<size_t>(c) * dim;
+            const double invSize = 1.0 / sizes[c];
+            for (int d = 0; d < dim; d++) {
+                centroid[d] = static_cast<float>(sum[d] * invSize);
+            }
+        }
+    }
+}
+
+// Moves every empty centroid next to a cluster picked in proportion to its size, splitting it in two
+void splitEmptyClusters(int dim, int k, float* centroids, std::vector<int>& sizes, std::mt19937& rng) {
+    for (int ci = 0; ci < k; ci++) {
+        if (sizes[ci] != 0) continue;
+
+        int64_t total = 0;
+        for (int c = 0; c < k; c++) {
+            if (sizes[c] > 1) total += sizes[c] - 1;
+        }
+        if (total == 0) return;
+
+        std::uniform_int_distribution<int64_t> pick(0, total - 1);
+        int64_t target = pick(rng);
+        int cj = 0;
+        for (; cj < k; cj++) {
+            if (sizes[cj] <= 1) continue;
+            target -= sizes[cj] - 1;
+            if (target < 0) break;
+        }
+
+        float* dst = centroids + static_cast<size_t>(ci) * dim;
+        float* src = centroids + static_cast<size_t>(cj) * dim;
+        for (int d = 0; d < dim; d++) {
+            const float sign = (d % 2 == 0) ? 1.0f : -1.0f;
+            dst[d] = src[d] * (1.0f + sign * SPLIT_EPS);
+            src[d] = src[d] * (1.0f - sign * SPLIT_EPS);
+        }
+        sizes[ci] = sizes[cj] / 2;
+        sizes[cj] -= sizes[ci];
+    }
+}
+
+double lloyd(const float* samples, int n, int dim, const KMeansConfig& config,
+             std::mt19937& rng, float* centroids) {
+    const int k = config.k;
+    std::vector<int> assignments(n, -1);
+    std::vector<int> next(n);
+    std::vector<float> distances(n);
+    std::vector<int> sizes(k);
+    double objective = 0.0;
+
+    for (int iter = 0; iter < config.maxIterations; iter++) {
+        assignNearestCentroids(samples, n, centroids, nullptr, k, dim, next.data(), distances.data());
+        objective = std::accumulate(distances.begin(), distances.end(), 0.0);
+        if (next == assignments) break;
+        assignments.swap(next);
+
+        updateCentroids(samples, n, dim, assignments.data(), k, centroids, sizes);
+        splitEmptyClusters(dim, k, centroids, sizes, rng);
+    }
+    return objective;
+}
+
+double miniBatch(const float* samples, int n, int dim, const KMeansConfig& config,
+                 std::mt19937& rng, float* centroids) {
+    const int k = config.k;
+    const int batchSize = config.batchSize;
+    const int batchesPerPass = (n + batchSize - 1) / batchSize;
+    std::vector<int64_t> counts(k, 0);
+    std::vector<float> batch(static_cast<size_t>(batchSize) * dim);
+    std::vector<int> rows(batchSize);
+    std::vector<int> assignments(batchSize);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+
+    for (int iter = 0; iter < config.maxIterations * batchesPerPass; iter++) {
+        for (int& row : rows) row = pick(rng);
+        gatherRows(samples, rows, dim, batch.data());
+        assignNearestCentroids(batch.data(), batchSize, centroids, nullptr, k, dim, assignments.data());
+
+        // Per-centroid learning rate 1 / count (Sculley 2010)
+        for (int j = 0; j < batchSize; j++) {
+            const int c = assignments[j];
+            const float eta = 1.0f / static_cast<float>(++counts[c]);
+            const float* x = batch.data() + static_cast<size_t>(j) * dim;
+            float* centroid = centroids + static_cast<size_t>(c) * dim;
+            for (int d = 0; d < dim; d++) {
+                centroid[d] += eta * (x[d] - centroid[d]);
+            }
+        }
+    }
+
+    std::vector<int> finalAssignments(n);
+    std::vector<float> distances(n);
+    assignNearestCentroids(samples, n, centroids, nullptr, k, dim, finalAssignments.data(), distances.data());
+    return std::accumulate(distances.begin(), distances.end(), 0.0);
+}
+
+} // namespace
+
+void assignNearestCentroids(const float* vectors, size_t n, const float* centroids,
+                            const float* centroidNormsSq, int k, int dim,
+                            int* assignments, float* distances) {
+    if (n == 0) return;
+
+    std::vector<float> ownNorms;
+    if (centroidNormsSq == nullptr) {
+        ownNorms.resize(k);
+        computeRowNormsSquared(centroids, k, dim, ownNorms.data());
+        centroidNormsSq = ownNorms.data();
+    }
+
+    const size_t tileRows = std::min(n, std::max<size_t>(1, ASSIGN_TILE_FLOATS / k));
+    std::vector<float> dots(tileRows * k);
+    std::vector<float> rowNorms(tileRows);
+
+    for (size_t start = 0; start < n; start += tileRows) {
+        const size_t rows = std::min(tileRows, n - start);
+        const float* tile = vectors + start * dim;
+        matrixMultiply(tile, centroids, dots.data(), rows, k, dim);
+        computeRowNormsSquared(tile, rows, dim, rowNorms.data());
+
+        // ||x||^2 is constant per row, so argmin only needs ||c||^2 - 2 x·c
+#ifdef HAVE_OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (int64_t r = 0; r < static_cast<int64_t>(rows); r++) {
+            const float* row = dots.data() + static_cast<size_t>(r) * k;
+            int best = 0;
+            float bestDist = std::numeric_limits<float>::max();
+            for (int c = 0; c < k; c++) {
+                const float dist = centroidNormsSq[c] - 2.0f * row[c];
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = c;
+                }
+            }
+            assignments[start + r] = best;
+            if (distances) {
+                distances[start + r] = std::max(0.0f, rowNorms[r] + bestDist);
+            }
+        }
+    }
+}
+
+double trainKMeans(const float* samples, int nSamples, int dim,
+                   const KMeansConfig& config, float* centroids) {
+    if (nSamples <= 0 || samples == nullptr || dim <= 0 || config.k <= 0) {
+        throw std::invalid_argument("Invalid k-means training input");
+    }
+
+    std::mt19937 rng(config.seed);
+
+    std::vector<float> subset;
+    int n = nSamples;
+    const int64_t limit = static_cast<int64_t>(config.k) * config.maxPointsPerCentroid;
+    if (config.maxPointsPerCentroid > 0 && nSamples > limit) {
+        n = static_cast<int>(limit);
+        subset.resize(static_cast<size_t>(n) * dim);
+        gatherRows(samples, sampleDistinct(nSamples, n, rng), dim, subset.data());
+        samples = subset.data();
+    }
+
+    if (config.init == KMeansInit::KMEANS_PLUS_PLUS) {
+        initPlusPlus(samples, n, dim, config.k, rng, centroids);
+    } else {
+        initRandom(samples, n, dim, config.k, rng, centroids);
+    }
+
+    if (config.batchSize > 0 && config.batchSize < n) {
+        return miniBatch(samples, n, dim, config, rng, centroids);
+    }
+    return lloyd(samples, n, dim, config, rng, centroids);
+}
+
+} // namespace vectordb
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace vectordb {
+
+/**
+ * 共享的 k-means 训练器 (IVF 粗聚类、PQ / HNSWPQ 码本共用)
+ * - 分配步骤按块做 GEMM (matrixMultiply)：||x - c||^2 = ||x||^2 + ||c||^2 - 2 x·c
+ * - 中心更新按中心区间划分给各 OpenMP 线程，每个线程只写自己负责的中心
+ * - 空簇从大簇中分裂出来 (复制中心后对称扰动，两边各分一半样本)
+ * - 样本数超过 k * maxPointsPerCentroid 时先随机下采样
+ * - batchSize > 0 时改为 mini-batch k-means，每轮只用一个随机批次按学习率 1/count 更新
+ */
+
+enum class KMeansInit : int32_t {
+    RANDOM = 0,           // 随机选取 k 个互不相同的样本
+    KMEANS_PLUS_PLUS = 1  // 按到已选中心的距离平方加权抽样
+};
+
+struct KMeansConfig {
+    int k = 256;
+    int maxIterations = 25;
+    KMeansInit init = KMeansInit::RANDOM;
+    uint32_t seed = 42;
+    int maxPointsPerCentroid = 256;  // 0 为不下采样
+    int batchSize = 0;               // 0 为全量 (Lloyd) 迭代
+};
+
+/**
+ * 训练 k 个中心
+ * @param samples 训练样本 [nSamples][dim]
+ * @param centroids 输出中心 [k][dim]
+ * @return 最终分配下的平方误差和
+ */
+double trainKMeans(const float* samples, int nSamples, int dim,
+                   const KMeansConfig& config, float* centroids);
+
+/**
+ * 为每个向量找到最近的中心
+ * @param vectors 向量 [n][dim]
+ * @param centroids 中心 [k][dim]
+ * @param centroidNormsSq 中心模长平方 [k]，传 nullptr 时内部计算
+ * @param assignments 输出最近中心下标 [n]
+ * @param distances 可选，输出到最近中心的平方距离 [n]
+ */
+void assignNearestCentroids(const float* vectors, size_t n, const float* centroids,
+                            const float* centroidNormsSq, int k, int dim,
+                            int* assignments, float* distances = nullptr);
+
+} // namespace vectordb
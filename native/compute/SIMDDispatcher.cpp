@@ -4,7 +4,6 @@
 
 #if defined(__x86_64__) || defined(_M_X64)
     #include <cpuid.h>
-    #include <immintrin.h>
 #endif
 
 namespace vectordb {
@@ -18,28 +17,43 @@ static void initSIMD() {
     g_initialized.store(true, std::memory_order_release);
 }
 
+#if defined(__x86_64__) || defined(_M_X64)
+// XCR0: which register states the OS saves on context switch
+static uint64_t readXCR0() {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+
 ISA detectISA() {
 #if defined(__x86_64__) || defined(_M_X64)
     unsigned int eax, ebx, ecx, edx;
 
-    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
-        if (ebx & bit_AVX512F) {
-            if (ebx & bit_AVX512DQ) {
-                return ISA::AVX512;
-            }
-        }
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return ISA::SCALAR;
     }
-
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
-        if (ecx & bit_AVX2) {
-            return ISA::AVX2;
+    const bool sse42 = (ecx & bit_SSE4_2) != 0;
+    const bool fma = (ecx & bit_FMA) != 0;
+    const bool osxsave = (ecx & bit_OSXSAVE) != 0;
+    const bool avx = (ecx & bit_AVX) != 0;
+    const bool f16c = (ecx & bit_F16C) != 0;  // FP16 storage kernels
+
+    // XMM | YMM state, plus opmask | ZMM_Hi256 | Hi16_ZMM for AVX-512
+    const uint64_t xcr0 = (osxsave && avx) ? readXCR0() : 0;
+    const bool osAVX = (xcr0 & 0x6) == 0x6;
+    const bool osAVX512 = (xcr0 & 0xe6) == 0xe6;
+
+    if (osAVX && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        if (osAVX512 && fma && f16c && (ebx & bit_AVX512F)) {
+            return ISA::AVX512;
         }
-        if (ecx & bit_SSE4_2) {
-            return ISA::SSE4;
+        if (fma && f16c && (ebx & bit_AVX2)) {
+            return ISA::AVX2;
         }
     }
 
-    return ISA::SCALAR;
+    return sse42 ? ISA::SSE4 : ISA::SCALAR;
 #elif defined(__aarch64__) || defined(_M_ARM64)
     return ISA::NEON;
 #else
@@ -58,66 +72,128 @@ const char* getISAName() {
     }
 }
 
+// Kernels, each set in its own translation unit built with its own target flags
+extern float euclideanDistanceScalar(const float*, const float*, size_t);
+extern float dotProductScalar(const float*, const float*, size_t);
+extern float cosineDistanceScalar(const float*, const float*, size_t);
+extern void batchEuclideanDistanceScalar(const float*, const float*, size_t, size_t, float*);
+extern float sq8EuclideanDistanceScalar(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float sq8DotProductScalar(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float fp16EuclideanDistanceScalar(const float*, const uint16_t*, size_t);
+extern float fp16DotProductScalar(const float*, const uint16_t*, size_t);
+
+static const DistanceKernels kScalarKernels = {
+    euclideanDistanceScalar, dotProductScalar, cosineDistanceScalar, batchEuclideanDistanceScalar,
+    sq8EuclideanDistanceScalar, sq8DotProductScalar, fp16EuclideanDistanceScalar, fp16DotProductScalar
+};
+
+#if defined(HAVE_AVX2)
 extern float euclideanDistanceAVX2(const float*, const float*, size_t);
-extern float cosineDistanceAVX2(const float*, const float*, size_t);
 extern float dotProductAVX2(const float*, const float*, size_t);
+extern float cosineDistanceAVX2(const float*, const float*, size_t);
+extern void batchEuclideanDistanceAVX2(const float*, const float*, size_t, size_t, float*);
+extern float sq8EuclideanDistanceAVX2(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float sq8DotProductAVX2(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float fp16EuclideanDistanceAVX2(const float*, const uint16_t*, size_t);
+extern float fp16DotProductAVX2(const float*, const uint16_t*, size_t);
+
+static const DistanceKernels kAVX2Kernels = {
+    euclideanDistanceAVX2, dotProductAVX2, cosineDistanceAVX2, batchEuclideanDistanceAVX2,
+    sq8EuclideanDistanceAVX2, sq8DotProductAVX2, fp16EuclideanDistanceAVX2, fp16DotProductAVX2
+};
+#endif
+
+#if defined(HAVE_AVX512)
+extern float euclideanDistanceAVX512(const float*, const float*, size_t);
+extern float dotProductAVX512(const float*, const float*, size_t);
+extern float cosineDistanceAVX512(const float*, const float*, size_t);
+extern void batchEuclideanDistanceAVX512(const float*, const float*, size_t, size_t, float*);
+extern float sq8EuclideanDistanceAVX512(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float sq8DotProductAVX512(const float*, const uint8_t*, const float*, const float*, size_t);
+extern float fp16EuclideanDistanceAVX512(const float*, const uint16_t*, size_t);
+extern float fp16DotProductAVX512(const float*, const uint16_t*, size_t);
+
+static const DistanceKernels kAVX512Kernels = {
+    euclideanDistanceAVX512, dotProductAVX512, cosineDistanceAVX512, batchEuclideanDistanceAVX512,
+    sq8EuclideanDistanceAVX512, sq8DotProductAVX512, fp16EuclideanDistanceAVX512, fp16DotProductAVX512
+};
+#endif
+
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+extern float euclideanDistanceNEON(const float*, const float*, size_t);
+extern float dotProductNEON(const float*, const float*, size_t);
+extern float cosineDistanceNEON(const float*, const float*, size_t);
+extern void batchEuclideanDistanceNEON(const float*, const float*, size_t, size_t, float*);
+
+// Quantized storage kernels have no NEON versions yet and use the scalar ones
+static const DistanceKernels kNEONKernels = {
+    euclideanDistanceNEON, dotProductNEON, cosineDistanceNEON, batchEuclideanDistanceNEON,
+    sq8EuclideanDistanceScalar, sq8DotProductScalar, fp16EuclideanDistanceScalar, fp16DotProductScalar
+};
+#endif
 
-static float euclideanDistanceScalar(const float* a, const float* b, size_t dim) {
-    float sum = 0.0f;
-    for (size_t i = 0; i < dim; i++) {
-        float diff = a[i] - b[i];
-        sum += diff * diff;
+const DistanceKernels* getDistanceKernels(ISA isa) {
+    initSIMD();
+    const ISA detected = g_isa.load(std::memory_order_acquire);
+
+    switch (isa) {
+        case ISA::SCALAR:
+            return &kScalarKernels;
+#if defined(HAVE_AVX2)
+        case ISA::AVX2:
+            // AVX-512 CPUs also run AVX2 code
+            return (detected == ISA::AVX2 || detected == ISA::AVX512) ? &kAVX2Kernels : nullptr;
+#endif
+#if defined(HAVE_AVX512)
+        case ISA::AVX512:
+            return detected == ISA::AVX512 ? &kAVX512Kernels : nullptr;
+#endif
+#if defined(HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+        case ISA::NEON:
+            return detected == ISA::NEON ? &kNEONKernels : nullptr;
+#endif
+        default:
+            return nullptr;
     }
-    return sum;
+}
+
+// Best kernel set that is both compiled in and supported, resolved once
+static const DistanceKernels& activeKernels() {
+    static const DistanceKernels* kernels = [] {
+        for (ISA isa : {ISA::AVX512, ISA::AVX2, ISA::NEON}) {
+            if (const DistanceKernels* k = getDistanceKernels(isa)) return k;
+        }
+        return &kScalarKernels;
+    }();
+    return *kernels;
 }
 
 DistanceFunc getEuclideanDistanceFunc() {
-    initSIMD();
-#if defined(__x86_64__) || defined(_M_X64)
-    ISA isa = g_isa.load(std::memory_order_acquire);
-    if (isa == ISA::AVX2 || isa == ISA::AVX512 || isa == ISA::SSE4) {
-        return euclideanDistanceAVX2;
-    }
-#endif
-    return euclideanDistanceScalar;
+    return activeKernels().euclidean;
 }
 
 DistanceFunc getCosineDistanceFunc() {
-    initSIMD();
-#if defined(__x86_64__) || defined(_M_X64)
-    ISA isa = g_isa.load(std::memory_order_acquire);
-    if (isa == ISA::AVX2 || isa == ISA::AVX512 || isa == ISA::SSE4) {
-        return cosineDistanceAVX2;
-    }
-#endif
-    return [](const float* a, const float* b, size_t dim) {
-        float dot = 0.0f;
-        for (size_t i = 0; i < dim; i++) {
-            dot += a[i] * b[i];
-        }
-        return 1.0f - dot;
-    };
+    return activeKernels().cosine;
 }
 
-extern void batchEuclideanDistanceAVX2(const float*, const float*, size_t, size_t, float*);
+DistanceFunc getInnerProductDistanceFunc() {
+    return activeKernels().innerProduct;
+}
 
-static void batchEuclideanDistanceScalar(const float* query, const float* vectors,
-                                         size_t n, size_t dim, float* distances) {
-    for (size_t i = 0; i < n; i++) {
-        const float* vec = vectors + i * dim;
-        distances[i] = euclideanDistanceScalar(query, vec, dim);
-    }
+DistanceFunc getDistanceFunc(Metric metric) {
+    return metric == Metric::L2 ? activeKernels().euclidean : activeKernels().innerProduct;
+}
+
+SQ8DistanceFunc getSQ8DistanceFunc(Metric metric) {
+    return metric == Metric::L2 ? activeKernels().sq8Euclidean : activeKernels().sq8InnerProduct;
+}
+
+FP16DistanceFunc getFP16DistanceFunc(Metric metric) {
+    return metric == Metric::L2 ? activeKernels().fp16Euclidean : activeKernels().fp16InnerProduct;
 }
 
 BatchDistanceFunc getBatchEuclideanDistanceFunc() {
-    initSIMD();
-#if defined(__x86_64__) || defined(_M_X64)
-    ISA isa = g_isa.load(std::memory_order_acquire);
-    if (isa == ISA::AVX2 || isa == ISA::AVX512 || isa == ISA::SSE4) {
-        return batchEuclideanDistanceAVX2;
-    }
-#endif
-    return batchEuclideanDistanceScalar;
+    return activeKernels().batchEuclidean;
 }
 
 } // namespace vectordb
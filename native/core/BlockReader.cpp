@@ -0,0 +1,256 @@
+#include "BlockReader.h"
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#endif
+
+namespace vectordb {
+
+#ifdef HAVE_IO_URING
+
+namespace {
+
+// Submission queue depth; a search reads a handful of blocks per step, larger batches go in rounds
+constexpr unsigned RING_DEPTH = 64;
+
+// One ring per thread, driven through the raw system calls. Only its own thread submits and
+// reaps, so the ring indices need ordering against the kernel but not against other threads
+class IoRing {
+public:
+    // nullptr when the kernel refuses io_uring (too old, or blocked by a seccomp policy)
+    static IoRing* local() {
+        thread_local IoRing ring;
+        return ring.fd_ >= 0 ? &ring : nullptr;
+    }
+
+    ~IoRing() { release(); }
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    unsigned capacity() const { return entries_; }
+    bool active() const { return fd_ >= 0; }
+
+    // Reads requests[0, n) with n <= capacity(), results[i] receives the cqe result of request i.
+    // If io_uring_enter fails the submitted reads are drained and the ring is torn down; requests
+    // it never completed keep their results entry, and the thread falls back to pread from then on
+    void submitAndWait(int fileFd, const BlockReader::Request* requests, int n, int* results) {
+        unsigned tail = *sqTail_;
+        for (int i = 0; i < n; i++) {
+            const unsigned index = tail & sqMask_;
+            io_uring_sqe* sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fileFd;
+            sqe->off = requests[i].offset;
+            sqe->addr = reinterpret_cast<uint64_t>(requests[i].buffer);
+            sqe->len = requests[i].length;
+            sqe->user_data = static_cast<uint64_t>(i);
+            sqArray_[index] = index;
+            tail++;
+        }
+        __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+        int pending = n;
+        int completed = 0;
+        while (completed < n) {
+            const long submitted = syscall(__NR_io_uring_enter, fd_, pending, n - completed,
+                                           IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR) continue;
+                // Submitted reads still write into the caller's buffers, so they must land first
+                drain(n - pending - completed, results);
+                release();
+                return;
+            }
+            pending -= static_cast<int>(submitted);
+            completed += reap(results);
+        }
+    }
+
+private:
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqRingBytes_ = 0;
+    size_t cqRingBytes_ = 0;
+    size_t sqesBytes_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    IoRing() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        const long fd = syscall(__NR_io_uring_setup, RING_DEPTH, &params);
+        if (fd < 0) return;
+        fd_ = static_cast<int>(fd);
+
+        sqRingBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) sqRingBytes_ = cqRingBytes_ = std::max(sqRingBytes_, cqRingBytes_);
+        sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqRing_ = map(sqRingBytes_, IORING_OFF_SQ_RING);
+        cqRing_ = singleMap ? sqRing_ : map(cqRingBytes_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqesBytes_, IORING_OFF_SQES));
+        if (!sqRing_ || !cqRing_ || !sqes_) {
+            release();
+            return;
+        }
+
+        auto* sq = static_cast<uint8_t*>(sqRing_);
+        auto* cq = static_cast<uint8_t*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        entries_ = params.sq_entries;
+    }
+
+    // Moves every available cqe into results, returns how many
+    int reap(int* results) {
+        int reaped = 0;
+        unsigned head = *cqHead_;
+        const unsigned available = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != available; head++) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            results[cqe.user_data] = cqe.res;
+            reaped++;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        return reaped;
+    }
+
+    // Waits for inFlight completions; if waiting through the ring fails too, any other system call
+    // also runs the completion work, so keep yielding until they show up
+    void drain(int inFlight, int* results) {
+        while (inFlight > 0) {
+            inFlight -= reap(results);
+            if (inFlight == 0) break;
+            if (syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                errno != EINTR) {
+                sched_yield();
+            }
+        }
+    }
+
+    void release() {
+        if (sqes_) munmap(sqes_, sqesBytes_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingBytes_);
+        if (sqRing_) munmap(sqRing_, sqRingBytes_);
+        if (fd_ >= 0) close(fd_);
+        sqes_ = nullptr;
+        sqRing_ = cqRing_ = nullptr;
+        fd_ = -1;
+    }
+
+    void* map(size_t bytes, uint64_t offset) const {
+        void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          static_cast<off_t>(offset));
+        return addr == MAP_FAILED ? nullptr : addr;
+    }
+};
+
+} // namespace
+
+#endif
+
+std::unique_ptr<BlockReader> BlockReader::open(const std::string& path, bool direct) {
+    std::unique_ptr<BlockReader> reader(new BlockReader());
+    reader->path_ = path;
+    if (direct) {
+        reader->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        reader->direct_ = reader->fd_ >= 0;
+    }
+    // tmpfs and some network filesystems reject O_DIRECT
+    if (reader->fd_ < 0) {
+        reader->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (reader->fd_ < 0) {
+        throw std::runtime_error("Cannot open index file for block reads: " + path);
+    }
+    return reader;
+}
+
+BlockReader::~BlockReader() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool BlockReader::usesIoUring() {
+#ifdef HAVE_IO_URING
+    return IoRing::local() != nullptr;
+#else
+    return false;
+#endif
+}
+
+void BlockReader::read(Request* requests, int count) const {
+#ifdef HAVE_IO_URING
+    if (IoRing* ring = IoRing::local()) {
+        thread_local std::vector<int> results;
+        const int batch = static_cast<int>(ring->capacity());
+        int start = 0;
+        for (; start < count && ring->active(); start += batch) {
+            const int n = std::min(batch, count - start);
+            results.assign(n, 0);
+            ring->submitAndWait(fd_, requests + start, n, results.data());
+            for (int i = 0; i < n; i++) {
+                const int res = results[i];
+                if (res < 0 && res != -EINVAL && res != -EOPNOTSUPP && res != -EAGAIN) {
+                    throw std::runtime_error("Block read failed on " + path_ + ": " + std::strerror(-res));
+                }
+                // Kernels before 5.6 lack IORING_OP_READ; short reads finish synchronously
+                const uint32_t done = res > 0 ? static_cast<uint32_t>(res) : 0;
+                if (done < requests[start + i].length) readSync(requests[start + i], done);
+            }
+        }
+        // The ring was torn down after an io_uring_enter failure
+        for (; start < count; start++) {
+            readSync(requests[start], 0);
+        }
+        return;
+    }
+#endif
+    for (int i = 0; i < count; i++) {
+        readSync(requests[i], 0);
+    }
+}
+
+void BlockReader::readSync(const Request& request, uint32_t done) const {
+    auto* buffer = static_cast<uint8_t*>(request.buffer);
+    while (done < request.length) {
+        const ssize_t n = pread(fd_, buffer + done, request.length - done,
+                                static_cast<off_t>(request.offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Block read failed on " + path_ + ": " + std::strerror(errno));
+        }
+        if (n == 0) {
+            throw std::runtime_error("Block read past the end of " + path_);
+        }
+        done += static_cast<uint32_t>(n);
+    }
+}
+
+} // namespace vectordb
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+
+namespace vectordb {
+
+/**
+ * 随机块读取器: 一批读请求一起提交，全部完成后返回，供磁盘驻留索引在搜索时读取节点块
+ * 编译时有 <linux/io_uring.h> (定义 HAVE_IO_URING) 且运行时 io_uring_setup 成功时，
+ * 每个线程一个 io_uring 实例，整批请求一次提交、并行完成 (直接使用系统调用，不依赖 liburing)；
+ * 否则 (旧内核、容器禁用 io_uring 等) 退回逐个 pread；io_uring_enter 出错时等已提交的读取完成后
+ * 关闭该线程的 io_uring 实例，本次未完成的请求及之后的读取都改用 pread
+ * 可被多个线程同时调用
+ */
+class BlockReader {
+public:
+    struct Request {
+        uint64_t offset;   // 文件内的字节偏移
+        uint32_t length;
+        void* buffer;
+    };
+
+    // direct 为 true 时以 O_DIRECT 打开，绕过页缓存；文件系统不支持时自动退回普通读取。
+    // O_DIRECT 下 offset、length 与 buffer 须按 4KB 对齐
+    static std::unique_ptr<BlockReader> open(const std::string& path, bool direct);
+    ~BlockReader();
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    // 读取失败或文件过短时抛出 std::runtime_error
+    void read(Request* requests, int count) const;
+
+    bool isDirect() const { return direct_; }
+    // 当前线程的读取是否经由 io_uring
+    static bool usesIoUring();
+
+private:
+    BlockReader() = default;
+
+    int fd_ = -1;
+    bool direct_ = false;
+    std::string path_;
+
+    void readSync(const Request& request, uint32_t done) const;
+};
+
+} // namespace vectordb
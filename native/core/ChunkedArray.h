@@ -0,0 +1,215 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+
+namespace vectordb {
+
+/**
+ * 分块数组
+ * 按行存储 (每行 rowWidth 个 T)，容量以 rowsPerChunk 行为一块增长。
+ * 块一经分配永不搬迁: 扩容与读取可以并发，读者不会看到重新分配；
+ * 块由 MemoryAllocator 分配 (默认是匿名 mmap，只有写入过的页才占用物理内存)，
+ * 可通过 setAllocator() 改用大页 / NUMA 策略。
+ * attach() 之后各块直接指向外部的连续内存 (如 mmap 映射的索引文件)，写入前须 detach()。
+ * 新分配的块内容为 0；T 必须是可平凡拷贝的类型，rowsPerChunk 必须是 2 的幂。
+ */
+template <typename T>
+class ChunkedArray {
+    static_assert(std::is_trivially_copyable<T>::value, "ChunkedArray needs a trivially copyable type");
+
+public:
+    // 块目录定长，最多容纳 MAX_CHUNKS * rowsPerChunk 行
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 16;
+
+    explicit ChunkedArray(size_t rowWidth = 1, size_t rowsPerChunk = 4096)
+        : allocator_(MemoryAllocator::defaultAllocator()), chunks_(allocateDirectory()) {
+        setShape(rowWidth, rowsPerChunk);
+    }
+
+    ~ChunkedArray() {
+        release();
+        MemoryAllocator::defaultAllocator()->deallocate(chunks_, MAX_CHUNKS * sizeof(std::atomic<T*>));
+    }
+
+    ChunkedArray(const ChunkedArray&) = delete;
+    ChunkedArray& operator=(const ChunkedArray&) = delete;
+
+    // 释放全部块并改变行宽 / 块大小，保留分配器；只在没有并发访问时使用 (如 load 时按文件参数重建)
+    void reset(size_t rowWidth, size_t rowsPerChunk) {
+        release();
+        setShape(rowWidth, rowsPerChunk);
+    }
+
+    // 更换之后分配块所用的分配器，须在还没有块时调用 (nullptr 恢复默认)
+    void setAllocator(std::shared_ptr<MemoryAllocator> allocator) {
+        if (chunkCount_.load(std::memory_order_relaxed) != 0) {
+            throw std::logic_error("ChunkedArray allocator must be set before any chunk exists");
+        }
+        allocator_ = allocator ? std::move(allocator) : MemoryAllocator::defaultAllocator();
+    }
+    const std::shared_ptr<MemoryAllocator>& allocator() const { return allocator_; }
+
+    T* row(size_t i) {
+        return chunks_[i >> shift_].load(std::memory_order_acquire) + (i & (rowsPerChunk_ - 1)) * rowWidth_;
+    }
+    const T* row(size_t i) const {
+        return chunks_[i >> shift_].load(std::memory_order_acquire) + (i & (rowsPerChunk_ - 1)) * rowWidth_;
+    }
+
+    // 每行一个元素时按元素访问
+    T& operator[](size_t i) { return *row(i); }
+    const T& operator[](size_t i) const { return *row(i); }
+
+    // 从第 i 行起在同一块内连续存放的行数
+    size_t contiguousRows(size_t i) const { return rowsPerChunk_ - (i & (rowsPerChunk_ - 1)); }
+
+    // 对前 rows 行按块内连续的片段依次调用 fn(const T* data, size_t nRows)
+    template <typename Fn>
+    void forEachRun(size_t rows, Fn&& fn) const {
+        for (size_t start = 0; start < rows; start += rowsPerChunk_) {
+            fn(row(start), std::min(rowsPerChunk_, rows - start));
+        }
+    }
+
+    size_t rowWidth() const { return rowWidth_; }
+    size_t rowsPerChunk() const { return rowsPerChunk_; }
+    // 已分配的行数 (按块取整)
+    size_t capacity() const { return chunkCount_.load(std::memory_order_acquire) * rowsPerChunk_; }
+    bool isAttached() const { return external_; }
+
+    // 分配覆盖前 rows 行的块；可与读者并发，并发的 reserve 之间由内部锁串行化
+    void reserve(size_t rows) {
+        if (rows <= capacity()) return;
+        if (external_) {
+            throw std::logic_error("ChunkedArray is attached to external memory");
+        }
+        const size_t needed = (rows + rowsPerChunk_ - 1) >> shift_;
+        if (needed > MAX_CHUNKS) {
+            throw std::length_error("ChunkedArray capacity exceeded");
+        }
+
+        std::lock_guard<std::mutex> lock(growMutex_);
+        for (size_t c = chunkCount_.load(std::memory_order_relaxed); c < needed; c++) {
+            chunks_[c].store(allocateChunk(), std::memory_order_release);
+            chunkCount_.store(c + 1, std::memory_order_release);
+        }
+    }
+
+    // 引用外部的 rows 行连续内存，不拷贝
+    void attach(T* base, size_t rows) {
+        release();
+        const size_t count = (rows + rowsPerChunk_ - 1) >> shift_;
+        if (count > MAX_CHUNKS) {
+            throw std::length_error("ChunkedArray capacity exceeded");
+        }
+        for (size_t c = 0; c < count; c++) {
+            chunks_[c].store(base + c * rowsPerChunk_ * rowWidth_, std::memory_order_release);
+        }
+        chunkCount_.store(count, std::memory_order_release);
+        external_ = true;
+    }
+
+    // 把外部内存中的前 rows 行拷贝到自有块
+    void detach(size_t rows) {
+        if (!external_) return;
+        const size_t count = chunkCount_.load(std::memory_order_relaxed);
+        std::unique_ptr<T*[]> sources(new T*[count]);
+        for (size_t c = 0; c < count; c++) {
+            sources[c] = chunks_[c].load(std::memory_order_relaxed);
+            chunks_[c].store(nullptr, std::memory_order_relaxed);
+        }
+        chunkCount_.store(0, std::memory_order_relaxed);
+        external_ = false;
+
+        reserve(rows);
+        for (size_t start = 0; start < rows; start += rowsPerChunk_) {
+            const size_t n = std::min(rowsPerChunk_, rows - start);
+            std::memcpy(row(start), sources[start >> shift_], n * rowWidth_ * sizeof(T));
+        }
+    }
+
+    // 原地重排前 order.size() 行: 新的第 i 行是原来的第 order[i] 行，order 须为排列；
+    // 沿置换环逐行搬移，只额外占用一行缓冲，调用方保证没有并发访问
+    void permuteRows(const std::vector<int32_t>& order) {
+        if (external_) {
+            throw std::logic_error("ChunkedArray is attached to external memory");
+        }
+        const size_t rows = order.size();
+        std::vector<bool> done(rows, false);
+        std::vector<T> saved(rowWidth_);
+        for (size_t start = 0; start < rows; start++) {
+            if (done[start]) continue;
+            std::memcpy(saved.data(), row(start), rowWidth_ * sizeof(T));
+            size_t to = start;
+            for (;;) {
+                done[to] = true;
+                const size_t from = static_cast<size_t>(order[to]);
+                if (from == start) {
+                    std::memcpy(row(to), saved.data(), rowWidth_ * sizeof(T));
+                    break;
+                }
+                std::memcpy(row(to), row(from), rowWidth_ * sizeof(T));
+                to = from;
+            }
+        }
+    }
+
+    // 释放全部块
+    void clear() { release(); }
+
+    // 已分配的虚拟内存字节数 (外部内存不计)
+    size_t allocatedBytes() const { return external_ ? 0 : capacity() * rowWidth_ * sizeof(T); }
+
+private:
+    std::shared_ptr<MemoryAllocator> allocator_;
+    std::atomic<T*>* chunks_;
+    size_t rowWidth_ = 1;
+    size_t rowsPerChunk_ = 1;
+    int shift_ = 0;
+    std::atomic<size_t> chunkCount_{0};
+    bool external_ = false;
+    std::mutex growMutex_;
+
+    size_t chunkBytes() const { return rowsPerChunk_ * rowWidth_ * sizeof(T); }
+
+    void setShape(size_t rowWidth, size_t rowsPerChunk) {
+        if (rowWidth == 0 || rowsPerChunk == 0 || (rowsPerChunk & (rowsPerChunk - 1)) != 0) {
+            throw std::invalid_argument("ChunkedArray needs a positive width and a power-of-two chunk size");
+        }
+        rowWidth_ = rowWidth;
+        rowsPerChunk_ = rowsPerChunk;
+        shift_ = 0;
+        while ((size_t(1) << shift_) < rowsPerChunk) shift_++;
+    }
+
+    // All-zero bytes are a null atomic pointer, so the directory costs nothing until chunks exist
+    static std::atomic<T*>* allocateDirectory() {
+        return static_cast<std::atomic<T*>*>(
+            MemoryAllocator::defaultAllocator()->allocate(MAX_CHUNKS * sizeof(std::atomic<T*>)));
+    }
+
+    T* allocateChunk() const { return static_cast<T*>(allocator_->allocate(chunkBytes())); }
+    void freeChunk(T* chunk) const { allocator_->deallocate(chunk, chunkBytes()); }
+
+    void release() {
+        const size_t count = chunkCount_.load(std::memory_order_relaxed);
+        for (size_t c = 0; c < count; c++) {
+            T* chunk = chunks_[c].exchange(nullptr, std::memory_order_relaxed);
+            if (chunk && !external_) freeChunk(chunk);
+        }
+        chunkCount_.store(0, std::memory_order_relaxed);
+        external_ = false;
+    }
+};
+
+} // namespace vectordb
@@ -0,0 +1,95 @@
+#include "EpochDomain.h"
+#include <thread>
+
+namespace vectordb {
+
+struct alignas(64) EpochDomain::Record {
+    std::atomic<uint64_t> active{0};  // epoch observed on entry, 0 while outside
+    std::atomic<bool> inUse{true};
+    int depth = 0;                    // only touched by the owning thread
+    Record* next = nullptr;
+};
+
+namespace {
+
+// Hands the record back when the thread exits so the list stays bounded by peak thread count
+struct RecordOwner {
+    EpochDomain::Record* record = nullptr;
+
+    ~RecordOwner() {
+        if (record) record->inUse.store(false, std::memory_order_release);
+    }
+};
+
+thread_local RecordOwner t_owner;
+
+} // namespace
+
+EpochDomain& EpochDomain::instance() {
+    static EpochDomain domain;
+    return domain;
+}
+
+EpochDomain::Record* EpochDomain::acquireRecord() {
+    for (Record* r = records_.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->inUse.load(std::memory_order_relaxed) &&
+            r->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            r->depth = 0;
+            return r;
+        }
+    }
+
+    Record* r = new Record();
+    Record* head = records_.load(std::memory_order_relaxed);
+    do {
+        r->next = head;
+    } while (!records_.compare_exchange_weak(head, r, std::memory_order_seq_cst, std::memory_order_relaxed));
+    return r;
+}
+
+EpochDomain::Guard::Guard() {
+    if (!t_owner.record) {
+        t_owner.record = EpochDomain::instance().acquireRecord();
+    }
+    record_ = t_owner.record;
+    if (record_->depth++ == 0) {
+        // Pairs with synchronize(): the caller's later seq_cst loads either see the unlink,
+        // or synchronize() sees this store
+        record_->active.store(EpochDomain::instance().epoch_.load(std::memory_order_acquire),
+                              std::memory_order_seq_cst);
+    }
+}
+
+EpochDomain::Guard::~Guard() {
+    if (--record_->depth == 0) {
+        record_->active.store(0, std::memory_order_release);
+    }
+}
+
+uint64_t EpochDomain::advance() {
+    return epoch_.fetch_add(1, std::memory_order_seq_cst);
+}
+
+uint64_t EpochDomain::oldestActive() const {
+    uint64_t oldest = UINT64_MAX;
+    for (Record* r = records_.load(std::memory_order_seq_cst); r; r = r->next) {
+        const uint64_t active = r->active.load(std::memory_order_seq_cst);
+        if (active != 0 && active < oldest) oldest = active;
+    }
+    return oldest;
+}
+
+void EpochDomain::synchronize() {
+    const uint64_t retired = epoch_.fetch_add(1, std::memory_order_seq_cst);
+
+    for (Record* r = records_.load(std::memory_order_seq_cst); r; r = r->next) {
+        for (;;) {
+            const uint64_t active = r->active.load(std::memory_order_seq_cst);
+            if (active == 0 || active > retired) break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace vectordb
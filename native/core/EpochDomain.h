@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace vectordb {
+
+/**
+ * 基于 epoch 的内存回收 (进程内单例)
+ * 读者用 Guard 标出临界区：进入时把当前全局 epoch 写入本线程的记录，离开时清零，
+ * 只写自己独占的缓存行，不碰任何共享计数。
+ * 写者先把对象从共享结构中摘除，再调用 synchronize() 等到摘除之前进入的读者全部离开，
+ * 之后即可安全释放；也可以用 advance() / oldestActive() 推迟释放而不阻塞写者。
+ * 适合读远多于写的场景 (如 JNI 句柄查找)。
+ */
+class EpochDomain {
+public:
+    struct Record;
+
+    static EpochDomain& instance();
+
+    // 读者临界区，可嵌套
+    class Guard {
+    public:
+        Guard();
+        ~Guard();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        Record* record_;
+    };
+
+    // 阻塞到调用前已进入的临界区全部退出；不可在 Guard 内调用
+    void synchronize();
+
+    /**
+     * 非阻塞的回收: advance() 推进全局 epoch 并返回摘除时的 epoch r，
+     * 此后 oldestActive() > r 即表示摘除之前进入的临界区已全部退出，可以释放
+     */
+    uint64_t advance();
+    // 仍在临界区内的读者中最早进入时的 epoch，没有读者时为 UINT64_MAX
+    uint64_t oldestActive() const;
+
+    // 为当前线程取一条记录 (优先复用已退出线程留下的)
+    Record* acquireRecord();
+
+private:
+    EpochDomain() = default;
+
+    std::atomic<uint64_t> epoch_{1};
+    std::atomic<Record*> records_{nullptr};  // 只增不减的链表
+};
+
+} // namespace vectordb
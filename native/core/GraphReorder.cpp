@@ -0,0 +1,203 @@
+#include "GraphReorder.h"
+#include <algorithm>
+#include <numeric>
+
+namespace vectordb {
+
+namespace {
+
+// Gorder window: a node is scored against the previous GORDER_WINDOW placed nodes
+constexpr int GORDER_WINDOW = 5;
+
+bool isNode(const CSRGraph& graph, int v) {
+    return v >= 0 && v < graph.nodes();
+}
+
+// Breadth-first from each seed in turn; byDegree expands low-degree neighbors first (Cuthill-McKee)
+std::vector<int32_t> breadthFirst(const CSRGraph& graph, const std::vector<int32_t>& seeds, bool byDegree) {
+    const int n = graph.nodes();
+    std::vector<int32_t> order;
+    order.reserve(n);
+    std::vector<char> visited(n, 0);
+    std::vector<int32_t> next;
+
+    for (int seed : seeds) {
+        if (visited[seed]) continue;
+        visited[seed] = 1;
+        order.push_back(seed);
+        // order doubles as the queue
+        for (size_t head = order.size() - 1; head < order.size(); head++) {
+            const int v = order[head];
+            next.clear();
+            for (int j = 0; j < graph.degree(v); j++) {
+                const int u = graph.neighbors(v)[j];
+                if (isNode(graph, u) && !visited[u]) {
+                    visited[u] = 1;
+                    next.push_back(u);
+                }
+            }
+            if (byDegree) {
+                std::stable_sort(next.begin(), next.end(),
+                                 [&](int a, int b) { return graph.degree(a) < graph.degree(b); });
+            }
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    return order;
+}
+
+// Bucket queue over small integer keys where every update is +1 or -1 (the "unit heap" of Gorder)
+class UnitHeap {
+public:
+    explicit UnitHeap(int n) : key_(n, 0), prev_(n), next_(n), head_(1, -1) {
+        for (int v = n - 1; v >= 0; v--) link(v);
+    }
+
+    void remove(int v) {
+        if (key_[v] < 0) return;
+        unlink(v);
+        key_[v] = -1;
+    }
+
+    void increment(int v) {
+        if (key_[v] < 0) return;
+        unlink(v);
+        key_[v]++;
+        link(v);
+        top_ = std::max(top_, key_[v]);
+    }
+
+    void decrement(int v) {
+        if (key_[v] <= 0) return;
+        unlink(v);
+        key_[v]--;
+        link(v);
+    }
+
+    // Removes and returns a node with the largest key, -1 once empty
+    int popMax() {
+        while (top_ > 0 && head_[top_] < 0) top_--;
+        const int v = head_[top_];
+        if (v >= 0) remove(v);
+        return v;
+    }
+
+private:
+    std::vector<int> key_;  // -1 once removed
+    std::vector<int> prev_;
+    std::vector<int> next_;
+    std::vector<int> head_;
+    int top_ = 0;
+
+    void link(int v) {
+        const int k = key_[v];
+        if (k >= static_cast<int>(head_.size())) head_.resize(k + 1, -1);
+        prev_[v] = -1;
+        next_[v] = head_[k];
+        if (head_[k] >= 0) prev_[head_[k]] = v;
+        head_[k] = v;
+    }
+
+    void unlink(int v) {
+        if (prev_[v] >= 0) {
+            next_[prev_[v]] = next_[v];
+        } else {
+            head_[key_[v]] = next_[v];
+        }
+        if (next_[v] >= 0) prev_[next_[v]] = prev_[v];
+    }
+};
+
+std::vector<int32_t> gorder(const CSRGraph& graph, int start) {
+    const int n = graph.nodes();
+
+    CSRGraph incoming;
+    incoming.offsets.assign(n + 1, 0);
+    for (int v = 0; v < n; v++) {
+        for (int j = 0; j < graph.degree(v); j++) {
+            const int u = graph.neighbors(v)[j];
+            if (isNode(graph, u)) incoming.offsets[u + 1]++;
+        }
+    }
+    std::partial_sum(incoming.offsets.begin(), incoming.offsets.end(), incoming.offsets.begin());
+    incoming.targets.resize(incoming.offsets[n]);
+    std::vector<int64_t> fill(incoming.offsets.begin(), incoming.offsets.end() - 1);
+    for (int v = 0; v < n; v++) {
+        for (int j = 0; j < graph.degree(v); j++) {
+            const int u = graph.neighbors(v)[j];
+            if (isNode(graph, u)) incoming.targets[fill[u]++] = v;
+        }
+    }
+
+    // Score of u against the window: edges to window nodes plus in-neighbors shared with them
+    UnitHeap heap(n);
+    auto update = [&](int v, bool entering) {
+        auto bump = [&](int u) {
+            if (entering) {
+                heap.increment(u);
+            } else {
+                heap.decrement(u);
+            }
+        };
+        for (int j = 0; j < graph.degree(v); j++) {
+            const int u = graph.neighbors(v)[j];
+            if (isNode(graph, u)) bump(u);
+        }
+        for (int j = 0; j < incoming.degree(v); j++) {
+            const int w = incoming.neighbors(v)[j];
+            bump(w);
+            for (int i = 0; i < graph.degree(w); i++) {
+                const int sibling = graph.neighbors(w)[i];
+                if (sibling != v && isNode(graph, sibling)) bump(sibling);
+            }
+        }
+    };
+
+    std::vector<int32_t> order;
+    order.reserve(n);
+    heap.remove(start);
+    order.push_back(start);
+    for (;;) {
+        update(order.back(), true);
+        if (order.size() > static_cast<size_t>(GORDER_WINDOW)) {
+            update(order[order.size() - 1 - GORDER_WINDOW], false);
+        }
+        const int next = heap.popMax();
+        if (next < 0) break;
+        order.push_back(next);
+    }
+    return order;
+}
+
+} // namespace
+
+std::vector<int32_t> computeGraphOrder(const CSRGraph& graph, GraphOrder order, int start) {
+    const int n = graph.nodes();
+    std::vector<int32_t> identity(n);
+    std::iota(identity.begin(), identity.end(), 0);
+    if (n == 0 || order == GraphOrder::NONE) return identity;
+    if (!isNode(graph, start)) start = 0;
+
+    switch (order) {
+    case GraphOrder::BFS: {
+        std::vector<int32_t> seeds{start};
+        seeds.insert(seeds.end(), identity.begin(), identity.end());
+        return breadthFirst(graph, seeds, false);
+    }
+    case GraphOrder::RCM: {
+        // Low-degree nodes sit on the periphery, the classic starting points
+        std::vector<int32_t> seeds = identity;
+        std::stable_sort(seeds.begin(), seeds.end(),
+                         [&](int a, int b) { return graph.degree(a) < graph.degree(b); });
+        std::vector<int32_t> result = breadthFirst(graph, seeds, true);
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+    case GraphOrder::GORDER:
+        return gorder(graph, start);
+    default:
+        return identity;
+    }
+}
+
+} // namespace vectordb
@@ -0,0 +1,200 @@
+#pragma once
+#include "EpochDomain.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vectordb {
+
+/**
+ * 固定容量的句柄表，查找无锁
+ * 句柄 = (generation << 32) | slot。槽位被释放时 generation 递增，旧句柄随之失效，
+ * 不会误指向复用该槽位的新对象。
+ *
+ * get() 只做两次 generation 读取和一次指针读取，不加锁、不修改引用计数；
+ * 返回的指针只在调用方的 EpochDomain::Guard 内有效。
+ * add / remove 由互斥锁串行化。remove 摘除对象后不等待读者: 对象连同槽位进入待回收表，
+ * 等摘除之前进入的读者全部离开、且没有 Pinned 引用后，由之后任一次 remove / add / reclaim 析构并归还槽位。
+ * Guard 会推迟此后摘除的所有对象的回收，因此可能长时间阻塞的调用 (如等待异步写入可见)
+ * 应在 Guard 内用 pin() 钉住对象后离开 Guard，只推迟这一个对象的回收。
+ */
+template <typename T>
+class HandleRegistry {
+public:
+    explicit HandleRegistry(uint32_t capacity) : slots_(capacity) {
+        freeSlots_.reserve(capacity);
+        for (uint32_t i = capacity; i > 0; i--) {
+            freeSlots_.push_back(i - 1);
+        }
+    }
+
+    ~HandleRegistry() {
+        for (auto& slot : slots_) {
+            delete slot.object.load(std::memory_order_relaxed);
+        }
+        for (auto& entry : retired_) {
+            delete entry.object;
+        }
+    }
+
+    HandleRegistry(const HandleRegistry&) = delete;
+    HandleRegistry& operator=(const HandleRegistry&) = delete;
+
+    // 登记对象并返回句柄，表满时返回 0 (对象被释放)
+    int64_t add(std::unique_ptr<T> object) {
+        reclaim();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (freeSlots_.empty()) return 0;
+        const uint32_t index = freeSlots_.back();
+        freeSlots_.pop_back();
+
+        Slot& slot = slots_[index];
+        const uint32_t generation = slot.generation.load(std::memory_order_relaxed);
+        slot.object.store(object.release(), std::memory_order_release);
+        return static_cast<int64_t>((static_cast<uint64_t>(generation) << 32) | index);
+    }
+
+    // 须在 EpochDomain::Guard 内调用；句柄无效或已释放时返回 nullptr
+    T* get(int64_t handle) const {
+        const uint32_t index = static_cast<uint32_t>(handle & 0xffffffff);
+        const uint32_t generation = static_cast<uint32_t>(static_cast<uint64_t>(handle) >> 32);
+        if (index >= slots_.size()) return nullptr;
+
+        const Slot& slot = slots_[index];
+        if (slot.generation.load(std::memory_order_acquire) != generation) return nullptr;
+        T* object = slot.object.load(std::memory_order_seq_cst);
+        // Re-check: the slot may have been released and reused between the two loads
+        if (slot.generation.load(std::memory_order_acquire) != generation) return nullptr;
+        return object;
+    }
+
+    // 钉住的对象在 Pinned 析构之前不会被回收，不需要持有 Guard；只可移动
+    class Pinned {
+    public:
+        Pinned() = default;
+        Pinned(Pinned&& other) noexcept : registry_(other.registry_), slot_(other.slot_), object_(other.object_) {
+            other.object_ = nullptr;
+        }
+        Pinned& operator=(Pinned&& other) noexcept {
+            if (this != &other) {
+                release();
+                registry_ = other.registry_;
+                slot_ = other.slot_;
+                object_ = other.object_;
+                other.object_ = nullptr;
+            }
+            return *this;
+        }
+        ~Pinned() { release(); }
+
+        T* get() const { return object_; }
+        explicit operator bool() const { return object_ != nullptr; }
+
+    private:
+        friend class HandleRegistry;
+        Pinned(HandleRegistry* registry, uint32_t slot, T* object)
+            : registry_(registry), slot_(slot), object_(object) {}
+
+        void release() {
+            if (!object_) return;
+            Slot& slot = registry_->slots_[slot_];
+            // The last pin of an already removed object hands it back for destruction
+            if (slot.pins.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+                slot.object.load(std::memory_order_seq_cst) != object_) {
+                registry_->reclaim();
+            }
+            object_ = nullptr;
+        }
+
+        HandleRegistry* registry_ = nullptr;
+        uint32_t slot_ = 0;
+        T* object_ = nullptr;
+    };
+
+    // 须在 EpochDomain::Guard 内调用；句柄无效或已释放时返回空的 Pinned
+    Pinned pin(int64_t handle) {
+        T* object = get(handle);
+        if (!object) return Pinned();
+        // The slot stays bound to this object until it is reclaimed, which our Guard holds off
+        const uint32_t index = static_cast<uint32_t>(handle & 0xffffffff);
+        slots_[index].pins.fetch_add(1, std::memory_order_seq_cst);
+        return Pinned(this, index, object);
+    }
+
+    // 摘除对象并立即返回，析构推迟到仍在使用它的读者全部离开之后
+    bool remove(int64_t handle) {
+        const uint32_t index = static_cast<uint32_t>(handle & 0xffffffff);
+        const uint32_t generation = static_cast<uint32_t>(static_cast<uint64_t>(handle) >> 32);
+        if (index >= slots_.size()) return false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Slot& slot = slots_[index];
+            if (slot.generation.load(std::memory_order_relaxed) != generation) return false;
+            T* object = slot.object.exchange(nullptr, std::memory_order_seq_cst);
+            if (!object) return false;
+            // Generation 0 is skipped so a valid handle is never 0
+            uint32_t next = generation + 1;
+            if (next == 0) next = 1;
+            slot.generation.store(next, std::memory_order_release);
+            retired_.push_back(Retired{EpochDomain::instance().advance(), object, index});
+        }
+
+        reclaim();
+        return true;
+    }
+
+    // 析构读者已全部离开的待回收对象并归还其槽位，返回仍在等待的个数
+    size_t reclaim() {
+        std::vector<Retired> ready;
+        size_t pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (retired_.empty()) return 0;
+            const uint64_t oldest = EpochDomain::instance().oldestActive();
+            auto waiting = std::partition(retired_.begin(), retired_.end(),
+                                          [&](const Retired& entry) {
+                                              return entry.epoch >= oldest ||
+                                                     slots_[entry.slot].pins.load(std::memory_order_seq_cst) > 0;
+                                          });
+            ready.assign(waiting, retired_.end());
+            retired_.erase(waiting, retired_.end());
+            pending = retired_.size();
+        }
+        if (ready.empty()) return pending;
+
+        // Destructors may be slow (an async index joins its worker), so they run outside the lock
+        for (auto& entry : ready) {
+            delete entry.object;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : ready) {
+            freeSlots_.push_back(entry.slot);
+        }
+        return pending;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> generation{1};
+        std::atomic<T*> object{nullptr};
+        std::atomic<uint32_t> pins{0};  // 存活的 Pinned 个数
+    };
+
+    // 已摘除、等待读者离开的对象；epoch 为摘除时 advance() 的返回值
+    struct Retired {
+        uint64_t epoch;
+        T* object;
+        uint32_t slot;
+    };
+
+    std::vector<Slot> slots_;
+    std::mutex mutex_;
+    std::vector<uint32_t> freeSlots_;
+    std::vector<Retired> retired_;
+};
+
+} // namespace vectordb
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vectordb {
+
+/**
+ * 搜索时的 id 过滤器 (按外部 id 判断)
+ * 过滤掉的向量仍可作为图遍历的中转节点，只是不会出现在结果里
+ */
+class IDFilter {
+public:
+    virtual ~IDFilter() = default;
+
+    virtual bool contains(int id) const = 0;
+
+    // 允许通过的 id 个数，未知时返回 -1 (索引会抽样估计通过率)
+    virtual int64_t cardinality() const { return -1; }
+};
+
+/**
+ * 位图过滤器: 第 id 位为 1 表示允许，位序与 java.util.BitSet.toLongArray 一致
+ * (第 id / 64 个字的第 id % 64 位)，超出位图范围的 id 视为不允许
+ */
+class BitsetFilter : public IDFilter {
+public:
+    // 自有存储，nBits 位全部清零
+    explicit BitsetFilter(size_t nBits)
+        : storage_((nBits + 63) / 64, 0), words_(storage_.data()), nBits_(nBits) {}
+
+    // 引用调用方的位图，不拷贝；调用方须保证其在过滤器使用期间有效
+    BitsetFilter(const uint64_t* words, size_t nBits) : words_(words), nBits_(nBits) {}
+
+    // 仅限自有存储的过滤器
+    void set(int id) {
+        storage_[static_cast<size_t>(id) >> 6] |= uint64_t(1) << (id & 63);
+        count_.store(-1, std::memory_order_relaxed);
+    }
+
+    bool contains(int id) const override {
+        return id >= 0 && static_cast<size_t>(id) < nBits_ &&
+               ((words_[static_cast<size_t>(id) >> 6] >> (id & 63)) & 1);
+    }
+
+    // 首次调用时统计并缓存
+    int64_t cardinality() const override {
+        int64_t count = count_.load(std::memory_order_relaxed);
+        if (count < 0) {
+            count = 0;
+            const size_t nWords = (nBits_ + 63) / 64;
+            for (size_t w = 0; w < nWords; w++) {
+                uint64_t word = words_[w];
+                if (w == nWords - 1 && (nBits_ & 63)) {
+                    word &= (uint64_t(1) << (nBits_ & 63)) - 1;
+                }
+                count += __builtin_popcountll(word);
+            }
+            count_.store(count, std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+private:
+    std::vector<uint64_t> storage_;
+    const uint64_t* words_;
+    size_t nBits_;
+    mutable std::atomic<int64_t> count_{-1};
+};
+
+// 任意谓词过滤器，通过率未知
+class PredicateFilter : public IDFilter {
+public:
+    explicit PredicateFilter(std::function<bool(int)> predicate) : predicate_(std::move(predicate)) {}
+
+    bool contains(int id) const override { return predicate_(id); }
+
+private:
+    std::function<bool(int)> predicate_;
+};
+
+} // namespace vectordb
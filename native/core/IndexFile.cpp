@@ -0,0 +1,348 @@
+#include "IndexFile.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define VECTORDB_HAVE_MMAP 1
+#endif
+
+namespace vectordb {
+
+static constexpr uint64_t CHECKSUM_PRIME = 0x100000001b3ULL;
+
+void Checksum64::mix(uint64_t word) {
+    hash_ ^= word;
+    hash_ *= CHECKSUM_PRIME;
+    hash_ ^= hash_ >> 29;
+}
+
+void Checksum64::update(const void* data, size_t bytes) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    total_ += bytes;
+
+    // Complete a partial word left over from the previous call
+    while (carryBytes_ > 0 && carryBytes_ < 8 && bytes > 0) {
+        carry_ |= static_cast<uint64_t>(*p++) << (8 * carryBytes_);
+        carryBytes_++;
+        bytes--;
+    }
+    if (carryBytes_ == 8) {
+        mix(carry_);
+        carry_ = 0;
+        carryBytes_ = 0;
+    }
+
+    for (; bytes >= 8; bytes -= 8, p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        mix(word);
+    }
+
+    for (; bytes > 0; bytes--) {
+        carry_ |= static_cast<uint64_t>(*p++) << (8 * carryBytes_);
+        carryBytes_++;
+    }
+}
+
+uint64_t Checksum64::value() const {
+    uint64_t h = hash_;
+    if (carryBytes_ > 0) {
+        h ^= carry_;
+        h *= CHECKSUM_PRIME;
+        h ^= h >> 29;
+    }
+    h ^= total_;
+    h *= CHECKSUM_PRIME;
+    return h;
+}
+
+static uint64_t headerChecksum(const IndexFileHeader& header,
+                               const IndexFileSection* sections, size_t count) {
+    IndexFileHeader copy = header;
+    copy.checksum = 0;
+    Checksum64 sum;
+    sum.update(&copy, sizeof(copy));
+    sum.update(sections, count * sizeof(IndexFileSection));
+    return sum.value();
+}
+
+// ==================== IndexFileWriter ====================
+
+IndexFileWriter::IndexFileWriter(const std::string& path, IndexType type, int dimension)
+    : path_(path), tmpPath_(path + ".tmp") {
+    file_ = std::fopen(tmpPath_.c_str(), "wb");
+    if (!file_) {
+        throw std::runtime_error("Failed to open index file for writing: " + tmpPath_);
+    }
+
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, INDEX_FILE_MAGIC, sizeof(header_.magic));
+    header_.version = INDEX_FILE_VERSION;
+    header_.indexType = static_cast<uint32_t>(type);
+    header_.dimension = static_cast<uint32_t>(dimension);
+
+    buffer_.resize(BUFFER_SIZE);
+
+    // Placeholder, rewritten by finish() once the section table is known
+    rawWrite(&header_, sizeof(header_));
+}
+
+IndexFileWriter::~IndexFileWriter() {
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    if (!finished_) {
+        std::remove(tmpPath_.c_str());
+    }
+}
+
+void IndexFileWriter::rawWrite(const void* data, size_t bytes) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    offset_ += bytes;
+
+    if (bufferUsed_ + bytes <= buffer_.size()) {
+        std::memcpy(buffer_.data() + bufferUsed_, p, bytes);
+        bufferUsed_ += bytes;
+        return;
+    }
+
+    flush();
+    if (bytes >= buffer_.size()) {
+        // Large arrays bypass the buffer entirely
+        if (std::fwrite(p, 1, bytes, file_) != bytes) {
+            throw std::runtime_error("Failed to write index file: " + tmpPath_);
+        }
+        return;
+    }
+    std::memcpy(buffer_.data(), p, bytes);
+    bufferUsed_ = bytes;
+}
+
+void IndexFileWriter::flush() {
+    if (bufferUsed_ == 0) return;
+    if (std::fwrite(buffer_.data(), 1, bufferUsed_, file_) != bufferUsed_) {
+        throw std::runtime_error("Failed to write index file: " + tmpPath_);
+    }
+    bufferUsed_ = 0;
+}
+
+void IndexFileWriter::padTo(size_t alignment) {
+    static const uint8_t zeros[INDEX_FILE_ALIGNMENT] = {};
+    size_t pad = (alignment - offset_ % alignment) % alignment;
+    while (pad > 0) {
+        const size_t bytes = std::min(pad, sizeof(zeros));
+        rawWrite(zeros, bytes);
+        pad -= bytes;
+    }
+}
+
+void IndexFileWriter::beginSection(SectionType type, size_t alignment) {
+    if (inSection_) {
+        throw std::logic_error("Index file section already open");
+    }
+    if (alignment == 0 || alignment % INDEX_FILE_ALIGNMENT != 0) {
+        throw std::invalid_argument("Section alignment must be a multiple of 64 bytes");
+    }
+    padTo(alignment);
+
+    IndexFileSection section;
+    std::memset(&section, 0, sizeof(section));
+    section.type = static_cast<uint32_t>(type);
+    section.offset = offset_;
+    sections_.push_back(section);
+
+    sectionChecksum_ = Checksum64();
+    inSection_ = true;
+}
+
+void IndexFileWriter::write(const void* data, size_t bytes) {
+    if (!inSection_) {
+        throw std::logic_error("Index file write outside of a section");
+    }
+    if (bytes == 0) return;
+    sectionChecksum_.update(data, bytes);
+    rawWrite(data, bytes);
+}
+
+void IndexFileWriter::endSection() {
+    if (!inSection_) {
+        throw std::logic_error("No index file section open");
+    }
+    IndexFileSection& section = sections_.back();
+    section.size = offset_ - section.offset;
+    section.checksum = sectionChecksum_.value();
+    inSection_ = false;
+}
+
+void IndexFileWriter::finish() {
+    if (inSection_) {
+        endSection();
+    }
+    padTo(INDEX_FILE_ALIGNMENT);
+
+    header_.sectionCount = static_cast<uint32_t>(sections_.size());
+    header_.sectionTableOffset = offset_;
+    header_.checksum = headerChecksum(header_, sections_.data(), sections_.size());
+
+    rawWrite(sections_.data(), sections_.size() * sizeof(IndexFileSection));
+    flush();
+
+    if (std::fseek(file_, 0, SEEK_SET) != 0 ||
+        std::fwrite(&header_, 1, sizeof(header_), file_) != sizeof(header_) ||
+        std::fflush(file_) != 0) {
+        throw std::runtime_error("Failed to finalize index file: " + tmpPath_);
+    }
+    std::fclose(file_);
+    file_ = nullptr;
+
+    if (std::rename(tmpPath_.c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("Failed to rename index file to " + path_);
+    }
+    finished_ = true;
+}
+
+// ==================== MappedIndexFile ====================
+
+std::shared_ptr<MappedIndexFile> MappedIndexFile::open(const std::string& path,
+                                                       IndexType expectedType) {
+    std::shared_ptr<MappedIndexFile> file(new MappedIndexFile());
+
+#if defined(VECTORDB_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open index file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat index file: " + path);
+    }
+    file->size_ = static_cast<size_t>(st.st_size);
+    if (file->size_ < sizeof(IndexFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Index file is truncated: " + path);
+    }
+
+    // Private writable mapping: pages fault in lazily, in-place updates stay process-local
+    void* addr = mmap(nullptr, file->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Failed to mmap index file: " + path);
+    }
+    file->base_ = static_cast<uint8_t*>(addr);
+    file->mapped_ = true;
+#else
+    std::FILE* fp = std::fopen(path.c_str(), "rb");
+    if (!fp) {
+        throw std::runtime_error("Failed to open index file: " + path);
+    }
+    std::fseek(fp, 0, SEEK_END);
+    file->size_ = static_cast<size_t>(std::ftell(fp));
+    std::fseek(fp, 0, SEEK_SET);
+    file->base_ = new uint8_t[file->size_];
+    size_t read = std::fread(file->base_, 1, file->size_, fp);
+    std::fclose(fp);
+    if (read != file->size_ || file->size_ < sizeof(IndexFileHeader)) {
+        throw std::runtime_error("Index file is truncated: " + path);
+    }
+#endif
+
+    std::memcpy(&file->header_, file->base_, sizeof(IndexFileHeader));
+    const IndexFileHeader& header = file->header_;
+
+    if (std::memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a vectordb index file: " + path);
+    }
+    if (header.version != INDEX_FILE_VERSION) {
+        throw std::runtime_error("Unsupported index file version: " + std::to_string(header.version));
+    }
+    if (header.indexType != static_cast<uint32_t>(expectedType)) {
+        throw std::runtime_error("Index file type mismatch: " + path);
+    }
+
+    uint64_t tableBytes = static_cast<uint64_t>(header.sectionCount) * sizeof(IndexFileSection);
+    if (header.sectionTableOffset > file->size_ ||
+        tableBytes > file->size_ - header.sectionTableOffset) {
+        throw std::runtime_error("Index file section table is out of bounds: " + path);
+    }
+
+    file->sections_.resize(header.sectionCount);
+    std::memcpy(file->sections_.data(), file->base_ + header.sectionTableOffset, tableBytes);
+
+    if (headerChecksum(header, file->sections_.data(), file->sections_.size()) != header.checksum) {
+        throw std::runtime_error("Index file header checksum mismatch: " + path);
+    }
+
+    for (const auto& section : file->sections_) {
+        if (section.offset > file->size_ || section.size > file->size_ - section.offset) {
+            throw std::runtime_error("Index file section is out of bounds: " + path);
+        }
+    }
+
+    return file;
+}
+
+MappedIndexFile::~MappedIndexFile() {
+    if (!base_) return;
+#if defined(VECTORDB_HAVE_MMAP)
+    if (mapped_) {
+        munmap(base_, size_);
+        return;
+    }
+#endif
+    delete[] base_;
+}
+
+const IndexFileSection* MappedIndexFile::find(SectionType type) const {
+    for (const auto& section : sections_) {
+        if (section.type == static_cast<uint32_t>(type)) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+bool MappedIndexFile::hasSection(SectionType type) const {
+    return find(type) != nullptr;
+}
+
+size_t MappedIndexFile::sectionSize(SectionType type) const {
+    const IndexFileSection* section = find(type);
+    return section ? static_cast<size_t>(section->size) : 0;
+}
+
+uint64_t MappedIndexFile::sectionOffset(SectionType type) const {
+    const IndexFileSection* section = find(type);
+    if (!section) {
+        throw std::runtime_error("Index file is missing section " +
+                                 std::to_string(static_cast<uint32_t>(type)));
+    }
+    return section->offset;
+}
+
+uint8_t* MappedIndexFile::section(SectionType type) const {
+    const IndexFileSection* section = find(type);
+    if (!section) {
+        throw std::runtime_error("Index file is missing section " +
+                                 std::to_string(static_cast<uint32_t>(type)));
+    }
+    return base_ + section->offset;
+}
+
+void MappedIndexFile::verifyChecksums() const {
+    for (const auto& section : sections_) {
+        Checksum64 sum;
+        sum.update(base_ + section.offset, static_cast<size_t>(section.size));
+        if (sum.value() != section.checksum) {
+            throw std::runtime_error("Index file section checksum mismatch: section " +
+                                     std::to_string(section.type));
+        }
+    }
+}
+
+} // namespace vectordb
@@ -0,0 +1,256 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+namespace vectordb {
+
+/**
+ * 索引文件容器格式
+ *
+ * 布局: [Header 64B][Section 0][Section 1]...[Section Table]
+ * 每个 Section 起始地址按 64 字节对齐 (需要直接 I/O 的 Section 按 4KB 页对齐)，mmap 之后可以直接当作
+ * float / int32 数组使用，无需反序列化。
+ * Section Table 写在文件末尾，因此写入端可以流式输出，不需要预先知道各段大小。
+ */
+
+enum class IndexType : uint32_t {
+    HNSW    = 1,
+    HNSWPQ  = 2,
+    PQ      = 3,
+    IVF     = 4,
+    LSH     = 5,
+    Annoy   = 6,
+    IVFPQ   = 7,
+    Flat    = 8,
+    Sharded = 9   // 分片清单，各分片另存为独立文件
+};
+
+/**
+ * Section 类型
+ * 所有索引共用同一套编号，文件格式的完整定义集中在这里
+ */
+enum class SectionType : uint32_t {
+    // 通用 (VectorStore)
+    Vectors      = 1,   // float [size][dimension]
+    Ids          = 2,   // int32 [size]
+    Norms        = 3,   // float [size]
+    VectorCodec  = 4,   // VectorCodecMeta，SQ8 时后接 float vmin[dimension] 与 float scale[dimension]
+    VectorCodes  = 5,   // uint8 [size][codeSize] 量化后的向量 (FP16 / SQ8)
+    Tombstones   = 6,   // uint64 [(size + 63) / 64] 删除标记位图，没有删除时不写
+
+    // HNSW
+    HNSWMeta       = 16,  // HNSWFileMeta
+    HNSWLevels     = 17,  // int32 [size] 每个节点的层数
+    HNSWLinks0     = 18,  // int32 [size][1 + maxLinks]，每行为 [count | ids...]
+    HNSWUpperIndex = 19,  // uint64 [size] 节点上层邻接块在 HNSWUpperLinks 中的起始偏移
+    HNSWUpperLinks = 20,  // int32 [...]，每个节点 level 个 [count | ids...] 定长块
+
+    // PQ (PQIndex / HNSWPQIndex 共用)
+    PQCodebooks    = 32,  // float [pqM][nCentroids][subDim]
+    PQCodes        = 33,  // uint8 [size][pqM]
+
+    // HNSWPQ
+    HNSWPQMeta         = 48,  // HNSWPQFileMeta
+    HNSWPQNodes        = 49,  // Node [size] {level, firstLevel}
+    HNSWPQLevels       = 50,  // NeighborLevel [...] {offset, size, capacity}
+    HNSWPQNeighborPool = 51,  // int32 [...] 邻居内存池 (磁盘驻留格式中只含上层邻居)
+    HNSWPQDiskLayout   = 52,  // HNSWPQDiskMeta，有此 Section 即为磁盘驻留格式
+    HNSWPQDiskBlocks   = 53,  // 4KB 对齐的节点块，每个节点一个定长槽
+                              // [float 向量 | float 模长平方 | int32 count | int32 第 0 层邻居...]，槽不跨块
+
+    // PQ
+    PQMeta         = 64,  // PQFileMeta
+
+    // IVF
+    IVFMeta        = 80,  // IVFFileMeta
+    IVFCentroids   = 81,  // float [nLists][dimension]
+    IVFListOffsets = 82,  // uint64 [nLists + 1] 倒排表在下列按列表顺序排列的数组中的起止位置
+    IVFListEntries = 83,  // int32 [size] 向量下标 (IVFPQ)
+    IVFListIds     = 84,  // int32 [size] 外部 id
+    IVFListVectors = 85,  // float [size][dimension]
+    IVFListNorms   = 86,  // float [size] 模长平方
+    IVFListRadii   = 87,  // float [nLists] 列表成员到质心的最大 L2 距离 (缺失时加载后重新计算)
+
+    // LSH
+    LSHMeta          = 96,   // LSHFileMeta
+    LSHHyperplanes   = 97,   // float [numTables][numFunctions][dimension]
+    LSHBiases        = 98,   // float [numTables][numFunctions]
+    LSHSlots         = 101,  // LSHIndex::Slot [numTables][slotCapacity] 开放寻址桶表
+    LSHChains        = 102,  // int32 [size][numTables] 同桶中上一个向量下标
+
+    // Annoy
+    AnnoyMeta        = 112,  // AnnoyFileMeta
+    AnnoyTreeOffsets = 113,  // uint64 [numTrees + 1] 每棵树在 AnnoyNodes 中的起止位置
+    AnnoyNodes       = 114,  // AnnoyIndex::Node [...]
+    AnnoyHyperplanes = 115,  // float [splitNodes][dimension]
+    AnnoyLeafIndices = 116,  // int32 [...] 叶子节点中的向量下标
+
+    // IVFPQ (另复用 IVFCentroids / IVFListOffsets / IVFListEntries / PQCodebooks，
+    // PQCodes 按倒排表顺序排列，与 IVFListEntries 一一对应)
+    IVFPQMeta        = 128,  // IVFPQFileMeta
+
+    // Flat (向量与模长使用通用 VectorStore Section)
+    FlatMeta         = 144,  // FlatFileMeta
+
+    // Sharded (清单文件)
+    ShardedMeta      = 160   // ShardedFileMeta
+};
+
+constexpr char INDEX_FILE_MAGIC[8] = {'V', 'D', 'B', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t INDEX_FILE_VERSION = 1;
+constexpr size_t INDEX_FILE_ALIGNMENT = 64;
+constexpr size_t INDEX_FILE_PAGE_SIZE = 4096;
+
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t indexType;
+    uint32_t dimension;
+    uint32_t sectionCount;
+    uint64_t sectionTableOffset;
+    uint64_t checksum;          // Header (checksum 字段置零) + Section Table 的校验和
+    uint8_t reserved[24];
+};
+static_assert(sizeof(IndexFileHeader) == 64, "IndexFileHeader must be 64 bytes");
+
+struct IndexFileSection {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;          // 段内容校验和
+};
+static_assert(sizeof(IndexFileSection) == 32, "IndexFileSection must be 32 bytes");
+
+/**
+ * 64 位流式校验和 (按 8 字节字处理，跨 update 调用保持一致)
+ */
+class Checksum64 {
+public:
+    void update(const void* data, size_t bytes);
+    uint64_t value() const;
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ULL;
+    uint64_t carry_ = 0;
+    int carryBytes_ = 0;
+    uint64_t total_ = 0;
+
+    void mix(uint64_t word);
+};
+
+/**
+ * 流式写入器
+ * 数据经固定大小缓冲区直接落盘，写入多 GB 索引时不会额外占用同等大小的内存。
+ * 先写入 path.tmp，finish() 成功后再原子地 rename 到目标路径。
+ */
+class IndexFileWriter {
+public:
+    IndexFileWriter(const std::string& path, IndexType type, int dimension);
+    ~IndexFileWriter();
+
+    IndexFileWriter(const IndexFileWriter&) = delete;
+    IndexFileWriter& operator=(const IndexFileWriter&) = delete;
+
+    // alignment 为 Section 起始偏移的对齐字节数，须是 INDEX_FILE_ALIGNMENT 的倍数
+    void beginSection(SectionType type, size_t alignment = INDEX_FILE_ALIGNMENT);
+    void write(const void* data, size_t bytes);
+    void endSection();
+
+    template<typename T>
+    void writePod(const T& value) { write(&value, sizeof(T)); }
+
+    // 写入一个完整的 Section
+    void writeSection(SectionType type, const void* data, size_t bytes) {
+        beginSection(type);
+        write(data, bytes);
+        endSection();
+    }
+
+    // 把分块数组 (ChunkedArray) 的前 rows 行按块依次写成一个 Section
+    template<typename Array>
+    void writeChunkedSection(SectionType type, const Array& array, size_t rows) {
+        beginSection(type);
+        array.forEachRun(rows, [&](const auto* data, size_t n) {
+            write(data, n * array.rowWidth() * sizeof(*data));
+        });
+        endSection();
+    }
+
+    void finish();
+
+private:
+    std::string path_;
+    std::string tmpPath_;
+    std::FILE* file_ = nullptr;
+    IndexFileHeader header_;
+    std::vector<IndexFileSection> sections_;
+    std::vector<uint8_t> buffer_;
+    size_t bufferUsed_ = 0;
+    uint64_t offset_ = 0;
+    bool inSection_ = false;
+    bool finished_ = false;
+    Checksum64 sectionChecksum_;
+
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    void rawWrite(const void* data, size_t bytes);
+    void flush();
+    void padTo(size_t alignment);
+};
+
+/**
+ * 只读映射的索引文件
+ * 使用 MAP_PRIVATE 映射：加载只产生缺页，不做拷贝；对映射内容的写入只影响当前进程。
+ * 索引对象持有 shared_ptr 以保证映射生命周期覆盖所有指向它的指针。
+ */
+class MappedIndexFile {
+public:
+    static std::shared_ptr<MappedIndexFile> open(const std::string& path, IndexType expectedType);
+    ~MappedIndexFile();
+
+    MappedIndexFile(const MappedIndexFile&) = delete;
+    MappedIndexFile& operator=(const MappedIndexFile&) = delete;
+
+    int dimension() const { return static_cast<int>(header_.dimension); }
+    uint32_t version() const { return header_.version; }
+    size_t fileSize() const { return size_; }
+
+    bool hasSection(SectionType type) const;
+    size_t sectionSize(SectionType type) const;
+    // Section 在文件中的字节偏移，供绕过映射直接读取文件的调用方使用
+    uint64_t sectionOffset(SectionType type) const;
+
+    // 返回 Section 数据指针；Section 不存在时抛出异常
+    uint8_t* section(SectionType type) const;
+
+    // 按元素个数校验大小后返回类型化指针
+    template<typename T>
+    T* sectionAs(SectionType type, size_t count) const {
+        if (sectionSize(type) != count * sizeof(T)) {
+            throw std::runtime_error("Index file section has unexpected size");
+        }
+        return reinterpret_cast<T*>(section(type));
+    }
+
+    // 校验全部 Section 内容 (会读取整个文件，冷启动路径默认不调用)
+    void verifyChecksums() const;
+
+private:
+    MappedIndexFile() = default;
+
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    IndexFileHeader header_;
+    std::vector<IndexFileSection> sections_;
+
+    const IndexFileSection* find(SectionType type) const;
+};
+
+} // namespace vectordb
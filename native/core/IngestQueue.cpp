@@ -0,0 +1,48 @@
+#include "IngestQueue.h"
+#include <stdexcept>
+#include <algorithm>
+
+namespace vectordb {
+
+IngestQueue::IngestQueue(size_t capacity, int dimension)
+    : dimension_(dimension) {
+    if (capacity == 0 || dimension <= 0) {
+        throw std::invalid_argument("IngestQueue needs a positive capacity and dimension");
+    }
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+    mask_ = rounded - 1;
+
+    cells_.reset(new Cell[rounded]);
+    for (size_t i = 0; i < rounded; i++) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ids_.reset(new int[rounded]);
+    vectors_.reset(new float[rounded * dimension]);
+}
+
+size_t IngestQueue::front(size_t maxCount, const float** vectors, const int** ids) const {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    const size_t first = head & mask_;
+    const size_t limit = std::min(maxCount, capacity() - first);
+
+    size_t count = 0;
+    while (count < limit &&
+           cells_[first + count].sequence.load(std::memory_order_acquire) == head + count + 1) {
+        count++;
+    }
+    *vectors = vectors_.get() + first * dimension_;
+    *ids = ids_.get() + first;
+    return count;
+}
+
+void IngestQueue::pop(size_t count) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        // Reopens the slot for the producer one lap ahead
+        cells_[(head + i) & mask_].sequence.store(head + i + capacity(), std::memory_order_release);
+    }
+    head_.store(head + count, std::memory_order_release);
+}
+
+} // namespace vectordb
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace vectordb {
+
+/**
+ * 定容无锁多生产者单消费者 (MPSC) 向量队列
+ * 每个槽带一个序号 (Vyukov 有界队列)：生产者 CAS 抢占 tail 后写入 id 与向量，再发布序号；
+ * 消费者原地读取队首一段已发布的槽，处理完才 pop 归还，所以在 pop 之前这些向量始终可被扫描到。
+ * 序号从 1 开始，consumedSequence() 之前 (含) 的写入都已经被消费者处理完。
+ */
+class IngestQueue {
+public:
+    // capacity 向上取整为 2 的幂
+    IngestQueue(size_t capacity, int dimension);
+
+    IngestQueue(const IngestQueue&) = delete;
+    IngestQueue& operator=(const IngestQueue&) = delete;
+
+    int dimension() const { return dimension_; }
+    size_t capacity() const { return mask_ + 1; }
+
+    // 生产者: 返回这条写入的序号，队列满时返回 0，不阻塞
+    uint64_t tryPush(int id, const float* vector) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return 0;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        const size_t slot = pos & mask_;
+        ids_[slot] = id;
+        std::memcpy(vectors_.get() + slot * dimension_, vector, sizeof(float) * dimension_);
+        cells_[slot].sequence.store(pos + 1, std::memory_order_release);
+        return pos + 1;
+    }
+
+    // 已分配出去的最大序号 (对应的写入可能尚未发布)
+    uint64_t pushedSequence() const { return tail_.load(std::memory_order_acquire); }
+    // 消费者已 pop 的最大序号
+    uint64_t consumedSequence() const { return head_.load(std::memory_order_acquire); }
+    // 已入队但尚未被消费者 pop 的条数 (近似值)
+    size_t pendingCount() const {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? static_cast<size_t>(tail - head) : 0;
+    }
+
+    /**
+     * 消费者: 队首连续已发布、且在内存中连续 (不跨越环尾) 的一段，最多 maxCount 条
+     * 返回条数，vectors / ids 指向队列内部存储，pop 之前保持有效
+     */
+    size_t front(size_t maxCount, const float** vectors, const int** ids) const;
+
+    // 消费者: 归还队首 count 个槽
+    void pop(size_t count);
+
+    /**
+     * 任意线程: 对每条已发布、尚未 pop 的写入调用 fn(id, vector)
+     * 向量先拷贝到 scratch [dimension] 再校验槽序号未变 (seqlock)，被 pop 或覆盖的槽会被跳过，
+     * 因此看不到的写入一定已经在 pop 之前交给了消费者
+     */
+    template <typename Fn>
+    void forEachPending(float* scratch, Fn&& fn) const {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+        for (uint64_t pos = head; pos < tail; pos++) {
+            const Cell& cell = cells_[pos & mask_];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1) continue;
+            const size_t slot = pos & mask_;
+            const int id = ids_[slot];
+            std::memcpy(scratch, vectors_.get() + slot * dimension_, sizeof(float) * dimension_);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cell.sequence.load(std::memory_order_relaxed) != pos + 1) continue;
+            fn(id, static_cast<const float*>(scratch));
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+    };
+
+    int dimension_;
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::unique_ptr<int[]> ids_;
+    std::unique_ptr<float[]> vectors_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> head_{0};
+};
+
+} // namespace vectordb
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+
+namespace vectordb {
+
+/**
+ * 可映射数组
+ * 平时等价于 std::vector<T>；attach() 之后直接引用外部内存 (如 mmap 映射)，
+ * 不做拷贝。外部模式下禁止改变大小，需要写入时先 detach() 拷贝回自有缓冲区。
+ * T 必须是可平凡拷贝的类型；Alloc 决定自有缓冲区的分配方式 (如缓存行对齐)。
+ */
+template<typename T, typename Alloc = std::allocator<T>>
+class MappedArray {
+public:
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    bool isAttached() const { return external_; }
+
+    void attach(T* data, size_t count) {
+        std::vector<T, Alloc>(owned_.get_allocator()).swap(owned_);
+        data_ = data;
+        size_ = count;
+        external_ = true;
+    }
+
+    void detach() {
+        if (!external_) return;
+        owned_.assign(data_, data_ + size_);
+        external_ = false;
+        sync();
+    }
+
+    void reserve(size_t n) { ownedOrThrow().reserve(n); sync(); }
+    void resize(size_t n) { ownedOrThrow().resize(n); sync(); }
+    void resize(size_t n, const T& value) { ownedOrThrow().resize(n, value); sync(); }
+    void push_back(const T& value) { ownedOrThrow().push_back(value); sync(); }
+    void append(const T* values, size_t count) {
+        auto& owned = ownedOrThrow();
+        owned.insert(owned.end(), values, values + count);
+        sync();
+    }
+
+    void clear() {
+        std::vector<T, Alloc>(owned_.get_allocator()).swap(owned_);
+        external_ = false;
+        sync();
+    }
+
+    size_t capacity() const { return external_ ? size_ : owned_.capacity(); }
+
+    // 改用 alloc 分配自有缓冲区，已有内容丢弃；有状态的分配器 (如 PolicyAllocator) 在写入前设置
+    void setAllocator(const Alloc& alloc) {
+        std::vector<T, Alloc>(alloc).swap(owned_);
+        external_ = false;
+        sync();
+    }
+
+private:
+    std::vector<T, Alloc> owned_;
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    bool external_ = false;
+
+    std::vector<T, Alloc>& ownedOrThrow() {
+        if (external_) {
+            throw std::logic_error("MappedArray is attached to external memory");
+        }
+        return owned_;
+    }
+
+    void sync() {
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+};
+
+} // namespace vectordb
@@ -0,0 +1,240 @@
+#include "MemoryAllocator.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace vectordb {
+
+namespace {
+
+constexpr size_t HUGE_2MB = size_t(2) << 20;
+constexpr size_t HUGE_1GB = size_t(1) << 30;
+
+size_t roundUp(size_t bytes, size_t page) { return (bytes + page - 1) / page * page; }
+
+PageMode weaker(PageMode mode) { return static_cast<PageMode>(static_cast<int32_t>(mode) - 1); }
+
+#ifdef __linux__
+
+#ifndef MAP_HUGE_SHIFT
+    #define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+    #define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+    #define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// From <numaif.h>, which is part of libnuma rather than the C library
+constexpr int MPOL_BIND_MODE = 2;
+constexpr int MPOL_INTERLEAVE_MODE = 3;
+constexpr size_t MAX_NUMA_NODES = 1024;
+constexpr size_t MASK_BITS = 8 * sizeof(unsigned long);
+
+// madvise(MADV_HUGEPAGE) succeeds even when THP is switched off system-wide
+bool transparentHugePagesEnabled() {
+    static const bool enabled = [] {
+        std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        return std::getline(in, line) && line.find("[never]") == std::string::npos;
+    }();
+    return enabled;
+}
+
+// Format: "0-1,4"; empty when the topology is unavailable
+std::vector<int> onlineNumaNodes() {
+    std::vector<int> nodes;
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        const size_t dash = part.find('-');
+        try {
+            const int first = std::stoi(part.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+            for (int node = first; node <= last; node++) nodes.push_back(node);
+        } catch (const std::exception&) {
+        }
+    }
+    return nodes;
+}
+
+void* mapAnonymous(size_t bytes, int extraFlags) {
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+#endif
+
+} // namespace
+
+MemoryAllocator::MemoryAllocator(const MemoryPolicy& policy)
+    : requested_(policy),
+      effectivePages_(static_cast<int32_t>(policy.pages)),
+      effectiveNuma_(static_cast<int32_t>(policy.numa)) {
+#ifndef __linux__
+    effectivePages_.store(static_cast<int32_t>(PageMode::Default));
+    effectiveNuma_.store(static_cast<int32_t>(NumaMode::None));
+#endif
+}
+
+MemoryAllocator::~MemoryAllocator() = default;
+
+MemoryPolicy MemoryAllocator::effective() const {
+    MemoryPolicy policy;
+    policy.pages = static_cast<PageMode>(effectivePages_.load(std::memory_order_relaxed));
+    policy.numa = static_cast<NumaMode>(effectiveNuma_.load(std::memory_order_relaxed));
+    policy.numaNode = policy.numa == NumaMode::Bind ? requested_.numaNode : 0;
+    return policy;
+}
+
+const std::shared_ptr<MemoryAllocator>& MemoryAllocator::defaultAllocator() {
+    static const std::shared_ptr<MemoryAllocator> instance = std::make_shared<MemoryAllocator>();
+    return instance;
+}
+
+void MemoryAllocator::downgradePages(PageMode mode) {
+    int32_t current = effectivePages_.load(std::memory_order_relaxed);
+    while (current > static_cast<int32_t>(mode) &&
+           !effectivePages_.compare_exchange_weak(current, static_cast<int32_t>(mode),
+                                                  std::memory_order_relaxed)) {
+    }
+}
+
+void* MemoryAllocator::allocate(size_t bytes) {
+    bytes = std::max<size_t>(bytes, 1);
+#ifdef __linux__
+    void* memory = nullptr;
+    PageMode mode = requested_.pages;
+    for (;; mode = weaker(mode)) {
+        if (mode == PageMode::Default) {
+            memory = mapAnonymous(bytes, 0);
+            if (!memory) throw std::bad_alloc();
+            applyNuma(memory, bytes);
+            break;
+        }
+        // Blocks under half a huge page would waste most of it, they take the next mode down
+        const size_t page = mode == PageMode::Huge1GB ? HUGE_1GB : HUGE_2MB;
+        if (bytes < page / 2) continue;
+
+        memory = mode == PageMode::Transparent ? mapTransparent(bytes) : mapHuge(bytes, mode);
+        if (memory) break;
+    }
+    // Blocks too small for any huge page say nothing about what the policy achieved
+    if (bytes >= HUGE_2MB / 2) downgradePages(mode);
+    return memory;
+#else
+    void* memory = ::operator new(bytes, std::align_val_t(64));
+    std::memset(memory, 0, bytes);
+    return memory;
+#endif
+}
+
+void MemoryAllocator::deallocate(void* memory, size_t bytes) {
+    if (!memory) return;
+#ifdef __linux__
+    {
+        std::lock_guard<std::mutex> lock(mappingMutex_);
+        auto it = mappings_.find(memory);
+        if (it != mappings_.end()) {
+            bytes = it->second;
+            mappings_.erase(it);
+        }
+    }
+    munmap(memory, std::max<size_t>(bytes, 1));
+#else
+    (void)bytes;
+    ::operator delete(memory, std::align_val_t(64));
+#endif
+}
+
+void* MemoryAllocator::mapHuge(size_t bytes, PageMode mode) {
+#ifdef __linux__
+    const bool gigantic = mode == PageMode::Huge1GB;
+    const size_t length = roundUp(bytes, gigantic ? HUGE_1GB : HUGE_2MB);
+    // Without MAP_NORESERVE the pool is charged here, an empty pool fails now instead of at first touch
+    void* memory = mapAnonymous(length, MAP_HUGETLB | (gigantic ? MAP_HUGE_1GB : MAP_HUGE_2MB));
+    if (!memory) return nullptr;
+
+    applyNuma(memory, length);
+    std::lock_guard<std::mutex> lock(mappingMutex_);
+    mappings_[memory] = length;
+    return memory;
+#else
+    (void)bytes;
+    (void)mode;
+    return nullptr;
+#endif
+}
+
+void* MemoryAllocator::mapTransparent(size_t bytes) {
+#ifdef __linux__
+    if (!transparentHugePagesEnabled()) return nullptr;
+
+    // Over-map and trim so the region starts on a 2MB boundary, otherwise its ends never get huge pages
+    const size_t length = roundUp(bytes, HUGE_2MB);
+    char* raw = static_cast<char*>(mapAnonymous(length + HUGE_2MB, 0));
+    if (!raw) return nullptr;
+    char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(raw), HUGE_2MB));
+    if (aligned > raw) munmap(raw, aligned - raw);
+    const size_t tail = (raw + length + HUGE_2MB) - (aligned + length);
+    if (tail > 0) munmap(aligned + length, tail);
+
+    if (madvise(aligned, length, MADV_HUGEPAGE) != 0) {
+        munmap(aligned, length);
+        return nullptr;
+    }
+    applyNuma(aligned, length);
+    std::lock_guard<std::mutex> lock(mappingMutex_);
+    mappings_[aligned] = length;
+    return aligned;
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+void MemoryAllocator::applyNuma(void* memory, size_t bytes) {
+#ifdef __linux__
+    if (requested_.numa == NumaMode::None ||
+        effectiveNuma_.load(std::memory_order_relaxed) == static_cast<int32_t>(NumaMode::None)) {
+        return;
+    }
+
+    unsigned long mask[MAX_NUMA_NODES / MASK_BITS] = {};
+    auto setNode = [&](int node) {
+        if (node >= 0 && static_cast<size_t>(node) < MAX_NUMA_NODES) {
+            mask[node / MASK_BITS] |= 1UL << (node % MASK_BITS);
+        }
+    };
+    if (requested_.numa == NumaMode::Bind) {
+        setNode(requested_.numaNode);
+    } else {
+        static const std::vector<int> online = onlineNumaNodes();
+        for (int node : online) setNode(node);
+    }
+
+    // Pages are untouched so far, the policy decides where each one is first placed
+    const int mode = requested_.numa == NumaMode::Bind ? MPOL_BIND_MODE : MPOL_INTERLEAVE_MODE;
+    if (syscall(SYS_mbind, memory, roundUp(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE))),
+                mode, mask, MAX_NUMA_NODES + 1, 0) != 0) {
+        // Unknown node, no NUMA support in the kernel, or mbind blocked by a seccomp profile
+        effectiveNuma_.store(static_cast<int32_t>(NumaMode::None), std::memory_order_relaxed);
+    }
+#else
+    (void)memory;
+    (void)bytes;
+#endif
+}
+
+} // namespace vectordb
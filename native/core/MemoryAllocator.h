@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+namespace vectordb {
+
+// 页面模式，按从强到弱排列；申请的模式不可用时逐级回退
+enum class PageMode : int32_t {
+    Default = 0,      // 普通 4KB 页
+    Transparent = 1,  // 透明大页 (madvise MADV_HUGEPAGE)
+    Huge2MB = 2,      // 显式 2MB 大页 (MAP_HUGETLB)，需要预留 hugetlb 页池
+    Huge1GB = 3       // 显式 1GB 大页
+};
+
+enum class NumaMode : int32_t {
+    None = 0,         // 不设置，沿用线程默认策略 (通常为首次访问所在节点)
+    Bind = 1,         // 绑定到 numaNode
+    Interleave = 2    // 在所有在线节点间按页交错
+};
+
+struct MemoryPolicy {
+    PageMode pages = PageMode::Default;
+    NumaMode numa = NumaMode::None;
+    int numaNode = 0;  // 仅 Bind 时使用
+};
+
+/**
+ * 大块内存分配器
+ * 按 MemoryPolicy 分配清零的匿名内存，供 VectorStore / 邻接表等大数组使用；
+ * 派生类可以覆盖 allocate / deallocate 接入其他来源。
+ * 申请的页面模式或 NUMA 策略不可用时回退到较弱的模式 (1GB → 2MB → 透明大页 → 普通页)，
+ * 不足半个大页的分配也直接用下一级；effective() 报告实际生效的模式，即不小于 1MB 的分配中
+ * 最弱的一次 (尚无这样的分配时为申请的模式)，更小的分配不计入。
+ * Linux 以外的平台只支持 Default / None。
+ */
+class MemoryAllocator {
+public:
+    explicit MemoryAllocator(const MemoryPolicy& policy = MemoryPolicy{});
+    virtual ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // 分配 bytes 字节的清零内存，至少 64 字节对齐；失败时抛出 std::bad_alloc
+    virtual void* allocate(size_t bytes);
+    // bytes 须与 allocate 时一致
+    virtual void deallocate(void* memory, size_t bytes);
+
+    const MemoryPolicy& requested() const { return requested_; }
+    MemoryPolicy effective() const;
+
+    // 普通页、无 NUMA 策略的共享实例
+    static const std::shared_ptr<MemoryAllocator>& defaultAllocator();
+
+private:
+    MemoryPolicy requested_;
+    std::atomic<int32_t> effectivePages_;
+    std::atomic<int32_t> effectiveNuma_;
+    // 大页映射按页面大小取整后的实际长度，munmap 时需要
+    std::mutex mappingMutex_;
+    std::unordered_map<void*, size_t> mappings_;
+
+    void downgradePages(PageMode mode);
+    void* mapHuge(size_t bytes, PageMode mode);
+    void* mapTransparent(size_t bytes);
+    void applyNuma(void* memory, size_t bytes);
+};
+
+/**
+ * 把 MemoryAllocator 包装成 STL 分配器，供 MappedArray / std::vector 使用
+ * 未指定时使用 MemoryAllocator::defaultAllocator()；容器交换、赋值时分配器随之转移
+ */
+template<typename T>
+struct PolicyAllocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template<typename U>
+    struct rebind { using other = PolicyAllocator<U>; };
+
+    PolicyAllocator() noexcept : allocator(MemoryAllocator::defaultAllocator()) {}
+    explicit PolicyAllocator(std::shared_ptr<MemoryAllocator> source) noexcept
+        : allocator(source ? std::move(source) : MemoryAllocator::defaultAllocator()) {}
+    template<typename U>
+    PolicyAllocator(const PolicyAllocator<U>& other) noexcept : allocator(other.allocator) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(allocator->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) noexcept { allocator->deallocate(p, n * sizeof(T)); }
+
+    std::shared_ptr<MemoryAllocator> allocator;
+};
+
+template<typename T, typename U>
+bool operator==(const PolicyAllocator<T>& a, const PolicyAllocator<U>& b) { return a.allocator == b.allocator; }
+
+template<typename T, typename U>
+bool operator!=(const PolicyAllocator<T>& a, const PolicyAllocator<U>& b) { return a.allocator != b.allocator; }
+
+} // namespace vectordb
@@ -0,0 +1,13 @@
+#pragma once
+
+/**
+ * 软件预取 (读, 预取到 L1)
+ */
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define PREFETCH(addr) __builtin_prefetch(addr, 0, 3)
+#else
+    #define PREFETCH(addr) __builtin_prefetch(addr, 0, 3)
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace vectordb {
+
+/**
+ * 最小堆，用作图搜索的候选队列
+ * clear() 保留存储，容量增长到稳定后不再分配
+ */
+template <typename T>
+class MinHeap {
+public:
+    void clear() { data_.clear(); }
+    void reserve(size_t n) { data_.reserve(n); }
+    bool empty() const { return data_.empty(); }
+    size_t size() const { return data_.size(); }
+    const T& top() const { return data_.front(); }
+
+    void push(const T& value) {
+        data_.push_back(value);
+        std::push_heap(data_.begin(), data_.end(), std::greater<T>());
+    }
+
+    void pop() {
+        std::pop_heap(data_.begin(), data_.end(), std::greater<T>());
+        data_.pop_back();
+    }
+
+private:
+    std::vector<T> data_;
+};
+
+/**
+ * 定容最大堆: 只保留最小的 capacity 个元素，堆顶是其中最大的一个
+ * 已满时新元素直接替换堆顶再下沉一次，不经过 push + pop；reset() 保留存储
+ */
+template <typename T>
+class BoundedMaxHeap {
+public:
+    void reset(size_t capacity) {
+        capacity_ = capacity;
+        data_.clear();
+        data_.reserve(capacity);
+    }
+
+    size_t size() const { return data_.size(); }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return data_.empty(); }
+    bool full() const { return data_.size() >= capacity_; }
+    const T& top() const { return data_.front(); }
+
+    // 未满时插入；已满时只有小于堆顶才替换堆顶，返回 value 是否被保留
+    bool push(const T& value) {
+        if (data_.size() < capacity_) {
+            data_.push_back(value);
+            std::push_heap(data_.begin(), data_.end());
+            return true;
+        }
+        if (data_.empty() || !(value < data_.front())) return false;
+        replaceTop(value);
+        return true;
+    }
+
+    // 原地按升序排列并返回存储；之后须 reset() 才能继续 push
+    const std::vector<T>& sortAscending() {
+        std::sort_heap(data_.begin(), data_.end());
+        return data_;
+    }
+
+private:
+    std::vector<T> data_;
+    size_t capacity_ = 0;
+
+    void replaceTop(const T& value) {
+        const size_t n = data_.size();
+        size_t i = 0;
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= n) break;
+            if (child + 1 < n && data_[child] < data_[child + 1]) child++;
+            if (!(value < data_[child])) break;
+            data_[i] = data_[child];
+            i = child;
+        }
+        data_[i] = value;
+    }
+};
+
+/**
+ * 图搜索的线程内上下文
+ * 候选最小堆、定容结果堆以及邻居 / 距离 / 向量暂存区，每个线程一份反复使用，
+ * 稳态下单次查询不再分配堆内存。同一线程内同时只能有一次搜索使用它
+ */
+struct SearchContext {
+    using Entry = std::pair<float, int>;
+
+    MinHeap<Entry> candidates;
+    BoundedMaxHeap<Entry> results;
+    std::vector<int> neighbors;       // 待计算距离的邻居
+    std::vector<float> distances;     // 与 neighbors 一一对应
+    std::vector<float> vectors;       // 批量距离计算时收集的邻居向量
+    std::vector<float> norms;         // 与 vectors 对应的模长平方
+    std::vector<float> query;         // 归一化后的查询
+    std::vector<uint8_t> codes;       // 批量 ADC 时收集的邻居编码
+    std::vector<float> table;         // ADC 距离表
+    std::vector<Entry> output;        // 排序后的最终结果
+
+    static SearchContext& local() {
+        thread_local SearchContext context;
+        return context;
+    }
+};
+
+} // namespace vectordb
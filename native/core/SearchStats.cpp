@@ -0,0 +1,145 @@
+#include "SearchStats.h"
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace vectordb {
+
+uint64_t SearchStatsSnapshot::percentile(Field field, double p) const {
+    if (queries == 0) return 0;
+    const double target = p * static_cast<double>(queries);
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += buckets[field][b];
+        if (seen > 0 && static_cast<double>(seen) >= target) {
+            return b == 0 ? 0 : (uint64_t(1) << b) - 1;
+        }
+    }
+    return UINT64_MAX;
+}
+
+namespace searchstats {
+
+namespace {
+
+// Written by its owning thread only; relaxed atomics let snapshot() read it concurrently
+struct Shard {
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> sums[SearchStatsSnapshot::NUM_FIELDS] = {};
+    std::atomic<uint64_t> buckets[SearchStatsSnapshot::NUM_FIELDS][SearchStatsSnapshot::NUM_BUCKETS] = {};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Shards outlive their threads, so a pool thread that exits keeps its history in the totals
+Shard& localShard() {
+    thread_local Shard* shard = [] {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.shards.push_back(std::make_unique<Shard>());
+        return reg.shards.back().get();
+    }();
+    return *shard;
+}
+
+inline int bucketOf(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+inline void add(Shard& shard, int field, uint64_t value) {
+    shard.sums[field].fetch_add(value, std::memory_order_relaxed);
+    const int bucket = std::min(bucketOf(value), SearchStatsSnapshot::NUM_BUCKETS - 1);
+    shard.buckets[field][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void record(const SearchStats& query) {
+    Shard& shard = localShard();
+    shard.queries.fetch_add(1, std::memory_order_relaxed);
+    add(shard, SearchStatsSnapshot::LATENCY, query.latencyNanos);
+    add(shard, SearchStatsSnapshot::DISTANCE_COMPUTATIONS, query.distanceComputations);
+    add(shard, SearchStatsSnapshot::HOPS, query.hops);
+    add(shard, SearchStatsSnapshot::VISITED_NODES, query.visitedNodes);
+    add(shard, SearchStatsSnapshot::LOCK_WAIT, query.lockWaitNanos);
+}
+
+SearchStatsSnapshot snapshot() {
+    SearchStatsSnapshot total;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& shard : reg.shards) {
+        total.queries += shard->queries.load(std::memory_order_relaxed);
+        for (int f = 0; f < SearchStatsSnapshot::NUM_FIELDS; f++) {
+            total.sums[f] += shard->sums[f].load(std::memory_order_relaxed);
+            for (int b = 0; b < SearchStatsSnapshot::NUM_BUCKETS; b++) {
+                total.buckets[f][b] += shard->buckets[f][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return total;
+}
+
+void reset() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& shard : reg.shards) {
+        shard->queries.store(0, std::memory_order_relaxed);
+        for (int f = 0; f < SearchStatsSnapshot::NUM_FIELDS; f++) {
+            shard->sums[f].store(0, std::memory_order_relaxed);
+            for (int b = 0; b < SearchStatsSnapshot::NUM_BUCKETS; b++) {
+                shard->buckets[f][b].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+} // namespace searchstats
+
+#ifdef HAVE_SEARCH_STATS
+
+namespace {
+
+thread_local int scopeDepth = 0;
+
+} // namespace
+
+SearchStatsScope::SearchStatsScope(SearchStats* out, bool record)
+    : out_(out), outermost_(scopeDepth++ == 0), record_(record) {
+    if (outermost_) {
+        start_ = searchstats::local();
+        startTime_ = std::chrono::steady_clock::now();
+    } else if (out_) {
+        // Counts already flow into the enclosing scope; leave nothing for the caller to merge twice
+        out_->clear();
+    }
+}
+
+SearchStatsScope::~SearchStatsScope() {
+    scopeDepth--;
+    if (!outermost_) return;
+
+    const SearchStats& now = searchstats::local();
+    SearchStats query;
+    query.distanceComputations = now.distanceComputations - start_.distanceComputations;
+    query.hops = now.hops - start_.hops;
+    query.visitedNodes = now.visitedNodes - start_.visitedNodes;
+    query.lockWaitNanos = now.lockWaitNanos - start_.lockWaitNanos;
+    query.latencyNanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime_).count());
+    if (record_) searchstats::record(query);
+    if (out_) *out_ = query;
+}
+
+#endif
+
+} // namespace vectordb
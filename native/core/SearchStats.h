@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+
+namespace vectordb {
+
+/**
+ * 单次查询的热路径计数
+ * 只有以 -DENABLE_SEARCH_STATS=ON 编译 (定义 HAVE_SEARCH_STATS) 时才会计数，否则全部为 0
+ */
+struct SearchStats {
+    uint64_t distanceComputations = 0;  // 距离计算次数 (含 ADC 查表距离、质心距离与精确重排)
+    uint64_t hops = 0;                  // 图索引展开的节点数；IVF / IVFPQ 为探测的列表数
+    uint64_t visitedNodes = 0;          // 图索引首次访问的节点数；IVF / IVFPQ 为扫描的条目数
+    uint64_t lockWaitNanos = 0;         // 阻塞在结构锁 mutex_ 与邻接锁上的时间
+    uint64_t latencyNanos = 0;          // 整个查询的耗时
+
+    void clear() { *this = SearchStats{}; }
+};
+
+/**
+ * 所有查询的聚合直方图，每个计数项一张 log2 直方图:
+ * 桶 0 记录值 0，桶 b (b >= 1) 记录 [2^(b-1), 2^b) 内的值
+ */
+struct SearchStatsSnapshot {
+    enum Field { LATENCY, DISTANCE_COMPUTATIONS, HOPS, VISITED_NODES, LOCK_WAIT, NUM_FIELDS };
+    static constexpr int NUM_BUCKETS = 64;
+
+    uint64_t queries = 0;
+    uint64_t sums[NUM_FIELDS] = {};
+    uint64_t buckets[NUM_FIELDS][NUM_BUCKETS] = {};
+
+    double mean(Field field) const { return queries ? static_cast<double>(sums[field]) / queries : 0.0; }
+    // 第 p (0..1) 分位所在桶的上界
+    uint64_t percentile(Field field, double p) const;
+};
+
+namespace searchstats {
+
+// 编译时是否开启了计数
+constexpr bool enabled() {
+#ifdef HAVE_SEARCH_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// 当前线程的累计计数，热路径只做普通加法；SearchStatsScope 在查询前后取差值
+inline SearchStats& local() {
+    thread_local SearchStats stats;
+    return stats;
+}
+
+// 把在其他线程上完成的一部分查询 (如分片搜索) 的计数并入当前线程，耗时不合并
+inline void merge(const SearchStats& part) {
+    SearchStats& stats = local();
+    stats.distanceComputations += part.distanceComputations;
+    stats.hops += part.hops;
+    stats.visitedNodes += part.visitedNodes;
+    stats.lockWaitNanos += part.lockWaitNanos;
+}
+
+// 把一次查询的计数并入当前线程的直方图分片 (分片在线程退出后保留，继续参与聚合)
+void record(const SearchStats& query);
+// 汇总所有线程的分片；与 record 并发时各分片之间不保证是同一时刻的快照
+SearchStatsSnapshot snapshot();
+void reset();
+
+} // namespace searchstats
+
+/**
+ * 查询计数的作用域: 同一线程上只有最外层的作用域生效，
+ * 析构时把期间的计数与耗时并入聚合直方图，并写入 out (非空时)；内层作用域把 out 清零
+ * record 为 false 时只写入 out、不计入直方图: 用于在工作线程上执行的一部分查询，
+ * 调用方再用 searchstats::merge 把 out 并入自己的查询
+ */
+class SearchStatsScope {
+public:
+#ifdef HAVE_SEARCH_STATS
+    explicit SearchStatsScope(SearchStats* out = nullptr, bool record = true);
+    ~SearchStatsScope();
+#else
+    explicit SearchStatsScope(SearchStats* out = nullptr, bool /*record*/ = true) {
+        if (out) out->clear();
+    }
+#endif
+
+    SearchStatsScope(const SearchStatsScope&) = delete;
+    SearchStatsScope& operator=(const SearchStatsScope&) = delete;
+
+private:
+#ifdef HAVE_SEARCH_STATS
+    SearchStats* out_;
+    bool outermost_;
+    bool record_;
+    SearchStats start_;
+    std::chrono::steady_clock::time_point startTime_;
+#endif
+};
+
+/**
+ * 加锁并把阻塞时间计入 lockWaitNanos: 先 try_lock，失败才计时，无竞争时不读时钟
+ * Lock 为 std::unique_lock / std::shared_lock
+ */
+template <typename Lock>
+Lock acquireLock(typename Lock::mutex_type& mutex) {
+#ifdef HAVE_SEARCH_STATS
+    Lock lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        searchstats::local().lockWaitNanos += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    return lock;
+#else
+    return Lock(mutex);
+#endif
+}
+
+} // namespace vectordb
+
+// 热路径计数，未开启时展开为空
+#ifdef HAVE_SEARCH_STATS
+#define VECTORDB_STATS_ADD(field, n) (::vectordb::searchstats::local().field += static_cast<uint64_t>(n))
+#else
+#define VECTORDB_STATS_ADD(field, n) ((void)0)
+#endif
@@ -0,0 +1,280 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace vectordb {
+
+namespace {
+
+// CPUs of every NUMA node, empty when the topology is unavailable
+std::vector<std::vector<int>> readNumaNodes() {
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    for (int node = 0;; node++) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!in) break;
+
+        // Format: "0-3,8-11"
+        std::vector<int> cpus;
+        std::string part;
+        while (std::getline(in, part, ',')) {
+            const size_t dash = part.find('-');
+            try {
+                const int first = std::stoi(part.substr(0, dash));
+                const int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            } catch (const std::exception&) {
+                // Empty cpulist of a memory-only node
+            }
+        }
+        nodes.push_back(std::move(cpus));
+    }
+#endif
+    return nodes;
+}
+
+struct NumaTopology {
+    std::vector<std::vector<int>> nodes;
+    std::vector<int> cpuToNode;
+
+    NumaTopology() : nodes(readNumaNodes()) {
+        for (size_t n = 0; n < nodes.size(); n++) {
+            for (int cpu : nodes[n]) {
+                if (cpu >= static_cast<int>(cpuToNode.size())) cpuToNode.resize(cpu + 1, 0);
+                cpuToNode[cpu] = static_cast<int>(n);
+            }
+        }
+    }
+
+    int currentNode() const {
+#ifdef __linux__
+        const int cpu = sched_getcpu();
+        if (cpu >= 0 && cpu < static_cast<int>(cpuToNode.size())) return cpuToNode[cpu];
+#endif
+        return 0;
+    }
+};
+
+const NumaTopology& topology() {
+    static const NumaTopology instance;
+    return instance;
+}
+
+constexpr uint64_t LOW_MASK = 0xffffffffULL;
+
+inline uint64_t packRange(uint64_t lo, uint64_t hi) { return (lo << 32) | hi; }
+
+} // namespace
+
+/**
+ * 一次 parallelFor 调用
+ * 每个参与者一个槽位，区间打包为 [lo:32 | hi:32] (相对 begin 的偏移)，
+ * 所有者从前端取、窃取者从后端切走一半，都通过 CAS 完成
+ */
+struct ThreadPool::Job {
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};
+        std::atomic<int> node{0};
+    };
+
+    const std::function<void(int64_t, int64_t)>* fn = nullptr;
+    int64_t begin = 0;
+    int64_t grain = 1;
+    int nSlots = 0;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<int> nextSlot{1};  // 槽位 0 属于调用线程
+    std::atomic<int64_t> remaining{0};
+
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+
+    bool takeFront(int slot, uint64_t& lo, uint64_t& hi) {
+        std::atomic<uint64_t>& range = slots[slot].range;
+        uint64_t current = range.load(std::memory_order_acquire);
+        for (;;) {
+            lo = current >> 32;
+            const uint64_t end = current & LOW_MASK;
+            if (lo >= end) return false;
+            hi = std::min(end, lo + static_cast<uint64_t>(grain));
+            if (range.compare_exchange_weak(current, packRange(hi, end), std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+    }
+
+    // Moves the back half of some other slot's range into `slot`, same-node victims first
+    bool steal(int slot) {
+        const int node = slots[slot].node.load(std::memory_order_relaxed);
+        for (int pass = 0; pass < 2; pass++) {
+            for (int offset = 1; offset < nSlots; offset++) {
+                const int victim = (slot + offset) % nSlots;
+                const bool sameNode = slots[victim].node.load(std::memory_order_relaxed) == node;
+                if (sameNode != (pass == 0)) continue;
+
+                std::atomic<uint64_t>& range = slots[victim].range;
+                uint64_t current = range.load(std::memory_order_acquire);
+                for (;;) {
+                    const uint64_t lo = current >> 32;
+                    const uint64_t hi = current & LOW_MASK;
+                    if (lo >= hi) break;
+                    const uint64_t mid = hi - lo <= static_cast<uint64_t>(grain) ? lo : lo + (hi - lo) / 2;
+                    if (range.compare_exchange_weak(current, packRange(lo, mid), std::memory_order_acq_rel)) {
+                        slots[slot].range.store(packRange(mid, hi), std::memory_order_release);
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void run(int slot) {
+        uint64_t lo, hi;
+        do {
+            while (takeFront(slot, lo, hi)) {
+                if (!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        (*fn)(begin + static_cast<int64_t>(lo), begin + static_cast<int64_t>(hi));
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) error = std::current_exception();
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                const int64_t count = static_cast<int64_t>(hi - lo);
+                if (remaining.fetch_sub(count, std::memory_order_acq_rel) == count) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.notify_all();
+                }
+            }
+        } while (steal(slot));
+    }
+};
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    return pool;
+}
+
+ThreadPool::ThreadPool(int numWorkers) {
+    const auto& nodes = topology().nodes;
+    for (int w = 0; w < numWorkers; w++) {
+        const int node = nodes.empty() ? 0 : w % static_cast<int>(nodes.size());
+        workerNodes_.push_back(node);
+        workers_.emplace_back([this, node]() { workerLoop(node); });
+
+#ifdef __linux__
+        // Only pin on multi-node machines, a single node gains nothing from a restricted mask
+        if (nodes.size() > 1 && !nodes[node].empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : nodes[node]) {
+                CPU_SET(cpu, &set);
+            }
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop(int node) {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;
+
+            job = jobs_.front();
+            slot = job->nextSlot.fetch_add(1, std::memory_order_relaxed);
+            if (slot >= job->nSlots - 1) jobs_.pop_front();
+            if (slot >= job->nSlots) continue;
+        }
+        job->slots[slot].node.store(node, std::memory_order_relaxed);
+        job->run(slot);
+    }
+}
+
+void ThreadPool::parallelFor(int64_t begin, int64_t end, int64_t grain,
+                             const std::function<void(int64_t, int64_t)>& fn, int maxThreads) {
+    const int64_t n = end - begin;
+    if (n <= 0) return;
+    grain = std::max<int64_t>(1, grain);
+    if (static_cast<uint64_t>(n) > LOW_MASK) {
+        throw std::invalid_argument("parallelFor range is too large");
+    }
+
+    int nThreads = maxThreads <= 0 ? this->maxThreads() : std::min(maxThreads, this->maxThreads());
+    const int nSlots = static_cast<int>(std::min<int64_t>(nThreads, (n + grain - 1) / grain));
+    if (nSlots <= 1) {
+        for (int64_t lo = begin; lo < end; lo += grain) {
+            fn(lo, std::min(end, lo + grain));
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->begin = begin;
+    job->grain = grain;
+    job->nSlots = nSlots;
+    job->slots.reset(new Job::Slot[nSlots]);
+    job->remaining.store(n, std::memory_order_relaxed);
+    for (int s = 0; s < nSlots; s++) {
+        const uint64_t lo = static_cast<uint64_t>(n) * s / nSlots;
+        const uint64_t hi = static_cast<uint64_t>(n) * (s + 1) / nSlots;
+        job->slots[s].range.store(packRange(lo, hi), std::memory_order_relaxed);
+        job->slots[s].node.store(-1, std::memory_order_relaxed);
+    }
+    job->slots[0].node.store(topology().currentNode(), std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    for (int s = 1; s < nSlots; s++) {
+        cv_.notify_one();
+    }
+
+    job->run(0);
+
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&job]() { return job->remaining.load(std::memory_order_acquire) == 0; });
+    }
+    {
+        // Workers may not have reached the job if the caller finished everything itself
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(jobs_.begin(), jobs_.end(), job);
+        if (it != jobs_.end()) jobs_.erase(it);
+    }
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+} // namespace vectordb
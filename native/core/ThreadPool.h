@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vectordb {
+
+/**
+ * 常驻的工作窃取线程池，所有索引的批量搜索 / 批量添加共用
+ *
+ * parallelFor 把区间平均切给每个参与者 (调用线程本身也参与)，参与者每次从自己区间的前端
+ * 取 grain 个下标；自己的区间取完后从其他参与者的区间后端窃取一半，优先窃取同一 NUMA
+ * 节点上的参与者。因此单个慢任务只拖慢它所在的 grain，不会拖住一整段静态分块。
+ *
+ * Linux 上按 /sys/devices/system/node 把工作线程绑定到各 NUMA 节点的 CPU 集合，
+ * 读不到拓扑时视为单节点、不做绑定。
+ * 在任务内部再次调用 parallelFor 是安全的：调用线程总会处理自己的区间，不会死等。
+ */
+class ThreadPool {
+public:
+    // 全局共享实例，工作线程数为 hardware_concurrency - 1
+    static ThreadPool& instance();
+
+    explicit ThreadPool(int numWorkers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 参与 parallelFor 的最大线程数 (工作线程 + 调用线程)
+    int maxThreads() const { return static_cast<int>(workers_.size()) + 1; }
+
+    /**
+     * 对 [begin, end) 并行执行 fn(lo, hi)，每次调用覆盖一个不超过 grain 的连续子区间
+     * @param maxThreads 本次调用最多使用的线程数 (含调用线程)，<= 0 表示不限
+     * 阻塞到全部完成；任一调用抛出异常时跳过剩余部分，并在调用线程重新抛出第一个异常
+     */
+    void parallelFor(int64_t begin, int64_t end, int64_t grain,
+                     const std::function<void(int64_t, int64_t)>& fn, int maxThreads = 0);
+
+private:
+    struct Job;
+
+    std::vector<std::thread> workers_;
+    std::vector<int> workerNodes_;  // 每个工作线程所在的 NUMA 节点
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    bool stopping_ = false;
+
+    void workerLoop(int node);
+};
+
+} // namespace vectordb
@@ -1,89 +1,324 @@
 #include "VectorStore.h"
+#include "IndexFile.h"
+#include "Prefetch.h"
+#include "../compute/DistanceUtils.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <string>
 
-#if defined(__x86_64__) || defined(_M_X64)
-    #include <immintrin.h>
-    #define PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
-#elif defined(__aarch64__) || defined(_M_ARM64)
-    #define PREFETCH(addr) __builtin_prefetch(addr, 0, 3)
-#else
-    #define PREFETCH(addr) __builtin_prefetch(addr, 0, 3)
-#endif
-
-#ifdef __linux__
-    #include <sys/mman.h>
-    #include <fcntl.h>
-    #include <unistd.h>
-#endif
-
 namespace vectordb {
 
-VectorStore::VectorStore(int dimension, int maxElements)
-    : dimension_(dimension), maxElements_(maxElements) {
+namespace {
+
+// Leading POD of the VectorCodec section
+struct VectorCodecMeta {
+    int32_t encoding;
+    int32_t reserved;
+};
+
+size_t encodedSize(VectorEncoding encoding, int dimension) {
+    switch (encoding) {
+        case VectorEncoding::FP16: return static_cast<size_t>(dimension) * sizeof(uint16_t);
+        case VectorEncoding::SQ8:  return static_cast<size_t>(dimension);
+        default:                   return 0;
+    }
+}
+
+} // namespace
+
+VectorStore::VectorStore(int dimension, int maxElements, VectorEncoding encoding, bool keepVectors)
+    : dimension_(dimension), maxElements_(maxElements), encoding_(encoding),
+      keepVectors_(keepVectors || encoding == VectorEncoding::FLOAT32),
+      codeSize_(encodedSize(encoding, dimension)),
+      vectors_(std::max(dimension, 1), CHUNK_ROWS),
+      ids_(1, CHUNK_ROWS),
+      norms_(1, CHUNK_ROWS),
+      codes_(std::max<size_t>(codeSize_, 1), CHUNK_ROWS),
+      deleted_(1, CHUNK_ROWS / 8) {
     if (dimension <= 0) {
         throw std::invalid_argument("Dimension must be positive");
     }
     if (maxElements <= 0) {
         throw std::invalid_argument("MaxElements must be positive");
     }
+    if (encoding != VectorEncoding::FLOAT32 && encoding != VectorEncoding::FP16 &&
+        encoding != VectorEncoding::SQ8) {
+        throw std::invalid_argument("Unknown vector encoding");
+    }
 
-    vectors_.resize(static_cast<size_t>(maxElements) * dimension);
-    ids_.resize(maxElements);
-    norms_.resize(maxElements);
+    resetBuffers();
 }
 
-int VectorStore::add(int id, const float* vector) {
-    int index = size_.fetch_add(1, std::memory_order_acq_rel);
+void VectorStore::resetBuffers() {
+    vectors_.clear();
+    ids_.clear();
+    norms_.clear();
+    codes_.clear();
+    deleted_.clear();
+    hasVectors_ = keepVectors_;
+    hasNorms_ = true;
+    deletedCount_.store(0, std::memory_order_release);
+    // Reserving only takes address space, pages are committed as rows are written
+    reserveRows(static_cast<size_t>(maxElements_));
+}
 
-    if (index >= maxElements_) {
-        size_.fetch_sub(1, std::memory_order_relaxed);
-        throw std::runtime_error("VectorStore is full");
-    }
+void VectorStore::reserveRows(size_t rows) {
+    if (rows <= ids_.capacity()) return;
+    if (hasVectors_) vectors_.reserve(rows);
+    ids_.reserve(rows);
+    norms_.reserve(rows);
+    if (codeSize_ > 0) codes_.reserve(rows);
+    deleted_.reserve((rows + 63) / 64);
+}
+
+size_t VectorStore::reservedBytes() const {
+    return vectors_.allocatedBytes() + ids_.allocatedBytes() + norms_.allocatedBytes() +
+           codes_.allocatedBytes() + deleted_.allocatedBytes();
+}
 
-    float* dest = &vectors_[static_cast<size_t>(index) * dimension_];
-    std::copy(vector, vector + dimension_, dest);
+void VectorStore::store(int index, int id, const float* vector) {
+    if (hasVectors_) {
+        std::copy(vector, vector + dimension_, vectors_.row(index));
+    }
     norms_[index] = computeNorm(vector, dimension_);
     ids_[index] = id;
+    idToIndex_[id] = index;
+
+    uint8_t* code = codeSize_ > 0 ? codes_.row(index) : nullptr;
+    if (encoding_ == VectorEncoding::FP16) {
+        uint16_t* half = reinterpret_cast<uint16_t*>(code);
+        for (int d = 0; d < dimension_; d++) {
+            half[d] = floatToHalf(vector[d]);
+        }
+    } else if (encoding_ == VectorEncoding::SQ8) {
+        for (int d = 0; d < dimension_; d++) {
+            const float q = std::round((vector[d] - sqMin_[d]) / sqScale_[d]);
+            code[d] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, q)));
+        }
+    }
+}
+
+void VectorStore::decode(int index, float* out) const {
+    if (hasVectors_) {
+        const float* vec = vectors_.row(index);
+        std::copy(vec, vec + dimension_, out);
+        return;
+    }
+
+    const uint8_t* code = codeSize_ > 0 ? codes_.row(index) : nullptr;
+    if (encoding_ == VectorEncoding::FP16) {
+        const uint16_t* half = reinterpret_cast<const uint16_t*>(code);
+        for (int d = 0; d < dimension_; d++) {
+            out[d] = halfToFloat(half[d]);
+        }
+    } else if (encoding_ == VectorEncoding::SQ8) {
+        for (int d = 0; d < dimension_; d++) {
+            out[d] = sqMin_[d] + code[d] * sqScale_[d];
+        }
+    } else {
+        throw std::runtime_error("VectorStore has no vectors to decode");
+    }
+}
+
+void VectorStore::trainEncoding(const float* samples, int nSamples) {
+    if (encoding_ != VectorEncoding::SQ8) return;
+    if (nSamples <= 0) {
+        throw std::invalid_argument("SQ8 training needs at least one sample");
+    }
+    if (size_.load(std::memory_order_acquire) > 0) {
+        throw std::runtime_error("SQ8 range cannot change once vectors are encoded");
+    }
+
+    std::vector<float> vmin(samples, samples + dimension_);
+    std::vector<float> vmax(vmin);
+    for (int i = 1; i < nSamples; i++) {
+        const float* vec = samples + static_cast<size_t>(i) * dimension_;
+        for (int d = 0; d < dimension_; d++) {
+            vmin[d] = std::min(vmin[d], vec[d]);
+            vmax[d] = std::max(vmax[d], vec[d]);
+        }
+    }
+
+    std::vector<float> scale(dimension_);
+    for (int d = 0; d < dimension_; d++) {
+        // A constant dimension encodes as 0 and decodes back to its value exactly
+        const float range = vmax[d] - vmin[d];
+        scale[d] = range > 0.0f ? range / 255.0f : 1.0f;
+    }
+
+    sqMin_.swap(vmin);
+    sqScale_.swap(scale);
+}
+
+int VectorStore::add(int id, const float* vector) {
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before adding");
+    }
+    if (!isEncodingTrained()) {
+        throw std::runtime_error("SQ8 VectorStore must be trained before adding");
+    }
+
+    int index = size_.fetch_add(1, std::memory_order_acq_rel);
+    reserveRows(static_cast<size_t>(index) + 1);
 
+    store(index, id, vector);
     return index;
 }
 
 int VectorStore::addBatch(const int* ids, const float* vectors, int count) {
     if (count <= 0) return size_.load();
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before adding");
+    }
+    if (!isEncodingTrained()) {
+        throw std::runtime_error("SQ8 VectorStore must be trained before adding");
+    }
 
     int startIndex = size_.fetch_add(count, std::memory_order_acq_rel);
+    reserveRows(static_cast<size_t>(startIndex) + count);
+
+    for (int i = 0; i < count; i++) {
+        store(startIndex + i, ids[i], vectors + static_cast<size_t>(i) * dimension_);
+    }
 
-    if (startIndex + count > maxElements_) {
-        size_.fetch_sub(count, std::memory_order_relaxed);
-        throw std::runtime_error("VectorStore capacity exceeded");
+    return startIndex;
+}
+
+bool VectorStore::markDeleted(int index) {
+    if (index < 0 || index >= size_.load(std::memory_order_acquire)) return false;
+    const uint64_t bit = uint64_t(1) << (index & 63);
+    if (__atomic_fetch_or(&deleted_[static_cast<size_t>(index) >> 6], bit, __ATOMIC_ACQ_REL) & bit) {
+        return false;
     }
 
-    for (int i = 0; i < count; i++) {
-        int index = startIndex + i;
-        const float* vec = vectors + static_cast<size_t>(i) * dimension_;
-        float* dest = &vectors_[static_cast<size_t>(index) * dimension_];
+    // A later duplicate of the same id keeps its own mapping
+    auto it = idToIndex_.find(ids_[index]);
+    if (it != idToIndex_.end() && it->second == index) {
+        idToIndex_.erase(it);
+    }
+    deletedCount_.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
 
-        std::copy(vec, vec + dimension_, dest);
-        norms_[index] = computeNorm(vec, dimension_);
-        ids_[index] = ids[i];
+void VectorStore::overwrite(int index, const float* vector) {
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before writing");
     }
+    store(index, ids_[index], vector);
+}
 
-    return startIndex;
+void VectorStore::revive(int index, int id, const float* vector) {
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before writing");
+    }
+    // Readers skip the slot until the bit clears, so the new contents go in first
+    store(index, id, vector);
+    const uint64_t bit = uint64_t(1) << (index & 63);
+    if (__atomic_fetch_and(&deleted_[static_cast<size_t>(index) >> 6], ~bit, __ATOMIC_ACQ_REL) & bit) {
+        deletedCount_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void VectorStore::moveEntry(int from, int to) {
+    if (hasVectors_) {
+        std::copy(vectors_.row(from), vectors_.row(from) + dimension_, vectors_.row(to));
+    }
+    if (codeSize_ > 0) {
+        std::copy(codes_.row(from), codes_.row(from) + codeSize_, codes_.row(to));
+    }
+    norms_[to] = norms_[from];
+    ids_[to] = ids_[from];
+
+    auto it = idToIndex_.find(ids_[to]);
+    if (it != idToIndex_.end() && it->second == from) {
+        it->second = to;
+    }
+}
+
+std::vector<std::pair<int, int>> VectorStore::compact() {
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before compacting");
+    }
+
+    std::vector<std::pair<int, int>> moves;
+    if (deletedCount() == 0) return moves;
+
+    // Fill each hole from the back; deleted entries at the tail are simply cut off
+    int last = size_.load(std::memory_order_acquire) - 1;
+    for (int i = 0; i <= last; i++) {
+        if (!isDeleted(i)) continue;
+        while (last > i && isDeleted(last)) last--;
+        if (last <= i) {
+            last = i - 1;
+            break;
+        }
+        moveEntry(last, i);
+        moves.emplace_back(last, i);
+        last--;
+    }
+
+    size_.store(last + 1, std::memory_order_release);
+    const size_t words = (static_cast<size_t>(last + 1) + 63) / 64;
+    for (size_t w = 0; w < words; w++) {
+        __atomic_store_n(&deleted_[w], uint64_t(0), __ATOMIC_RELEASE);
+    }
+    deletedCount_.store(0, std::memory_order_release);
+    return moves;
+}
+
+void VectorStore::permute(const std::vector<int32_t>& order) {
+    if (external_) {
+        throw std::runtime_error("VectorStore is attached to external memory, detach() before permuting");
+    }
+    const int n = size_.load(std::memory_order_acquire);
+    if (order.size() != static_cast<size_t>(n)) {
+        throw std::invalid_argument("Permutation size does not match the store");
+    }
+
+    std::vector<int32_t> newIndex(n, -1);
+    for (int i = 0; i < n; i++) {
+        const int from = order[i];
+        if (from < 0 || from >= n || newIndex[from] >= 0) {
+            throw std::invalid_argument("Order is not a permutation of the store");
+        }
+        newIndex[from] = i;
+    }
+
+    if (hasVectors_) vectors_.permuteRows(order);
+    if (codeSize_ > 0) codes_.permuteRows(order);
+    norms_.permuteRows(order);
+    ids_.permuteRows(order);
+
+    std::vector<uint64_t> deleted((static_cast<size_t>(n) + 63) / 64, 0);
+    for (int i = 0; i < n; i++) {
+        if (isDeleted(order[i])) deleted[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    for (size_t w = 0; w < deleted.size(); w++) {
+        __atomic_store_n(&deleted_[w], deleted[w], __ATOMIC_RELEASE);
+    }
+    for (auto& entry : idToIndex_) {
+        entry.second = newIndex[entry.second];
+    }
 }
 
 void VectorStore::clear() {
     size_.store(0, std::memory_order_release);
-    std::fill(vectors_.begin(), vectors_.end(), 0.0f);
-    std::fill(ids_.begin(), ids_.end(), -1);
-    std::fill(norms_.begin(), norms_.end(), 0.0f);
+    external_ = false;
+    resetBuffers();
+    idToIndex_.clear();
 }
 
 void VectorStore::prefetchVector(int index) const {
-    const float* vec = getVector(index);
-    for (int i = 0; i < dimension_; i += 16) {
-        PREFETCH(&vec[i]);
+    if (index < 0 || index >= size_.load() || (codeSize_ == 0 && !hasVectors_)) return;
+
+    // Traversal reads the codes when the store is quantized, the float copy only for rerank
+    const uint8_t* data = codeSize_ > 0
+        ? codes_.row(index)
+        : reinterpret_cast<const uint8_t*>(vectors_.row(index));
+    const size_t bytes = codeSize_ > 0 ? codeSize_ : static_cast<size_t>(dimension_) * sizeof(float);
+    for (size_t offset = 0; offset < bytes; offset += 64) {
+        PREFETCH(data + offset);
     }
     PREFETCH(&ids_[index]);
     PREFETCH(&norms_[index]);
@@ -95,6 +330,127 @@ void VectorStore::prefetchVectors(const int* indices, int count) const {
     }
 }
 
+void VectorStore::writeSections(IndexFileWriter& writer, bool includeVectors) const {
+    const size_t count = static_cast<size_t>(size_.load(std::memory_order_acquire));
+    if (includeVectors && !hasVectors() && !isQuantized() && count > 0) {
+        throw std::runtime_error("VectorStore has no raw vectors to save");
+    }
+    const bool writeVectors = includeVectors && hasVectors();
+    if (writeVectors) {
+        writer.writeChunkedSection(SectionType::Vectors, vectors_, count);
+    }
+    if (writeVectors || isQuantized()) {
+        writer.writeChunkedSection(SectionType::Norms, norms_, count);
+    }
+    if (isQuantized()) {
+        VectorCodecMeta meta;
+        std::memset(&meta, 0, sizeof(meta));
+        meta.encoding = static_cast<int32_t>(encoding_);
+        writer.beginSection(SectionType::VectorCodec);
+        writer.writePod(meta);
+        writer.write(sqMin_.data(), sqMin_.size() * sizeof(float));
+        writer.write(sqScale_.data(), sqScale_.size() * sizeof(float));
+        writer.endSection();
+        writer.writeChunkedSection(SectionType::VectorCodes, codes_, count);
+    }
+    writer.writeChunkedSection(SectionType::Ids, ids_, count);
+    if (deletedCount() > 0) {
+        writer.writeChunkedSection(SectionType::Tombstones, deleted_, (count + 63) / 64);
+    }
+}
+
+void VectorStore::attachSections(const MappedIndexFile& file, int count) {
+    if (file.dimension() != dimension_) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+    const size_t n = static_cast<size_t>(count);
+
+    // The file decides the encoding, the small SQ8 range tables are copied out
+    VectorEncoding encoding = VectorEncoding::FLOAT32;
+    std::vector<float> vmin, scale;
+    if (file.hasSection(SectionType::VectorCodec)) {
+        const uint8_t* codec = file.section(SectionType::VectorCodec);
+        const size_t codecSize = file.sectionSize(SectionType::VectorCodec);
+        if (codecSize < sizeof(VectorCodecMeta)) {
+            throw std::runtime_error("Corrupted vector codec section");
+        }
+        VectorCodecMeta meta;
+        std::memcpy(&meta, codec, sizeof(meta));
+        encoding = static_cast<VectorEncoding>(meta.encoding);
+        const size_t rangeFloats = encoding == VectorEncoding::SQ8 ? static_cast<size_t>(dimension_) : 0;
+        if ((encoding != VectorEncoding::FP16 && encoding != VectorEncoding::SQ8) ||
+            codecSize != sizeof(meta) + 2 * rangeFloats * sizeof(float)) {
+            throw std::runtime_error("Corrupted vector codec section");
+        }
+        const float* ranges = reinterpret_cast<const float*>(codec + sizeof(meta));
+        vmin.assign(ranges, ranges + rangeFloats);
+        scale.assign(ranges + rangeFloats, ranges + 2 * rangeFloats);
+    }
+    const size_t codeSize = encodedSize(encoding, dimension_);
+
+    int32_t* ids = file.sectionAs<int32_t>(SectionType::Ids, n);
+    float* vectors = file.hasSection(SectionType::Vectors)
+        ? file.sectionAs<float>(SectionType::Vectors, n * dimension_) : nullptr;
+    float* norms = file.hasSection(SectionType::Norms)
+        ? file.sectionAs<float>(SectionType::Norms, n) : nullptr;
+    uint8_t* codes = codeSize > 0 ? file.sectionAs<uint8_t>(SectionType::VectorCodes, n * codeSize) : nullptr;
+    const uint64_t* tombstones = file.hasSection(SectionType::Tombstones)
+        ? file.sectionAs<uint64_t>(SectionType::Tombstones, (n + 63) / 64) : nullptr;
+
+    encoding_ = encoding;
+    codeSize_ = codeSize;
+    keepVectors_ = vectors != nullptr;
+    sqMin_.swap(vmin);
+    sqScale_.swap(scale);
+
+    // Chunks point straight into the mapping, the owned chunks are released
+    vectors_.clear();
+    codes_.reset(std::max<size_t>(codeSize_, 1), CHUNK_ROWS);
+    hasVectors_ = vectors != nullptr;
+    hasNorms_ = norms != nullptr;
+    if (vectors) vectors_.attach(vectors, n);
+    if (norms) norms_.attach(norms, n); else norms_.clear();
+    if (codes) codes_.attach(codes, n);
+    ids_.attach(ids, n);
+
+    // Tombstones stay in owned memory so removals never write to the file
+    deleted_.clear();
+    deleted_.reserve(std::max<size_t>((n + 63) / 64, 1));
+    int deleted = 0;
+    if (tombstones) {
+        for (size_t w = 0; w < (n + 63) / 64; w++) {
+            deleted_[w] = tombstones[w];
+            deleted += __builtin_popcountll(tombstones[w]);
+        }
+    }
+    deletedCount_.store(deleted, std::memory_order_release);
+
+    maxElements_ = std::max(maxElements_, count);
+    size_.store(count, std::memory_order_release);
+    idToIndex_.clear();
+    idToIndex_.reserve(n);
+    for (int i = 0; i < count; i++) {
+        if (!isDeleted(i)) idToIndex_[ids_[i]] = i;
+    }
+    external_ = true;
+}
+
+void VectorStore::detach() {
+    if (!external_) return;
+    if (!hasVectors() && !isQuantized()) {
+        throw std::runtime_error("VectorStore was loaded without raw vectors and cannot be detached");
+    }
+
+    const size_t count = static_cast<size_t>(size_.load(std::memory_order_acquire));
+    vectors_.detach(count);
+    ids_.detach(count);
+    codes_.detach(count);
+    norms_.detach(count);
+    hasNorms_ = true;
+    external_ = false;
+    reserveRows(std::max(count, static_cast<size_t>(maxElements_)));
+}
+
 float VectorStore::computeNorm(const float* vector, int dimension) {
     float sum = 0.0f;
     for (int i = 0; i < dimension; i++) {
@@ -103,30 +459,29 @@ float VectorStore::computeNorm(const float* vector, int dimension) {
     return sum;  // Return squared norm to avoid sqrt overhead
 }
 
-bool VectorStore::enableHugePages() {
-#ifdef __linux__
-    if (usingHugePages_) return true;
-
-    size_t vectorSize = static_cast<size_t>(maxElements_) * dimension_ * sizeof(float);
-    size_t idsSize = static_cast<size_t>(maxElements_) * sizeof(int32_t);
-    size_t normsSize = static_cast<size_t>(maxElements_) * sizeof(float);
-    hugePageSize_ = ((vectorSize + idsSize + normsSize + (2 * 1024 * 1024) - 1) / (2 * 1024 * 1024)) * (2 * 1024 * 1024);
-
-    hugePageMemory_ = mmap(nullptr, hugePageSize_,
-                           PROT_READ | PROT_WRITE,
-                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
-                           -1, 0);
+MemoryPolicy VectorStore::setMemoryPolicy(const MemoryPolicy& policy) {
+    setAllocator(std::make_shared<MemoryAllocator>(policy));
+    return memoryPolicy();
+}
 
-    if (hugePageMemory_ == MAP_FAILED) {
-        hugePageMemory_ = nullptr;
-        return false;
+void VectorStore::setAllocator(std::shared_ptr<MemoryAllocator> allocator) {
+    if (size_.load(std::memory_order_acquire) > 0 || external_) {
+        throw std::logic_error("VectorStore memory policy must be set before adding vectors");
     }
+    allocator_ = allocator ? std::move(allocator) : MemoryAllocator::defaultAllocator();
 
-    usingHugePages_ = true;
-    return true;
-#else
-    return false;
-#endif
+    // Chunks of the old allocator go first, the reservation is redone with the new one
+    vectors_.clear();
+    ids_.clear();
+    norms_.clear();
+    codes_.clear();
+    deleted_.clear();
+    vectors_.setAllocator(allocator_);
+    ids_.setAllocator(allocator_);
+    norms_.setAllocator(allocator_);
+    codes_.setAllocator(allocator_);
+    deleted_.setAllocator(allocator_);
+    reserveRows(static_cast<size_t>(maxElements_));
 }
 
 } // namespace vectordb
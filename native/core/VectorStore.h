@@ -1,18 +1,46 @@
 #pragma once
+#include "ChunkedArray.h"
 #include <vector>
 #include <cstdint>
 #include <atomic>
+#include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
 
 namespace vectordb {
 
+class IndexFileWriter;
+class MappedIndexFile;
+
+/**
+ * 向量存储编码
+ * - FLOAT32: 原始 float
+ * - FP16: IEEE 半精度，内存为 1/2，无需训练
+ * - SQ8: 逐维 8 位标量量化 (每维 min/scale)，内存为 1/4，添加前须 trainEncoding
+ * 数值会写入索引文件，不可改动已有取值
+ */
+enum class VectorEncoding : int32_t {
+    FLOAT32 = 0,
+    FP16 = 1,
+    SQ8 = 2
+};
+
 /**
  * 向量存储类
  * 使用Structure of Arrays (SoA)布局优化缓存性能
+ * 量化编码下另存一份紧凑编码供遍历使用；keepVectors 为 false 时不保留 float 原向量，
+ * getVector 返回 nullptr，模长始终按原向量计算
+ * 各数组按 CHUNK_ROWS 行分块增长，maxElements 只是初始预留 (只占虚拟地址，不占物理内存)；
+ * 块地址永不改变，add 扩容时并发读者不受影响。同一块内的行连续存放
  */
 class VectorStore {
 public:
-    VectorStore(int dimension, int maxElements);
+    // 每块行数，批量扫描按块内连续的片段处理
+    static constexpr int CHUNK_ROWS = 4096;
+
+    VectorStore(int dimension, int maxElements,
+                VectorEncoding encoding = VectorEncoding::FLOAT32, bool keepVectors = true);
 
     // 添加向量，返回索引
     int add(int id, const float* vector);
@@ -20,12 +48,12 @@ public:
     // 批量添加
     int addBatch(const int* ids, const float* vectors, int count);
 
-    // 获取向量
+    // 获取向量，同一块内后续向量紧随其后 (见 contiguousRows)
     const float* getVector(int index) const {
-        if (index < 0 || index >= size_.load()) {
+        if (index < 0 || index >= size_.load() || !hasVectors_) {
             return nullptr;
         }
-        return vectors_.data() + static_cast<size_t>(index) * dimension_;
+        return vectors_.row(index);
     }
 
     // 获取ID
@@ -38,44 +66,138 @@ public:
 
     // 获取模长
     float getNorm(int index) const {
-        if (index < 0 || index >= size_.load()) {
+        if (index < 0 || index >= size_.load() || !hasNorms_) {
             return 0.0f;
         }
         return norms_[index];
     }
 
-    // 预取向量到缓存
+    // 从 start 起连续存放的 contiguousRows(start) 个模长，供批量扫描使用
+    const float* getNorms(int start) const { return hasNorms_ ? norms_.row(start) : nullptr; }
+
+    // 从第 index 行起与它处于同一块、地址连续的行数
+    int contiguousRows(int index) const { return CHUNK_ROWS - (index & (CHUNK_ROWS - 1)); }
+
+    // 量化编码 (FP16 为 uint16 数组，SQ8 为 uint8 数组)，FLOAT32 下返回 nullptr
+    const uint8_t* getCode(int index) const {
+        if (index < 0 || index >= size_.load() || codeSize_ == 0) {
+            return nullptr;
+        }
+        return codes_.row(index);
+    }
+
+    // 外部 id 对应的下标，不存在或已删除时返回 -1；同一 id 添加多次时指向最后一次
+    // 与 add 一样不加锁，由调用方串行化
+    int findIndex(int id) const {
+        auto it = idToIndex_.find(id);
+        return it == idToIndex_.end() ? -1 : it->second;
+    }
+
+    // 删除标记 (墓碑): 被标记的下标仍占用槽位，由索引在遍历中跳过
+    // isDeleted 可与 markDeleted 并发调用
+    bool isDeleted(int index) const {
+        return (__atomic_load_n(&deleted_[static_cast<size_t>(index) >> 6], __ATOMIC_ACQUIRE) >>
+                (index & 63)) & 1;
+    }
+    // 标记删除并解除 id 映射，已删除时返回 false
+    bool markDeleted(int index);
+    int deletedCount() const { return deletedCount_.load(std::memory_order_acquire); }
+
+    // 原地覆盖第 index 个向量 (id 不变)；复用已删除的槽位时 revive 写入新 id 并清除删除标记
+    void overwrite(int index, const float* vector);
+    void revive(int index, int id, const float* vector);
+
+    // 把末尾的存活向量搬进已删除的槽位并截断，返回依次执行的 (from, to) 搬移，
+    // 带平行数组的索引按同样顺序重放；之后不再有删除标记
+    std::vector<std::pair<int, int>> compact();
+
+    // 按 order 重排全部行 (新下标 i 存放原下标 order[i] 的向量)，删除标记与 id 映射随之更新；
+    // order 须为 [0, size) 的排列，调用方保证没有并发访问
+    void permute(const std::vector<int32_t>& order);
+
+    // 把第 index 个向量解码为 float 写入 out (FLOAT32 下直接拷贝)
+    void decode(int index, float* out) const;
+
+    VectorEncoding encoding() const { return encoding_; }
+    bool isQuantized() const { return encoding_ != VectorEncoding::FLOAT32; }
+    size_t codeSize() const { return codeSize_; }
+
+    // SQ8 按样本的逐维取值范围确定 min/scale，超出范围的分量编码时截断
+    void trainEncoding(const float* samples, int nSamples);
+    bool isEncodingTrained() const { return encoding_ != VectorEncoding::SQ8 || !sqMin_.empty(); }
+    const float* sqMin() const { return sqMin_.data(); }
+    const float* sqScale() const { return sqScale_.data(); }
+
+    // 预取向量到缓存 (量化编码下预取编码)
     void prefetchVector(int index) const;
     void prefetchVectors(const int* indices, int count) const;
 
     // 清空存储
     void clear();
 
-    // 基本信息
+    // 基本信息；capacity 为已预留的行数，add 超出时自动按块扩容
     int size() const { return size_.load(); }
     int dimension() const { return dimension_; }
-    int capacity() const { return maxElements_; }
-
-    // HugePages支持
-    bool enableHugePages();
+    int capacity() const { return static_cast<int>(ids_.capacity()); }
+    // 已分配的虚拟内存字节数，实际占用的物理内存只包括写入过的页
+    size_t reservedBytes() const;
+
+    // 大页 / NUMA 策略: 之后分配的块按 policy 分配，须在写入任何向量之前调用，返回实际生效的模式；
+    // 块不足半个大页时 (如 dimension < 64 的向量块、id 块) 仍用普通页
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy);
+    void setAllocator(std::shared_ptr<MemoryAllocator> allocator);
+    const std::shared_ptr<MemoryAllocator>& allocator() const { return allocator_; }
+    MemoryPolicy memoryPolicy() const { return allocator_->effective(); }
+
+    // 持久化: 写入 Ids Section，以及可选的 Vectors/Norms Section
+    // 量化编码下总是写入 VectorCodec/VectorCodes 与 Norms，Vectors 只在保留原向量时写入；
+    // 有删除标记时另写 Tombstones Section
+    void writeSections(IndexFileWriter& writer, bool includeVectors = true) const;
+
+    // 直接使用映射文件中的数据 (零拷贝)，不再占用自有缓冲区；删除标记与 id 映射拷贝到内存
+    // 编码方式以文件为准；文件中没有 Vectors Section 时 getVector 返回 nullptr
+    void attachSections(const MappedIndexFile& file, int count);
+
+    // 将外部数据拷贝回自有缓冲区，之后才能继续 add
+    void detach();
+    bool isAttached() const { return external_; }
+    bool hasVectors() const { return hasVectors_; }
 
 private:
     int dimension_;
     int maxElements_;
     std::atomic<int> size_{0};
-
-    // SoA布局存储
-    std::vector<float> vectors_;  // [maxElements][dimension]
-    std::vector<int32_t> ids_;    // [maxElements]
-    std::vector<float> norms_;    // [maxElements] 预计算模长
-
-    // HugePages支持
-    void* hugePageMemory_ = nullptr;
-    size_t hugePageSize_ = 0;
-    bool usingHugePages_ = false;
+    VectorEncoding encoding_;
+    bool keepVectors_;
+    size_t codeSize_ = 0;  // 每个向量的编码字节数
+
+    // SoA布局存储，按 CHUNK_ROWS 行分块
+    ChunkedArray<float> vectors_;   // [size][dimension]
+    ChunkedArray<int32_t> ids_;     // [size]
+    ChunkedArray<float> norms_;     // [size] 预计算模长
+    ChunkedArray<uint8_t> codes_;   // [size][codeSize] 量化编码
+    std::vector<float> sqMin_;      // [dimension] SQ8 每维最小值
+    std::vector<float> sqScale_;    // [dimension] SQ8 每维步长
+
+    // 各数组是否有数据 (load 的文件可能缺少 Vectors / Norms)
+    bool hasVectors_ = false;
+    bool hasNorms_ = true;
+    bool external_ = false;
+
+    // 删除标记位图 [(size + 63) / 64]，与 id 映射一样始终在自有内存中
+    ChunkedArray<uint64_t> deleted_;
+    std::atomic<int> deletedCount_{0};
+    std::unordered_map<int32_t, int32_t> idToIndex_;
+
+    std::shared_ptr<MemoryAllocator> allocator_ = MemoryAllocator::defaultAllocator();
 
     // 工具方法
     static float computeNorm(const float* vector, int dimension);
+    void store(int index, int id, const float* vector);
+    // 为前 rows 行分配各数组的块
+    void reserveRows(size_t rows);
+    void resetBuffers();
+    void moveEntry(int from, int to);
 };
 
 } // namespace vectordb
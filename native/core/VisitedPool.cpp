@@ -0,0 +1,29 @@
+#include "VisitedPool.h"
+
+namespace vectordb {
+
+VisitedPool::Handle VisitedPool::acquire(size_t capacity) {
+    std::unique_ptr<VisitedTable> table;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            table = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+
+    if (!table) {
+        table.reset(new VisitedTable(capacity));
+    } else {
+        table->ensureCapacity(capacity);
+    }
+    table->reset();
+    return Handle(this, std::move(table));
+}
+
+void VisitedPool::release(std::unique_ptr<VisitedTable> table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(std::move(table));
+}
+
+} // namespace vectordb
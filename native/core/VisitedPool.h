@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace vectordb {
+
+/**
+ * 访问标记表
+ * 每个节点一个 epoch 标记，tag == epoch 即视为已访问。
+ * reset() 只递增 epoch，是 O(1) 操作；epoch 回绕时才整体清零一次。
+ * 检查只需一次数组读取，无哈希、无分配。
+ */
+class VisitedTable {
+public:
+    explicit VisitedTable(size_t capacity) : tags_(capacity, 0) {}
+
+    // 开始一次新的搜索
+    void reset() {
+        if (++epoch_ == 0) {
+            std::fill(tags_.begin(), tags_.end(), 0);
+            epoch_ = 1;
+        }
+    }
+
+    bool isVisited(int id) const { return tags_[id] == epoch_; }
+    void markVisited(int id) { tags_[id] = epoch_; }
+
+    // 未访问时标记并返回 true
+    bool tryVisit(int id) {
+        if (tags_[id] == epoch_) return false;
+        tags_[id] = epoch_;
+        return true;
+    }
+
+    size_t capacity() const { return tags_.size(); }
+
+    // 扩容时新增部分为 0，不会与任何有效 epoch 冲突
+    void ensureCapacity(size_t capacity) {
+        if (capacity > tags_.size()) {
+            tags_.resize(capacity, 0);
+        }
+    }
+
+private:
+    std::vector<uint16_t> tags_;
+    uint16_t epoch_ = 0;
+};
+
+/**
+ * 访问标记表池
+ * 每次搜索借出一张表，结束时由 Handle 自动归还；并发搜索数超过池中表数时按需新建。
+ */
+class VisitedPool {
+public:
+    class Handle {
+    public:
+        Handle(VisitedPool* pool, std::unique_ptr<VisitedTable> table)
+            : pool_(pool), table_(std::move(table)) {}
+        ~Handle() {
+            if (table_) pool_->release(std::move(table_));
+        }
+
+        Handle(Handle&&) = default;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        VisitedTable& operator*() { return *table_; }
+        VisitedTable* operator->() { return table_.get(); }
+
+    private:
+        VisitedPool* pool_;
+        std::unique_ptr<VisitedTable> table_;
+    };
+
+    VisitedPool() = default;
+    VisitedPool(const VisitedPool&) = delete;
+    VisitedPool& operator=(const VisitedPool&) = delete;
+
+    // 借出一张至少容纳 capacity 个节点、已 reset 的表
+    Handle acquire(size_t capacity);
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<VisitedTable>> free_;
+
+    void release(std::unique_ptr<VisitedTable> table);
+};
+
+} // namespace vectordb
@@ -1,11 +1,37 @@
 #include "AnnoyIndex.h"
 #include "../compute/DistanceUtils.h"
+#include "../core/SearchContext.h"
+#include "../core/ThreadPool.h"
 #include <random>
+#include <chrono>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 namespace vectordb {
 
+namespace {
+
+constexpr size_t ANNOY_LEAF_SIZE = 10;
+
+// Best-first search frontier: node of one tree and the smallest margin on its path
+struct AnnoyQueueEntry {
+    float margin;
+    int32_t tree;
+    int32_t node;
+    bool operator<(const AnnoyQueueEntry& other) const { return margin < other.margin; }
+};
+
+} // namespace
+
+struct AnnoyIndex::TreeBuild {
+    std::vector<Node> nodes;
+    std::vector<float> hyperplanes;
+    std::vector<int32_t> leaves;
+};
+
 AnnoyIndex::AnnoyIndex(int dimension, int maxElements)
     : AnnoyIndex(dimension, maxElements, 10) {}
 
@@ -15,175 +41,322 @@ AnnoyIndex::AnnoyIndex(int dimension, int maxElements, int numTrees)
 
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     rng_.seed(seed);
-    trees_.resize(numTrees);
+    treeOffsets_.resize(static_cast<size_t>(numTrees) + 1, 0);
 }
 
 void AnnoyIndex::add(int id, const float* vector) {
+    detachMapping();
     vectorStore_.add(id, vector);
     size_++;
 }
 
 void AnnoyIndex::build() {
-    std::vector<int> indices(size_);
-    for (int i = 0; i < size_; i++) {
-        indices[i] = i;
+    // Seeds are drawn up front so the result does not depend on thread scheduling
+    std::vector<uint32_t> seeds(numTrees_);
+    for (auto& seed : seeds) {
+        seed = static_cast<uint32_t>(rng_());
     }
 
-    for (int t = 0; t < numTrees_; t++) {
-        std::shuffle(indices.begin(), indices.end(), rng_);
-        buildTree(t, indices);
+    std::vector<TreeBuild> trees(numTrees_);
+    ThreadPool::instance().parallelFor(0, numTrees_, 1, [&](int64_t start, int64_t end) {
+        for (int64_t t = start; t < end; t++) {
+            buildTree(seeds[t], trees[t]);
+        }
+    });
+
+    // Concatenate into the flat arrays, rebasing hyperplane rows and leaf offsets
+    size_t nodeCount = 0, hyperplaneCount = 0, leafCount = 0;
+    for (const auto& tree : trees) {
+        nodeCount += tree.nodes.size();
+        hyperplaneCount += tree.hyperplanes.size();
+        leafCount += tree.leaves.size();
+    }
+    treeOffsets_.clear();
+    nodes_.clear();
+    hyperplanes_.clear();
+    leafIndices_.clear();
+    treeOffsets_.reserve(static_cast<size_t>(numTrees_) + 1);
+    nodes_.reserve(nodeCount);
+    hyperplanes_.reserve(hyperplaneCount);
+    leafIndices_.reserve(leafCount);
+
+    treeOffsets_.push_back(0);
+    for (auto& tree : trees) {
+        const int32_t rowBase = static_cast<int32_t>(hyperplanes_.size() / dimension_);
+        const uint64_t leafBase = leafIndices_.size();
+        for (Node& node : tree.nodes) {
+            if (node.hyperplane >= 0) node.hyperplane += rowBase;
+            node.indexOffset += leafBase;
+        }
+        nodes_.append(tree.nodes.data(), tree.nodes.size());
+        hyperplanes_.append(tree.hyperplanes.data(), tree.hyperplanes.size());
+        leafIndices_.append(tree.leaves.data(), tree.leaves.size());
+        treeOffsets_.push_back(nodes_.size());
     }
 
     built_ = true;
 }
 
-void AnnoyIndex::buildTree(int treeIdx, const std::vector<int>& indices) {
-    if (indices.empty()) return;
+void AnnoyIndex::buildTree(uint32_t seed, TreeBuild& tree) const {
+    if (size_ == 0) return;
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0, 1.0);
+    DistanceFunc dotFunc = getInnerProductDistanceFunc();
+
+    std::vector<int> indices(size_);
+    for (int i = 0; i < size_; i++) {
+        indices[i] = i;
+    }
+    std::shuffle(indices.begin(), indices.end(), rng);
 
-    std::vector<int> toProcess = indices;
-    trees_[treeIdx].clear();
+    tree.nodes.push_back(Node{-1, -1, -1, 0.0f, 0, 0});
 
-    trees_[treeIdx].push_back(Node{});
-    int rootIdx = 0;
+    // Work list of (node, vectors routed to that node)
+    std::vector<std::pair<int, std::vector<int>>> toProcess;
+    toProcess.emplace_back(0, std::move(indices));
 
-    std::normal_distribution<float> dist(0.0, 1.0);
+    std::vector<float> hyperplane(dimension_);
+    std::vector<float> dots;
+
+    auto makeLeaf = [&](int nodeIdx, const std::vector<int>& members) {
+        Node& node = tree.nodes[nodeIdx];
+        node.indexOffset = tree.leaves.size();
+        node.indexCount = members.size();
+        tree.leaves.insert(tree.leaves.end(), members.begin(), members.end());
+    };
 
     while (!toProcess.empty()) {
-        int nodeIdx = toProcess.back();
+        int nodeIdx = toProcess.back().first;
+        std::vector<int> nodeIndices = std::move(toProcess.back().second);
         toProcess.pop_back();
 
-        if (static_cast<int>(toProcess.size()) < 10) {
-            trees_[treeIdx][nodeIdx].indices = toProcess;
-            toProcess.clear();
+        if (nodeIndices.size() <= ANNOY_LEAF_SIZE) {
+            makeLeaf(nodeIdx, nodeIndices);
             continue;
         }
 
-        std::vector<float> hyperplane(dimension_);
-        for (int d = 0; d < dimension_; d++) {
-            hyperplane[d] = dist(rng_);
-        }
-
         float norm = 0.0f;
-        for (float v : hyperplane) {
-            norm += v * v;
+        for (int d = 0; d < dimension_; d++) {
+            hyperplane[d] = dist(rng);
+            norm += hyperplane[d] * hyperplane[d];
         }
         norm = std::sqrt(norm);
         for (float& v : hyperplane) {
             v /= norm;
         }
 
+        dots.resize(nodeIndices.size());
         float bias = 0.0f;
-        for (int idx : toProcess) {
-            const float* vec = vectorStore_.getVector(idx);
-            float dot = 0.0f;
-            for (int d = 0; d < dimension_; d++) {
-                dot += vec[d] * hyperplane[d];
-            }
-            bias += dot;
+        for (size_t i = 0; i < nodeIndices.size(); i++) {
+            dots[i] = -dotFunc(vectorStore_.getVector(nodeIndices[i]), hyperplane.data(), dimension_);
+            bias += dots[i];
         }
-        bias /= toProcess.size();
+        bias /= nodeIndices.size();
 
         std::vector<int> leftIndices, rightIndices;
-        for (int idx : toProcess) {
-            const float* vec = vectorStore_.getVector(idx);
-            float dot = 0.0f;
-            for (int d = 0; d < dimension_; d++) {
-                dot += vec[d] * hyperplane[d];
-            }
-            if (dot < bias) {
-                leftIndices.push_back(idx);
+        for (size_t i = 0; i < nodeIndices.size(); i++) {
+            if (dots[i] < bias) {
+                leftIndices.push_back(nodeIndices[i]);
             } else {
-                rightIndices.push_back(idx);
+                rightIndices.push_back(nodeIndices[i]);
             }
         }
 
-        trees_[treeIdx][nodeIdx].hyperplane = hyperplane;
-        trees_[treeIdx][nodeIdx].bias = bias;
-
-        if (!leftIndices.empty()) {
-            trees_[treeIdx][nodeIdx].left = trees_[treeIdx].size();
-            trees_[treeIdx].push_back(Node{});
-            toProcess.insert(toProcess.end(), leftIndices.begin(), leftIndices.end());
+        // Degenerate split (duplicate vectors), keep everything in one leaf
+        if (leftIndices.empty() || rightIndices.empty()) {
+            makeLeaf(nodeIdx, nodeIndices);
+            continue;
         }
 
-        if (!rightIndices.empty()) {
-            trees_[treeIdx][nodeIdx].right = trees_[treeIdx].size();
-            trees_[treeIdx].push_back(Node{});
-            toProcess.insert(toProcess.end(), rightIndices.begin(), rightIndices.end());
-        }
+        int leftIdx = static_cast<int>(tree.nodes.size());
+        int rightIdx = leftIdx + 1;
+        tree.nodes.push_back(Node{-1, -1, -1, 0.0f, 0, 0});
+        tree.nodes.push_back(Node{-1, -1, -1, 0.0f, 0, 0});
+
+        Node& node = tree.nodes[nodeIdx];
+        node.left = leftIdx;
+        node.right = rightIdx;
+        node.hyperplane = static_cast<int32_t>(tree.hyperplanes.size() / dimension_);
+        node.bias = bias;
+        tree.hyperplanes.insert(tree.hyperplanes.end(), hyperplane.begin(), hyperplane.end());
+
+        toProcess.emplace_back(leftIdx, std::move(leftIndices));
+        toProcess.emplace_back(rightIdx, std::move(rightIndices));
     }
 }
 
 void AnnoyIndex::search(const float* query, int k,
                        int* resultIds, float* resultDistances,
                        int* resultCount) {
-    if (!built_) {
+    if (!built_ || size_ == 0 || k <= 0) {
         *resultCount = 0;
         return;
     }
 
     DistanceFunc distFunc = getEuclideanDistanceFunc();
-    const int maxCandidates = k * numTrees_ * 2;
-    std::vector<int> candidates;
+    DistanceFunc dotFunc = getInnerProductDistanceFunc();
+    const int64_t maxCandidates = static_cast<int64_t>(k) * numTrees_ * 2;
 
+    // One frontier over all trees, always expanding the side farthest from any split seen so far
+    thread_local std::vector<AnnoyQueueEntry> queue;
+    queue.clear();
     for (int t = 0; t < numTrees_; t++) {
-        searchTree(t, 0, query, candidates, maxCandidates);
+        if (treeOffsets_[t + 1] > treeOffsets_[t]) {
+            queue.push_back({std::numeric_limits<float>::infinity(), t, 0});
+        }
     }
+    std::make_heap(queue.begin(), queue.end());
+
+    SearchContext& context = SearchContext::local();
+    auto& results = context.results;
+    results.reset(k);
+    auto visited = visitedPool_.acquire(size_);
+
+    int64_t candidates = 0;
+    while (candidates < maxCandidates && !queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end());
+        AnnoyQueueEntry entry = queue.back();
+        queue.pop_back();
+
+        const Node* tree = nodes_.data() + treeOffsets_[entry.tree];
+        const Node& node = tree[entry.node];
+
+        if (node.left < 0) {
+            const int32_t* members = leafIndices_.data() + node.indexOffset;
+            for (uint64_t i = 0; i < node.indexCount; i++) {
+                const int idx = members[i];
+                if (!visited->tryVisit(idx)) continue;
+                results.push({distFunc(query, vectorStore_.getVector(idx), dimension_), idx});
+            }
+            candidates += static_cast<int64_t>(node.indexCount);
+            continue;
+        }
 
-    std::sort(candidates.begin(), candidates.end());
-    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
-
-    std::vector<std::pair<float, int>> results;
-    for (int idx : candidates) {
-        const float* vec = vectorStore_.getVector(idx);
-        float dist = distFunc(query, vec, dimension_);
-        results.emplace_back(dist, vectorStore_.getId(idx));
+        const float* hyperplane = hyperplanes_.data() + static_cast<size_t>(node.hyperplane) * dimension_;
+        float margin = -dotFunc(query, hyperplane, dimension_) - node.bias;
+        queue.push_back({std::min(entry.margin, margin), entry.tree, node.right});
+        std::push_heap(queue.begin(), queue.end());
+        queue.push_back({std::min(entry.margin, -margin), entry.tree, node.left});
+        std::push_heap(queue.begin(), queue.end());
     }
 
-    std::partial_sort(results.begin(),
-                      results.begin() + std::min(k, static_cast<int>(results.size())),
-                      results.end());
-
-    int count = std::min(k, static_cast<int>(results.size()));
+    const auto& sorted = results.sortAscending();
+    int count = static_cast<int>(sorted.size());
     for (int i = 0; i < count; i++) {
-        resultDistances[i] = results[i].first;
-        resultIds[i] = results[i].second;
+        resultDistances[i] = sorted[i].first;
+        resultIds[i] = vectorStore_.getId(sorted[i].second);
     }
     *resultCount = count;
 }
 
-void AnnoyIndex::searchTree(int treeIdx, int nodeIdx, const float* query,
-                           std::vector<int>& candidates, int maxCandidates) {
-    if (nodeIdx < 0 || nodeIdx >= static_cast<int>(trees_[treeIdx].size())) return;
-    if (static_cast<int>(candidates.size()) >= maxCandidates) return;
+namespace {
 
-    const Node& node = trees_[treeIdx][nodeIdx];
+struct AnnoyFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t numTrees;
+    int32_t built;
+};
 
-    if (node.left < 0 && node.right < 0) {
-        candidates.insert(candidates.end(), node.indices.begin(), node.indices.end());
-        return;
+} // namespace
+
+void AnnoyIndex::save(const std::string& path) {
+    IndexFileWriter writer(path, IndexType::Annoy, dimension_);
+
+    AnnoyFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = size_;
+    meta.capacity = maxElements_;
+    meta.numTrees = numTrees_;
+    meta.built = built_ ? 1 : 0;
+    writer.writeSection(SectionType::AnnoyMeta, &meta, sizeof(meta));
+
+    // The in-memory arrays already have the file layout
+    writer.writeSection(SectionType::AnnoyTreeOffsets, treeOffsets_.data(), treeOffsets_.size() * sizeof(uint64_t));
+    writer.writeSection(SectionType::AnnoyNodes, nodes_.data(), nodes_.size() * sizeof(Node));
+    writer.writeSection(SectionType::AnnoyHyperplanes, hyperplanes_.data(), hyperplanes_.size() * sizeof(float));
+    writer.writeSection(SectionType::AnnoyLeafIndices, leafIndices_.data(), leafIndices_.size() * sizeof(int32_t));
+
+    vectorStore_.writeSections(writer);
+
+    writer.finish();
+}
+
+void AnnoyIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::Annoy);
+    if (file->dimension() != dimension_) {
+        throw std::runtime_error("Index file dimension mismatch");
     }
+    const std::string corrupted = "Corrupted Annoy index file: " + path;
 
-    float dot = 0.0f;
-    for (int d = 0; d < dimension_; d++) {
-        dot += query[d] * node.hyperplane[d];
+    const auto* meta = file->sectionAs<AnnoyFileMeta>(SectionType::AnnoyMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->numTrees < 0) {
+        throw std::runtime_error(corrupted);
+    }
+    const size_t numTrees = meta->numTrees;
+
+    uint64_t* treeOffsets = file->sectionAs<uint64_t>(SectionType::AnnoyTreeOffsets, numTrees + 1);
+    size_t nodeCount = file->sectionSize(SectionType::AnnoyNodes) / sizeof(Node);
+    Node* nodes = file->sectionAs<Node>(SectionType::AnnoyNodes, nodeCount);
+    size_t hyperplaneCount = file->sectionSize(SectionType::AnnoyHyperplanes) / (sizeof(float) * dimension_);
+    float* hyperplanes = file->sectionAs<float>(SectionType::AnnoyHyperplanes, hyperplaneCount * dimension_);
+    size_t leafCount = file->sectionSize(SectionType::AnnoyLeafIndices) / sizeof(int32_t);
+    int32_t* leafIndices = file->sectionAs<int32_t>(SectionType::AnnoyLeafIndices, leafCount);
+    if (treeOffsets[0] != 0 || treeOffsets[numTrees] != nodeCount) {
+        throw std::runtime_error(corrupted);
     }
 
-    if (dot < node.bias) {
-        searchTree(treeIdx, node.left, query, candidates, maxCandidates);
-        searchTree(treeIdx, node.right, query, candidates, maxCandidates);
-    } else {
-        searchTree(treeIdx, node.right, query, candidates, maxCandidates);
-        searchTree(treeIdx, node.left, query, candidates, maxCandidates);
+    for (size_t i = 0; i < leafCount; i++) {
+        if (leafIndices[i] < 0 || leafIndices[i] >= n) {
+            throw std::runtime_error(corrupted);
+        }
     }
-}
+    for (size_t t = 0; t < numTrees; t++) {
+        const uint64_t begin = treeOffsets[t];
+        const uint64_t end = treeOffsets[t + 1];
+        if (begin > end || end > nodeCount) {
+            throw std::runtime_error(corrupted);
+        }
+        const int64_t treeSize = static_cast<int64_t>(end - begin);
+
+        // Children are always created after their parent, which keeps every walk finite
+        for (int64_t i = 0; i < treeSize; i++) {
+            const Node& node = nodes[begin + i];
+            const bool leaf = node.left < 0 && node.right < 0;
+            const bool split = node.left > i && node.left < treeSize &&
+                               node.right > i && node.right < treeSize &&
+                               node.hyperplane >= 0 && node.hyperplane < static_cast<int64_t>(hyperplaneCount);
+            if ((!leaf && !split) ||
+                node.indexOffset > leafCount || node.indexCount > leafCount - node.indexOffset) {
+                throw std::runtime_error(corrupted);
+            }
+        }
+    }
+
+    numTrees_ = meta->numTrees;
+    treeOffsets_.attach(treeOffsets, numTrees + 1);
+    nodes_.attach(nodes, nodeCount);
+    hyperplanes_.attach(hyperplanes, hyperplaneCount * dimension_);
+    leafIndices_.attach(leafIndices, leafCount);
+
+    vectorStore_.attachSections(*file, n);
+    mappedFile_ = std::move(file);
 
-void AnnoyIndex::save(const std::string& /*path*/) {
-    // TODO: Implement save
+    maxElements_ = std::max(maxElements_, n);
+    built_ = meta->built != 0;
+    size_ = n;
 }
 
-void AnnoyIndex::load(const std::string& /*path*/) {
-    // TODO: Implement load
+void AnnoyIndex::detachMapping() {
+    if (!mappedFile_) return;
+    vectorStore_.detach();
+    treeOffsets_.detach();
+    nodes_.detach();
+    hyperplanes_.detach();
+    leafIndices_.detach();
+    mappedFile_.reset();
 }
 
 } // namespace vectordb
@@ -1,11 +1,21 @@
 #pragma once
 #include "VectorIndex.h"
 #include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/MappedArray.h"
+#include "../core/VisitedPool.h"
 #include <vector>
 #include <random>
+#include <memory>
 
 namespace vectordb {
 
+/**
+ * 随机投影树 (Annoy) 索引
+ * 所有树的节点、分割超平面和叶子成员分别存放在三个连续数组里 (与文件格式相同，load 后直接 mmap 使用)；
+ * build 每棵树一个线程并行构建；搜索在所有树上共用一个按间隔 (margin) 排序的优先队列，
+ * 最优先展开离分割面最远一侧的子树，直到收集够候选。
+ */
 class AnnoyIndex : public VectorIndex {
 public:
     AnnoyIndex(int dimension, int maxElements);
@@ -15,6 +25,7 @@ public:
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
                int* resultCount) override;
+    using VectorIndex::search;  // 带过滤的重载使用基类的放大 k 实现
     void save(const std::string& path) override;
     void load(const std::string& path) override;
     int size() const override { return size_; }
@@ -22,8 +33,22 @@ public:
     int capacity() const override { return maxElements_; }
 
     void build();
+    bool isBuilt() const { return built_; }
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
 
 private:
+    // 与文件中的节点布局相同；left / right 为同一棵树内的下标，叶子两者均为 -1
+    struct Node {
+        int32_t left;
+        int32_t right;
+        int32_t hyperplane;     // hyperplanes_ 中的行号，叶子为 -1
+        float bias;
+        uint64_t indexOffset;   // 叶子成员在 leafIndices_ 中的位置
+        uint64_t indexCount;
+    };
+
     int dimension_;
     int maxElements_;
     int numTrees_;
@@ -33,19 +58,16 @@ private:
     VectorStore vectorStore_;
     std::mt19937 rng_;
 
-    struct Node {
-        int left = -1;
-        int right = -1;
-        std::vector<float> hyperplane;
-        float bias = 0.0f;
-        std::vector<int> indices;
-    };
-
-    std::vector<std::vector<Node>> trees_;
+    MappedArray<uint64_t> treeOffsets_;  // [numTrees + 1] 每棵树在 nodes_ 中的起止位置
+    MappedArray<Node> nodes_;            // 所有树的节点依次排列
+    MappedArray<float> hyperplanes_;     // [splitNodes][dimension]
+    MappedArray<int32_t> leafIndices_;   // 叶子中的向量下标
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+    mutable VisitedPool visitedPool_;
 
-    void buildTree(int treeIdx, const std::vector<int>& indices);
-    void searchTree(int treeIdx, int nodeIdx, const float* query,
-                   std::vector<int>& candidates, int maxCandidates);
+    struct TreeBuild;
+    void buildTree(uint32_t seed, TreeBuild& tree) const;
+    void detachMapping();
 };
 
 } // namespace vectordb
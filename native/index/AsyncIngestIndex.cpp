@@ -0,0 +1,306 @@
+#include "AsyncIngestIndex.h"
+#include "../core/SearchContext.h"
+#include "../core/ThreadPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+
+namespace vectordb {
+
+namespace {
+
+// Upper bound on how long the worker sleeps when a producer's wake-up races with it going idle
+constexpr auto INGEST_IDLE_WAIT = std::chrono::milliseconds(1);
+
+int dimensionOf(const std::unique_ptr<VectorIndex>& index) {
+    if (!index) {
+        throw std::invalid_argument("AsyncIngestIndex needs an index to wrap");
+    }
+    return index->dimension();
+}
+
+} // namespace
+
+AsyncIngestIndex::AsyncIngestIndex(std::unique_ptr<VectorIndex> index)
+    : AsyncIngestIndex(std::move(index), AsyncIngestConfig{}) {}
+
+AsyncIngestIndex::AsyncIngestIndex(std::unique_ptr<VectorIndex> index, const AsyncIngestConfig& config)
+    : index_(std::move(index)), config_(config),
+      queue_(config.queueCapacity > 0 ? config.queueCapacity : 1, dimensionOf(index_)) {
+    if (config_.batchSize <= 0) config_.batchSize = 1;
+    worker_ = std::thread([this] { workerLoop(); });
+}
+
+AsyncIngestIndex::~AsyncIngestIndex() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    workReady_.notify_one();
+    worker_.join();
+}
+
+void AsyncIngestIndex::wakeWorker() {
+    if (idle_.load(std::memory_order_relaxed)) {
+        workReady_.notify_one();
+    }
+}
+
+uint64_t AsyncIngestIndex::tryIngest(int id, const float* vector) {
+    uint64_t sequence = queue_.tryPush(id, vector);
+    if (sequence) wakeWorker();
+    return sequence;
+}
+
+uint64_t AsyncIngestIndex::ingest(int id, const float* vector) {
+    for (;;) {
+        uint64_t sequence = queue_.tryPush(id, vector);
+        wakeWorker();
+        if (sequence) return sequence;
+        std::this_thread::yield();
+    }
+}
+
+void AsyncIngestIndex::addBatch(const float* vectors, const int* ids, int n) {
+    const int dim = dimension();
+    for (int i = 0; i < n; i++) {
+        ingest(ids[i], vectors + static_cast<size_t>(i) * dim);
+    }
+}
+
+void AsyncIngestIndex::workerLoop() {
+    for (;;) {
+        const float* vectors;
+        const int* ids;
+        size_t count = queue_.front(config_.batchSize, &vectors, &ids);
+        if (count > 0) {
+            // The batch is indexed straight from the queue slots, which stay visible
+            // to scanPending until pop()
+            std::string error;
+            try {
+                index_->addBatch(vectors, ids, static_cast<int>(count));
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            queue_.pop(count);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error.empty() && error_.empty()) error_ = error;
+            }
+            visible_.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stop_) break;
+        idle_.store(true, std::memory_order_relaxed);
+        // Re-check after announcing idleness so a producer that missed the flag costs at most one wait
+        if (queue_.front(1, &vectors, &ids) == 0) {
+            workReady_.wait_for(lock, INGEST_IDLE_WAIT);
+        }
+        idle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncIngestIndex::waitVisible(uint64_t sequence) {
+    sequence = std::min(sequence, queue_.pushedSequence());
+    std::unique_lock<std::mutex> lock(mutex_);
+    visible_.wait(lock, [&] { return queue_.consumedSequence() >= sequence || !error_.empty(); });
+    if (!error_.empty()) {
+        std::string error;
+        error.swap(error_);
+        throw std::runtime_error("Background ingest failed: " + error);
+    }
+}
+
+template <typename Fn>
+void AsyncIngestIndex::forEachPendingDistance(const float* query, const IDFilter* filter, Fn&& fn) const {
+    const int dim = dimension();
+    thread_local std::vector<float> scratch;
+    thread_local std::vector<float> normalized;
+    scratch.resize(dim);
+
+    const float* q = query;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(dim);
+        normalizeVector(query, dim, normalized.data());
+        q = normalized.data();
+    }
+    DistanceFunc euclidean = getEuclideanDistanceFunc();
+    DistanceFunc innerProduct = getInnerProductDistanceFunc();
+
+    queue_.forEachPending(scratch.data(), [&](int id, const float* vector) {
+        if (filter && !filter->contains(id)) return;
+        float dist;
+        switch (config_.metric) {
+            case Metric::INNER_PRODUCT: dist = innerProduct(q, vector, dim); break;
+            case Metric::COSINE:
+                dist = cosineFromNegDot(innerProduct(q, vector, dim), 1.0f, -innerProduct(vector, vector, dim));
+                break;
+            default: dist = euclidean(q, vector, dim); break;
+        }
+        fn(dist, id);
+    });
+}
+
+int AsyncIngestIndex::scanPending(const float* query, int k, const IDFilter* filter, Entry* out) const {
+    if (queue_.pendingCount() == 0) return 0;
+
+    thread_local BoundedMaxHeap<Entry> heap;
+    heap.reset(k);
+    forEachPendingDistance(query, filter, [&](float dist, int id) { heap.push({dist, id}); });
+
+    const auto& sorted = heap.sortAscending();
+    std::copy(sorted.begin(), sorted.end(), out);
+    return static_cast<int>(sorted.size());
+}
+
+int AsyncIngestIndex::mergePending(const Entry* pending, int pendingCount, int k,
+                                   int* resultIds, float* resultDistances, int count) {
+    thread_local std::vector<Entry> merged;
+    merged.clear();
+
+    // A write can be both indexed and still queued (between addBatch and pop); keep one copy
+    auto queued = [&](int id) {
+        for (int j = 0; j < pendingCount; j++) {
+            if (pending[j].second == id) return true;
+        }
+        return false;
+    };
+
+    int i = 0, j = 0;
+    while (static_cast<int>(merged.size()) < k && (i < count || j < pendingCount)) {
+        if (j < pendingCount && (i >= count || pending[j].first < resultDistances[i])) {
+            merged.push_back(pending[j++]);
+        } else {
+            if (!queued(resultIds[i])) merged.emplace_back(resultDistances[i], resultIds[i]);
+            i++;
+        }
+    }
+
+    for (size_t m = 0; m < merged.size(); m++) {
+        resultDistances[m] = merged[m].first;
+        resultIds[m] = merged[m].second;
+    }
+    return static_cast<int>(merged.size());
+}
+
+void AsyncIngestIndex::search(const float* query, int k,
+                             int* resultIds, float* resultDistances,
+                             int* resultCount, const IDFilter* filter) {
+    if (k <= 0) {
+        *resultCount = 0;
+        return;
+    }
+
+    // The queue is scanned before the index: a write missing from the scan was popped,
+    // and pop only happens after it was added to the index
+    thread_local std::vector<Entry> pending;
+    pending.resize(k);
+    int pendingCount = scanPending(query, k, filter, pending.data());
+
+    int count = 0;
+    index_->search(query, k, resultIds, resultDistances, &count, filter);
+    *resultCount = pendingCount > 0
+        ? mergePending(pending.data(), pendingCount, k, resultIds, resultDistances, count)
+        : count;
+}
+
+void AsyncIngestIndex::searchBatch(const float* queries, int nQueries, int k,
+                                  int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    if (nQueries <= 0 || k <= 0) return;
+    const int dim = dimension();
+
+    std::vector<Entry> pending;
+    std::vector<int> pendingCounts(nQueries, 0);
+    if (queue_.pendingCount() > 0) {
+        pending.resize(static_cast<size_t>(nQueries) * k);
+        ThreadPool::instance().parallelFor(0, nQueries, 16, [&](int64_t start, int64_t end) {
+            for (int64_t q = start; q < end; q++) {
+                pendingCounts[q] = scanPending(queries + q * dim, k, nullptr, pending.data() + q * k);
+            }
+        }, numThreads_);
+    }
+
+    index_->searchBatch(queries, nQueries, k, resultIds, resultDistances, queryStats);
+
+    for (int q = 0; q < nQueries; q++) {
+        if (pendingCounts[q] == 0) continue;
+        int* ids = resultIds + static_cast<size_t>(q) * k;
+        float* dists = resultDistances + static_cast<size_t>(q) * k;
+        int count = static_cast<int>(std::find(ids, ids + k, -1) - ids);
+        count = mergePending(pending.data() + static_cast<size_t>(q) * k, pendingCounts[q], k, ids, dists, count);
+        for (int j = count; j < k; j++) {
+            ids[j] = -1;
+            dists[j] = -1.0f;
+        }
+    }
+}
+
+void AsyncIngestIndex::rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                                   const IDFilter* filter) {
+    // Same ordering argument as search: queue first, then the index
+    std::vector<Entry> pending;
+    if (queue_.pendingCount() > 0) {
+        forEachPendingDistance(query, filter, [&](float dist, int id) {
+            if (dist <= radius) pending.emplace_back(dist, id);
+        });
+    }
+
+    index_->rangeSearch(query, radius, result, filter);
+    if (pending.empty()) return;
+
+    std::sort(pending.begin(), pending.end(),
+              [](const Entry& a, const Entry& b) { return a.second < b.second; });
+    auto queued = [&](int id) {
+        return std::binary_search(pending.begin(), pending.end(), Entry{0.0f, id},
+                                  [](const Entry& a, const Entry& b) { return a.second < b.second; });
+    };
+
+    // A write can be both indexed and still queued; the queued copy wins
+    size_t kept = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        if (queued(result.ids[i])) continue;
+        result.ids[kept] = result.ids[i];
+        result.distances[kept] = result.distances[i];
+        kept++;
+    }
+    result.ids.resize(kept);
+    result.distances.resize(kept);
+    for (const auto& entry : pending) {
+        result.push(entry.second, entry.first);
+    }
+    result.sort();
+}
+
+bool AsyncIngestIndex::remove(int id) {
+    flush();
+    return index_->remove(id);
+}
+
+bool AsyncIngestIndex::update(int id, const float* vector) {
+    flush();
+    return index_->update(id, vector);
+}
+
+int AsyncIngestIndex::compact() {
+    flush();
+    return index_->compact();
+}
+
+void AsyncIngestIndex::optimize() {
+    flush();
+    index_->optimize();
+}
+
+void AsyncIngestIndex::save(const std::string& path) {
+    flush();
+    index_->save(path);
+}
+
+void AsyncIngestIndex::load(const std::string& path) {
+    flush();
+    index_->load(path);
+}
+
+} // namespace vectordb
@@ -0,0 +1,109 @@
+#pragma once
+#include "VectorIndex.h"
+#include "../core/IngestQueue.h"
+#include "../compute/DistanceUtils.h"
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+
+namespace vectordb {
+
+struct AsyncIngestConfig {
+    Metric metric = Metric::L2;  // 须与被包装索引的度量一致，用于暴力扫描尚未建索引的写入
+    int queueCapacity = 8192;    // 队列槽数 (向上取整为 2 的幂)，满时 add 自旋等待
+    int batchSize = 256;         // 后台线程每次交给 addBatch 的最大条数
+};
+
+/**
+ * 异步写入索引: add / ingest 把向量放入无锁 MPSC 队列后立即返回，
+ * 一个后台线程按批调用被包装索引的 addBatch (HNSW 等的 addBatch 自身会用线程池并行建图)。
+ * 每条写入有一个序号，visibleSequence() 之前的写入都已进入被包装的索引，
+ * waitVisible / flush 用于需要确认落入索引的场景；
+ * 在此之前 search 会暴力扫描队列中的向量并与索引结果合并，因此写入返回后立刻可以被搜到。
+ *
+ * remove / update / save / load / compact / optimize 先 flush，再交给被包装的索引；
+ * 被包装索引须支持 addBatch 与 search 并发 (HNSW、IVF、Flat 等都满足)。
+ */
+class AsyncIngestIndex : public VectorIndex {
+public:
+    explicit AsyncIngestIndex(std::unique_ptr<VectorIndex> index);
+    AsyncIngestIndex(std::unique_ptr<VectorIndex> index, const AsyncIngestConfig& config);
+    ~AsyncIngestIndex() override;
+
+    // 等同于 ingest，忽略序号
+    void add(int id, const float* vector) override { ingest(id, vector); }
+    void addBatch(const float* vectors, const int* ids, int n) override;
+
+    // 入队并返回序号；队列满时等待后台线程腾出空间
+    uint64_t ingest(int id, const float* vector);
+    // 入队并返回序号，队列满时返回 0
+    uint64_t tryIngest(int id, const float* vector);
+
+    // 序号不超过该值的写入都已进入被包装的索引
+    uint64_t visibleSequence() const { return queue_.consumedSequence(); }
+    // 阻塞到 sequence 可见；后台写入出错时抛出 std::runtime_error (只报告一次)
+    void waitVisible(uint64_t sequence);
+    // 等待此前所有写入可见
+    void flush() { waitVisible(queue_.pushedSequence()); }
+    // 队列中尚未进入索引的写入条数
+    size_t pendingCount() const { return queue_.pendingCount(); }
+
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
+    void searchBatch(const float* queries, int nQueries, int k,
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+    // 先扫描队列中半径内的写入，再做被包装索引的范围搜索，按 id 去重后排序
+    void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                     const IDFilter* filter = nullptr) override;
+
+    bool remove(int id) override;
+    bool update(int id, const float* vector) override;
+    int compact() override;
+    void optimize() override;
+    void save(const std::string& path) override;
+    void load(const std::string& path) override;
+
+    int size() const override { return index_->size() + static_cast<int>(queue_.pendingCount()); }
+    int dimension() const override { return index_->dimension(); }
+    int capacity() const override { return index_->capacity(); }
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override { return index_->setMemoryPolicy(policy); }
+
+    VectorIndex& index() { return *index_; }
+
+private:
+    using Entry = std::pair<float, int>;
+
+    std::unique_ptr<VectorIndex> index_;
+    AsyncIngestConfig config_;
+    IngestQueue queue_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable workReady_;
+    std::condition_variable visible_;
+    std::atomic<bool> idle_{false};
+    bool stop_ = false;
+    std::string error_;  // 后台 addBatch 抛出的第一个异常，由 waitVisible 报告
+
+    void workerLoop();
+    void wakeWorker();
+    // 对队列中每条 filter 接受的写入调用 fn(距离, id)
+    template <typename Fn>
+    void forEachPendingDistance(const float* query, const IDFilter* filter, Fn&& fn) const;
+    // 扫描队列中的写入，把 filter 接受的最近 k 个按距离升序写入 out，返回条数
+    int scanPending(const float* query, int k, const IDFilter* filter, Entry* out) const;
+    // 把已排序的 pending 结果并入已排序的索引结果 (按 id 去重)，返回合并后的条数
+    static int mergePending(const Entry* pending, int pendingCount, int k,
+                            int* resultIds, float* resultDistances, int count);
+};
+
+} // namespace vectordb
@@ -0,0 +1,272 @@
+#include "FlatIndex.h"
+#include "../compute/BatchDistance.h"
+#include "../core/ThreadPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace vectordb {
+
+namespace {
+
+// Database rows per GEMV/GEMM tile (one VectorStore chunk) and queries per GEMM block
+// (block * tile floats = 4 MB)
+constexpr int FLAT_DB_TILE = VectorStore::CHUNK_ROWS;
+constexpr int FLAT_QUERY_BLOCK = 256;
+
+// Max-heap of (distance, vector index) holding the best k so far
+inline void pushBounded(std::vector<std::pair<float, int>>& heap, int k, float dist, int index) {
+    if (static_cast<int>(heap.size()) < k) {
+        heap.emplace_back(dist, index);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (dist < heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = {dist, index};
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+} // namespace
+
+FlatIndex::FlatIndex(int dimension, int maxElements)
+    : FlatIndex(dimension, maxElements, FlatConfig{}) {}
+
+FlatIndex::FlatIndex(int dimension, int maxElements, const FlatConfig& config)
+    : vectorStore_(dimension, maxElements), config_(config) {}
+
+void FlatIndex::add(int id, const float* vector) {
+    detachMapping();
+    vectorStore_.add(id, vector);
+}
+
+void FlatIndex::addBatch(const float* vectors, const int* ids, int n) {
+    if (n <= 0) return;
+    detachMapping();
+    vectorStore_.addBatch(ids, vectors, n);
+}
+
+bool FlatIndex::remove(int id) {
+    const int index = vectorStore_.findIndex(id);
+    return index >= 0 && vectorStore_.markDeleted(index);
+}
+
+bool FlatIndex::update(int id, const float* vector) {
+    const int index = vectorStore_.findIndex(id);
+    if (index < 0) return false;
+    detachMapping();
+    vectorStore_.overwrite(index, vector);
+    return true;
+}
+
+int FlatIndex::compact() {
+    const int deleted = vectorStore_.deletedCount();
+    if (deleted == 0) return 0;
+    detachMapping();
+    vectorStore_.compact();
+    return deleted;
+}
+
+void FlatIndex::search(const float* query, int k,
+                      int* resultIds, float* resultDistances,
+                      int* resultCount, const IDFilter* filter) {
+    const int n = vectorStore_.size();
+    if (n == 0 || k <= 0) {
+        *resultCount = 0;
+        return;
+    }
+
+    const int dim = vectorStore_.dimension();
+    std::vector<float> normalized;
+    query = prepareVector(query, normalized);
+    const float queryNormSq = computeNorm(query, dim);
+
+    thread_local std::vector<float> dots;
+    dots.resize(FLAT_DB_TILE);
+    std::vector<std::pair<float, int>> heap;
+    heap.reserve(k + 1);
+
+    // Tiles never cross a store chunk, so each is one contiguous block of rows
+    for (int start = 0; start < n; start += FLAT_DB_TILE) {
+        const int rows = std::min({FLAT_DB_TILE, n - start, vectorStore_.contiguousRows(start)});
+        const float* norms = vectorStore_.getNorms(start);
+        batchInnerProduct(query, vectorStore_.getVector(start), rows, dim, dots.data());
+        for (int j = 0; j < rows; j++) {
+            if (vectorStore_.isDeleted(start + j)) continue;
+            if (filter && !filter->contains(vectorStore_.getId(start + j))) continue;
+            pushBounded(heap, k, distanceFromDot(config_.metric, dots[j], queryNormSq, norms[j]),
+                        start + j);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    const int count = static_cast<int>(heap.size());
+    for (int i = 0; i < count; i++) {
+        resultDistances[i] = heap[i].first;
+        resultIds[i] = vectorStore_.getId(heap[i].second);
+    }
+    *resultCount = count;
+}
+
+void FlatIndex::rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                            const IDFilter* filter) {
+    result.clear();
+    const int n = vectorStore_.size();
+    if (n == 0) return;
+
+    const int dim = vectorStore_.dimension();
+    std::vector<float> normalized;
+    query = prepareVector(query, normalized);
+    const float queryNormSq = computeNorm(query, dim);
+
+    thread_local std::vector<float> dots;
+    dots.resize(FLAT_DB_TILE);
+    for (int start = 0; start < n; start += FLAT_DB_TILE) {
+        const int rows = std::min({FLAT_DB_TILE, n - start, vectorStore_.contiguousRows(start)});
+        const float* norms = vectorStore_.getNorms(start);
+        batchInnerProduct(query, vectorStore_.getVector(start), rows, dim, dots.data());
+        for (int j = 0; j < rows; j++) {
+            const float dist = distanceFromDot(config_.metric, dots[j], queryNormSq, norms[j]);
+            if (dist > radius || vectorStore_.isDeleted(start + j)) continue;
+            const int id = vectorStore_.getId(start + j);
+            if (filter && !filter->contains(id)) continue;
+            result.push(id, dist);
+        }
+    }
+    result.sort();
+}
+
+void FlatIndex::searchBatch(const float* queries, int nQueries, int k,
+                           int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    if (nQueries <= 0 || k <= 0) return;
+
+    const int dim = vectorStore_.dimension();
+
+    // Each task is one GEMM query block; stolen halves may be shorter
+    ThreadPool::instance().parallelFor(0, nQueries, FLAT_QUERY_BLOCK, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i += FLAT_QUERY_BLOCK) {
+            const int count = static_cast<int>(std::min<int64_t>(FLAT_QUERY_BLOCK, end - i));
+            // Every query of a block finishes with the block's GEMM, so each one reports the block's time
+            SearchStats blockStats;
+            {
+                SearchStatsScope scope(queryStats ? &blockStats : nullptr, false);
+                searchBlock(queries + static_cast<size_t>(i) * dim, count, k,
+                            resultIds + static_cast<size_t>(i) * k, resultDistances + static_cast<size_t>(i) * k);
+            }
+            if (queryStats) std::fill_n(queryStats + i, count, blockStats);
+        }
+    }, numThreads_);
+}
+
+void FlatIndex::searchBlock(const float* queries, int nQueries, int k,
+                            int* resultIds, float* resultDistances) const {
+    const int n = vectorStore_.size();
+    const int dim = vectorStore_.dimension();
+
+    std::vector<float> block(static_cast<size_t>(nQueries) * dim);
+    std::vector<float> queryNorms(nQueries);
+    for (int q = 0; q < nQueries; q++) {
+        const float* query = queries + static_cast<size_t>(q) * dim;
+        float* row = block.data() + static_cast<size_t>(q) * dim;
+        if (config_.metric == Metric::COSINE) {
+            normalizeVector(query, dim, row);
+        } else {
+            std::copy(query, query + dim, row);
+        }
+    }
+    computeRowNormsSquared(block.data(), nQueries, dim, queryNorms.data());
+
+    std::vector<std::vector<std::pair<float, int>>> heaps(nQueries);
+    for (auto& heap : heaps) {
+        heap.reserve(k + 1);
+    }
+
+    const bool hasDeleted = vectorStore_.deletedCount() > 0;
+    std::vector<float> dots(static_cast<size_t>(nQueries) * FLAT_DB_TILE);
+    for (int start = 0; start < n; start += FLAT_DB_TILE) {
+        const int rows = std::min({FLAT_DB_TILE, n - start, vectorStore_.contiguousRows(start)});
+        const float* norms = vectorStore_.getNorms(start);
+        matrixMultiply(block.data(), vectorStore_.getVector(start), dots.data(), nQueries, rows, dim);
+        for (int q = 0; q < nQueries; q++) {
+            const float* row = dots.data() + static_cast<size_t>(q) * rows;
+            for (int j = 0; j < rows; j++) {
+                if (hasDeleted && vectorStore_.isDeleted(start + j)) continue;
+                pushBounded(heaps[q], k, distanceFromDot(config_.metric, row[j], queryNorms[q], norms[j]),
+                            start + j);
+            }
+        }
+    }
+
+    for (int q = 0; q < nQueries; q++) {
+        auto& heap = heaps[q];
+        std::sort_heap(heap.begin(), heap.end());
+        int* ids = resultIds + static_cast<size_t>(q) * k;
+        float* dists = resultDistances + static_cast<size_t>(q) * k;
+        const int count = static_cast<int>(heap.size());
+        for (int i = 0; i < count; i++) {
+            dists[i] = heap[i].first;
+            ids[i] = vectorStore_.getId(heap[i].second);
+        }
+        for (int i = count; i < k; i++) {
+            ids[i] = -1;
+            dists[i] = -1.0f;
+        }
+    }
+}
+
+const float* FlatIndex::prepareVector(const float* vector, std::vector<float>& buffer) const {
+    if (config_.metric != Metric::COSINE) return vector;
+    buffer.resize(vectorStore_.dimension());
+    normalizeVector(vector, vectorStore_.dimension(), buffer.data());
+    return buffer.data();
+}
+
+namespace {
+
+struct FlatFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t metric;
+    int32_t reserved;
+};
+
+} // namespace
+
+void FlatIndex::save(const std::string& path) {
+    IndexFileWriter writer(path, IndexType::Flat, vectorStore_.dimension());
+
+    FlatFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = vectorStore_.size();
+    meta.capacity = vectorStore_.capacity();
+    meta.metric = static_cast<int32_t>(config_.metric);
+    writer.writeSection(SectionType::FlatMeta, &meta, sizeof(meta));
+
+    vectorStore_.writeSections(writer);
+
+    writer.finish();
+}
+
+void FlatIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::Flat);
+    if (file->dimension() != vectorStore_.dimension()) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+
+    const auto* meta = file->sectionAs<FlatFileMeta>(SectionType::FlatMeta, 1);
+    if (meta->size < 0 || !isValidMetric(meta->metric) ||
+        !file->hasSection(SectionType::Vectors) || !file->hasSection(SectionType::Norms)) {
+        throw std::runtime_error("Corrupted Flat index file: " + path);
+    }
+
+    config_.metric = static_cast<Metric>(meta->metric);
+    vectorStore_.attachSections(*file, meta->size);
+    mappedFile_ = std::move(file);
+}
+
+void FlatIndex::detachMapping() {
+    if (!mappedFile_) return;
+    vectorStore_.detach();
+    mappedFile_.reset();
+}
+
+} // namespace vectordb
@@ -0,0 +1,71 @@
+#pragma once
+#include "VectorIndex.h"
+#include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../compute/DistanceUtils.h"
+#include <vector>
+#include <memory>
+
+namespace vectordb {
+
+struct FlatConfig {
+    Metric metric = Metric::L2;
+};
+
+/**
+ * 精确暴力检索索引
+ * 单条查询按库向量分块做 GEMV；searchBatch 把查询块与库向量块做 GEMM，
+ * 每条查询用大小为 k 的最大堆保留结果
+ */
+class FlatIndex : public VectorIndex {
+public:
+    FlatIndex(int dimension, int maxElements);
+    FlatIndex(int dimension, int maxElements, const FlatConfig& config);
+
+    void add(int id, const float* vector) override;
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
+    // 分块 GEMV 扫描全部向量，直接收集半径内的结果 (无需逐步放大 k)
+    void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                     const IDFilter* filter = nullptr) override;
+    void save(const std::string& path) override;
+    void load(const std::string& path) override;
+    int size() const override { return vectorStore_.size() - vectorStore_.deletedCount(); }
+    int dimension() const override { return vectorStore_.dimension(); }
+    int capacity() const override { return vectorStore_.capacity(); }
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override { return vectorStore_.setMemoryPolicy(policy); }
+
+    void addBatch(const float* vectors, const int* ids, int n) override;
+
+    // 删除只打标记，扫描时跳过；update 原地覆盖向量
+    bool remove(int id) override;
+    bool update(int id, const float* vector) override;
+    // 把末尾的向量搬进删除留下的空位，不可与 search 并发
+    int compact() override;
+
+    // 结果不足 k 个时以 id = -1、距离 = -1 补齐
+    void searchBatch(const float* queries, int nQueries, int k,
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+private:
+    VectorStore vectorStore_;
+    FlatConfig config_;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+
+    // 对连续的 nQueries 条查询做分块 GEMM 检索
+    void searchBlock(const float* queries, int nQueries, int k,
+                     int* resultIds, float* resultDistances) const;
+    const float* prepareVector(const float* vector, std::vector<float>& buffer) const;
+    void detachMapping();
+};
+
+} // namespace vectordb
@@ -1,5 +1,8 @@
 #include "HNSWIndex.h"
 #include "../compute/BatchDistance.h"
+#include "../core/Prefetch.h"
+#include "../core/ThreadPool.h"
+#include "../core/SearchContext.h"
 #include <algorithm>
 #include <queue>
 #include <cmath>
@@ -7,7 +10,6 @@
 #include <chrono>
 #include <limits>
 #include <thread>
-#include <future>
 #include <cstring>
 
 namespace vectordb {
@@ -15,62 +17,90 @@ namespace vectordb {
 // Threshold for using batch distance computation - lowered for better performance
 static constexpr int BATCH_DISTANCE_THRESHOLD = 8;
 
-typedef std::pair<float, int> DistIdPair;
+// Upper-level blocks per chunk of upperLinks_, roughly one chunk per 32K nodes at the default M
+static constexpr size_t UPPER_CHUNK_BLOCKS = 1024;
 
-struct CompareByFirst {
-    bool operator()(const DistIdPair& a, const DistIdPair& b) const {
-        return a.first > b.first;
-    }
-};
+typedef std::pair<float, int> DistIdPair;
 
 HNSWIndex::HNSWIndex(int dimension, int maxElements)
     : HNSWIndex(dimension, maxElements, HNSWConfig{}) {}
 
 HNSWIndex::HNSWIndex(int dimension, int maxElements, const HNSWConfig& config)
-    : vectorStore_(dimension, maxElements), config_(config) {
-    distanceFunc_ = getEuclideanDistanceFunc();
-    nodes_.reserve(maxElements);
+    : vectorStore_(dimension, maxElements, config.storage, config.rerankWithVectors),
+      config_(config), linkLocks_(NUM_LINK_LOCKS) {
+    distanceFunc_ = getDistanceFunc(config_.metric);
+    sq8DistanceFunc_ = getSQ8DistanceFunc(config_.metric);
+    fp16DistanceFunc_ = getFP16DistanceFunc(config_.metric);
+
+    // Round blocks up to whole cache lines so every node's level-0 list starts on one
+    constexpr int intsPerLine = 64 / sizeof(int32_t);
+    linkStride_ = (maxLinksPerLevel() + 1 + intsPerLine - 1) / intsPerLine * intsPerLine;
+    links0_.reset(linkStride_, VectorStore::CHUNK_ROWS);
+    upperLinks_.reset(linkStride_, UPPER_CHUNK_BLOCKS);
+    reserveLinks(maxElements, 0);
+
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     rng_.seed(seed);
+}
+
+void HNSWIndex::add(int id, const float* rawVector) {
+    int newIndex;
+    int newLevel;
+    {
+        std::lock_guard<std::mutex> appendLock(appendMutex_);
+        if (mappedFile_) {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            detachMapping();
+        }
+        if (!freeSlots_.empty()) {
+            newIndex = freeSlots_.back();
+            freeSlots_.pop_back();
+            newLevel = reuseSlot(newIndex, id, rawVector);
+        } else {
+            newLevel = getRandomLevel();
+            newIndex = appendNode(id, rawVector, newLevel);
+        }
+    }
 
-    // Pre-allocate thread-local visited tracking
-    int maxThreads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
-    threadVisited_.resize(maxThreads);
-    visitedVersion_.resize(maxElements, 0);
+    linkNode(newIndex, newLevel, rawVector);
 }
 
-void HNSWIndex::add(int id, const float* vector) {
-    int newIndex = vectorStore_.size();
-    vectorStore_.add(id, vector);
+void HNSWIndex::linkNode(int newIndex, int newLevel, const float* rawVector) {
+    // The stored vector stays as given, only the graph search uses the normalized copy
+    thread_local std::vector<float> queryBuffer;
+    const float* vector = prepareQuery(rawVector, queryBuffer);
 
-    Node newNode;
-    newNode.level = getRandomLevel();
-    newNode.neighbors.resize(newNode.level + 1);
+    // Linking runs concurrently with searches and other inserts, per-node link locks guard the blocks
+    std::shared_lock<std::shared_mutex> lock(mutex_);
 
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // An insert that raises the top level holds entryMutex_ throughout, so the new
+    // entry point is only published once it is fully linked
+    std::unique_lock<std::mutex> entryLock(entryMutex_, std::defer_lock);
+    if (newLevel > maxLevel_.load(std::memory_order_acquire)) {
+        entryLock.lock();
+    }
 
-    if (newIndex == 0) {
-        entryPoint_.store(0, std::memory_order_release);
-        nodes_.push_back(std::move(newNode));
-        size_.store(1, std::memory_order_release);
+    int currObj = entryPoint_.load(std::memory_order_acquire);
+    if (currObj < 0) {
+        entryPoint_.store(newIndex, std::memory_order_release);
+        maxLevel_.store(newLevel, std::memory_order_release);
         return;
     }
 
-    int currObj = entryPoint_.load(std::memory_order_acquire);
     float currDist = computeDistance(vector, currObj);
 
-    // Search for the nearest entry point from top level down to newNode.level + 1
-    int currLevel = nodes_[currObj].level;
-    while (currLevel > newNode.level) {
+    // Search for the nearest entry point from top level down to newLevel + 1
+    int currLevel = getNodeLevel(currObj);
+    while (currLevel > newLevel) {
         bool changed = true;
         while (changed) {
             changed = false;
+            if (currLevel > getNodeLevel(currObj)) break;
 
-            if (currObj < 0 || currObj >= static_cast<int>(nodes_.size())) break;
-            if (currLevel > nodes_[currObj].level) break;
-
-            const auto& neighbors = nodes_[currObj].neighbors[currLevel];
-            for (int neighbor : neighbors) {
+            std::lock_guard<std::mutex> guard(linkLock(currObj));
+            LinkList links = getLinks(currObj, currLevel);
+            for (int j = 0; j < links.size; j++) {
+                int neighbor = links.data[j];
                 float d = computeDistance(vector, neighbor);
                 if (d < currDist) {
                     currDist = d;
@@ -80,67 +110,453 @@ void HNSWIndex::add(int id, const float* vector) {
             }
         }
         currLevel--;
-        if (currObj >= 0 && currObj < static_cast<int>(nodes_.size())) {
-            currLevel = std::min(currLevel, nodes_[currObj].level);
-        }
+        currLevel = std::min(currLevel, getNodeLevel(currObj));
     }
 
-    int maxLevelToProcess = std::min(newNode.level, nodes_[currObj].level);
+    auto visited = visitedPool_.acquire(vectorStore_.capacity());
+    int maxLevelToProcess = std::min(newLevel, getNodeLevel(currObj));
     for (int level = maxLevelToProcess; level >= 0; level--) {
         std::vector<DistIdPair> results;
         int efBuild = config_.efConstruction;
         if (level > 0 && size_ > 1000) {
             efBuild = std::max(config_.M * 2, static_cast<int>(config_.efConstruction * 0.8));
         }
-        searchLevel(vector, currObj, efBuild, level, results);
+        searchLevel(vector, currObj, efBuild, level, results, *visited);
+        // An updated node can reach itself through its old in-links
+        results.erase(std::remove_if(results.begin(), results.end(),
+                                     [&](const DistIdPair& r) { return r.second == newIndex; }),
+                      results.end());
 
+        // The diversity heuristic relies on the triangle inequality, which inner product lacks
         std::vector<int> selectedNeighbors;
-        if (config_.useHeuristicSelection && results.size() > static_cast<size_t>(config_.M)) {
-            selectedNeighbors = selectNeighborsHeuristic(vector, results, config_.M, level);
+        if (config_.useHeuristicSelection && config_.metric != Metric::INNER_PRODUCT &&
+            results.size() > static_cast<size_t>(config_.M)) {
+            selectedNeighbors = selectNeighborsHeuristic(results, config_.M);
         } else {
             selectedNeighbors = selectNeighbors(results, config_.M);
         }
-        newNode.neighbors[level] = selectedNeighbors;
-        connectNeighbors(newIndex, selectedNeighbors, level);
+        {
+            std::lock_guard<std::mutex> guard(linkLock(newIndex));
+            setLinks(newIndex, level, selectedNeighbors);
+        }
+        connectNeighbors(newIndex, selectedNeighbors, results, level);
 
         if (!results.empty()) {
             currObj = results[0].second;
         }
     }
 
-    int currentEntry = entryPoint_.load(std::memory_order_acquire);
-    if (newNode.level > nodes_[currentEntry].level) {
+    if (entryLock.owns_lock() && newLevel > maxLevel_.load(std::memory_order_acquire)) {
+        // Entry point first: readers that see the new max level must also see its node
         entryPoint_.store(newIndex, std::memory_order_release);
+        maxLevel_.store(newLevel, std::memory_order_release);
+    }
+}
+
+int HNSWIndex::appendNode(int id, const float* vector, int level) {
+    const size_t upperNeeded = upperUsed_ + static_cast<size_t>(level) * linkStride_;
+
+    int index = vectorStore_.add(id, vector);
+    // Growth only appends chunks, readers of existing nodes are unaffected
+    reserveLinks(static_cast<size_t>(index) + 1, upperNeeded);
+
+    levels_[index] = level;
+    upperIndex_[index] = upperUsed_;
+    for (int l = 0; l <= level; l++) {
+        int32_t* block = linkBlock(index, l);
+        std::fill(block, block + linkStride_, -1);
+        block[0] = 0;
+    }
+    upperUsed_ = upperNeeded;
+
+    size_.store(index + 1, std::memory_order_release);
+    return index;
+}
+
+int HNSWIndex::reuseSlot(int index, int id, const float* vector) {
+    // compact() only frees slots nothing links to any more, so the reset is unobserved
+    const int level = levels_[index];
+    for (int l = 0; l <= level; l++) {
+        int32_t* block = linkBlock(index, l);
+        std::fill(block, block + linkStride_, -1);
+        block[0] = 0;
+    }
+    vectorStore_.revive(index, id, vector);
+    return level;
+}
+
+bool HNSWIndex::remove(int id) {
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    const int index = vectorStore_.findIndex(id);
+    if (index < 0 || !vectorStore_.markDeleted(index)) return false;
+    pendingDeleted_.push_back(index);
+    return true;
+}
+
+bool HNSWIndex::update(int id, const float* vector) {
+    int index;
+    int level;
+    {
+        std::lock_guard<std::mutex> appendLock(appendMutex_);
+        index = vectorStore_.findIndex(id);
+        if (index < 0) return false;
+        // Searches must not read a half-written vector
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        detachMapping();
+        vectorStore_.overwrite(index, vector);
+        level = levels_[index];
+    }
+
+    linkNode(index, level, vector);
+    return true;
+}
+
+int HNSWIndex::compact() {
+    std::vector<int> dead;
+    {
+        // The exclusive lock drains in-flight inserts, whose neighbor choice may predate the deletes
+        std::lock_guard<std::mutex> appendLock(appendMutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (pendingDeleted_.empty()) return 0;
+        detachMapping();
+        dead.swap(pendingDeleted_);
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const int nodeCount = size_.load(std::memory_order_acquire);
+        ThreadPool::instance().parallelFor(0, nodeCount, 64, [&](int64_t start, int64_t end) {
+            for (int64_t node = start; node < end; node++) {
+                if (vectorStore_.isDeleted(static_cast<int>(node))) continue;
+                for (int level = 0; level <= getNodeLevel(static_cast<int>(node)); level++) {
+                    repairLinks(static_cast<int>(node), level);
+                }
+            }
+        }, numThreads_);
+
+        std::lock_guard<std::mutex> entryLock(entryMutex_);
+        const int entry = entryPoint_.load(std::memory_order_acquire);
+        if (entry >= 0 && vectorStore_.isDeleted(entry)) {
+            int best = -1;
+            for (int node = 0; node < nodeCount; node++) {
+                if (!vectorStore_.isDeleted(node) && (best < 0 || levels_[node] > levels_[best])) {
+                    best = node;
+                }
+            }
+            entryPoint_.store(best, std::memory_order_release);
+            maxLevel_.store(best >= 0 ? levels_[best] : -1, std::memory_order_release);
+        }
+    }
+
+    // Searches that started before the repair may still stand on a dead node
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    freeSlots_.insert(freeSlots_.end(), dead.begin(), dead.end());
+    return static_cast<int>(dead.size());
+}
+
+void HNSWIndex::repairLinks(int nodeId, int level) {
+    std::vector<int> original;
+    {
+        std::lock_guard<std::mutex> guard(linkLock(nodeId));
+        LinkList links = getLinks(nodeId, level);
+        original.assign(links.data, links.data + links.size);
+    }
+    if (std::none_of(original.begin(), original.end(),
+                     [&](int n) { return vectorStore_.isDeleted(n); })) {
+        return;
+    }
+
+    // Live neighbors plus whatever the deleted ones pointed at, one link lock at a time
+    std::vector<int> candidates;
+    for (int neighbor : original) {
+        if (!vectorStore_.isDeleted(neighbor)) {
+            candidates.push_back(neighbor);
+            continue;
+        }
+        if (level > getNodeLevel(neighbor)) continue;
+        std::lock_guard<std::mutex> guard(linkLock(neighbor));
+        LinkList links = getLinks(neighbor, level);
+        for (int j = 0; j < links.size; j++) {
+            const int hop = links.data[j];
+            if (hop != nodeId && !vectorStore_.isDeleted(hop)) {
+                candidates.push_back(hop);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<DistIdPair> scored;
+    scored.reserve(candidates.size());
+    for (int candidate : candidates) {
+        scored.emplace_back(computeNodeDistance(nodeId, candidate), candidate);
+    }
+    std::sort(scored.begin(), scored.end());
+
+    std::vector<int> selected;
+    if (config_.useHeuristicSelection && config_.metric != Metric::INNER_PRODUCT &&
+        scored.size() > static_cast<size_t>(config_.M)) {
+        selected = selectNeighborsHeuristic(scored, config_.M);
+    } else {
+        selected = selectNeighbors(scored, config_.M);
+    }
+
+    // Keep links that concurrent inserts added since the snapshot
+    std::lock_guard<std::mutex> guard(linkLock(nodeId));
+    LinkList current = getLinks(nodeId, level);
+    const size_t maxLinks = static_cast<size_t>(maxLinksPerLevel());
+    for (int j = 0; j < current.size && selected.size() < maxLinks; j++) {
+        const int neighbor = current.data[j];
+        if (!vectorStore_.isDeleted(neighbor) &&
+            std::find(original.begin(), original.end(), neighbor) == original.end() &&
+            std::find(selected.begin(), selected.end(), neighbor) == selected.end()) {
+            selected.push_back(neighbor);
+        }
+    }
+    setLinks(nodeId, level, selected);
+}
+
+void HNSWIndex::reorder(GraphOrder order) {
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    const int n = size_.load(std::memory_order_acquire);
+    if (n == 0 || order == GraphOrder::NONE) return;
+    detachMapping();
+
+    // Level 0 holds every node and nearly all the hops a search makes
+    CSRGraph graph;
+    graph.offsets.reserve(static_cast<size_t>(n) + 1);
+    graph.targets.reserve(static_cast<size_t>(n) * config_.M * 2);
+    for (int i = 0; i < n; i++) {
+        LinkList links = getLinks(i, 0);
+        graph.addNode(links.data, links.size);
+    }
+    const std::vector<int32_t> newToOld =
+        computeGraphOrder(graph, order, entryPoint_.load(std::memory_order_acquire));
+    std::vector<int32_t> oldToNew(n);
+    for (int i = 0; i < n; i++) oldToNew[newToOld[i]] = i;
+    auto remap = [&](int32_t* block) {
+        for (int j = 1; j <= block[0]; j++) block[j] = oldToNew[block[j]];
+    };
+
+    vectorStore_.permute(newToOld);
+    levels_.permuteRows(newToOld);
+    links0_.permuteRows(newToOld);
+    for (int i = 0; i < n; i++) remap(links0_.row(i));
+
+    // Upper blocks are repacked in the new node order, so the last node's blocks still end the array
+    std::vector<int32_t> upper(upperUsed_);
+    std::vector<uint64_t> upperIndex(n);
+    size_t used = 0;
+    for (int i = 0; i < n; i++) {
+        const int old = newToOld[i];
+        upperIndex[i] = used;
+        for (int l = 1; l <= levels_[i]; l++) {
+            const int32_t* block = upperLinks_.row(upperIndex_[old] / linkStride_ + l - 1);
+            std::copy(block, block + linkStride_, upper.data() + used);
+            remap(upper.data() + used);
+            used += linkStride_;
+        }
+    }
+    for (size_t b = 0; b < used / linkStride_; b++) {
+        std::copy(upper.data() + b * linkStride_, upper.data() + (b + 1) * linkStride_, upperLinks_.row(b));
+    }
+    for (int i = 0; i < n; i++) upperIndex_[i] = upperIndex[i];
+    upperUsed_ = used;
+
+    for (int& node : pendingDeleted_) node = oldToNew[node];
+    for (int& node : freeSlots_) node = oldToNew[node];
+    const int entry = entryPoint_.load(std::memory_order_acquire);
+    if (entry >= 0) entryPoint_.store(oldToNew[entry], std::memory_order_release);
+}
+
+void HNSWIndex::reserveLinks(size_t nodes, size_t upperInts) {
+    levels_.reserve(nodes);
+    upperIndex_.reserve(nodes);
+    links0_.reserve(nodes);
+    upperLinks_.reserve(upperInts / linkStride_);
+}
+
+MemoryPolicy HNSWIndex::setMemoryPolicy(const MemoryPolicy& policy) {
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (size_.load(std::memory_order_acquire) > 0 || mappedFile_) {
+        throw std::logic_error("HNSW memory policy must be set before adding vectors");
     }
 
-    nodes_.push_back(std::move(newNode));
-    size_.fetch_add(1, std::memory_order_release);
+    auto allocator = std::make_shared<MemoryAllocator>(policy);
+    vectorStore_.setAllocator(allocator);
+    levels_.clear();
+    links0_.clear();
+    upperIndex_.clear();
+    upperLinks_.clear();
+    levels_.setAllocator(allocator);
+    links0_.setAllocator(allocator);
+    upperIndex_.setAllocator(allocator);
+    upperLinks_.setAllocator(allocator);
+    upperUsed_ = 0;
+    reserveLinks(vectorStore_.capacity(), 0);
+    return allocator->effective();
+}
+
+void HNSWIndex::setLinks(int nodeId, int level, const std::vector<int>& links) {
+    int32_t* block = linkBlock(nodeId, level);
+    const int count = std::min(static_cast<int>(links.size()), linkStride_ - 1);
+    block[0] = count;
+    std::copy(links.begin(), links.begin() + count, block + 1);
+    std::fill(block + 1 + count, block + linkStride_, -1);
 }
 
 void HNSWIndex::search(const float* query, int k,
                        int* resultIds, float* resultDistances,
-                       int* resultCount) {
+                       int* resultCount, const IDFilter* filter) {
     if (size_.load() == 0) {
         *resultCount = 0;
         return;
     }
 
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    SearchStatsScope scope;
+    auto lock = acquireLock<std::shared_lock<std::shared_mutex>>(mutex_);
 
     int currObj = entryPoint_.load(std::memory_order_acquire);
-    float currDist = computeDistance(query, currObj);
+    if (currObj < 0) {
+        *resultCount = 0;
+        return;
+    }
+
+    thread_local std::vector<float> queryBuffer;
+    query = prepareQuery(query, queryBuffer);
+
+    const int nodeCount = size_.load(std::memory_order_acquire);
+    int efSearch = config_.efSearchOverride > 0
+        ? std::max(config_.efSearchOverride, k) : config_.getEfSearch(k, nodeCount);
+    const bool rerankable = vectorStore_.isQuantized() && vectorStore_.hasVectors();
+
+    // Results land in the thread's context, steady-state queries allocate nothing
+    std::vector<DistIdPair>& results = SearchContext::local().output;
+
+    // Too few nodes pass for the graph to reach k of them, scanning is cheaper
+    if (filter && estimateSelectivity(filter, nodeCount) < config_.filterBruteForceSelectivity) {
+        searchBruteForce(query, rerankable ? efSearch : k, filter, results);
+        if (rerankable) {
+            rerank(query, results);
+        }
+        int count = std::min(k, static_cast<int>(results.size()));
+        for (int i = 0; i < count; i++) {
+            resultDistances[i] = results[i].first;
+            resultIds[i] = vectorStore_.getId(results[i].second);
+        }
+        *resultCount = count;
+        return;
+    }
+
+    currObj = greedyDescend(query, currObj, nodeCount);
+
+    auto visited = visitedPool_.acquire(vectorStore_.capacity());
+    searchLevel(query, currObj, efSearch, 0, results, *visited, filter);
+    if (rerankable) {
+        rerank(query, results);
+    }
+
+    int count = std::min(k, static_cast<int>(results.size()));
+    for (int i = 0; i < count; i++) {
+        resultDistances[i] = results[i].first;
+        resultIds[i] = vectorStore_.getId(results[i].second);
+    }
+    *resultCount = count;
+}
+
+void HNSWIndex::rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                            const IDFilter* filter) {
+    result.clear();
+    if (size_.load() == 0) return;
+
+    SearchStatsScope scope;
+    auto lock = acquireLock<std::shared_lock<std::shared_mutex>>(mutex_);
+
+    int currObj = entryPoint_.load(std::memory_order_acquire);
+    if (currObj < 0) return;
+
+    thread_local std::vector<float> queryBuffer;
+    query = prepareQuery(query, queryBuffer);
+
+    const int nodeCount = size_.load(std::memory_order_acquire);
+    const bool rerankable = vectorStore_.isQuantized() && vectorStore_.hasVectors();
+
+    // The filter is applied on output only, so filtered-out nodes can still seed the flood
+    std::vector<DistIdPair>& results = SearchContext::local().output;
+    currObj = greedyDescend(query, currObj, nodeCount);
+    auto visited = visitedPool_.acquire(vectorStore_.capacity());
+    searchLevel(query, currObj, config_.getEfSearch(1, nodeCount), 0, results, *visited, nullptr);
+
+    auto accepted = [&](int node) {
+        return !vectorStore_.isDeleted(node) &&
+               (filter == nullptr || filter->contains(vectorStore_.getId(node)));
+    };
+
+    // Flood level 0 from every hit inside the radius; nodes outside it are scored but never expanded
+    thread_local std::vector<int> frontier;
+    thread_local std::vector<DistIdPair> inside;
+    frontier.clear();
+    inside.clear();
+    visited->reset();
+    for (const auto& hit : results) {
+        if (hit.first > radius) break;
+        visited->tryVisit(hit.second);
+        frontier.push_back(hit.second);
+        if (accepted(hit.second)) inside.push_back(hit);
+    }
+
+    const int visitedLimit = static_cast<int>(visited->capacity());
+    while (!frontier.empty()) {
+        const int node = frontier.back();
+        frontier.pop_back();
+        VECTORDB_STATS_ADD(hops, 1);
+
+        auto guard = acquireLock<std::unique_lock<std::mutex>>(linkLock(node));
+        LinkList links = getLinks(node, 0);
+        for (int j = 0; j < links.size; j++) {
+            const int neighbor = links.data[j];
+            if (neighbor >= visitedLimit || !visited->tryVisit(neighbor)) continue;
+            VECTORDB_STATS_ADD(visitedNodes, 1);
+            VECTORDB_STATS_ADD(distanceComputations, 1);
+            const float d = computeDistance(query, neighbor);
+            if (d > radius) continue;
+            frontier.push_back(neighbor);
+            if (accepted(neighbor)) inside.push_back({d, neighbor});
+        }
+    }
+
+    if (rerankable) {
+        // Quantized distances only steer the flood, membership is decided on the float vectors
+        rerank(query, inside);
+    }
+    for (const auto& hit : inside) {
+        if (hit.first > radius) continue;
+        result.push(vectorStore_.getId(hit.second), hit.first);
+    }
+    result.sort();
+}
 
-    int currLevel = nodes_[currObj].level;
+int HNSWIndex::greedyDescend(const float* query, int currObj, int nodeCount) {
+    VECTORDB_STATS_ADD(distanceComputations, 1);
+    float currDist = computeDistance(query, currObj);
+    int currLevel = getNodeLevel(currObj);
 
     while (currLevel > 0) {
         bool changed = true;
         while (changed) {
             changed = false;
-            if (currObj < 0 || currObj >= static_cast<int>(nodes_.size())) break;
-            if (currLevel > nodes_[currObj].level) break;
-
-            const auto& neighbors = nodes_[currObj].neighbors[currLevel];
-            for (int neighbor : neighbors) {
+            if (currObj < 0 || currObj >= nodeCount) break;
+            if (currLevel > getNodeLevel(currObj)) break;
+
+            auto guard = acquireLock<std::unique_lock<std::mutex>>(linkLock(currObj));
+            LinkList links = getLinks(currObj, currLevel);
+            VECTORDB_STATS_ADD(hops, 1);
+            VECTORDB_STATS_ADD(distanceComputations, links.size);
+            for (int j = 0; j < links.size; j++) {
+                int neighbor = links.data[j];
                 float d = computeDistance(query, neighbor);
                 if (d < currDist) {
                     currDist = d;
@@ -150,39 +566,25 @@ void HNSWIndex::search(const float* query, int k,
             }
         }
         currLevel--;
-        if (currObj >= 0 && currObj < static_cast<int>(nodes_.size())) {
-            currLevel = std::min(currLevel, nodes_[currObj].level);
+        if (currObj >= 0 && currObj < nodeCount) {
+            currLevel = std::min(currLevel, getNodeLevel(currObj));
         }
     }
-
-    std::vector<DistIdPair> results;
-    int dataSize = size_.load(std::memory_order_acquire);
-    int efSearch = config_.getEfSearch(k, dataSize);
-    searchLevel(query, currObj, efSearch, 0, results);
-
-    int count = std::min(k, static_cast<int>(results.size()));
-    for (int i = 0; i < count; i++) {
-        resultDistances[i] = results[i].first;
-        resultIds[i] = vectorStore_.getId(results[i].second);
-    }
-    *resultCount = count;
+    return currObj;
 }
 
 void HNSWIndex::searchLevel(const float* query, int entryPoint, int ef, int level,
-                            std::vector<DistIdPair>& results) {
-    std::priority_queue<DistIdPair, std::vector<DistIdPair>, CompareByFirst> candidates;
-    std::priority_queue<DistIdPair> bestResults;
+                            std::vector<DistIdPair>& results, VisitedTable& visited,
+                            const IDFilter* filter) {
+    SearchContext& context = SearchContext::local();
+    MinHeap<DistIdPair>& candidates = context.candidates;
+    BoundedMaxHeap<DistIdPair>& bestResults = context.results;
+    candidates.clear();
+    bestResults.reset(ef);
 
-    // Get thread ID for thread-local storage
-    static thread_local int threadId = -1;
-    if (threadId == -1) {
-        static std::atomic<int> nextId{0};
-        threadId = nextId++ % threadVisited_.size();
-    }
-
-    auto& visited = threadVisited_[threadId];
-    visited.clear();
+    visited.reset();
 
+    VECTORDB_STATS_ADD(distanceComputations, 1);
     float dist = computeDistance(query, entryPoint);
 
     if (dist == std::numeric_limits<float>::max()) {
@@ -190,31 +592,68 @@ void HNSWIndex::searchLevel(const float* query, int entryPoint, int ef, int leve
         return;
     }
 
-    candidates.emplace(dist, entryPoint);
-    bestResults.emplace(dist, entryPoint);
-    visited.insert(entryPoint);
+    // Deleted nodes stay traversable, they just never become results or neighbors
+    auto accepted = [&](int node) {
+        return !vectorStore_.isDeleted(node) &&
+               (filter == nullptr || filter->contains(vectorStore_.getId(node)));
+    };
 
+    candidates.push({dist, entryPoint});
+    if (accepted(entryPoint)) {
+        bestResults.push({dist, entryPoint});
+    }
+    visited.markVisited(entryPoint);
+
+    // Distance of the worst kept result once ef of them are held
     float lowerBound = dist;
     int expansionCount = 0;
     const int maxExpansions = config_.getMaxExpansions(ef);
+    // Filtered-out nodes are expanded without adding results, so the expansion cap would starve it
+    const bool capExpansions = config_.useEarlyTermination && filter == nullptr;
 
-    // Pre-allocate neighbor buffer for better cache utilization
-    std::vector<int> neighborBuffer;
+    // The table was sized when the search began; nodes appended into newer chunks since then are skipped
+    const int visitedLimit = static_cast<int>(visited.capacity());
+    const int dim = vectorStore_.dimension();
+    std::vector<int>& unvisitedNeighbors = context.neighbors;
+    std::vector<float>& batchDistances = context.distances;
+    std::vector<float>& vectorBuffer = context.vectors;
+    std::vector<float>& normBuffer = context.norms;
+    const bool storedNorms = vectorStore_.getNorms(0) != nullptr;
+
+    auto consider = [&](float d, int neighbor) {
+        if (config_.distanceThreshold > 0 && d > config_.distanceThreshold) {
+            return;
+        }
+        if (!bestResults.full() || d < lowerBound) {
+            candidates.push({d, neighbor});
+            if (accepted(neighbor)) {
+                bestResults.push({d, neighbor});
+                if (bestResults.full()) {
+                    lowerBound = bestResults.top().first;
+                }
+            }
+        }
+    };
 
     while (!candidates.empty()) {
-        auto curr = candidates.top();
+        const DistIdPair curr = candidates.top();
         candidates.pop();
         expansionCount++;
 
+        // Pull in the next candidate's adjacency block while this one is expanded
+        if (!candidates.empty()) {
+            PREFETCH(linkBlock(candidates.top().second, level));
+        }
+
         if (curr.second < 0 || curr.second >= vectorStore_.size()) {
             continue;
         }
 
-        if (curr.first > lowerBound && bestResults.size() >= static_cast<size_t>(ef)) {
+        if (curr.first > lowerBound && bestResults.full()) {
             break;
         }
 
-        if (config_.useEarlyTermination && expansionCount > maxExpansions) {
+        if (capExpansions && expansionCount > maxExpansions) {
             break;
         }
 
@@ -222,89 +661,101 @@ void HNSWIndex::searchLevel(const float* query, int entryPoint, int ef, int leve
             break;
         }
 
-        if (level >= static_cast<int>(nodes_[curr.second].neighbors.size())) {
+        if (level > getNodeLevel(curr.second)) {
             continue;
         }
 
-        const auto& neighbors = nodes_[curr.second].neighbors[level];
-        const int dim = vectorStore_.dimension();
-
         // Collect all unvisited neighbors first
-        thread_local std::vector<int> unvisitedNeighbors;
-        thread_local std::vector<float> batchDistances;
-        thread_local std::vector<float> vectorBuffer;
         unvisitedNeighbors.clear();
-
-        for (int neighbor : neighbors) {
-            if (visited.insert(neighbor).second) {
-                unvisitedNeighbors.push_back(neighbor);
+        {
+            auto guard = acquireLock<std::unique_lock<std::mutex>>(linkLock(curr.second));
+            LinkList links = getLinks(curr.second, level);
+            for (int j = 0; j < links.size; j++) {
+                int neighbor = links.data[j];
+                if (neighbor < visitedLimit && visited.tryVisit(neighbor)) {
+                    unvisitedNeighbors.push_back(neighbor);
+                }
             }
         }
+        VECTORDB_STATS_ADD(hops, 1);
+        VECTORDB_STATS_ADD(visitedNodes, unvisitedNeighbors.size());
+        VECTORDB_STATS_ADD(distanceComputations, unvisitedNeighbors.size());
 
         if (unvisitedNeighbors.empty()) continue;
 
-        // Use batch distance computation for larger batches
-        if (static_cast<int>(unvisitedNeighbors.size()) >= BATCH_DISTANCE_THRESHOLD) {
-            // Gather vectors into contiguous buffer
+        // Use batch distance computation for larger batches (the batch kernel is L2 over floats)
+        if (config_.metric == Metric::L2 && !vectorStore_.isQuantized() &&
+            static_cast<int>(unvisitedNeighbors.size()) >= BATCH_DISTANCE_THRESHOLD) {
+            // Gather vectors and their stored squared norms into contiguous buffers
             vectorBuffer.resize(unvisitedNeighbors.size() * dim);
+            normBuffer.resize(unvisitedNeighbors.size());
             for (size_t i = 0; i < unvisitedNeighbors.size(); ++i) {
                 const float* vec = vectorStore_.getVector(unvisitedNeighbors[i]);
                 std::memcpy(vectorBuffer.data() + i * dim, vec, dim * sizeof(float));
+                normBuffer[i] = vectorStore_.getNorm(unvisitedNeighbors[i]);
+            }
+            if (!storedNorms) {
+                computeRowNormsSquared(vectorBuffer.data(), unvisitedNeighbors.size(), dim, normBuffer.data());
             }
 
-            // Batch compute distances using BLAS/Accelerate
             batchDistances.resize(unvisitedNeighbors.size());
-            batchEuclideanDistance(query, vectorBuffer.data(),
+            batchEuclideanDistance(query, vectorBuffer.data(), normBuffer.data(),
                                    unvisitedNeighbors.size(), dim, batchDistances.data());
 
-            // Process results
             for (size_t i = 0; i < unvisitedNeighbors.size(); ++i) {
-                float d = batchDistances[i];
-
-                if (config_.distanceThreshold > 0 && d > config_.distanceThreshold) {
-                    continue;
-                }
-
-                if (bestResults.size() < static_cast<size_t>(ef) || d < lowerBound) {
-                    int neighbor = unvisitedNeighbors[i];
-                    candidates.emplace(d, neighbor);
-                    bestResults.emplace(d, neighbor);
-
-                    if (bestResults.size() > static_cast<size_t>(ef)) {
-                        bestResults.pop();
-                        lowerBound = bestResults.top().first;
-                    }
-                }
+                consider(batchDistances[i], unvisitedNeighbors[i]);
             }
         } else {
             // For small batches, use individual distance computation
             for (int neighbor : unvisitedNeighbors) {
-                float d = computeDistance(query, neighbor);
-
-                if (config_.distanceThreshold > 0 && d > config_.distanceThreshold) {
-                    continue;
-                }
-
-                if (bestResults.size() < static_cast<size_t>(ef) || d < lowerBound) {
-                    candidates.emplace(d, neighbor);
-                    bestResults.emplace(d, neighbor);
-
-                    if (bestResults.size() > static_cast<size_t>(ef)) {
-                        bestResults.pop();
-                        lowerBound = bestResults.top().first;
-                    }
-                }
+                consider(computeDistance(query, neighbor), neighbor);
             }
         }
     }
 
+    const std::vector<DistIdPair>& sorted = bestResults.sortAscending();
+    results.assign(sorted.begin(), sorted.end());
+}
+
+void HNSWIndex::searchBruteForce(const float* query, int ef, const IDFilter* filter,
+                                 std::vector<DistIdPair>& results) {
+    const int nodeCount = size_.load(std::memory_order_acquire);
+    // Max-heap of the best ef accepted nodes
     results.clear();
-    results.reserve(bestResults.size());
-    while (!bestResults.empty()) {
-        results.push_back(bestResults.top());
-        bestResults.pop();
+    results.reserve(ef + 1);
+    for (int node = 0; node < nodeCount; node++) {
+        if (vectorStore_.isDeleted(node)) continue;
+        if (filter && !filter->contains(vectorStore_.getId(node))) continue;
+        VECTORDB_STATS_ADD(distanceComputations, 1);
+        const float d = computeDistance(query, node);
+        if (static_cast<int>(results.size()) < ef) {
+            results.emplace_back(d, node);
+            std::push_heap(results.begin(), results.end());
+        } else if (d < results.front().first) {
+            std::pop_heap(results.begin(), results.end());
+            results.back() = {d, node};
+            std::push_heap(results.begin(), results.end());
+        }
+    }
+    std::sort_heap(results.begin(), results.end());
+}
+
+float HNSWIndex::estimateSelectivity(const IDFilter* filter, int nodeCount) const {
+    if (nodeCount <= 0) return 1.0f;
+    const int64_t cardinality = filter->cardinality();
+    if (cardinality >= 0) {
+        return std::min(1.0f, static_cast<float>(cardinality) / nodeCount);
     }
-    std::reverse(results.begin(), results.end());
+
+    constexpr int SAMPLES = 256;
+    const int step = std::max(1, nodeCount / SAMPLES);
+    int sampled = 0;
+    int passed = 0;
+    for (int node = 0; node < nodeCount; node += step) {
+        sampled++;
+        if (filter->contains(vectorStore_.getId(node))) passed++;
+    }
+    return static_cast<float>(passed) / sampled;
 }
 
 std::vector<int> HNSWIndex::selectNeighbors(const std::vector<DistIdPair>& candidates, int M) {
@@ -319,9 +770,7 @@ std::vector<int> HNSWIndex::selectNeighbors(const std::vector<DistIdPair>& candi
     return result;
 }
 
-std::vector<int> HNSWIndex::selectNeighborsHeuristic(const float* query,
-                                                     const std::vector<DistIdPair>& candidates,
-                                                     int M, int level) {
+std::vector<int> HNSWIndex::selectNeighborsHeuristic(const std::vector<DistIdPair>& candidates, int M) {
     if (candidates.size() <= static_cast<size_t>(M)) {
         std::vector<int> result;
         result.reserve(candidates.size());
@@ -331,106 +780,36 @@ std::vector<int> HNSWIndex::selectNeighborsHeuristic(const float* query,
         return result;
     }
 
-    // Optimized heuristic selection using precomputed distances and early termination
     const size_t maxCandidates = std::min(static_cast<size_t>(M * 6), candidates.size());
+    const int dim = vectorStore_.dimension();
 
-    // Pre-fetch candidate vectors
+    // Candidates are gathered into one contiguous block; each selection scores every candidate
+    // against the new pick with a single GEMV over it. Distances to the query are the ones
+    // searchLevel already computed
+    thread_local std::vector<int> nodes;
+    thread_local std::vector<float> block;
+    thread_local std::vector<float> normsSq;
+    thread_local std::vector<float> dots;
+    nodes.resize(maxCandidates);
     for (size_t j = 0; j < maxCandidates; ++j) {
-        vectorStore_.prefetchVector(candidates[j].second);
+        nodes[j] = candidates[j].second;
     }
+    block.resize(maxCandidates * dim);
+    normsSq.resize(maxCandidates);
+    gatherVectors(nodes.data(), maxCandidates, block.data(), normsSq.data());
+    dots.resize(maxCandidates);
 
-    // Fast path: if dimension is small, use simpler heuristic
-    const int dim = vectorStore_.dimension();
+    // Fast path: if dimension is small, diversify by distance to the selected set,
+    // otherwise by angular similarity to it
     const bool useSimpleHeuristic = (dim <= 128) || (M <= 16);
 
-    if (useSimpleHeuristic) {
-        // Simplified heuristic: sort by distance and diversify with angular check
-        std::vector<std::pair<float, int>> scoredCandidates;
-        scoredCandidates.reserve(maxCandidates);
-
-        // First pass: calculate diversity scores
-        std::vector<float> minDistToSelected(maxCandidates, std::numeric_limits<float>::max());
-        std::vector<bool> selected(maxCandidates, false);
-
-        for (int i = 0; i < M && i < static_cast<int>(maxCandidates); ++i) {
-            int bestIdx = -1;
-            float bestScore = -1.0f;
-
-            for (size_t j = 0; j < maxCandidates; ++j) {
-                if (selected[j]) continue;
-
-                float distToQuery = candidates[j].first;
-                float diversity = minDistToSelected[j];
-
-                // Combined score: balance proximity and diversity
-                float score = 1.0f / (1.0f + distToQuery);
-                if (i > 0) {
-                    score += 0.3f * std::min(diversity, 10.0f) / 10.0f;
-                }
-
-                if (score > bestScore) {
-                    bestScore = score;
-                    bestIdx = static_cast<int>(j);
-                }
-            }
-
-            if (bestIdx < 0) break;
-
-            selected[bestIdx] = true;
-            int selectedId = candidates[bestIdx].second;
-
-            // Update min distances for remaining candidates
-            const float* selectedVec = vectorStore_.getVector(selectedId);
-
-            // Batch prefetch for next iteration
-            for (size_t j = 0; j < maxCandidates; ++j) {
-                if (!selected[j]) {
-                    vectorStore_.prefetchVector(candidates[j].second);
-                }
-            }
-
-            for (size_t j = 0; j < maxCandidates; ++j) {
-                if (!selected[j]) {
-                    const float* candidateVec = vectorStore_.getVector(candidates[j].second);
-                    float d = distanceFunc_(selectedVec, candidateVec, dim);
-                    minDistToSelected[j] = std::min(minDistToSelected[j], d);
-                }
-            }
-        }
-
-        // Collect results
-        std::vector<int> result;
-        result.reserve(M);
-        for (size_t j = 0; j < maxCandidates && result.size() < static_cast<size_t>(M); ++j) {
-            if (selected[j]) {
-                result.push_back(candidates[j].second);
-            }
-        }
-        return result;
-    }
-
-    // Full heuristic for high dimensions: use angular diversity
+    // Closeness of each remaining candidate to the selected set, updated once per selection:
+    // min distance for the simple heuristic, max |cosine similarity| for the angular one
+    std::vector<float> closeness(maxCandidates,
+                                 useSimpleHeuristic ? std::numeric_limits<float>::max() : 0.0f);
+    std::vector<bool> selected(maxCandidates, false);
     std::vector<int> result;
     result.reserve(M);
-    std::vector<bool> selected(maxCandidates, false);
-
-    // Precompute vector pointers for cache efficiency
-    std::vector<const float*> candidateVectors(maxCandidates);
-    for (size_t j = 0; j < maxCandidates; ++j) {
-        candidateVectors[j] = vectorStore_.getVector(candidates[j].second);
-    }
-
-    // Angular diversity check using dot products
-    auto computeCosineSimilarity = [&](const float* a, const float* b) -> float {
-        float dot = 0.0f, normA = 0.0f, normB = 0.0f;
-        for (int d = 0; d < dim; d++) {
-            dot += a[d] * b[d];
-            normA += a[d] * a[d];
-            normB += b[d] * b[d];
-        }
-        float denom = std::sqrt(normA * normB);
-        return denom > 1e-8f ? dot / denom : 0.0f;
-    };
 
     for (int i = 0; i < M && i < static_cast<int>(maxCandidates); ++i) {
         int bestIdx = -1;
@@ -439,78 +818,124 @@ std::vector<int> HNSWIndex::selectNeighborsHeuristic(const float* query,
         for (size_t j = 0; j < maxCandidates; ++j) {
             if (selected[j]) continue;
 
-            float distToQuery = candidates[j].first;
-            const float* candidateVec = candidateVectors[j];
-
-            // Check angular diversity with already selected neighbors
-            float maxSimilarity = 0.0f;
-            for (int selectedIdx : result) {
-                float sim = computeCosineSimilarity(candidateVec, vectorStore_.getVector(selectedIdx));
-                maxSimilarity = std::max(maxSimilarity, std::abs(sim));
+            // Score: closer to query is better, plus a bonus for diversity from the selected set
+            float score = 1.0f / (1.0f + candidates[j].first);
+            if (useSimpleHeuristic) {
+                if (i > 0) {
+                    score += 0.3f * std::min(closeness[j], 10.0f) / 10.0f;
+                }
+            } else {
+                score += (1.0f - closeness[j]) * 0.5f;
             }
 
-            // Score: closer to query is better, but penalize high similarity to selected
-            float diversityBonus = (1.0f - maxSimilarity) * 0.5f;
-            float score = 1.0f / (1.0f + distToQuery) + diversityBonus;
-
             if (score > bestScore) {
                 bestScore = score;
                 bestIdx = static_cast<int>(j);
             }
         }
 
-        if (bestIdx >= 0) {
-            selected[bestIdx] = true;
-            result.push_back(candidates[bestIdx].second);
+        if (bestIdx < 0) break;
+        selected[bestIdx] = true;
+
+        batchInnerProduct(block.data() + static_cast<size_t>(bestIdx) * dim, block.data(), maxCandidates, dim,
+                          dots.data());
+        for (size_t j = 0; j < maxCandidates; ++j) {
+            if (selected[j]) continue;
+            if (useSimpleHeuristic) {
+                closeness[j] = std::min(closeness[j], pairDistance(dots[j], normsSq[bestIdx], normsSq[j]));
+            } else {
+                const float denom = std::sqrt(normsSq[bestIdx] * normsSq[j]);
+                const float similarity = denom > 1e-8f ? dots[j] / denom : 0.0f;
+                closeness[j] = std::max(closeness[j], std::abs(similarity));
+            }
         }
     }
 
+    // Selected candidates in order of distance to the query
+    for (size_t j = 0; j < maxCandidates && result.size() < static_cast<size_t>(M); ++j) {
+        if (selected[j]) {
+            result.push_back(candidates[j].second);
+        }
+    }
     return result;
 }
 
-void HNSWIndex::connectNeighbors(int newId, const std::vector<int>& neighbors, int level) {
+void HNSWIndex::connectNeighbors(int newId, const std::vector<int>& neighbors,
+                                 const std::vector<DistIdPair>& scored, int level) {
+    const int maxLinks = maxLinksPerLevel();
     for (int neighbor : neighbors) {
-        auto& neighborNode = nodes_[neighbor];
-        auto& neighborLinks = neighborNode.neighbors[level];
-
-        neighborLinks.push_back(newId);
+        std::lock_guard<std::mutex> guard(linkLock(neighbor));
+        int32_t* block = linkBlock(neighbor, level);
 
-        if (neighborLinks.size() > static_cast<size_t>(config_.M)) {
-            pruneNeighbors(neighbor, level);
+        if (block[0] < maxLinks) {
+            block[1 + block[0]] = newId;
+            block[0]++;
+        } else {
+            // The distance to the new node is symmetric and was scored by the insert's search
+            auto it = std::find_if(scored.begin(), scored.end(),
+                                   [neighbor](const DistIdPair& s) { return s.second == neighbor; });
+            pruneNeighbors(neighbor, level, newId,
+                           it != scored.end() ? it->first : computeNodeDistance(neighbor, newId));
         }
     }
 }
 
-void HNSWIndex::pruneNeighbors(int nodeId, int level) {
-    auto& node = nodes_[nodeId];
-    auto& links = node.neighbors[level];
-
-    if (links.size() <= static_cast<size_t>(config_.M * config_.pruneOverflowFactor)) {
-        return;
-    }
+void HNSWIndex::pruneNeighbors(int nodeId, int level, int newNeighbor, float newDistance) {
+    // The list is full (M * pruneOverflowFactor): shrink it back to the M closest,
+    // considering the incoming link as well
+    int32_t* block = linkBlock(nodeId, level);
+    const int count = block[0];
+    const int dim = vectorStore_.dimension();
 
-    const float* nodeVec = vectorStore_.getVector(nodeId);
+    // The node and its current links are gathered into one block, a single GEMV scores them all
+    thread_local std::vector<float> vectors;
+    thread_local std::vector<float> normsSq;
+    thread_local std::vector<float> dots;
+    vectors.resize(static_cast<size_t>(count + 1) * dim);
+    normsSq.resize(count + 1);
+    dots.resize(count);
+    gatherVectors(&nodeId, 1, vectors.data(), normsSq.data());
+    gatherVectors(block + 1, count, vectors.data() + dim, normsSq.data() + 1);
+    batchInnerProduct(vectors.data(), vectors.data() + dim, count, dim, dots.data());
 
     std::vector<DistIdPair> neighborDists;
-    neighborDists.reserve(links.size());
-
-    // Batch prefetch before computing distances
-    for (size_t i = 0; i < links.size(); ++i) {
-        vectorStore_.prefetchVector(links[i]);
+    neighborDists.reserve(count + 1);
+    for (int i = 0; i < count; ++i) {
+        neighborDists.emplace_back(pairDistance(dots[i], normsSq[0], normsSq[1 + i]), block[1 + i]);
     }
+    neighborDists.emplace_back(newDistance, newNeighbor);
 
-    for (int neighborId : links) {
-        const float* neighborVec = vectorStore_.getVector(neighborId);
-        float d = distanceFunc_(nodeVec, neighborVec, vectorStore_.dimension());
-        neighborDists.emplace_back(d, neighborId);
+    std::sort(neighborDists.begin(), neighborDists.end());
+
+    const int keep = std::min(config_.M, static_cast<int>(neighborDists.size()));
+    for (int i = 0; i < keep; ++i) {
+        block[1 + i] = neighborDists[i].second;
     }
+    std::fill(block + 1 + keep, block + linkStride_, -1);
+    block[0] = keep;
+}
 
-    std::sort(neighborDists.begin(), neighborDists.end());
+void HNSWIndex::gatherVectors(const int32_t* nodes, size_t count, float* vectors, float* normsSq) const {
+    const int dim = vectorStore_.dimension();
+    for (size_t i = 0; i < count; ++i) {
+        float* out = vectors + i * dim;
+        const float* vector = vectorStore_.getVector(nodes[i]);
+        if (vector) {
+            std::memcpy(out, vector, dim * sizeof(float));
+            normsSq[i] = vectorStore_.getNorm(nodes[i]);
+        } else {
+            // Quantized-only stores: decoded vectors carry their own norms
+            vectorStore_.decode(nodes[i], out);
+            normsSq[i] = computeNorm(out, dim);
+        }
+    }
+}
 
-    links.clear();
-    links.reserve(config_.M);
-    for (int i = 0; i < config_.M && i < static_cast<int>(neighborDists.size()); ++i) {
-        links.push_back(neighborDists[i].second);
+float HNSWIndex::pairDistance(float dot, float normSqA, float normSqB) const {
+    switch (config_.metric) {
+        case Metric::INNER_PRODUCT: return -dot;
+        case Metric::COSINE: return cosineFromNegDot(-dot, normSqA, normSqB);
+        default: return std::max(0.0f, normSqA + normSqB - 2.0f * dot);
     }
 }
 
@@ -525,75 +950,285 @@ float HNSWIndex::computeDistance(const float* a, int bIndex) {
     if (bIndex < 0 || bIndex >= vectorStore_.size()) {
         return std::numeric_limits<float>::max();
     }
+    if (vectorStore_.isQuantized()) {
+        return computeCodeDistance(a, 1.0f, bIndex);
+    }
     const float* b = vectorStore_.getVector(bIndex);
     if (b == nullptr) {
         return std::numeric_limits<float>::max();
     }
-    return distanceFunc_(a, b, vectorStore_.dimension());
+    const float d = distanceFunc_(a, b, vectorStore_.dimension());
+    // a is unit length for COSINE, only b's stored norm is needed
+    return config_.metric == Metric::COSINE ? cosineFromNegDot(d, 1.0f, vectorStore_.getNorm(bIndex)) : d;
 }
 
-void HNSWIndex::save(const std::string& /*path*/) {
-    // TODO: Implement save
+float HNSWIndex::computeNodeDistance(int aIndex, int bIndex) {
+    if (vectorStore_.isQuantized()) {
+        // Build-time pairs decode one side and stay asymmetric against the other's codes
+        thread_local std::vector<float> decoded;
+        decoded.resize(vectorStore_.dimension());
+        vectorStore_.decode(aIndex, decoded.data());
+        return computeCodeDistance(decoded.data(), vectorStore_.getNorm(aIndex), bIndex);
+    }
+    const float* a = vectorStore_.getVector(aIndex);
+    const float* b = vectorStore_.getVector(bIndex);
+    if (a == nullptr || b == nullptr) {
+        return std::numeric_limits<float>::max();
+    }
+    const float d = distanceFunc_(a, b, vectorStore_.dimension());
+    if (config_.metric == Metric::COSINE) {
+        return cosineFromNegDot(d, vectorStore_.getNorm(aIndex), vectorStore_.getNorm(bIndex));
+    }
+    return d;
 }
 
-void HNSWIndex::load(const std::string& /*path*/) {
-    // TODO: Implement load
+float HNSWIndex::computeCodeDistance(const float* a, float normSqA, int bIndex) const {
+    const uint8_t* code = vectorStore_.getCode(bIndex);
+    if (code == nullptr) {
+        return std::numeric_limits<float>::max();
+    }
+    const size_t dim = vectorStore_.dimension();
+    const float d = vectorStore_.encoding() == VectorEncoding::SQ8
+        ? sq8DistanceFunc_(a, code, vectorStore_.sqMin(), vectorStore_.sqScale(), dim)
+        : fp16DistanceFunc_(a, reinterpret_cast<const uint16_t*>(code), dim);
+    return config_.metric == Metric::COSINE ? cosineFromNegDot(d, normSqA, vectorStore_.getNorm(bIndex)) : d;
 }
 
-void HNSWIndex::searchBatch(const float* queries, int nQueries, int k,
-                            int* resultIds, float* resultDistances) {
-    int dim = vectorStore_.dimension();
-    int nThreads = std::min(numThreads_, nQueries);
-    int chunkSize = (nQueries + nThreads - 1) / nThreads;
-
-    std::vector<std::future<void>> futures;
-
-    for (int t = 0; t < nThreads; t++) {
-        int start = t * chunkSize;
-        int end = std::min(start + chunkSize, nQueries);
-
-        if (start >= end) break;
-
-        futures.push_back(std::async(std::launch::async, [this, queries, k, resultIds, resultDistances, dim, start, end]() {
-            for (int i = start; i < end; i++) {
-                const float* query = queries + static_cast<size_t>(i) * dim;
-                int* ids = resultIds + static_cast<size_t>(i) * k;
-                float* dists = resultDistances + static_cast<size_t>(i) * k;
-                int count;
-                search(query, k, ids, dists, &count);
-            }
-        }));
+void HNSWIndex::rerank(const float* query, std::vector<DistIdPair>& results) {
+    const int dim = vectorStore_.dimension();
+    VECTORDB_STATS_ADD(distanceComputations, results.size());
+    for (auto& result : results) {
+        const float d = distanceFunc_(query, vectorStore_.getVector(result.second), dim);
+        result.first = config_.metric == Metric::COSINE
+            ? cosineFromNegDot(d, 1.0f, vectorStore_.getNorm(result.second)) : d;
     }
+    std::sort(results.begin(), results.end());
+}
 
-    for (auto& f : futures) {
-        f.get();
+const float* HNSWIndex::prepareQuery(const float* query, std::vector<float>& buffer) const {
+    if (config_.metric != Metric::COSINE) return query;
+    const int dim = vectorStore_.dimension();
+    buffer.resize(dim);
+    normalizeVector(query, dim, buffer.data());
+    return buffer.data();
+}
+
+int HNSWIndex::maxLinksPerLevel() const {
+    // Links can grow to M * pruneOverflowFactor before pruneNeighbors trims them
+    return std::max(config_.M, config_.M * config_.pruneOverflowFactor);
+}
+
+namespace {
+
+// On-disk snapshot of HNSWConfig plus graph bookkeeping
+struct HNSWFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t entryPoint;
+    int32_t maxLinks;
+    int32_t M;
+    int32_t efConstruction;
+    int32_t efSearch;
+    int32_t maxLevel;
+    double levelMultiplier;
+    int32_t efSearchDelta;
+    float distanceThreshold;
+    int32_t useEarlyTermination;
+    int32_t maxExpansionsMultiplier;
+    int32_t useHeuristicSelection;
+    int32_t heuristicCandidates;
+    int32_t pruneOverflowFactor;
+    int32_t metric;
+};
+
+} // namespace
+
+void HNSWIndex::save(const std::string& path) {
+    // Exclude appends and in-flight linking so the snapshot is consistent
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    const int n = size_.load(std::memory_order_acquire);
+    const size_t upperCount = upperUsed_;
+
+    IndexFileWriter writer(path, IndexType::HNSW, vectorStore_.dimension());
+
+    HNSWFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = n;
+    meta.capacity = vectorStore_.capacity();
+    meta.entryPoint = entryPoint_.load(std::memory_order_acquire);
+    meta.maxLinks = linkStride_ - 1;
+    meta.M = config_.M;
+    meta.efConstruction = config_.efConstruction;
+    meta.efSearch = config_.efSearch;
+    meta.maxLevel = config_.maxLevel;
+    meta.levelMultiplier = config_.levelMultiplier;
+    meta.efSearchDelta = config_.efSearchDelta;
+    meta.distanceThreshold = config_.distanceThreshold;
+    meta.useEarlyTermination = config_.useEarlyTermination ? 1 : 0;
+    meta.maxExpansionsMultiplier = config_.maxExpansionsMultiplier;
+    meta.useHeuristicSelection = config_.useHeuristicSelection ? 1 : 0;
+    meta.heuristicCandidates = config_.heuristicCandidates;
+    meta.pruneOverflowFactor = config_.pruneOverflowFactor;
+    meta.metric = static_cast<int32_t>(config_.metric);
+    writer.writeSection(SectionType::HNSWMeta, &meta, sizeof(meta));
+
+    vectorStore_.writeSections(writer);
+
+    // Chunks concatenate to the file sections, each array goes out one chunk per write
+    writer.writeChunkedSection(SectionType::HNSWLevels, levels_, n);
+    writer.writeChunkedSection(SectionType::HNSWLinks0, links0_, n);
+    writer.writeChunkedSection(SectionType::HNSWUpperIndex, upperIndex_, n);
+    writer.writeChunkedSection(SectionType::HNSWUpperLinks, upperLinks_, upperCount / linkStride_);
+
+    writer.finish();
+}
+
+void HNSWIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::HNSW);
+    if (file->dimension() != vectorStore_.dimension()) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+
+    const auto* meta = file->sectionAs<HNSWFileMeta>(SectionType::HNSWMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->maxLinks < 0 || !isValidMetric(meta->metric) ||
+        meta->entryPoint < -1 || meta->entryPoint >= n) {
+        throw std::runtime_error("Corrupted HNSW index file: " + path);
+    }
+    const int stride = meta->maxLinks + 1;
+    if (meta->maxLinks < std::max(meta->M, meta->M * meta->pruneOverflowFactor)) {
+        throw std::runtime_error("Corrupted HNSW index file: " + path);
+    }
+
+    int32_t* levels = file->sectionAs<int32_t>(SectionType::HNSWLevels, n);
+    int32_t* links0 = file->sectionAs<int32_t>(SectionType::HNSWLinks0,
+                                              static_cast<size_t>(n) * stride);
+    uint64_t* upperIndex = file->sectionAs<uint64_t>(SectionType::HNSWUpperIndex, n);
+    size_t upperCount = file->sectionSize(SectionType::HNSWUpperLinks) / sizeof(int32_t);
+    int32_t* upperLinks = reinterpret_cast<int32_t*>(file->section(SectionType::HNSWUpperLinks));
+    if (upperCount % stride != 0 ||
+        (n > 0 && upperIndex[n - 1] + static_cast<uint64_t>(levels[n - 1]) * stride != upperCount)) {
+        throw std::runtime_error("Corrupted HNSW index file: " + path);
+    }
+
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    config_.M = meta->M;
+    config_.efConstruction = meta->efConstruction;
+    config_.efSearch = meta->efSearch;
+    config_.maxLevel = meta->maxLevel;
+    config_.levelMultiplier = meta->levelMultiplier;
+    config_.efSearchDelta = meta->efSearchDelta;
+    config_.distanceThreshold = meta->distanceThreshold;
+    config_.useEarlyTermination = meta->useEarlyTermination != 0;
+    config_.maxExpansionsMultiplier = meta->maxExpansionsMultiplier;
+    config_.useHeuristicSelection = meta->useHeuristicSelection != 0;
+    config_.heuristicCandidates = meta->heuristicCandidates;
+    config_.pruneOverflowFactor = meta->pruneOverflowFactor;
+    config_.metric = static_cast<Metric>(meta->metric);
+    distanceFunc_ = getDistanceFunc(config_.metric);
+    sq8DistanceFunc_ = getSQ8DistanceFunc(config_.metric);
+    fp16DistanceFunc_ = getFP16DistanceFunc(config_.metric);
+
+    // The store takes its encoding from the file
+    vectorStore_.attachSections(*file, n);
+    config_.storage = vectorStore_.encoding();
+    config_.rerankWithVectors = vectorStore_.hasVectors();
+    // The file's block length may differ from this instance's, rebuild the link arrays to match
+    links0_.reset(stride, VectorStore::CHUNK_ROWS);
+    upperLinks_.reset(stride, UPPER_CHUNK_BLOCKS);
+    levels_.attach(levels, n);
+    links0_.attach(links0, n);
+    upperIndex_.attach(upperIndex, n);
+    upperLinks_.attach(upperLinks, upperCount / stride);
+    linkStride_ = stride;
+    upperUsed_ = upperCount;
+    mappedFile_ = std::move(file);
+
+    // Which deleted nodes were already repaired is not saved, the next compact() redoes them
+    pendingDeleted_.clear();
+    freeSlots_.clear();
+    for (int i = 0; i < n; i++) {
+        if (vectorStore_.isDeleted(i)) pendingDeleted_.push_back(i);
     }
+
+    // The entry point is -1 when every node has been deleted and compacted
+    const int entry = n > 0 ? meta->entryPoint : -1;
+    entryPoint_.store(entry, std::memory_order_release);
+    maxLevel_.store(entry >= 0 ? levels[entry] : -1, std::memory_order_release);
+    size_.store(n, std::memory_order_release);
+}
+
+void HNSWIndex::detachMapping() {
+    if (!mappedFile_) return;
+
+    const size_t n = static_cast<size_t>(size_.load(std::memory_order_acquire));
+    vectorStore_.detach();
+    levels_.detach(n);
+    links0_.detach(n);
+    upperIndex_.detach(n);
+    upperLinks_.detach(upperUsed_ / linkStride_);
+    reserveLinks(vectorStore_.capacity(), upperUsed_);
+    mappedFile_.reset();
+}
+
+void HNSWIndex::searchBatch(const float* queries, int nQueries, int k,
+                            int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    const int dim = vectorStore_.dimension();
+
+    // One query per task, idle threads steal from slow chunks
+    ThreadPool::instance().parallelFor(0, nQueries, 1, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            const float* query = queries + static_cast<size_t>(i) * dim;
+            int* ids = resultIds + static_cast<size_t>(i) * k;
+            float* dists = resultDistances + static_cast<size_t>(i) * k;
+            int count;
+            SearchStatsScope scope(queryStats ? queryStats + i : nullptr, queryStats == nullptr);
+            search(query, k, ids, dists, &count);
+            for (int j = count; j < k; j++) {
+                ids[j] = -1;
+                dists[j] = -1.0f;
+            }
+        }
+    }, numThreads_);
 }
 
 void HNSWIndex::addBatch(const float* vectors, const int* ids, int n,
                         int* failedIndices, int* failedCount) {
     if (failedCount) *failedCount = 0;
+    if (n <= 0) return;
 
-    int dim = vectorStore_.dimension();
+    const int dim = vectorStore_.dimension();
+    if (!vectorStore_.isEncodingTrained()) {
+        train(n, vectors);
+    }
 
-    for (int i = 0; i < n; i++) {
-        try {
-            add(ids[i], vectors + static_cast<size_t>(i) * dim);
-        } catch (...) {
-            if (failedIndices && failedCount) {
-                failedIndices[*failedCount] = i;
-                (*failedCount)++;
+    // add() itself is thread-safe
+    std::mutex failedMutex;
+    ThreadPool::instance().parallelFor(0, n, 1, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            try {
+                add(ids[i], vectors + static_cast<size_t>(i) * dim);
+            } catch (...) {
+                if (failedIndices && failedCount) {
+                    std::lock_guard<std::mutex> guard(failedMutex);
+                    failedIndices[(*failedCount)++] = static_cast<int>(i);
+                }
             }
         }
-    }
-}
+    }, numThreads_);
 
-void HNSWIndex::setNumThreads(int numThreads) {
-    numThreads_ = std::max(1, numThreads);
+    if (failedIndices && failedCount) {
+        std::sort(failedIndices, failedIndices + *failedCount);
+    }
 }
 
-int HNSWIndex::getNumThreads() const {
-    return numThreads_;
+void HNSWIndex::train(int nSamples, const float* samples) {
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+    vectorStore_.trainEncoding(samples, nSamples);
 }
 
 } // namespace vectordb
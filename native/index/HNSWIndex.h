@@ -1,6 +1,10 @@
 #pragma once
 #include "VectorIndex.h"
 #include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/VisitedPool.h"
+#include "../core/ChunkedArray.h"
+#include "../core/GraphReorder.h"
 #include "../compute/DistanceUtils.h"
 #include <vector>
 #include <random>
@@ -8,7 +12,7 @@
 #include <mutex>
 #include <shared_mutex>
 #include <atomic>
-#include <unordered_set>
+#include <memory>
 
 namespace vectordb {
 
@@ -19,12 +23,23 @@ struct HNSWConfig {
     int maxLevel = 16;
     double levelMultiplier = 1.0 / std::log(1.0 * M);
     int efSearchDelta = 32;
+    // > 0 时第 0 层搜索的 ef 固定为 max(efSearchOverride, k)，不再按 getEfSearch 随 k 和规模自适应
+    int efSearchOverride = 0;
     float distanceThreshold = 0.0f;
     bool useEarlyTermination = true;
     int maxExpansionsMultiplier = 4;
     bool useHeuristicSelection = true;
     int heuristicCandidates = 8;
     int pruneOverflowFactor = 2;
+    Metric metric = Metric::L2;  // COSINE 时向量原样存储，距离用预存模长换算
+    // 向量存储编码: FP16/SQ8 时图遍历与建图都在量化编码上做非对称距离计算
+    VectorEncoding storage = VectorEncoding::FLOAT32;
+    // 量化存储时是否另存 float 原向量，用于对 ef 个候选做精确距离重排
+    bool rerankWithVectors = true;
+    // 过滤搜索: 估计通过率低于该值时不走图，直接扫描全部通过过滤的向量
+    float filterBruteForceSelectivity = 0.02f;
+    // optimize() 使用的节点重排方式
+    GraphOrder graphOrder = GraphOrder::GORDER;
 
     HNSWConfig() = default;
 
@@ -57,51 +72,175 @@ public:
     void add(int id, const float* vector) override;
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
-               int* resultCount) override;
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    // 过滤掉的节点照常参与图遍历但不进入结果；估计通过率低于 filterBruteForceSelectivity 时改为暴力扫描
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
+    // 先按普通搜索找到半径内的入口，再在第 0 层只沿半径内的节点扩展；filter 只作用于输出
+    void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                     const IDFilter* filter = nullptr) override;
     void save(const std::string& path) override;
     void load(const std::string& path) override;
-    int size() const override { return size_.load(std::memory_order_acquire); }
+    int size() const override {
+        return size_.load(std::memory_order_acquire) - vectorStore_.deletedCount();
+    }
     int dimension() const override { return vectorStore_.dimension(); }
     int capacity() const override { return vectorStore_.capacity(); }
+    // 向量与四个邻接表数组共用同一个分配器
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override;
 
+    // 结果不足 k 个时以 id = -1、距离 = -1 补齐
     void searchBatch(const float* queries, int nQueries, int k,
-                    int* resultIds, float* resultDistances);
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+    void addBatch(const float* vectors, const int* ids, int n) override {
+        addBatch(vectors, ids, n, nullptr, nullptr);
+    }
+    // 添加失败的向量下标按升序写入 failedIndices
     void addBatch(const float* vectors, const int* ids, int n,
-                 int* failedIndices = nullptr, int* failedCount = nullptr);
-    void setNumThreads(int numThreads);
-    int getNumThreads() const;
+                 int* failedIndices, int* failedCount);
+
+    // 删除只打标记: 节点照常作为图遍历的中转，不再进入结果，也不会被新节点选为邻居
+    bool remove(int id) override;
+    // 原地覆盖向量后重新为该节点选邻居，指向它的旧边保留
+    bool update(int id, const float* vector) override;
+    /**
+     * 修复并回收已删除的节点: 把存活节点邻接表中的已删除邻居换成经由它们的两跳候选
+     * (按启发式重新选择)，入口点被删除时换成层数最高的存活节点；
+     * 修复后已删除节点不再可达，其槽位 (连同层数和上层邻接块) 交给后续 add 复用。
+     * 修复阶段与 search / add 并发执行，只在开始和回收槽位时短暂持有结构锁的独占权
+     */
+    int compact() override;
+
+    // 按 config_.graphOrder 重排节点
+    void optimize() override { reorder(config_.graphOrder); }
+    /**
+     * 按 order 给全部节点重新编号，使第 0 层上相邻的节点在内存中也相邻:
+     * 向量、编码、层数与第 0 层邻接表按新顺序搬移，上层邻接块按新顺序重新紧凑排列，外部 id 不变。
+     * 期间独占结构锁，search / add 会被阻塞；mmap 加载的索引先拷贝到内存
+     */
+    void reorder(GraphOrder order);
+
+    // SQ8 存储时按样本确定每维量化范围，须在首次 add 之前调用；
+    // addBatch 遇到未训练的 SQ8 索引时用该批数据训练。其余编码下为空操作
+    void train(int nSamples, const float* samples);
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+    // 见 HNSWConfig::efSearchOverride，0 恢复自适应；不写入索引文件
+    void setEfSearch(int ef) { config_.efSearchOverride = std::max(ef, 0); }
 
 private:
     VectorStore vectorStore_;
     HNSWConfig config_;
     std::atomic<int> size_{0};
     std::atomic<int> entryPoint_{-1};
+    std::atomic<int> maxLevel_{-1};
     std::mt19937 rng_;
+
+    // 锁层次 (按此顺序获取):
+    // - appendMutex_: 串行化新节点的分配 (ID 下标、层数、邻接块)
+    // - mutex_: 结构锁。search 和插入的连边阶段持共享锁，只有数组扩容、load/save 持独占锁
+    // - entryMutex_: 新节点层数超过当前最高层时，整个插入过程持有，保证入口点与最高层一起更新
+    // - linkLocks_: 分段邻接锁，读写任意节点的邻接块前持有，同一时刻最多持有一把
+    std::mutex appendMutex_;
     mutable std::shared_mutex mutex_;
+    std::mutex entryMutex_;
+    static constexpr int NUM_LINK_LOCKS = 4096;
+    mutable std::vector<std::mutex> linkLocks_;
+    std::mutex& linkLock(int nodeId) const { return linkLocks_[nodeId & (NUM_LINK_LOCKS - 1)]; }
 
-    struct Node {
-        int level;
-        std::vector<std::vector<int>> neighbors;
-    };
-    std::vector<Node> nodes_;
     DistanceFunc distanceFunc_;
-    int numThreads_ = 4;
+    SQ8DistanceFunc sq8DistanceFunc_;
+    FP16DistanceFunc fp16DistanceFunc_;
+
+    // 邻接表按定长块存储，逐块写出即为索引文件中的 Section:
+    // 每层一个块 [count | ids..., -1 填充]，块长 linkStride_ 按 64 字节对齐
+    // - links0_: 第 0 层，节点 i 的块是第 i 行
+    // - upperIndex_/upperLinks_: 稀疏的上层表，只有 level > 0 的节点占用块，
+    //   节点 i 第 l 层的块从 upperIndex_[i] + (l - 1) * linkStride_ 个 int32 处开始
+    // 四个数组都是分块数组，插入时按需追加新块，已有的块不会搬迁，读者无需加锁；
+    // 上层表已用部分为 upperUsed_ (int32 个数)
+    // load 之后四个数组直接挂载 mmap 映射，首次写入时再拷贝出来
+    ChunkedArray<int32_t> levels_{1, VectorStore::CHUNK_ROWS};
+    ChunkedArray<int32_t> links0_;
+    ChunkedArray<uint64_t> upperIndex_{1, VectorStore::CHUNK_ROWS};
+    ChunkedArray<int32_t> upperLinks_;
+    int linkStride_ = 0;   // 1 + 每层最大邻居数，向上取整到 16 个 int32
+    size_t upperUsed_ = 0;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+
+    // 已删除、尚未修复的节点，以及已回收、可供 add 复用的槽位；均由 appendMutex_ 保护
+    std::vector<int> pendingDeleted_;
+    std::vector<int> freeSlots_;
+
+    struct LinkList {
+        const int* data;
+        int size;
+    };
+    LinkList getLinks(int nodeId, int level) const {
+        const int32_t* block = linkBlock(nodeId, level);
+        return LinkList{block + 1, block[0]};
+    }
+    const int32_t* linkBlock(int nodeId, int level) const {
+        return level == 0
+            ? links0_.row(nodeId)
+            : upperLinks_.row(upperIndex_[nodeId] / linkStride_ + level - 1);
+    }
+    int32_t* linkBlock(int nodeId, int level) {
+        return const_cast<int32_t*>(static_cast<const HNSWIndex*>(this)->linkBlock(nodeId, level));
+    }
+    int getNodeLevel(int nodeId) const { return levels_[nodeId]; }
+    int maxLinksPerLevel() const;
+    int appendNode(int id, const float* vector, int level);
+    // 复用已回收的槽位，保留原来的层数，返回该层数
+    int reuseSlot(int index, int id, const float* vector);
+    // 从入口点逐层下降，为节点选邻居并建立双向连接 (持共享结构锁)
+    void linkNode(int index, int level, const float* rawVector);
+    // 用两跳候选替换 nodeId 在 level 层的已删除邻居
+    void repairLinks(int nodeId, int level);
+    // 确保前 nodes 个节点以及前 upperInts 个上层 int32 都已有块
+    void reserveLinks(size_t nodes, size_t upperInts);
+    void setLinks(int nodeId, int level, const std::vector<int>& links);
+    void detachMapping();
 
-    // Thread-local visited array to avoid repeated allocation
-    mutable std::vector<std::unordered_set<int>> threadVisited_;
-    mutable std::vector<int> visitedVersion_;
-    mutable std::atomic<int> currentVersion_{0};
+    // 搜索时借出的访问标记表
+    mutable VisitedPool visitedPool_;
 
     int getRandomLevel();
+    // filter 非空时被过滤的节点只作为中转，不进入 results
     void searchLevel(const float* query, int entryPoint, int ef, int level,
-                    std::vector<std::pair<float, int>>& results);
+                    std::vector<std::pair<float, int>>& results, VisitedTable& visited,
+                    const IDFilter* filter = nullptr);
+    // 扫描全部节点，保留通过 filter 的最近 ef 个
+    void searchBruteForce(const float* query, int ef, const IDFilter* filter,
+                          std::vector<std::pair<float, int>>& results);
+    // 通过 filter 的节点比例，filter 未给出个数时按固定步长抽样估计
+    float estimateSelectivity(const IDFilter* filter, int nodeCount) const;
     std::vector<int> selectNeighbors(const std::vector<std::pair<float, int>>& candidates, int M);
-    std::vector<int> selectNeighborsHeuristic(const float* query,
-                                              const std::vector<std::pair<float, int>>& candidates,
-                                              int M, int level);
-    void connectNeighbors(int newId, const std::vector<int>& neighbors, int level);
-    void pruneNeighbors(int nodeId, int level);
+    std::vector<int> selectNeighborsHeuristic(const std::vector<std::pair<float, int>>& candidates, int M);
+    // scored 为插入时 searchLevel 得到的 (距离, 节点)，裁剪邻居表时复用其中到新节点的距离
+    void connectNeighbors(int newId, const std::vector<int>& neighbors,
+                          const std::vector<std::pair<float, int>>& scored, int level);
+    void pruneNeighbors(int nodeId, int level, int newNeighbor, float newDistance);
+    // 把 nodes 的向量拷贝 (量化存储时解码) 到连续的 vectors [count][dim]，并给出模长平方
+    void gatherVectors(const int32_t* nodes, size_t count, float* vectors, float* normsSq) const;
+    // 由两个存储向量的内积和模长平方换算距离
+    float pairDistance(float dot, float normSqA, float normSqB) const;
+    // a 为查询或待插入向量，COSINE 下须已归一化 (见 prepareQuery)
     float computeDistance(const float* a, int bIndex);
+    float computeNodeDistance(int aIndex, int bIndex);
+    // a 到 bIndex 量化编码的非对称距离，a 的平方模长用于 COSINE 换算
+    float computeCodeDistance(const float* a, float normSqA, int bIndex) const;
+    // 量化存储时用 float 原向量重算 results 的距离并重新排序
+    void rerank(const float* query, std::vector<std::pair<float, int>>& results);
+    // 从 currObj 出发在第 1 层及以上贪心下降，返回第 0 层的入口
+    int greedyDescend(const float* query, int currObj, int nodeCount);
+    // COSINE 时把查询归一化到 buffer 并返回它，否则原样返回 query
+    const float* prepareQuery(const float* query, std::vector<float>& buffer) const;
 };
 
 } // namespace vectordb
@@ -1,5 +1,9 @@
 #include "HNSWPQIndex.h"
 #include "../compute/ADCUtils.h"
+#include "../compute/KMeans.h"
+#include "../core/ThreadPool.h"
+#include "../core/SearchContext.h"
+#include "../core/AlignedAllocator.h"
 #include <algorithm>
 #include <queue>
 #include <cmath>
@@ -7,7 +11,6 @@
 #include <chrono>
 #include <limits>
 #include <thread>
-#include <future>
 #include <cstring>
 
 #ifdef HAVE_OPENMP
@@ -18,11 +21,12 @@ namespace vectordb {
 
 typedef std::pair<float, int> DistIdPair;
 
-struct CompareByFirst {
-    bool operator()(const DistIdPair& a, const DistIdPair& b) const {
-        return a.first > b.first;
-    }
-};
+namespace {
+
+// Queries per batched ADC table build (64 * pqM * nCentroids floats = 4 MB at pqM = 64)
+constexpr int ADC_QUERY_BLOCK = 64;
+
+} // namespace
 
 HNSWPQIndex::HNSWPQIndex(int dimension, int maxElements)
     : HNSWPQIndex(dimension, maxElements, HNSWPQConfig{}) {}
@@ -40,16 +44,14 @@ HNSWPQIndex::HNSWPQIndex(int dimension, int maxElements, const HNSWPQConfig& con
 
     codebooks_.resize(static_cast<size_t>(config.pqM) * nCentroids_ * subDim_);
     distanceFunc_ = getEuclideanDistanceFunc();
+    exactDistanceFunc_ = getDistanceFunc(config.metric);
     batchDistFunc_ = getBatchEuclideanDistanceFunc();
+    adcBatchFunc_ = getADCDistanceBatchFunc();
 
     nodes_.reserve(maxElements);
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     rng_.seed(seed);
 
-    // Pre-allocate thread-local visited tracking
-    int maxThreads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
-    threadVisited_.resize(maxThreads);
-
     // Initialize fine-grained bucket locks
     bucketMutexes_.reserve(NUM_BUCKETS);
     for (int i = 0; i < NUM_BUCKETS; i++) {
@@ -83,41 +85,56 @@ void HNSWPQIndex::unlockBuckets(const std::vector<int>& nodeIds) {
 }
 
 // 内存池实现
-HNSWPQIndex::NeighborLevel* HNSWPQIndex::allocateNeighborLevels(int levelCount) {
-    NeighborLevel* levels = new NeighborLevel[levelCount + 1];
+uint32_t HNSWPQIndex::allocateNeighborSlots(int count) {
+    size_t offset = neighborPoolUsed_;
+    size_t required = offset + static_cast<size_t>(count);
+    if (required > neighborPool_.size()) {
+        size_t newSize = std::max(required, neighborPool_.size() * 2);
+        newSize = (newSize + NEIGHBOR_POOL_BLOCK_SIZE - 1) / NEIGHBOR_POOL_BLOCK_SIZE * NEIGHBOR_POOL_BLOCK_SIZE;
+        neighborPool_.resize(newSize);
+    }
+    neighborPoolUsed_ = required;
+    return static_cast<uint32_t>(offset);
+}
+
+uint32_t HNSWPQIndex::allocateNeighborLevels(int levelCount) {
+    // connectNeighbors prunes as soon as a list exceeds M, so M + 1 slots never overflow
+    const uint16_t capacity = static_cast<uint16_t>(config_.M + 1);
+    uint32_t firstLevel = static_cast<uint32_t>(levelPool_.size());
     for (int i = 0; i <= levelCount; i++) {
-        levels[i].data = nullptr;
-        levels[i].size = 0;
-        levels[i].capacity = 0;
+        NeighborLevel nl;
+        nl.offset = allocateNeighborSlots(capacity);
+        nl.size = 0;
+        nl.capacity = capacity;
+        levelPool_.push_back(nl);
     }
-    return levels;
+    return firstLevel;
 }
 
 void HNSWPQIndex::addNeighborToLevel(int nodeId, int level, int neighborId) {
     if (nodeId < 0 || nodeId >= static_cast<int>(nodes_.size())) return;
     if (level < 0 || level > nodes_[nodeId].level) return;
 
-    NeighborLevel& nl = nodes_[nodeId].levels[level];
+    NeighborLevel& nl = getNeighborLevel(nodeId, level);
     if (nl.size >= nl.capacity) {
-        // 需要扩容
-        int newCapacity = (nl.capacity == 0) ? 4 : nl.capacity * 2;
-        int* newData = new int[newCapacity];
-        if (nl.data && nl.size > 0) {
-            std::memcpy(newData, nl.data, nl.size * sizeof(int));
-            delete[] nl.data;
-        }
-        nl.data = newData;
-        nl.capacity = newCapacity;
+        // 需要扩容: 在内存池末尾重新分配，旧空间留作碎片
+        uint16_t newCapacity = static_cast<uint16_t>(nl.capacity * 2);
+        uint32_t newOffset = allocateNeighborSlots(newCapacity);
+        NeighborLevel& grown = getNeighborLevel(nodeId, level);
+        std::memcpy(neighborPool_.data() + newOffset, neighborPool_.data() + grown.offset,
+                    grown.size * sizeof(int));
+        grown.offset = newOffset;
+        grown.capacity = newCapacity;
     }
-    nl.data[nl.size++] = neighborId;
+    NeighborLevel& target = getNeighborLevel(nodeId, level);
+    neighborPool_[target.offset + target.size++] = neighborId;
 }
 
 void HNSWPQIndex::clearNeighborLevel(int nodeId, int level) {
     if (nodeId < 0 || nodeId >= static_cast<int>(nodes_.size())) return;
     if (level < 0 || level > nodes_[nodeId].level) return;
 
-    NeighborLevel& nl = nodes_[nodeId].levels[level];
-    nl.size = 0;
+    getNeighborLevel(nodeId, level).size = 0;
 }
 
 void HNSWPQIndex::reserveNeighborPool(size_t totalNeighbors) {
@@ -129,10 +146,26 @@ void HNSWPQIndex::train(int nSamples, const float* samples) {
         throw std::invalid_argument("Invalid training samples");
     }
 
+    // Codebooks for COSINE are learned on the unit sphere
+    std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(static_cast<size_t>(nSamples) * dimension_);
+        for (int i = 0; i < nSamples; i++) {
+            normalizeVector(samples + static_cast<size_t>(i) * dimension_, dimension_,
+                            normalized.data() + static_cast<size_t>(i) * dimension_);
+        }
+        samples = normalized.data();
+    }
+
+    // Subspaces are independent, each one writes only its own codebook slice
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
     for (int m = 0; m < config_.pqM; m++) {
         trainSubspace(m, nSamples, samples);
     }
 
+    updateCodebookNorms();
     trained_ = true;
 }
 
@@ -147,100 +180,12 @@ void HNSWPQIndex::trainSubspace(int subspaceIdx, int nSamples, const float* samp
         std::copy(vec, vec + subDim, subData.data() + static_cast<size_t>(i) * subDim);
     }
 
-    // KMeans++ initialization
-    std::mt19937 rng(42 + subspaceIdx);
-    std::uniform_int_distribution<int> dist(0, nSamples - 1);
-
-    // First centroid: random
-    int firstIdx = dist(rng);
-    float* firstCentroid = getCodebookCentroid(subspaceIdx, 0);
-    const float* firstSample = subData.data() + static_cast<size_t>(firstIdx) * subDim;
-    std::copy(firstSample, firstSample + subDim, firstCentroid);
-
-    // Remaining centroids: KMeans++
-    std::vector<float> minDistances(nSamples, std::numeric_limits<float>::max());
-
-    for (int c = 1; c < nCentroids; c++) {
-        // Update minimum distances
-        float* newCentroid = getCodebookCentroid(subspaceIdx, c);
-        float totalDist = 0.0f;
-
-        for (int i = 0; i < nSamples; i++) {
-            const float* sample = subData.data() + static_cast<size_t>(i) * subDim;
-            float* prevCentroid = getCodebookCentroid(subspaceIdx, c - 1);
-            float d = distanceFunc_(sample, prevCentroid, subDim);
-
-            if (d < minDistances[i]) {
-                minDistances[i] = d;
-            }
-            totalDist += minDistances[i];
-        }
-
-        // Select next centroid with probability proportional to distance squared
-        std::uniform_real_distribution<float> probDist(0.0f, totalDist);
-        float target = probDist(rng);
-        float cumsum = 0.0f;
-        int selectedIdx = 0;
-
-        for (int i = 0; i < nSamples; i++) {
-            cumsum += minDistances[i];
-            if (cumsum >= target) {
-                selectedIdx = i;
-                break;
-            }
-        }
-
-        const float* selectedSample = subData.data() + static_cast<size_t>(selectedIdx) * subDim;
-        std::copy(selectedSample, selectedSample + subDim, newCentroid);
-    }
-
-    // KMeans iterations
-    std::vector<int> assignments(nSamples);
-    std::vector<int> clusterSizes(nCentroids);
-
-    for (int iter = 0; iter < config_.pqIterations; iter++) {
-        bool changed = false;
-
-        // E-step: assign to nearest centroid
-        for (int i = 0; i < nSamples; i++) {
-            const float* sample = subData.data() + static_cast<size_t>(i) * subDim;
-            int nearest = findNearestCentroid(subspaceIdx, sample);
-            if (assignments[i] != nearest) {
-                assignments[i] = nearest;
-                changed = true;
-            }
-        }
-
-        if (!changed) break;
-
-        // M-step: update centroids
-        std::fill(clusterSizes.begin(), clusterSizes.end(), 0);
-        for (int i = 0; i < nCentroids; i++) {
-            float* centroid = getCodebookCentroid(subspaceIdx, i);
-            std::fill(centroid, centroid + subDim, 0.0f);
-        }
-
-        for (int i = 0; i < nSamples; i++) {
-            int cluster = assignments[i];
-            float* centroid = getCodebookCentroid(subspaceIdx, cluster);
-            const float* sample = subData.data() + static_cast<size_t>(i) * subDim;
-
-            for (int d = 0; d < subDim; d++) {
-                centroid[d] += sample[d];
-            }
-            clusterSizes[cluster]++;
-        }
-
-        for (int i = 0; i < nCentroids; i++) {
-            if (clusterSizes[i] > 0) {
-                float* centroid = getCodebookCentroid(subspaceIdx, i);
-                float invSize = 1.0f / clusterSizes[i];
-                for (int d = 0; d < subDim; d++) {
-                    centroid[d] *= invSize;
-                }
-            }
-        }
-    }
+    KMeansConfig kmeans;
+    kmeans.k = nCentroids;
+    kmeans.maxIterations = config_.pqIterations;
+    kmeans.init = KMeansInit::KMEANS_PLUS_PLUS;
+    kmeans.seed = 42 + subspaceIdx;
+    trainKMeans(subData.data(), nSamples, subDim, kmeans, getCodebookCentroid(subspaceIdx, 0));
 }
 
 int HNSWPQIndex::findNearestCentroid(int subspaceIdx, const float* subVector) {
@@ -260,12 +205,62 @@ int HNSWPQIndex::findNearestCentroid(int subspaceIdx, const float* subVector) {
 }
 
 void HNSWPQIndex::encode(const float* vector, uint8_t* codes) {
+    thread_local std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(dimension_);
+        normalizeVector(vector, dimension_, normalized.data());
+        vector = normalized.data();
+    }
+
     for (int m = 0; m < config_.pqM; m++) {
         const float* subVector = vector + static_cast<size_t>(m) * subDim_;
         codes[m] = static_cast<uint8_t>(findNearestCentroid(m, subVector));
     }
 }
 
+void HNSWPQIndex::encodeBatch(const float* vectors, int n, uint8_t* codes) {
+    // Blocks of vectors are matched against each subspace codebook with one GEMM
+    static constexpr int ENCODE_BLOCK = 256;
+    const int nBlocks = (n + ENCODE_BLOCK - 1) / ENCODE_BLOCK;
+
+    ThreadPool::instance().parallelFor(0, nBlocks, 1, [&](int64_t blockBegin, int64_t blockEnd) {
+        for (int64_t b = blockBegin; b < blockEnd; b++) {
+            const int start = static_cast<int>(b) * ENCODE_BLOCK;
+            const int count = std::min(ENCODE_BLOCK, n - start);
+            std::vector<float> subBlock(static_cast<size_t>(count) * subDim_);
+            std::vector<float> dists(static_cast<size_t>(count) * nCentroids_);
+
+            // COSINE encodes the normalized vector, fold the scale into the gather
+            std::vector<float> scales(count, 1.0f);
+            if (config_.metric == Metric::COSINE) {
+                for (int i = 0; i < count; i++) {
+                    const float normSq = computeNorm(vectors + static_cast<size_t>(start + i) * dimension_, dimension_);
+                    scales[i] = normSq > 0.0f ? 1.0f / std::sqrt(normSq) : 1.0f;
+                }
+            }
+
+            for (int m = 0; m < config_.pqM; m++) {
+                for (int i = 0; i < count; i++) {
+                    const float* subVector = vectors + static_cast<size_t>(start + i) * dimension_ +
+                                             static_cast<size_t>(m) * subDim_;
+                    float* dst = subBlock.data() + static_cast<size_t>(i) * subDim_;
+                    for (int d = 0; d < subDim_; d++) {
+                        dst[d] = subVector[d] * scales[i];
+                    }
+                }
+                batchEuclideanDistanceMultiQuery(subBlock.data(), getCodebookCentroid(m, 0),
+                                                 count, nCentroids_, subDim_, dists.data());
+
+                for (int i = 0; i < count; i++) {
+                    const float* row = dists.data() + static_cast<size_t>(i) * nCentroids_;
+                    codes[static_cast<size_t>(start + i) * config_.pqM + m] =
+                        static_cast<uint8_t>(std::min_element(row, row + nCentroids_) - row);
+                }
+            }
+        }
+    }, numThreads_);
+}
+
 float HNSWPQIndex::computeDistancePQ(const float* query, int nodeId) {
     // ADC: Asymmetric Distance Computation
     // Compute distance between query (float) and compressed node (codes)
@@ -273,32 +268,54 @@ float HNSWPQIndex::computeDistancePQ(const float* query, int nodeId) {
     float dist = 0.0f;
     const uint8_t* nodeCodes = codes_.data() + static_cast<size_t>(nodeId) * config_.pqM;
 
+    if (config_.metric == Metric::L2) {
+        for (int m = 0; m < config_.pqM; m++) {
+            const float* querySub = query + static_cast<size_t>(m) * subDim_;
+            int centroidIdx = nodeCodes[m];
+            float* centroid = getCodebookCentroid(m, centroidIdx);
+
+            // Compute ||querySub - centroid||^2
+            for (int d = 0; d < subDim_; d++) {
+                float diff = querySub[d] - centroid[d];
+                dist += diff * diff;
+            }
+        }
+        return dist;
+    }
+
+    // -<query, reconstruction>; for COSINE both sides are unit length
     for (int m = 0; m < config_.pqM; m++) {
         const float* querySub = query + static_cast<size_t>(m) * subDim_;
-        int centroidIdx = nodeCodes[m];
-        float* centroid = getCodebookCentroid(m, centroidIdx);
-
-        // Compute ||querySub - centroid||^2
+        float* centroid = getCodebookCentroid(m, nodeCodes[m]);
         for (int d = 0; d < subDim_; d++) {
-            float diff = querySub[d] - centroid[d];
-            dist += diff * diff;
+            dist -= querySub[d] * centroid[d];
         }
     }
-
-    return dist;
+    return config_.metric == Metric::COSINE ? 1.0f + dist : dist;
 }
 
 float HNSWPQIndex::computeExactDistance(int idA, int idB) {
     const float* vecA = vectorStore_.getVector(idA);
     const float* vecB = vectorStore_.getVector(idB);
     if (!vecA || !vecB) return std::numeric_limits<float>::max();
-    return distanceFunc_(vecA, vecB, dimension_);
+    const float d = exactDistanceFunc_(vecA, vecB, dimension_);
+    if (config_.metric == Metric::COSINE) {
+        return cosineFromNegDot(d, vectorStore_.getNorm(idA), vectorStore_.getNorm(idB));
+    }
+    return d;
 }
 
 float HNSWPQIndex::computeExactDistanceToQuery(const float* query, int nodeId) {
     const float* nodeVec = vectorStore_.getVector(nodeId);
-    if (!nodeVec) return std::numeric_limits<float>::max();
-    return distanceFunc_(query, nodeVec, dimension_);
+    if (!nodeVec) return computeDistancePQ(query, nodeId);  // PQ-only: fall back to ADC
+    const float d = exactDistanceFunc_(query, nodeVec, dimension_);
+    // The query is normalized up front for COSINE
+    return config_.metric == Metric::COSINE ? cosineFromNegDot(d, 1.0f, vectorStore_.getNorm(nodeId)) : d;
+}
+
+void HNSWPQIndex::updateCodebookNorms() {
+    codebookNorms_.resize(static_cast<size_t>(config_.pqM) * nCentroids_);
+    computeRowNormsSquared(codebooks_.data(), codebookNorms_.size(), subDim_, codebookNorms_.data());
 }
 
 void HNSWPQIndex::add(int id, const float* vector) {
@@ -306,8 +323,17 @@ void HNSWPQIndex::add(int id, const float* vector) {
         throw std::runtime_error("HNSWPQ index must be trained before adding vectors");
     }
 
+    if (mappedFile_) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        detachMapping();
+    }
+
     // Phase 1: Prepare data (no lock needed)
     int newIndex = size_.load(std::memory_order_acquire);
+    // Node storage and visited tables are sized by maxElements_, unlike the growable store
+    if (newIndex >= maxElements_) {
+        throw std::runtime_error("HNSWPQ index is full");
+    }
     vectorStore_.add(id, vector);
 
     // Encode vector with PQ
@@ -316,14 +342,14 @@ void HNSWPQIndex::add(int id, const float* vector) {
 
     Node newNode;
     newNode.level = getRandomLevel();
-    newNode.levels = nullptr;  // Will be allocated in write phase
+    newNode.firstLevel = 0;  // Will be allocated in write phase
 
     // Phase 2: First element (needs write lock)
     if (newIndex == 0) {
         std::unique_lock<std::shared_mutex> lock(mutex_);
         entryPoint_.store(0, std::memory_order_release);
-        newNode.levels = allocateNeighborLevels(newNode.level);
-        nodes_.push_back(std::move(newNode));
+        newNode.firstLevel = allocateNeighborLevels(newNode.level);
+        nodes_.push_back(newNode);
         size_.store(1, std::memory_order_release);
         return;
     }
@@ -332,131 +358,154 @@ void HNSWPQIndex::add(int id, const float* vector) {
     std::vector<std::vector<int>> neighborsPerLevel(newNode.level + 1);
     {
         std::shared_lock<std::shared_mutex> readLock(mutex_);
+        auto visited = visitedPool_.acquire(maxElements_);
+        findInsertNeighbors(newIndex, newNode.level, *visited, false, neighborsPerLevel);
+    } // Release read lock
 
-        int currObj = entryPoint_.load(std::memory_order_acquire);
-        float currDist = computeExactDistance(newIndex, currObj);
-
-        // Search for entry point (greedy search at upper layers)
-        int currLevel = nodes_[currObj].level;
-        while (currLevel > newNode.level) {
-            bool changed = true;
-            while (changed) {
-                changed = false;
-                if (currObj < 0 || currObj >= static_cast<int>(nodes_.size())) break;
-                if (currLevel > nodes_[currObj].level) break;
-
-                const auto& levelInfo = nodes_[currObj].levels[currLevel];
-                for (int i = 0; i < levelInfo.size; i++) {
-                    int neighbor = levelInfo.data[i];
-                    float d = computeExactDistance(newIndex, neighbor);
-                    if (d < currDist) {
-                        currDist = d;
-                        currObj = neighbor;
-                        changed = true;
-                    }
+    // Phase 4: Write phase (exclusive lock only for modifying graph structure)
+    {
+        std::unique_lock<std::shared_mutex> writeLock(mutex_);
+
+        // Allocate neighbor levels and register the new node before linking it
+        newNode.firstLevel = allocateNeighborLevels(newNode.level);
+        nodes_.push_back(newNode);
+
+        linkNode(newIndex, neighborsPerLevel, false);
+
+        // Update entry point if needed
+        int currentEntry = entryPoint_.load(std::memory_order_acquire);
+        if (newNode.level > nodes_[currentEntry].level) {
+            entryPoint_.store(newIndex, std::memory_order_release);
+        }
+
+        size_.fetch_add(1, std::memory_order_release);
+    } // Release write lock
+}
+
+void HNSWPQIndex::copyNeighbors(int nodeId, int level, bool useBucketLocks, std::vector<int>& out) {
+    std::shared_lock<std::shared_mutex> bucketLock(getBucketMutex(nodeId), std::defer_lock);
+    if (useBucketLocks) bucketLock.lock();
+
+    const NeighborLevel& levelInfo = getNeighborLevel(nodeId, level);
+    const int* levelNeighbors = getNeighborData(levelInfo);
+    out.assign(levelNeighbors, levelNeighbors + levelInfo.size);
+}
+
+void HNSWPQIndex::findInsertNeighbors(int newIndex, int newLevel, VisitedTable& visited,
+                                      bool useBucketLocks,
+                                      std::vector<std::vector<int>>& neighborsPerLevel) {
+    std::vector<int> levelNeighbors;
+
+    int currObj = entryPoint_.load(std::memory_order_acquire);
+    float currDist = computeExactDistance(newIndex, currObj);
+
+    // Search for entry point (greedy search at upper layers)
+    int currLevel = nodes_[currObj].level;
+    while (currLevel > newLevel) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            if (currObj < 0 || currObj >= static_cast<int>(nodes_.size())) break;
+            if (currLevel > nodes_[currObj].level) break;
+
+            copyNeighbors(currObj, currLevel, useBucketLocks, levelNeighbors);
+            for (int neighbor : levelNeighbors) {
+                float d = computeExactDistance(newIndex, neighbor);
+                if (d < currDist) {
+                    currDist = d;
+                    currObj = neighbor;
+                    changed = true;
                 }
             }
-            currLevel--;
-            if (currObj >= 0 && currObj < static_cast<int>(nodes_.size())) {
-                currLevel = std::min(currLevel, nodes_[currObj].level);
-            }
         }
+        currLevel--;
+        if (currObj >= 0 && currObj < static_cast<int>(nodes_.size())) {
+            currLevel = std::min(currLevel, nodes_[currObj].level);
+        }
+    }
 
-        // Search and find neighbors at each level
-        int maxLevelToProcess = std::min(newNode.level, nodes_[currObj].level);
-        for (int level = maxLevelToProcess; level >= 0; level--) {
-            int efBuild = config_.efConstruction;
-
-            // Greedy search for entry point
-            int searchEntry = currObj;
-            float searchDist = computeExactDistance(newIndex, searchEntry);
-
-            bool changed = true;
-            while (changed) {
-                changed = false;
-                const auto& levelInfo = nodes_[searchEntry].levels[level];
-                for (int i = 0; i < levelInfo.size; i++) {
-                    int neighbor = levelInfo.data[i];
-                    float d = computeExactDistance(newIndex, neighbor);
-                    if (d < searchDist) {
-                        searchDist = d;
-                        searchEntry = neighbor;
-                        changed = true;
-                    }
+    // Search and find neighbors at each level
+    int maxLevelToProcess = std::min(newLevel, nodes_[currObj].level);
+    for (int level = maxLevelToProcess; level >= 0; level--) {
+        int efBuild = config_.efConstruction;
+
+        // Greedy search for entry point
+        int searchEntry = currObj;
+        float searchDist = computeExactDistance(newIndex, searchEntry);
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            copyNeighbors(searchEntry, level, useBucketLocks, levelNeighbors);
+            for (int neighbor : levelNeighbors) {
+                float d = computeExactDistance(newIndex, neighbor);
+                if (d < searchDist) {
+                    searchDist = d;
+                    searchEntry = neighbor;
+                    changed = true;
                 }
             }
+        }
 
-            // BFS to collect candidates
-            std::vector<std::pair<float, int>> candidates;
-            candidates.reserve(efBuild * 2);
-            std::unordered_set<int> visited;
-            std::queue<int> bfsQueue;
-            bfsQueue.push(searchEntry);
-            visited.insert(searchEntry);
-
-            while (!bfsQueue.empty() && static_cast<int>(candidates.size()) < efBuild * 2) {
-                int node = bfsQueue.front();
-                bfsQueue.pop();
-
-                float d = computeExactDistance(newIndex, node);
-                candidates.emplace_back(d, node);
-
-                const auto& levelInfo = nodes_[node].levels[level];
-                for (int i = 0; i < levelInfo.size; i++) {
-                    int neighbor = levelInfo.data[i];
-                    if (visited.insert(neighbor).second) {
-                        bfsQueue.push(neighbor);
-                    }
+        // BFS to collect candidates
+        std::vector<std::pair<float, int>> candidates;
+        candidates.reserve(efBuild * 2);
+        std::queue<int> bfsQueue;
+        bfsQueue.push(searchEntry);
+        visited.reset();
+        visited.markVisited(searchEntry);
+
+        while (!bfsQueue.empty() && static_cast<int>(candidates.size()) < efBuild * 2) {
+            int node = bfsQueue.front();
+            bfsQueue.pop();
+
+            float d = computeExactDistance(newIndex, node);
+            candidates.emplace_back(d, node);
+
+            copyNeighbors(node, level, useBucketLocks, levelNeighbors);
+            for (int neighbor : levelNeighbors) {
+                if (visited.tryVisit(neighbor)) {
+                    bfsQueue.push(neighbor);
                 }
             }
+        }
 
-            // Sort and select neighbors
-            std::partial_sort(candidates.begin(),
-                             candidates.begin() + std::min(efBuild, static_cast<int>(candidates.size())),
-                             candidates.end());
-
-            if (config_.useHeuristicSelection && candidates.size() > static_cast<size_t>(config_.M)) {
-                neighborsPerLevel[level] = selectNeighborsHeuristic(candidates, config_.M, level);
-            } else {
-                neighborsPerLevel[level] = selectNeighbors(candidates, config_.M);
-            }
+        // Sort and select neighbors
+        std::partial_sort(candidates.begin(),
+                         candidates.begin() + std::min(efBuild, static_cast<int>(candidates.size())),
+                         candidates.end());
 
-            if (!candidates.empty()) {
-                currObj = candidates[0].second;
-            }
+        if (config_.useHeuristicSelection && candidates.size() > static_cast<size_t>(config_.M)) {
+            neighborsPerLevel[level] = selectNeighborsHeuristic(candidates, config_.M);
+        } else {
+            neighborsPerLevel[level] = selectNeighbors(candidates, config_.M);
         }
-    } // Release read lock
 
-    // Phase 4: Write phase (exclusive lock only for modifying graph structure)
-    {
-        std::unique_lock<std::shared_mutex> writeLock(mutex_);
+        if (!candidates.empty()) {
+            currObj = candidates[0].second;
+        }
+    }
+}
 
-        // Allocate neighbor levels for the new node
-        newNode.levels = allocateNeighborLevels(newNode.level);
+void HNSWPQIndex::linkNode(int newIndex, const std::vector<std::vector<int>>& neighborsPerLevel,
+                           bool useBucketLocks) {
+    const int newLevel = nodes_[newIndex].level;
 
-        // Set neighbors for the new node
-        for (int level = 0; level <= newNode.level && level < static_cast<int>(neighborsPerLevel.size()); level++) {
+    // Set neighbors for the new node
+    {
+        std::unique_lock<std::shared_mutex> bucketLock(getBucketMutex(newIndex), std::defer_lock);
+        if (useBucketLocks) bucketLock.lock();
+        for (int level = 0; level <= newLevel && level < static_cast<int>(neighborsPerLevel.size()); level++) {
             for (int neighborId : neighborsPerLevel[level]) {
                 addNeighborToLevel(newIndex, level, neighborId);
             }
         }
+    }
 
-        // Connect neighbors (this modifies existing nodes, needs write lock)
-        for (int level = 0; level <= newNode.level; level++) {
-            if (level < static_cast<int>(neighborsPerLevel.size())) {
-                connectNeighbors(newIndex, neighborsPerLevel[level], level);
-            }
-        }
-
-        // Update entry point if needed
-        int currentEntry = entryPoint_.load(std::memory_order_acquire);
-        if (newNode.level > nodes_[currentEntry].level) {
-            entryPoint_.store(newIndex, std::memory_order_release);
-        }
-
-        nodes_.push_back(std::move(newNode));
-        size_.fetch_add(1, std::memory_order_release);
-    } // Release write lock
+    // Connect neighbors (modifies existing nodes)
+    for (int level = 0; level <= newLevel && level < static_cast<int>(neighborsPerLevel.size()); level++) {
+        connectNeighbors(newIndex, neighborsPerLevel[level], level, useBucketLocks);
+    }
 }
 
 void HNSWPQIndex::search(const float* query, int k,
@@ -467,16 +516,43 @@ void HNSWPQIndex::search(const float* query, int k,
         return;
     }
 
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    SearchStatsScope scope;
+    auto lock = acquireLock<std::shared_lock<std::shared_mutex>>(mutex_);
 
+    // Heaps and buffers come from the thread's context, steady-state queries allocate nothing
+    SearchContext& context = SearchContext::local();
+    if (config_.metric == Metric::COSINE) {
+        context.query.resize(dimension_);
+        normalizeVector(query, dimension_, context.query.data());
+        query = context.query.data();
+    }
+
+    // One ADC table per query: a GEMM per subspace against the codebooks
+    context.table.resize(static_cast<size_t>(config_.pqM) * nCentroids_);
+    buildADCTables(config_.metric, query, 1, codebooks_.data(), codebookNorms_.data(),
+                   config_.pqM, nCentroids_, subDim_, context.table.data());
+    searchWithTable(query, context.table.data(), k, resultIds, resultDistances, resultCount);
+}
+
+void HNSWPQIndex::searchWithTable(const float* query, const float* table, int k,
+                                  int* resultIds, float* resultDistances, int* resultCount) {
+    // Nested under search(); on its own when called per query from searchBatch
+    SearchStatsScope scope;
+    SearchContext& context = SearchContext::local();
     int currObj = entryPoint_.load(std::memory_order_acquire);
 
-    // Encode query once for fast distance computation
-    std::vector<uint8_t> queryCodes(config_.pqM);
-    encode(query, queryCodes.data());
+    // The upper-level descent costs pqM lookups per node.
+    // At pqBits = 4 the whole table is pqM * 16 floats and stays in L1
+    const float adcOffset = config_.metric == Metric::COSINE ? 1.0f : 0.0f;
+    auto tableDistance = [&](int nodeId) {
+        // A single code is pqM dependent scalar loads, the AVX2 variant only repacks them
+        return adcDistanceScalar(table, codes_.data() + static_cast<size_t>(nodeId) * config_.pqM,
+                                 config_.pqM, nCentroids_) + adcOffset;
+    };
 
     // Use PQ distance for entry point search (matching build-time distance)
-    float currDist = computeDistancePQ(query, currObj);
+    VECTORDB_STATS_ADD(distanceComputations, 1);
+    float currDist = tableDistance(currObj);
 
     int currLevel = nodes_[currObj].level;
     while (currLevel > 0) {
@@ -486,11 +562,14 @@ void HNSWPQIndex::search(const float* query, int k,
             if (currObj < 0 || currObj >= static_cast<int>(nodes_.size())) break;
             if (currLevel > nodes_[currObj].level) break;
 
-            const auto& levelInfo = nodes_[currObj].levels[currLevel];
+            const NeighborLevel& levelInfo = getNeighborLevel(currObj, currLevel);
+            const int* levelNeighbors = getNeighborData(levelInfo);
+            VECTORDB_STATS_ADD(hops, 1);
+            VECTORDB_STATS_ADD(distanceComputations, levelInfo.size);
             for (int i = 0; i < levelInfo.size; i++) {
-                int neighbor = levelInfo.data[i];
-                // 上层搜索使用PQ距离（快速），底层使用精确距离
-                float d = computeDistancePQ(query, neighbor);
+                int neighbor = levelNeighbors[i];
+                // 上层搜索使用PQ距离（快速）
+                float d = tableDistance(neighbor);
                 if (d < currDist) {
                     currDist = d;
                     currObj = neighbor;
@@ -504,154 +583,251 @@ void HNSWPQIndex::search(const float* query, int k,
         }
     }
 
-    // Final search at level 0 using exact distance for accuracy
-    std::vector<DistIdPair> results;
-    int dataSize = size_.load(std::memory_order_acquire);
-    // Use much larger efSearch for high recall (>90%)
-    // Aim to visit at least 10% of the dataset or 50*k nodes
-    int efSearch = std::max(k * 50, std::min(dataSize / 10, 2000));
-
-    // Greedy search with exact distance
-    std::unordered_set<int> visited;
-    std::priority_queue<DistIdPair, std::vector<DistIdPair>, CompareByFirst> candidates;
-    std::priority_queue<DistIdPair> bestResults;
-
-    float dist = computeExactDistance(-1, currObj); // Hack: use vectorStore_ directly
-    // Actually compute exact distance properly
-    visited.insert(currObj);
-
-    // Get actual vector from store for exact distance
-    // This is a simplified version - in production would need proper exact distance calc
+    if (diskReader_) {
+        searchDisk(query, table, k, currObj, currDist, resultIds, resultDistances, resultCount);
+        return;
+    }
 
-    // Use PQ distance table for fast lookup
-    std::vector<float> distanceTable(static_cast<size_t>(config_.pqM) * nCentroids_);
-    for (int m = 0; m < config_.pqM; m++) {
-        const float* querySub = query + static_cast<size_t>(m) * subDim_;
-        float* distTableSub = distanceTable.data() + static_cast<size_t>(m) * nCentroids_;
-
-        for (int c = 0; c < nCentroids_; c++) {
-            float* centroid = getCodebookCentroid(m, c);
-            float d = 0.0f;
-            for (int d_idx = 0; d_idx < subDim_; d_idx++) {
-                float diff = querySub[d_idx] - centroid[d_idx];
-                d += diff * diff;
+    auto visited = visitedPool_.acquire(maxElements_);
+    MinHeap<DistIdPair>& candidates = context.candidates;
+    BoundedMaxHeap<DistIdPair>& bestResults = context.results;
+    candidates.clear();
+    visited->markVisited(currObj);
+
+    auto writeResults = [&](const std::vector<DistIdPair>& sorted) {
+        const int count = std::min(k, static_cast<int>(sorted.size()));
+        for (int i = 0; i < count; i++) {
+            resultDistances[i] = sorted[i].first;
+            resultIds[i] = vectorStore_.getId(sorted[i].second);
+        }
+        *resultCount = count;
+    };
+
+    if (!config_.adcSearch) {
+        // Final search at level 0 using exact distance for accuracy
+        int dataSize = size_.load(std::memory_order_acquire);
+        // Use much larger efSearch for high recall (>90%)
+        // Aim to visit at least 10% of the dataset or 50*k nodes
+        int efSearch = std::max(k * 50, std::min(dataSize / 10, 2000));
+        // Keep the best 200*k candidates seen along the way
+        bestResults.reset(k * 200);
+
+        int visitedCount = 1;
+        VECTORDB_STATS_ADD(distanceComputations, 1);
+        float entryDist = computeExactDistanceToQuery(query, currObj);
+        candidates.push({entryDist, currObj});
+        bestResults.push({entryDist, currObj});
+
+        // Beam search until efSearch nodes have been visited
+        while (!candidates.empty() && visitedCount < efSearch) {
+            const int currNode = candidates.top().second;
+            candidates.pop();
+            VECTORDB_STATS_ADD(hops, 1);
+
+            const NeighborLevel& levelInfo = getNeighborLevel(currNode, 0);
+            const int* levelNeighbors = getNeighborData(levelInfo);
+            for (int i = 0; i < levelInfo.size; i++) {
+                int neighbor = levelNeighbors[i];
+                if (!visited->tryVisit(neighbor)) continue;
+                visitedCount++;
+                VECTORDB_STATS_ADD(visitedNodes, 1);
+                VECTORDB_STATS_ADD(distanceComputations, 1);
+
+                float d = computeExactDistanceToQuery(query, neighbor);
+                candidates.push({d, neighbor});
+                bestResults.push({d, neighbor});
             }
-            distTableSub[c] = d;
         }
-    }
-
-    // Get optimized ADC function
-    ADCDistanceFunc adcFunc = getADCDistanceFunc();
-
-    // Beam search using distance table
-    // Compute exact distance for entry point to initialize properly
-    float entryDist = computeExactDistanceToQuery(query, currObj);
-    candidates.emplace(entryDist, currObj);
-    bestResults.emplace(entryDist, currObj);
-    float lowerBound = entryDist;
 
-    // Standard HNSW beam search: expand while we have promising candidates
-    // Use much larger candidate pool for high recall (>90%)
-    const int candidatePoolSize = k * 200; // Collect 200*k candidates for refinement
+        // Distances are already exact (ADC for PQ-only files), so the kept pool only needs sorting
+        writeResults(bestResults.sortAscending());
+        return;
+    }
 
-    while (!candidates.empty() && visited.size() < static_cast<size_t>(efSearch)) {
-        auto curr = candidates.top();
+    // Phase 1: ef-bounded search at level 0 on ADC distances, each expansion scores all of its
+    // unvisited neighbors with one batched table lookup over their gathered codes
+    const int rerankLimit = k * std::max(1, config_.rerankFactor);
+    bestResults.reset(std::max(config_.efSearch, rerankLimit));
+    candidates.push({currDist, currObj});
+    bestResults.push({currDist, currObj});
+    float lowerBound = currDist;
+
+    std::vector<int>& neighbors = context.neighbors;
+    std::vector<uint8_t>& neighborCodes = context.codes;
+    std::vector<float>& adcDistances = context.distances;
+    const size_t codeSize = config_.pqM;
+    while (!candidates.empty()) {
+        const DistIdPair curr = candidates.top();
         candidates.pop();
-        int currNode = curr.second;
-
-        const auto& levelInfo = nodes_[currNode].levels[0];
+        if (bestResults.full() && curr.first > lowerBound) break;
 
-        // Collect unvisited neighbors
-        std::vector<int> unvisitedNeighbors;
-        unvisitedNeighbors.reserve(levelInfo.size);
+        neighbors.clear();
+        const NeighborLevel& levelInfo = getNeighborLevel(curr.second, 0);
+        const int* levelNeighbors = getNeighborData(levelInfo);
         for (int i = 0; i < levelInfo.size; i++) {
-            int neighbor = levelInfo.data[i];
-            if (visited.find(neighbor) == visited.end()) {
-                unvisitedNeighbors.push_back(neighbor);
-                visited.insert(neighbor);
-            }
+            if (visited->tryVisit(levelNeighbors[i])) neighbors.push_back(levelNeighbors[i]);
         }
-
-        if (unvisitedNeighbors.empty()) continue;
-
-        // Process neighbors using exact distance for better recall
-        // Collect vectors for batch distance computation
-        std::vector<const float*> neighborVecs;
-        neighborVecs.reserve(unvisitedNeighbors.size());
-        for (int neighbor : unvisitedNeighbors) {
-            neighborVecs.push_back(vectorStore_.getVector(neighbor));
+        VECTORDB_STATS_ADD(hops, 1);
+        VECTORDB_STATS_ADD(visitedNodes, neighbors.size());
+        VECTORDB_STATS_ADD(distanceComputations, neighbors.size());
+        if (neighbors.empty()) continue;
+
+        neighborCodes.resize(neighbors.size() * codeSize);
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            std::memcpy(neighborCodes.data() + i * codeSize,
+                        codes_.data() + static_cast<size_t>(neighbors[i]) * codeSize, codeSize);
         }
-
-        // Compute exact distances in batch - sequential for single queries
-        // Parallelization overhead exceeds benefits for typical neighbor batch sizes
-        std::vector<float> exactDists(unvisitedNeighbors.size());
-        for (size_t j = 0; j < unvisitedNeighbors.size(); j++) {
-            if (neighborVecs[j]) {
-                exactDists[j] = distanceFunc_(query, neighborVecs[j], dimension_);
-            } else {
-                exactDists[j] = std::numeric_limits<float>::max();
-            }
-        }
-
-        // Process results with exact distances
-        for (size_t j = 0; j < unvisitedNeighbors.size(); j++) {
-            float d = exactDists[j];
-            int neighbor = unvisitedNeighbors[j];
-
-            // Add to candidates and best results
-            candidates.emplace(d, neighbor);
-            bestResults.emplace(d, neighbor);
-
-            // Keep only top candidatePoolSize results
-            if (bestResults.size() > static_cast<size_t>(candidatePoolSize)) {
-                bestResults.pop();
-            }
-
-            // Update lower bound for early termination check
-            if (!bestResults.empty()) {
-                lowerBound = bestResults.top().first;
+        adcDistances.resize(neighbors.size());
+        adcBatchFunc_(table, neighborCodes.data(), static_cast<int>(neighbors.size()),
+                      config_.pqM, nCentroids_, adcDistances.data());
+
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            const float d = adcDistances[i] + adcOffset;
+            if (!bestResults.full() || d < lowerBound) {
+                candidates.push({d, neighbors[i]});
+                bestResults.push({d, neighbors[i]});
+                if (bestResults.full()) lowerBound = bestResults.top().first;
             }
         }
     }
 
-    // Refine with exact distance for top results
-    std::vector<DistIdPair> finalResults;
-    while (!bestResults.empty()) {
-        finalResults.push_back(bestResults.top());
-        bestResults.pop();
+    // PQ-only files have nothing to rerank against
+    if (!vectorStore_.hasVectors()) {
+        writeResults(bestResults.sortAscending());
+        return;
     }
-    std::reverse(finalResults.begin(), finalResults.end());
-
-    // Re-rank top candidates with exact distance (refine step)
-    // Take more candidates than k and re-rank with exact distance
-    const int refineFactor = 20; // Take 20x k candidates for refinement
-    int nRefine = std::min(static_cast<int>(finalResults.size()), k * refineFactor);
 
-    if (nRefine > 0) {
-        // Recompute exact distances for top candidates
-        std::vector<DistIdPair> refinedResults;
-        refinedResults.reserve(nRefine);
-
-        for (int i = 0; i < nRefine; i++) {
-            int nodeId = finalResults[i].second;
-            float exactDist = computeExactDistanceToQuery(query, nodeId);
-            refinedResults.emplace_back(exactDist, nodeId);
+    // Phase 2: exact rerank in ADC order. Once k exact results are held, a candidate whose ADC
+    // distance is beyond the k-th exact distance by more than the margin is unlikely to enter,
+    // so well-separated queries stop early and hard ones use the whole budget
+    const std::vector<DistIdPair>& approximate = bestResults.sortAscending();
+    std::vector<DistIdPair>& pool = context.output;
+    pool.assign(approximate.begin(),
+                approximate.begin() + std::min(rerankLimit, static_cast<int>(approximate.size())));
+    bestResults.reset(k);
+    for (const DistIdPair& candidate : pool) {
+        if (config_.rerankMargin >= 0 && bestResults.full()) {
+            const float kth = bestResults.top().first;
+            if (candidate.first > kth + config_.rerankMargin * std::fabs(kth)) break;
         }
+        VECTORDB_STATS_ADD(distanceComputations, 1);
+        bestResults.push({computeExactDistanceToQuery(query, candidate.second), candidate.second});
+    }
+    writeResults(bestResults.sortAscending());
+}
 
-        // Sort by exact distance
-        std::sort(refinedResults.begin(), refinedResults.end());
-
-        // Take top k
-        finalResults = std::move(refinedResults);
-        if (finalResults.size() > static_cast<size_t>(k)) {
-            finalResults.resize(k);
+void HNSWPQIndex::searchDisk(const float* query, const float* table, int k, int entry, float entryDist,
+                             int* resultIds, float* resultDistances, int* resultCount) {
+    // DiskANN-style beam search: the candidate list is ordered by ADC distance from the codes in
+    // memory; each step expands the best W unexpanded candidates, fetching their blocks in one
+    // batch. A fetched block carries the node's full vector, so exact distances come for free and
+    // the result heap needs no second rerank pass
+    struct Candidate {
+        float distance;
+        int node;
+        bool expanded;
+    };
+    thread_local std::vector<Candidate> list;
+    thread_local std::vector<int> expanding;
+    thread_local std::vector<uint64_t> groups;
+    thread_local std::vector<BlockReader::Request> requests;
+    thread_local std::vector<uint8_t, AlignedAllocator<uint8_t, INDEX_FILE_PAGE_SIZE>> buffer;
+
+    SearchContext& context = SearchContext::local();
+    const float adcOffset = config_.metric == Metric::COSINE ? 1.0f : 0.0f;
+    const size_t listSize = static_cast<size_t>(
+        std::max(config_.efSearch, k * std::max(1, config_.rerankFactor)));
+    const int beamWidth = std::max(1, config_.diskBeamWidth);
+    const size_t groupBytes = static_cast<size_t>(diskLayout_.blocksPerNode) * INDEX_FILE_PAGE_SIZE;
+    const size_t codeSize = config_.pqM;
+
+    auto visited = visitedPool_.acquire(maxElements_);
+    visited->markVisited(entry);
+    list.assign(1, Candidate{entryDist, entry, false});
+    BoundedMaxHeap<DistIdPair>& bestResults = context.results;
+    bestResults.reset(k);
+
+    std::vector<int>& neighbors = context.neighbors;
+    std::vector<uint8_t>& neighborCodes = context.codes;
+    std::vector<float>& adcDistances = context.distances;
+    for (;;) {
+        expanding.clear();
+        for (Candidate& candidate : list) {
+            if (candidate.expanded) continue;
+            candidate.expanded = true;
+            expanding.push_back(candidate.node);
+            if (static_cast<int>(expanding.size()) == beamWidth) break;
+        }
+        if (expanding.empty()) break;
+
+        // Beam nodes placed next to each other by optimize() often share a block
+        groups.clear();
+        for (int node : expanding) groups.push_back(node / diskLayout_.nodesPerBlock);
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+        if (buffer.size() < groups.size() * groupBytes) buffer.resize(groups.size() * groupBytes);
+        requests.resize(groups.size());
+        for (size_t g = 0; g < groups.size(); g++) {
+            requests[g].offset = diskLayout_.blocksOffset + groups[g] * groupBytes;
+            requests[g].length = static_cast<uint32_t>(groupBytes);
+            requests[g].buffer = buffer.data() + g * groupBytes;
+        }
+        diskReader_->read(requests.data(), static_cast<int>(requests.size()));
+        VECTORDB_STATS_ADD(hops, expanding.size());
+
+        for (int node : expanding) {
+            const uint64_t group = node / diskLayout_.nodesPerBlock;
+            const size_t g = std::lower_bound(groups.begin(), groups.end(), group) - groups.begin();
+            const uint8_t* slot = buffer.data() + g * groupBytes +
+                                  static_cast<size_t>(node % diskLayout_.nodesPerBlock) * diskLayout_.slotBytes;
+            const auto* vector = reinterpret_cast<const float*>(slot);
+            float normSq;
+            int32_t count;
+            std::memcpy(&normSq, slot + dimension_ * sizeof(float), sizeof(float));
+            std::memcpy(&count, slot + (dimension_ + 1) * sizeof(float), sizeof(int32_t));
+            const auto* links = reinterpret_cast<const int32_t*>(slot + (dimension_ + 2) * sizeof(float));
+            count = std::min<int32_t>(std::max<int32_t>(count, 0), diskLayout_.maxNeighbors);
+
+            // The query is normalized up front for COSINE
+            const float d = exactDistanceFunc_(query, vector, dimension_);
+            bestResults.push({config_.metric == Metric::COSINE ? cosineFromNegDot(d, 1.0f, normSq) : d, node});
+
+            neighbors.clear();
+            const int n = size_.load(std::memory_order_acquire);
+            for (int i = 0; i < count; i++) {
+                if (links[i] >= 0 && links[i] < n && visited->tryVisit(links[i])) {
+                    neighbors.push_back(links[i]);
+                }
+            }
+            VECTORDB_STATS_ADD(visitedNodes, neighbors.size());
+            VECTORDB_STATS_ADD(distanceComputations, neighbors.size() + 1);
+            if (neighbors.empty()) continue;
+
+            neighborCodes.resize(neighbors.size() * codeSize);
+            for (size_t i = 0; i < neighbors.size(); i++) {
+                std::memcpy(neighborCodes.data() + i * codeSize,
+                            codes_.data() + static_cast<size_t>(neighbors[i]) * codeSize, codeSize);
+            }
+            adcDistances.resize(neighbors.size());
+            adcBatchFunc_(table, neighborCodes.data(), static_cast<int>(neighbors.size()),
+                          config_.pqM, nCentroids_, adcDistances.data());
+
+            for (size_t i = 0; i < neighbors.size(); i++) {
+                const Candidate candidate{adcDistances[i] + adcOffset, neighbors[i], false};
+                if (list.size() >= listSize && candidate.distance >= list.back().distance) continue;
+                auto pos = std::upper_bound(list.begin(), list.end(), candidate.distance,
+                                            [](float value, const Candidate& c) { return value < c.distance; });
+                list.insert(pos, candidate);
+                if (list.size() > listSize) list.pop_back();
+            }
         }
     }
 
-    int count = std::min(k, static_cast<int>(finalResults.size()));
+    const std::vector<DistIdPair>& sorted = bestResults.sortAscending();
+    const int count = std::min(k, static_cast<int>(sorted.size()));
     for (int i = 0; i < count; i++) {
-        resultDistances[i] = finalResults[i].first;
-        resultIds[i] = vectorStore_.getId(finalResults[i].second);
+        resultDistances[i] = sorted[i].first;
+        resultIds[i] = vectorStore_.getId(sorted[i].second);
     }
     *resultCount = count;
 }
@@ -673,8 +849,7 @@ std::vector<int> HNSWPQIndex::selectNeighbors(const std::vector<DistIdPair>& can
     return result;
 }
 
-std::vector<int> HNSWPQIndex::selectNeighborsHeuristic(const std::vector<DistIdPair>& candidates,
-                                                       int M, int level) {
+std::vector<int> HNSWPQIndex::selectNeighborsHeuristic(const std::vector<DistIdPair>& candidates, int M) {
     if (candidates.size() <= static_cast<size_t>(M)) {
         std::vector<int> result;
         result.reserve(candidates.size());
@@ -730,12 +905,15 @@ std::vector<int> HNSWPQIndex::selectNeighborsHeuristic(const std::vector<DistIdP
     return result;
 }
 
-void HNSWPQIndex::connectNeighbors(int newId, const std::vector<int>& neighbors, int level) {
+void HNSWPQIndex::connectNeighbors(int newId, const std::vector<int>& neighbors, int level,
+                                   bool useBucketLocks) {
     for (int neighbor : neighbors) {
+        std::unique_lock<std::shared_mutex> bucketLock(getBucketMutex(neighbor), std::defer_lock);
+        if (useBucketLocks) bucketLock.lock();
         addNeighborToLevel(neighbor, level, newId);
 
         // 检查是否需要裁剪
-        if (nodes_[neighbor].levels[level].size > config_.M) {
+        if (getNeighborLevel(neighbor, level).size > config_.M) {
             pruneNeighbors(neighbor, level);
         }
     }
@@ -745,8 +923,8 @@ void HNSWPQIndex::pruneNeighbors(int nodeId, int level) {
     if (nodeId < 0 || nodeId >= static_cast<int>(nodes_.size())) return;
     if (level < 0 || level > nodes_[nodeId].level) return;
 
-    auto& node = nodes_[nodeId];
-    auto& levelInfo = node.levels[level];
+    NeighborLevel& levelInfo = getNeighborLevel(nodeId, level);
+    int* levelNeighbors = getNeighborData(levelInfo);
 
     const float* nodeVec = vectorStore_.getVector(nodeId);
     if (!nodeVec) return;
@@ -757,7 +935,7 @@ void HNSWPQIndex::pruneNeighbors(int nodeId, int level) {
     neighborDists.reserve(levelInfo.size);
 
     for (int i = 0; i < levelInfo.size; i++) {
-        int neighborId = levelInfo.data[i];
+        int neighborId = levelNeighbors[i];
         float d = computeExactDistance(nodeId, neighborId);
         neighborDists.emplace_back(d, neighborId);
     }
@@ -767,54 +945,460 @@ void HNSWPQIndex::pruneNeighbors(int nodeId, int level) {
     // 保留最近的M个邻居
     levelInfo.size = std::min(static_cast<uint16_t>(config_.M), static_cast<uint16_t>(neighborDists.size()));
     for (int i = 0; i < levelInfo.size; i++) {
-        levelInfo.data[i] = neighborDists[i].second;
+        levelNeighbors[i] = neighborDists[i].second;
     }
 }
 
-void HNSWPQIndex::save(const std::string& /*path*/) {
-    // TODO: Implement save
+namespace {
+
+struct HNSWPQFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t entryPoint;
+    int32_t trained;
+    int32_t M;
+    int32_t efConstruction;
+    int32_t efSearch;
+    int32_t maxLevel;
+    double levelMultiplier;
+    int32_t useHeuristicSelection;
+    int32_t pqM;
+    int32_t pqBits;
+    int32_t pqIterations;
+    int32_t subDim;
+    int32_t nCentroids;
+    int32_t hasRawVectors;
+    int32_t metric;
+};
+
+struct HNSWPQDiskMeta {
+    uint32_t blockSize;
+    uint32_t slotBytes;
+    uint32_t nodesPerBlock;
+    uint32_t blocksPerNode;
+    uint32_t maxNeighbors;
+    uint32_t reserved;
+    uint64_t blockCount;
+};
+
+} // namespace
+
+void HNSWPQIndex::save(const std::string& path) {
+    save(path, config_.saveRawVectors);
 }
 
-void HNSWPQIndex::load(const std::string& /*path*/) {
-    // TODO: Implement load
+void HNSWPQIndex::save(const std::string& path, bool includeRawVectors) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (diskReader_) {
+        throw std::runtime_error("HNSWPQ index is disk-resident and read-only");
+    }
+
+    const int n = size_.load(std::memory_order_acquire);
+    if (includeRawVectors && !vectorStore_.hasVectors() && n > 0) {
+        throw std::runtime_error("HNSWPQ index has no raw vectors to save");
+    }
+
+    IndexFileWriter writer(path, IndexType::HNSWPQ, dimension_);
+    writeCommonSections(writer, includeRawVectors, false);
+    writer.finish();
 }
 
-void HNSWPQIndex::searchBatch(const float* queries, int nQueries, int k,
-                              int* resultIds, float* resultDistances) {
-    int nThreads = std::min(4, nQueries);
-    int chunkSize = (nQueries + nThreads - 1) / nThreads;
-
-    std::vector<std::future<void>> futures;
-
-    for (int t = 0; t < nThreads; t++) {
-        int start = t * chunkSize;
-        int end = std::min(start + chunkSize, nQueries);
-        if (start >= end) break;
-
-        futures.push_back(std::async(std::launch::async, [this, queries, k, resultIds, resultDistances, start, end]() {
-            for (int i = start; i < end; i++) {
-                const float* query = queries + static_cast<size_t>(i) * dimension_;
-                int* ids = resultIds + static_cast<size_t>(i) * k;
-                float* dists = resultDistances + static_cast<size_t>(i) * k;
-                int count;
-                search(query, k, ids, dists, &count);
+void HNSWPQIndex::saveDiskResident(const std::string& path) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (diskReader_) {
+        throw std::runtime_error("HNSWPQ index is disk-resident and read-only");
+    }
+
+    const int n = size_.load(std::memory_order_acquire);
+    if (!vectorStore_.hasVectors() && n > 0) {
+        throw std::runtime_error("HNSWPQ index has no raw vectors to save");
+    }
+
+    uint32_t maxNeighbors = 1;
+    for (int i = 0; i < n; i++) {
+        maxNeighbors = std::max<uint32_t>(maxNeighbors, getNeighborLevel(i, 0).size);
+    }
+
+    HNSWPQDiskMeta disk;
+    std::memset(&disk, 0, sizeof(disk));
+    disk.blockSize = static_cast<uint32_t>(INDEX_FILE_PAGE_SIZE);
+    disk.slotBytes = static_cast<uint32_t>((dimension_ + 2 + maxNeighbors) * sizeof(float));
+    if (disk.slotBytes <= disk.blockSize) {
+        disk.nodesPerBlock = disk.blockSize / disk.slotBytes;
+        disk.blocksPerNode = 1;
+    } else {
+        disk.nodesPerBlock = 1;
+        disk.blocksPerNode = (disk.slotBytes + disk.blockSize - 1) / disk.blockSize;
+    }
+    disk.maxNeighbors = maxNeighbors;
+    disk.blockCount = (static_cast<uint64_t>(n) + disk.nodesPerBlock - 1) / disk.nodesPerBlock *
+                      disk.blocksPerNode;
+
+    IndexFileWriter writer(path, IndexType::HNSWPQ, dimension_);
+    writeCommonSections(writer, false, true);
+    writer.writeSection(SectionType::HNSWPQDiskLayout, &disk, sizeof(disk));
+
+    // One group of blocksPerNode blocks per nodesPerBlock nodes, slots zero-padded to the group end
+    const size_t groupBytes = static_cast<size_t>(disk.blocksPerNode) * disk.blockSize;
+    std::vector<uint8_t> group(groupBytes);
+    writer.beginSection(SectionType::HNSWPQDiskBlocks, INDEX_FILE_PAGE_SIZE);
+    for (int first = 0; first < n; first += static_cast<int>(disk.nodesPerBlock)) {
+        std::fill(group.begin(), group.end(), 0);
+        const int last = std::min(n, first + static_cast<int>(disk.nodesPerBlock));
+        for (int i = first; i < last; i++) {
+            uint8_t* slot = group.data() + static_cast<size_t>(i - first) * disk.slotBytes;
+            std::memcpy(slot, vectorStore_.getVector(i), dimension_ * sizeof(float));
+            const float normSq = vectorStore_.getNorm(i);
+            std::memcpy(slot + dimension_ * sizeof(float), &normSq, sizeof(float));
+
+            const NeighborLevel& nl = getNeighborLevel(i, 0);
+            const int32_t count = nl.size;
+            std::memcpy(slot + (dimension_ + 1) * sizeof(float), &count, sizeof(int32_t));
+            std::memcpy(slot + (dimension_ + 2) * sizeof(float), getNeighborData(nl),
+                        nl.size * sizeof(int32_t));
+        }
+        writer.write(group.data(), group.size());
+    }
+    writer.endSection();
+
+    writer.finish();
+}
+
+void HNSWPQIndex::writeCommonSections(IndexFileWriter& writer, bool includeRawVectors,
+                                      bool diskResident) {
+    const int n = size_.load(std::memory_order_acquire);
+
+    HNSWPQFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = n;
+    meta.capacity = maxElements_;
+    meta.entryPoint = entryPoint_.load(std::memory_order_acquire);
+    meta.trained = trained_ ? 1 : 0;
+    meta.M = config_.M;
+    meta.efConstruction = config_.efConstruction;
+    meta.efSearch = config_.efSearch;
+    meta.maxLevel = config_.maxLevel;
+    meta.levelMultiplier = config_.levelMultiplier;
+    meta.useHeuristicSelection = config_.useHeuristicSelection ? 1 : 0;
+    meta.pqM = config_.pqM;
+    meta.pqBits = config_.pqBits;
+    meta.pqIterations = config_.pqIterations;
+    meta.subDim = subDim_;
+    meta.nCentroids = nCentroids_;
+    meta.hasRawVectors = includeRawVectors ? 1 : 0;
+    meta.metric = static_cast<int32_t>(config_.metric);
+    writer.writeSection(SectionType::HNSWPQMeta, &meta, sizeof(meta));
+
+    writer.writeSection(SectionType::PQCodebooks, codebooks_.data(),
+                        codebooks_.size() * sizeof(float));
+    writer.writeSection(SectionType::PQCodes, codes_.data(),
+                        static_cast<size_t>(n) * config_.pqM);
+    writer.writeSection(SectionType::HNSWPQNodes, nodes_.data(),
+                        static_cast<size_t>(n) * sizeof(Node));
+
+    if (!diskResident) {
+        writer.writeSection(SectionType::HNSWPQLevels, levelPool_.data(),
+                            levelPool_.size() * sizeof(NeighborLevel));
+        writer.writeSection(SectionType::HNSWPQNeighborPool, neighborPool_.data(),
+                            neighborPoolUsed_ * sizeof(int));
+    } else {
+        // Level 0 lives in the node blocks: its entries stay (so firstLevel still indexes the
+        // pool) but are emptied, and the pool is compacted down to the upper levels
+        std::vector<NeighborLevel> levels(levelPool_.data(), levelPool_.data() + levelPool_.size());
+        std::vector<int> pool;
+        for (int i = 0; i < n; i++) {
+            NeighborLevel* nodeLevels = levels.data() + nodes_[i].firstLevel;
+            nodeLevels[0] = NeighborLevel{0, 0, 0};
+            for (int l = 1; l <= nodes_[i].level; l++) {
+                const NeighborLevel& src = getNeighborLevel(i, l);
+                const int* data = getNeighborData(src);
+                nodeLevels[l] = NeighborLevel{static_cast<uint32_t>(pool.size()), src.size, src.size};
+                pool.insert(pool.end(), data, data + src.size);
             }
-        }));
+        }
+        writer.writeSection(SectionType::HNSWPQLevels, levels.data(),
+                            levels.size() * sizeof(NeighborLevel));
+        writer.writeSection(SectionType::HNSWPQNeighborPool, pool.data(), pool.size() * sizeof(int));
+    }
+
+    vectorStore_.writeSections(writer, includeRawVectors);
+}
+
+void HNSWPQIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::HNSWPQ);
+    if (file->dimension() != dimension_) {
+        throw std::runtime_error("Index file dimension mismatch");
     }
 
-    for (auto& f : futures) {
-        f.get();
+    const auto* meta = file->sectionAs<HNSWPQFileMeta>(SectionType::HNSWPQMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->pqM <= 0 || meta->subDim * meta->pqM != dimension_ ||
+        meta->nCentroids != (1 << meta->pqBits) || !isValidMetric(meta->metric) ||
+        (n > 0 && (meta->entryPoint < 0 || meta->entryPoint >= n))) {
+        throw std::runtime_error("Corrupted HNSWPQ index file: " + path);
     }
+
+    const size_t codebookCount = static_cast<size_t>(meta->pqM) * meta->nCentroids * meta->subDim;
+    const float* codebooks = file->sectionAs<float>(SectionType::PQCodebooks, codebookCount);
+    uint8_t* codes = file->sectionAs<uint8_t>(SectionType::PQCodes, static_cast<size_t>(n) * meta->pqM);
+    Node* nodes = file->sectionAs<Node>(SectionType::HNSWPQNodes, n);
+    size_t levelCount = file->sectionSize(SectionType::HNSWPQLevels) / sizeof(NeighborLevel);
+    auto* levels = reinterpret_cast<NeighborLevel*>(file->section(SectionType::HNSWPQLevels));
+    size_t poolCount = file->sectionSize(SectionType::HNSWPQNeighborPool) / sizeof(int);
+    auto* pool = reinterpret_cast<int*>(file->section(SectionType::HNSWPQNeighborPool));
+
+    DiskLayout diskLayout;
+    std::unique_ptr<BlockReader> diskReader;
+    if (file->hasSection(SectionType::HNSWPQDiskLayout)) {
+        const auto* disk = file->sectionAs<HNSWPQDiskMeta>(SectionType::HNSWPQDiskLayout, 1);
+        const uint64_t groups = disk->nodesPerBlock == 0 ? 0 :
+            (static_cast<uint64_t>(n) + disk->nodesPerBlock - 1) / disk->nodesPerBlock;
+        if (disk->blockSize != INDEX_FILE_PAGE_SIZE || disk->nodesPerBlock == 0 ||
+            disk->blocksPerNode == 0 || disk->maxNeighbors == 0 ||
+            disk->slotBytes != (dimension_ + 2 + disk->maxNeighbors) * sizeof(float) ||
+            static_cast<uint64_t>(disk->slotBytes) * disk->nodesPerBlock >
+                static_cast<uint64_t>(disk->blocksPerNode) * disk->blockSize ||
+            disk->blockCount != groups * disk->blocksPerNode ||
+            file->sectionSize(SectionType::HNSWPQDiskBlocks) < disk->blockCount * disk->blockSize ||
+            file->sectionOffset(SectionType::HNSWPQDiskBlocks) % INDEX_FILE_PAGE_SIZE != 0) {
+            throw std::runtime_error("Corrupted HNSWPQ disk layout: " + path);
+        }
+        diskLayout.blocksOffset = file->sectionOffset(SectionType::HNSWPQDiskBlocks);
+        diskLayout.slotBytes = disk->slotBytes;
+        diskLayout.nodesPerBlock = disk->nodesPerBlock;
+        diskLayout.blocksPerNode = disk->blocksPerNode;
+        diskLayout.maxNeighbors = disk->maxNeighbors;
+        diskReader = BlockReader::open(path, config_.diskDirectIO);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    config_.M = meta->M;
+    config_.efConstruction = meta->efConstruction;
+    config_.efSearch = meta->efSearch;
+    config_.maxLevel = meta->maxLevel;
+    config_.levelMultiplier = meta->levelMultiplier;
+    config_.useHeuristicSelection = meta->useHeuristicSelection != 0;
+    config_.pqM = meta->pqM;
+    config_.pqBits = meta->pqBits;
+    config_.pqIterations = meta->pqIterations;
+    config_.metric = static_cast<Metric>(meta->metric);
+    exactDistanceFunc_ = getDistanceFunc(config_.metric);
+    subDim_ = meta->subDim;
+    nCentroids_ = meta->nCentroids;
+
+    // Codebooks are tiny and hot, keep a private copy
+    codebooks_.assign(codebooks, codebooks + codebookCount);
+    updateCodebookNorms();
+
+    codes_.attach(codes, static_cast<size_t>(n) * meta->pqM);
+    nodes_.attach(nodes, n);
+    levelPool_.attach(levels, levelCount);
+    neighborPool_.attach(pool, poolCount);
+    neighborPoolUsed_ = poolCount;
+    vectorStore_.attachSections(*file, n);
+    mappedFile_ = std::move(file);
+    diskLayout_ = diskLayout;
+    diskReader_ = std::move(diskReader);
+
+    maxElements_ = std::max(maxElements_, n);
+    trained_ = meta->trained != 0;
+    entryPoint_.store(n > 0 ? meta->entryPoint : -1, std::memory_order_release);
+    size_.store(n, std::memory_order_release);
 }
 
-void HNSWPQIndex::addBatch(const float* vectors, const int* ids, int n) {
+void HNSWPQIndex::detachMapping() {
+    if (!mappedFile_) return;
+    if (!vectorStore_.hasVectors()) {
+        throw std::runtime_error("HNSWPQ index was loaded without raw vectors and is read-only");
+    }
+
+    vectorStore_.detach();
+    codes_.detach();
+    nodes_.detach();
+    levelPool_.detach();
+    neighborPool_.detach();
+    nodes_.reserve(maxElements_);
+    mappedFile_.reset();
+}
+
+void HNSWPQIndex::reorder(GraphOrder order) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    const int n = size_.load(std::memory_order_acquire);
+    if (n == 0 || order == GraphOrder::NONE) return;
+    detachMapping();
+
+    CSRGraph graph;
+    graph.offsets.reserve(static_cast<size_t>(n) + 1);
+    graph.targets.reserve(static_cast<size_t>(n) * config_.M);
     for (int i = 0; i < n; i++) {
-        try {
-            add(ids[i], vectors + static_cast<size_t>(i) * dimension_);
-        } catch (...) {
-            // Skip failed adds
+        const NeighborLevel& nl = getNeighborLevel(i, 0);
+        graph.addNode(getNeighborData(nl), nl.size);
+    }
+    const std::vector<int32_t> newToOld =
+        computeGraphOrder(graph, order, entryPoint_.load(std::memory_order_acquire));
+    std::vector<int32_t> oldToNew(n);
+    for (int i = 0; i < n; i++) oldToNew[newToOld[i]] = i;
+
+    vectorStore_.permute(newToOld);
+
+    const size_t codeSize = static_cast<size_t>(config_.pqM);
+    std::vector<uint8_t> codes(static_cast<size_t>(n) * codeSize);
+    for (int i = 0; i < n; i++) {
+        const uint8_t* code = codes_.data() + static_cast<size_t>(newToOld[i]) * codeSize;
+        std::copy(code, code + codeSize, codes.data() + static_cast<size_t>(i) * codeSize);
+    }
+    std::copy(codes.begin(), codes.end(), codes_.data());
+
+    // Levels and neighbor lists are rewritten in the new node order with the same capacities,
+    // so the pools keep their size and a node's lists sit next to its neighbors' in memory
+    std::vector<Node> nodes(n);
+    std::vector<NeighborLevel> levels;
+    levels.reserve(levelPool_.size());
+    std::vector<int> pool;
+    pool.reserve(neighborPoolUsed_);
+    for (int i = 0; i < n; i++) {
+        const int old = newToOld[i];
+        nodes[i].level = nodes_[old].level;
+        nodes[i].firstLevel = static_cast<uint32_t>(levels.size());
+        for (int l = 0; l <= nodes[i].level; l++) {
+            const NeighborLevel& src = getNeighborLevel(old, l);
+            NeighborLevel dst = src;
+            dst.offset = static_cast<uint32_t>(pool.size());
+            const int* data = getNeighborData(src);
+            for (int j = 0; j < src.size; j++) pool.push_back(oldToNew[data[j]]);
+            pool.resize(pool.size() + (src.capacity - src.size), 0);
+            levels.push_back(dst);
+        }
+    }
+    std::copy(nodes.begin(), nodes.end(), nodes_.data());
+    std::copy(levels.begin(), levels.end(), levelPool_.data());
+    std::copy(pool.begin(), pool.end(), neighborPool_.data());
+    neighborPoolUsed_ = pool.size();
+
+    const int entry = entryPoint_.load(std::memory_order_acquire);
+    if (entry >= 0) entryPoint_.store(oldToNew[entry], std::memory_order_release);
+}
+
+MemoryPolicy HNSWPQIndex::setMemoryPolicy(const MemoryPolicy& policy) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (size_.load(std::memory_order_acquire) > 0 || mappedFile_) {
+        throw std::logic_error("HNSWPQ memory policy must be set before adding vectors");
+    }
+
+    auto allocator = std::make_shared<MemoryAllocator>(policy);
+    vectorStore_.setAllocator(allocator);
+    neighborPool_.setAllocator(PolicyAllocator<int>(allocator));
+    neighborPoolUsed_ = 0;
+    return allocator->effective();
+}
+
+void HNSWPQIndex::searchBatch(const float* queries, int nQueries, int k,
+                              int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    if (nQueries <= 0 || k <= 0) return;
+    if (!trained_ || size_.load() == 0) {
+        std::fill(resultIds, resultIds + static_cast<size_t>(nQueries) * k, -1);
+        std::fill(resultDistances, resultDistances + static_cast<size_t>(nQueries) * k, -1.0f);
+        return;
+    }
+
+    const size_t tableSize = static_cast<size_t>(config_.pqM) * nCentroids_;
+
+    // Tables for a block of queries come from one GEMM per subspace
+    ThreadPool::instance().parallelFor(0, nQueries, 1, [&](int64_t start, int64_t end) {
+        thread_local std::vector<float> block;
+        thread_local std::vector<float> tables;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+
+        for (int64_t first = start; first < end; first += ADC_QUERY_BLOCK) {
+            const int count = static_cast<int>(std::min<int64_t>(ADC_QUERY_BLOCK, end - first));
+            const float* batch = queries + static_cast<size_t>(first) * dimension_;
+            if (config_.metric == Metric::COSINE) {
+                block.resize(static_cast<size_t>(count) * dimension_);
+                for (int q = 0; q < count; q++) {
+                    normalizeVector(batch + static_cast<size_t>(q) * dimension_, dimension_,
+                                    block.data() + static_cast<size_t>(q) * dimension_);
+                }
+                batch = block.data();
+            }
+            tables.resize(count * tableSize);
+            buildADCTables(config_.metric, batch, count, codebooks_.data(), codebookNorms_.data(),
+                           config_.pqM, nCentroids_, subDim_, tables.data());
+
+            for (int q = 0; q < count; q++) {
+                int* ids = resultIds + static_cast<size_t>(first + q) * k;
+                float* dists = resultDistances + static_cast<size_t>(first + q) * k;
+                int found;
+                SearchStatsScope scope(queryStats ? queryStats + first + q : nullptr, queryStats == nullptr);
+                searchWithTable(batch + static_cast<size_t>(q) * dimension_, tables.data() + q * tableSize,
+                                k, ids, dists, &found);
+                for (int j = found; j < k; j++) {
+                    ids[j] = -1;
+                    dists[j] = -1.0f;
+                }
+            }
         }
+    }, numThreads_);
+}
+
+void HNSWPQIndex::addBatch(const float* vectors, const int* ids, int n) {
+    if (n <= 0) return;
+    if (!trained_) {
+        throw std::runtime_error("HNSWPQ index must be trained before adding vectors");
     }
+
+    // Bulk build holds the structural lock exclusively, worker threads coordinate through bucket locks
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    detachMapping();
+
+    const int base = size_.load(std::memory_order_acquire);
+    n = std::min(n, maxElements_ - base);  // vectors beyond capacity are skipped
+    if (n <= 0) return;
+
+    vectorStore_.addBatch(ids, vectors, n);
+    codes_.resize(static_cast<size_t>(base + n) * config_.pqM);
+    encodeBatch(vectors, n, codes_.data() + static_cast<size_t>(base) * config_.pqM);
+
+    // Allocate every node up front so nodes_, levelPool_ and neighborPool_ never move while
+    // workers link; lists hold M + 1 slots and are pruned back to M, so they never grow either
+    for (int i = 0; i < n; i++) {
+        Node node;
+        node.level = getRandomLevel();
+        node.firstLevel = allocateNeighborLevels(node.level);
+        nodes_.push_back(node);
+    }
+
+    int first = 0;
+    if (base == 0) {
+        entryPoint_.store(0, std::memory_order_release);
+        first = 1;
+    }
+
+    // Small chunks keep threads balanced, the visited set is reused across a chunk
+    ThreadPool::instance().parallelFor(first, n, 16, [&](int64_t start, int64_t end) {
+        auto visited = visitedPool_.acquire(maxElements_);
+        for (int64_t i = start; i < end; i++) {
+            const int newIndex = base + static_cast<int>(i);
+            const int newLevel = nodes_[newIndex].level;
+
+            // A node that raises the top level keeps entryMutex_ until it is fully linked
+            std::unique_lock<std::mutex> entryLock(entryMutex_, std::defer_lock);
+            if (newLevel > nodes_[entryPoint_.load(std::memory_order_acquire)].level) {
+                entryLock.lock();
+            }
+
+            std::vector<std::vector<int>> neighborsPerLevel(newLevel + 1);
+            findInsertNeighbors(newIndex, newLevel, *visited, true, neighborsPerLevel);
+            linkNode(newIndex, neighborsPerLevel, true);
+
+            if (entryLock.owns_lock() &&
+                newLevel > nodes_[entryPoint_.load(std::memory_order_acquire)].level) {
+                entryPoint_.store(newIndex, std::memory_order_release);
+            }
+        }
+    }, numThreads_);
+
+    size_.store(base + n, std::memory_order_release);
 }
 
 float* HNSWPQIndex::getCodebookCentroid(int subspaceIdx, int centroidIdx) {
@@ -825,15 +1409,12 @@ float* HNSWPQIndex::getCodebookCentroid(int subspaceIdx, int centroidIdx) {
 size_t HNSWPQIndex::getMemoryUsage() const {
     size_t codebookMem = codebooks_.size() * sizeof(float);
     size_t codesMem = codes_.size() * sizeof(uint8_t);
-    size_t graphMem = 0;
-    for (const auto& node : nodes_) {
-        if (node.levels) {
-            for (int i = 0; i <= node.level; i++) {
-                graphMem += node.levels[i].capacity * sizeof(int);
-            }
-        }
-    }
-    return codebookMem + codesMem + graphMem + vectorStore_.capacity() * dimension_ * sizeof(float);
+    size_t graphMem = nodes_.size() * sizeof(Node) +
+                      levelPool_.size() * sizeof(NeighborLevel) +
+                      neighborPool_.size() * sizeof(int);
+    size_t rawMem = vectorStore_.hasVectors() ?
+                    static_cast<size_t>(vectorStore_.capacity()) * dimension_ * sizeof(float) : 0;
+    return codebookMem + codesMem + graphMem + rawMem;
 }
 
 float HNSWPQIndex::getCompressionRatio() const {
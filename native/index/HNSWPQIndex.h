@@ -1,15 +1,21 @@
 #pragma once
 #include "VectorIndex.h"
 #include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/MappedArray.h"
+#include "../core/VisitedPool.h"
+#include "../core/GraphReorder.h"
+#include "../core/BlockReader.h"
 #include "../compute/DistanceUtils.h"
 #include "../compute/BatchDistance.h"
+#include "../compute/ADCUtils.h"
 #include <vector>
 #include <random>
 #include <queue>
 #include <mutex>
 #include <shared_mutex>
 #include <atomic>
-#include <unordered_set>
+#include <memory>
 
 namespace vectordb {
 
@@ -32,6 +38,29 @@ struct HNSWPQConfig {
     int pqM = 64;          // PQ 子空间数量 (128维/64=2维/子空间，更高精度)
     int pqBits = 8;        // 每个子空间的位数 (256个聚类中心)
     int pqIterations = 25; // KMeans 迭代次数
+
+    // 距离度量: COSINE 时在归一化后的向量上训练和编码，精确距离用预存模长换算
+    Metric metric = Metric::L2;
+
+    // 两阶段搜索: true 时第 0 层按 ADC 距离遍历 (批量查表)，再用原始向量精确重排最好的候选；
+    // false 时第 0 层直接用精确距离遍历
+    bool adcSearch = false;
+    // 精确重排的候选上限为 k * rerankFactor，第 0 层的 ef 不小于该值
+    int rerankFactor = 8;
+    // 自适应重排: 凑满 k 个精确结果后，ADC 距离超出第 k 个精确距离 rerankMargin (相对值) 的候选不再重排；
+    // 小于 0 时总是重排到上限
+    float rerankMargin = 0.5f;
+
+    // 持久化参数
+    bool saveRawVectors = true;  // false 时 save 只写 PQ 编码，文件约为原来的 pqM / (4 * dim)
+
+    // optimize() 使用的节点重排方式
+    GraphOrder graphOrder = GraphOrder::GORDER;
+
+    // 磁盘驻留搜索: 每步同时展开的候选数 (一批并行读取的节点块数上限)
+    int diskBeamWidth = 4;
+    // 磁盘驻留文件以 O_DIRECT 读取节点块，绕过页缓存；文件系统不支持时自动退回普通读取
+    bool diskDirectIO = true;
 };
 
 class HNSWPQIndex : public VectorIndex {
@@ -43,25 +72,62 @@ public:
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
                int* resultCount) override;
+    using VectorIndex::search;  // 带过滤的重载使用基类的放大 k 实现
     void save(const std::string& path) override;
+    void save(const std::string& path, bool includeRawVectors);
     void load(const std::string& path) override;
+    /**
+     * 保存为磁盘驻留格式: PQ 编码、码本与上层图照常写入并在加载后留在内存，
+     * 第 0 层邻居和原始向量按节点写进 4KB 对齐的块，加载后搜索时按需从磁盘读取
+     * 需要原始向量；先调用 optimize() 可让图上相邻的节点落在同一块内
+     */
+    void saveDiskResident(const std::string& path);
     int size() const override { return size_.load(std::memory_order_acquire); }
     int dimension() const override { return dimension_; }
     int capacity() const override { return maxElements_; }
+    // 原始向量与 neighborPool_ 共用同一个分配器
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override;
 
     // 训练 PQ
     void train(int nSamples, const float* samples);
     bool isTrained() const { return trained_; }
 
-    // 批量操作
+    // 批量搜索，结果不足 k 个时以 id = -1、距离 = -1 补齐
     void searchBatch(const float* queries, int nQueries, int k,
-                    int* resultIds, float* resultDistances);
-    void addBatch(const float* vectors, const int* ids, int n);
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+    /**
+     * 批量构建: 一次性写入向量、分块并行编码，再由线程池并行连边
+     * 期间独占结构锁，搜索会被阻塞；超出容量的向量被跳过
+     */
+    void addBatch(const float* vectors, const int* ids, int n) override;
+
+    // 按 config_.graphOrder 重排节点
+    void optimize() override { reorder(config_.graphOrder); }
+    /**
+     * 按 order 给全部节点重新编号: 原始向量、PQ 编码按新顺序搬移，邻居表按新顺序重写进内存池，
+     * 外部 id 不变。期间独占结构锁；PQ-only 文件加载的只读索引会抛出异常
+     */
+    void reorder(GraphOrder order);
 
     // 内存统计
     size_t getMemoryUsage() const;
     float getCompressionRatio() const;
 
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+    // 调整 ADC 搜索 (adcSearch) 第 0 层的 ef，不小于 k * rerankFactor
+    void setEfSearch(int ef) { config_.efSearch = ef > 0 ? ef : 1; }
+    // 是否保留原始向量 (PQ-only 文件加载后为 false，搜索只使用 ADC 距离)
+    bool hasRawVectors() const { return vectorStore_.hasVectors(); }
+    /**
+     * 是否从磁盘驻留格式加载: 第 0 层按 ADC 距离做束搜索，每步一批读取 diskBeamWidth 个候选的节点块，
+     * 用块内的原始向量精确计算距离作为结果；索引只读
+     */
+    bool isDiskResident() const { return diskReader_ != nullptr; }
+
+    ~HNSWPQIndex() override = default;
+
 private:
     int dimension_;
     int maxElements_;
@@ -71,6 +137,7 @@ private:
     std::mt19937 rng_;
     mutable std::shared_mutex mutex_;
     mutable std::vector<std::unique_ptr<std::shared_mutex>> bucketMutexes_;  // 细粒度锁
+    std::mutex entryMutex_;  // 批量构建时，提升最高层的节点持有直到连边完成
     bool trained_ = false;
     static constexpr int NUM_BUCKETS = 64;  // 桶数量，用于细粒度锁
 
@@ -78,52 +145,89 @@ private:
     int subDim_ = 0;
     int nCentroids_ = 0;
     std::vector<float> codebooks_;  // [pqM][nCentroids][subDim]
-    std::vector<uint8_t> codes_;    // [nVectors][pqM]
+    std::vector<float> codebookNorms_;  // [pqM][nCentroids] 中心模长平方，GEMM 建表用
+    MappedArray<uint8_t> codes_;    // [nVectors][pqM]
 
     // 内存池优化的邻居存储
+    // 所有结构都是 POD 且只保存偏移，可整块写盘并在 mmap 后原样使用
     struct NeighborLevel {
-        int* data;           // 邻居ID数组（内存池分配）
+        uint32_t offset;     // 邻居ID数组在 neighborPool_ 中的起始位置
         uint16_t size;       // 当前邻居数量
         uint16_t capacity;   // 容量
     };
 
     struct Node {
-        int level;
-        NeighborLevel* levels;  // 每层邻居数组（内存池分配）
+        int32_t level;
+        uint32_t firstLevel;  // 第 0 层在 levelPool_ 中的下标，各层连续存放
     };
-    std::vector<Node> nodes_;
+    MappedArray<Node> nodes_;
+    MappedArray<NeighborLevel> levelPool_;
 
     // 内存池
-    std::vector<int> neighborPool_;       // 邻居ID内存池
+    MappedArray<int, PolicyAllocator<int>> neighborPool_;  // 邻居ID内存池
     size_t neighborPoolUsed_ = 0;         // 已使用大小
     static constexpr size_t NEIGHBOR_POOL_BLOCK_SIZE = 1024;  // 每次扩容大小
 
+    // mmap 加载的文件，生命周期覆盖所有挂载的数组
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+
+    // 磁盘驻留格式: 节点 i 的槽位于第 (i / nodesPerBlock) * blocksPerNode 块，
+    // 块内偏移 (i % nodesPerBlock) * slotBytes；大槽 (高维向量) 独占 blocksPerNode 个连续块
+    struct DiskLayout {
+        uint64_t blocksOffset = 0;  // HNSWPQDiskBlocks 在文件中的偏移
+        uint32_t slotBytes = 0;
+        uint32_t nodesPerBlock = 0;
+        uint32_t blocksPerNode = 0;
+        uint32_t maxNeighbors = 0;
+    };
+    DiskLayout diskLayout_;
+    std::unique_ptr<BlockReader> diskReader_;
+
     // 原始向量存储 (可选，用于 refine)
     VectorStore vectorStore_;
 
-    // 距离函数
+    // 距离函数: distanceFunc_ 固定为 L2，用于码本训练和编码；exactDistanceFunc_ 按度量选择
     DistanceFunc distanceFunc_;
+    DistanceFunc exactDistanceFunc_;
     BatchDistanceFunc batchDistFunc_;
+    ADCDistanceBatchFunc adcBatchFunc_;
 
-    // 线程局部存储
-    mutable std::vector<std::unordered_set<int>> threadVisited_;
+    // 搜索时借出的访问标记表
+    mutable VisitedPool visitedPool_;
 
     // 内部方法
     int getRandomLevel();
     void encode(const float* vector, uint8_t* codes);
+    void encodeBatch(const float* vectors, int n, uint8_t* codes);
     float computeDistancePQ(const float* query, int nodeId);
     float computeExactDistance(int idA, int idB);
     float computeExactDistanceToQuery(const float* query, int nodeId);
+    void updateCodebookNorms();
+
+    // 用已建好的 ADC 距离表搜索，调用方持有 mutex_ 的共享锁；query 已按度量预处理
+    void searchWithTable(const float* query, const float* table, int k,
+                         int* resultIds, float* resultDistances, int* resultCount);
+
+    // searchWithTable 在磁盘驻留格式下的第 0 层，entry 为上层下降的终点
+    void searchDisk(const float* query, const float* table, int k, int entry, float entryDist,
+                    int* resultIds, float* resultDistances, int* resultCount);
 
     void searchLevel(const float* query, const uint8_t* queryCodes,
                      int entryPoint, int ef, int level,
                      std::vector<std::pair<float, int>>& results);
 
     std::vector<int> selectNeighbors(const std::vector<std::pair<float, int>>& candidates, int M);
-    std::vector<int> selectNeighborsHeuristic(const std::vector<std::pair<float, int>>& candidates,
-                                              int M, int level);
+    std::vector<int> selectNeighborsHeuristic(const std::vector<std::pair<float, int>>& candidates, int M);
+
+    // 插入的两个阶段；useBucketLocks 为 true 时按节点所在桶加锁，供批量构建的并行连边使用
+    void findInsertNeighbors(int newIndex, int newLevel, VisitedTable& visited, bool useBucketLocks,
+                             std::vector<std::vector<int>>& neighborsPerLevel);
+    void linkNode(int newIndex, const std::vector<std::vector<int>>& neighborsPerLevel,
+                  bool useBucketLocks);
+    void copyNeighbors(int nodeId, int level, bool useBucketLocks, std::vector<int>& out);
 
-    void connectNeighbors(int newId, const std::vector<int>& neighbors, int level);
+    void connectNeighbors(int newId, const std::vector<int>& neighbors, int level,
+                          bool useBucketLocks);
     void pruneNeighbors(int nodeId, int level);
 
     // 锁优化辅助函数
@@ -132,7 +236,15 @@ private:
     void unlockBuckets(const std::vector<int>& nodeIds);
 
     // 内存池辅助函数
-    NeighborLevel* allocateNeighborLevels(int levelCount);
+    NeighborLevel& getNeighborLevel(int nodeId, int level) {
+        return levelPool_[nodes_[nodeId].firstLevel + level];
+    }
+    int* getNeighborData(const NeighborLevel& nl) { return neighborPool_.data() + nl.offset; }
+    uint32_t allocateNeighborLevels(int levelCount);
+    uint32_t allocateNeighborSlots(int count);
+    void detachMapping();
+    // 写出通用的 Section；diskResident 时第 0 层邻居不写入 HNSWPQNeighborPool
+    void writeCommonSections(IndexFileWriter& writer, bool includeRawVectors, bool diskResident);
     void addNeighborToLevel(int nodeId, int level, int neighborId);
     void clearNeighborLevel(int nodeId, int level);
     void reserveNeighborPool(size_t totalNeighbors);
@@ -1,21 +1,44 @@
 #include "IVFIndex.h"
+#include "../compute/BatchDistance.h"
+#include "../compute/KMeans.h"
+#include "../core/ThreadPool.h"
 #include <stdexcept>
-#include <random>
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <cstring>
 
 namespace vectordb {
 
+namespace {
+
+// Queries grouped per batch, and the upper bound on one [group][listRows] GEMM tile in floats
+constexpr int IVF_QUERY_BLOCK = 1024;
+constexpr size_t IVF_GEMM_TILE_FLOATS = size_t(1) << 20;
+// Slack on the triangle-inequality test of rangeSearch, so rounding never prunes a list with a hit
+constexpr float RANGE_PRUNE_SLACK = 1e-4f;
+
+} // namespace
+
 IVFIndex::IVFIndex(int dimension, int maxElements)
     : IVFIndex(dimension, maxElements, IVFConfig{}) {}
 
 IVFIndex::IVFIndex(int dimension, int maxElements, const IVFConfig& config)
-    : vectorStore_(dimension, maxElements), config_(config) {
-    distanceFunc_ = getEuclideanDistanceFunc();
+    : dimension_(dimension), maxElements_(maxElements), config_(config) {
+    if (dimension <= 0) {
+        throw std::invalid_argument("Dimension must be positive");
+    }
+    if (maxElements <= 0) {
+        throw std::invalid_argument("MaxElements must be positive");
+    }
+    if (config.nLists <= 0) {
+        throw std::invalid_argument("nLists must be positive");
+    }
+    centroidDistanceFunc_ = getEuclideanDistanceFunc();
     centroids_.resize(static_cast<size_t>(config.nLists) * dimension);
-    invertedLists_.resize(config.nLists);
-    idToList_.resize(maxElements, -1);
+    centroidNorms_.resize(config.nLists);
+    listRadii_.resize(config.nLists);
+    lists_.resize(config.nLists);
 }
 
 void IVFIndex::train(int nSamples, const float* samples) {
@@ -23,60 +46,28 @@ void IVFIndex::train(int nSamples, const float* samples) {
         throw std::invalid_argument("Invalid training samples");
     }
 
-    const int dim = vectorStore_.dimension();
+    const int dim = dimension_;
     const int nLists = config_.nLists;
 
-    std::mt19937 rng(42);
-    std::uniform_int_distribution<int> dist(0, nSamples - 1);
-
-    for (int i = 0; i < nLists; i++) {
-        int sampleIdx = dist(rng);
-        std::copy(samples + static_cast<size_t>(sampleIdx) * dim,
-                  samples + static_cast<size_t>(sampleIdx + 1) * dim,
-                  centroids_.begin() + static_cast<size_t>(i) * dim);
-    }
-
-    std::vector<int> assignments(nSamples);
-    std::vector<int> clusterSizes(nLists);
-
-    for (int iter = 0; iter < config_.maxIterations; iter++) {
-        bool changed = false;
+    std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(static_cast<size_t>(nSamples) * dim);
         for (int i = 0; i < nSamples; i++) {
-            const float* sample = samples + static_cast<size_t>(i) * dim;
-            int nearest = findNearestCentroid(sample);
-            if (assignments[i] != nearest) {
-                assignments[i] = nearest;
-                changed = true;
-            }
-        }
-
-        if (!changed) break;
-
-        std::fill(centroids_.begin(), centroids_.end(), 0.0f);
-        std::fill(clusterSizes.begin(), clusterSizes.end(), 0);
-
-        for (int i = 0; i < nSamples; i++) {
-            int cluster = assignments[i];
-            float* centroid = centroids_.data() + static_cast<size_t>(cluster) * dim;
-            const float* sample = samples + static_cast<size_t>(i) * dim;
-
-            for (int d = 0; d < dim; d++) {
-                centroid[d] += sample[d];
-            }
-            clusterSizes[cluster]++;
-        }
-
-        for (int i = 0; i < nLists; i++) {
-            if (clusterSizes[i] > 0) {
-                float* centroid = centroids_.data() + static_cast<size_t>(i) * dim;
-                float invSize = 1.0f / clusterSizes[i];
-                for (int d = 0; d < dim; d++) {
-                    centroid[d] *= invSize;
-                }
-            }
+            normalizeVector(samples + static_cast<size_t>(i) * dim, dim,
+                            normalized.data() + static_cast<size_t>(i) * dim);
         }
+        samples = normalized.data();
     }
 
+    KMeansConfig kmeans;
+    kmeans.k = nLists;
+    kmeans.maxIterations = config_.maxIterations;
+    kmeans.maxPointsPerCentroid = config_.maxPointsPerCentroid;
+    kmeans.batchSize = config_.kmeansBatchSize;
+    trainKMeans(samples, nSamples, dim, kmeans, centroids_.data());
+
+    updateCentroidNorms();
+    computeListRadii();
     trained_ = true;
 }
 
@@ -84,22 +75,72 @@ void IVFIndex::add(int id, const float* vector) {
     if (!trained_) {
         throw std::runtime_error("IVF index must be trained before adding vectors");
     }
+    if (size_ >= maxElements_) {
+        throw std::runtime_error("IVF index is full");
+    }
 
-    int index = vectorStore_.size();
-    int listId = findNearestCentroid(vector);
+    detachMapping();
 
-    vectorStore_.add(id, vector);
-    invertedLists_[listId].push_back(index);
-    idToList_[index] = listId;
+    std::vector<float> normalized;
+    float centroidDist;
+    int listId = findNearestCentroid(prepareVector(vector, normalized), &centroidDist);
+    listRadii_[listId] = std::max(listRadii_[listId], std::sqrt(centroidDist));
+
+    InvertedList& list = lists_[listId];
+    locations_[id] = {listId, static_cast<int>(list.ids.size())};
+    list.vectors.append(vector, dimension_);
+    list.ids.push_back(id);
+    list.norms.push_back(computeNorm(vector, dimension_));
     size_++;
 }
 
+bool IVFIndex::remove(int id) {
+    auto it = locations_.find(id);
+    if (it == locations_.end()) return false;
+    const int listId = it->second.first;
+    const size_t pos = static_cast<size_t>(it->second.second);
+    locations_.erase(it);
+
+    detachMapping();
+
+    // Move the list's last entry into the hole, order within a list carries no meaning
+    InvertedList& list = lists_[listId];
+    const size_t last = list.ids.size() - 1;
+    if (pos != last) {
+        std::copy(list.vectors.data() + last * dimension_, list.vectors.data() + (last + 1) * dimension_,
+                  list.vectors.data() + pos * dimension_);
+        list.ids[pos] = list.ids[last];
+        list.norms[pos] = list.norms[last];
+
+        auto moved = locations_.find(list.ids[pos]);
+        if (moved != locations_.end() && moved->second == std::make_pair(listId, static_cast<int>(last))) {
+            moved->second.second = static_cast<int>(pos);
+        }
+    }
+    list.vectors.resize(last * dimension_);
+    list.ids.resize(last);
+    list.norms.resize(last);
+    size_--;
+    return true;
+}
+
+void IVFIndex::rebuildLocations() {
+    locations_.clear();
+    locations_.reserve(size_);
+    for (int l = 0; l < static_cast<int>(lists_.size()); l++) {
+        const InvertedList& list = lists_[l];
+        for (size_t i = 0; i < list.ids.size(); i++) {
+            locations_[list.ids[i]] = {l, static_cast<int>(i)};
+        }
+    }
+}
+
 void IVFIndex::addBatch(const float* vectors, const int* ids, int n) {
     if (!trained_) {
         throw std::runtime_error("IVF index must be trained before adding vectors");
     }
 
-    const int dim = vectorStore_.dimension();
+    const int dim = dimension_;
 
     for (int i = 0; i < n; i++) {
         const float* vec = vectors + static_cast<size_t>(i) * dim;
@@ -109,72 +150,478 @@ void IVFIndex::addBatch(const float* vectors, const int* ids, int n) {
 
 void IVFIndex::search(const float* query, int k,
                      int* resultIds, float* resultDistances,
-                     int* resultCount) {
-    if (!trained_) {
+                     int* resultCount, const IDFilter* filter) {
+    if (!trained_ || k <= 0) {
         *resultCount = 0;
         return;
     }
 
-    const int dim = vectorStore_.dimension();
+    SearchStatsScope scope;
+    std::vector<float> normalized;
+    query = prepareVector(query, normalized);
+
+    const int nProbes = std::min(config_.nProbes, config_.nLists);
+    VECTORDB_STATS_ADD(distanceComputations, config_.nLists);
+    std::vector<float> centroidDists(config_.nLists);
+    batchEuclideanDistance(query, centroids_.data(), centroidNorms_.data(),
+                           config_.nLists, dimension_, centroidDists.data());
 
-    std::vector<std::pair<float, int>> centroidDists;
+    std::vector<std::pair<float, int>> probes(config_.nLists);
     for (int i = 0; i < config_.nLists; i++) {
-        float dist = distanceFunc_(query, centroids_.data() + static_cast<size_t>(i) * dim, dim);
-        centroidDists.emplace_back(dist, i);
+        probes[i] = {centroidDists[i], i};
+    }
+    // A filter may leave the nearest lists short of k hits, so keep every list in probe order
+    const int sorted = filter ? config_.nLists : nProbes;
+    std::partial_sort(probes.begin(), probes.begin() + sorted, probes.end());
+
+    // Max-heap of (distance, id) holding the best k so far
+    std::vector<std::pair<float, int>> heap;
+    heap.reserve(k + 1);
+    for (int p = 0; p < sorted; p++) {
+        if (p >= nProbes && static_cast<int>(heap.size()) >= k) break;
+        scanList(lists_[probes[p].second], query, heap, k, filter);
     }
 
-    std::partial_sort(centroidDists.begin(),
-                      centroidDists.begin() + config_.nProbes,
-                      centroidDists.end());
+    std::sort_heap(heap.begin(), heap.end());
+    const int count = static_cast<int>(heap.size());
+    for (int i = 0; i < count; i++) {
+        resultDistances[i] = heap[i].first;
+        resultIds[i] = heap[i].second;
+    }
+    *resultCount = count;
+}
 
-    std::vector<std::pair<float, int>> candidates;
-    candidates.reserve(k * 10);
+void IVFIndex::scanList(const InvertedList& list, const float* query,
+                        std::vector<std::pair<float, int>>& heap, int k,
+                        const IDFilter* filter) const {
+    const size_t listSize = list.ids.size();
+    if (listSize == 0) return;
+
+    VECTORDB_STATS_ADD(hops, 1);
+    VECTORDB_STATS_ADD(visitedNodes, listSize);
+    VECTORDB_STATS_ADD(distanceComputations, listSize);
+    thread_local std::vector<float> dists;
+    dists.resize(listSize);
+    listDistances(list, query, dists.data());
+
+    for (size_t i = 0; i < listSize; i++) {
+        if (filter && !filter->contains(list.ids[i])) continue;
+        const float dist = dists[i];
+        if (static_cast<int>(heap.size()) < k) {
+            heap.emplace_back(dist, list.ids[i]);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (dist < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = {dist, list.ids[i]};
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+}
 
-    for (int p = 0; p < config_.nProbes && p < config_.nLists; p++) {
-        int listId = centroidDists[p].second;
-        const auto& list = invertedLists_[listId];
+void IVFIndex::listDistances(const InvertedList& list, const float* query, float* dists) const {
+    const size_t listSize = list.ids.size();
+    if (config_.metric == Metric::L2) {
+        batchEuclideanDistance(query, list.vectors.data(), list.norms.data(),
+                               listSize, dimension_, dists);
+    } else {
+        batchInnerProduct(query, list.vectors.data(), listSize, dimension_, dists);
+        for (size_t i = 0; i < listSize; i++) {
+            dists[i] = config_.metric == Metric::COSINE
+                ? cosineFromNegDot(-dists[i], 1.0f, list.norms[i])
+                : -dists[i];
+        }
+    }
+}
 
-        for (int idx : list) {
-            const float* vec = vectorStore_.getVector(idx);
-            float dist = distanceFunc_(query, vec, dim);
-            candidates.emplace_back(dist, vectorStore_.getId(idx));
+void IVFIndex::rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                           const IDFilter* filter) {
+    result.clear();
+    if (!trained_ || size_ == 0) return;
+
+    SearchStatsScope scope;
+    std::vector<float> normalized;
+    query = prepareVector(query, normalized);
+
+    // Every list member lies within listRadii_ of its centroid in the clustering (L2) space, so by
+    // the triangle inequality a list whose centroid is farther than radius + listRadius holds no hit.
+    // Inner product is not a metric and scans every list
+    float bound = -1.0f;
+    if (config_.metric == Metric::L2) {
+        bound = std::sqrt(std::max(radius, 0.0f));
+    } else if (config_.metric == Metric::COSINE) {
+        // Between unit vectors |q - x|^2 = 2 * (1 - cos)
+        bound = std::sqrt(std::max(2.0f * radius, 0.0f));
+    }
+
+    std::vector<float> centroidDists(config_.nLists);
+    if (bound >= 0.0f) {
+        batchEuclideanDistance(query, centroids_.data(), centroidNorms_.data(),
+                               config_.nLists, dimension_, centroidDists.data());
+        VECTORDB_STATS_ADD(distanceComputations, config_.nLists);
+    }
+
+    thread_local std::vector<float> dists;
+    for (int l = 0; l < config_.nLists; l++) {
+        const InvertedList& list = lists_[l];
+        const size_t listSize = list.ids.size();
+        if (listSize == 0) continue;
+        if (bound >= 0.0f) {
+            const float reach = bound + listRadii_[l];
+            // Relative slack absorbs the rounding of the expanded-form distances
+            if (std::sqrt(centroidDists[l]) > reach * (1.0f + RANGE_PRUNE_SLACK) + RANGE_PRUNE_SLACK) continue;
+        }
+
+        VECTORDB_STATS_ADD(hops, 1);
+        VECTORDB_STATS_ADD(visitedNodes, listSize);
+        VECTORDB_STATS_ADD(distanceComputations, listSize);
+        dists.resize(listSize);
+        listDistances(list, query, dists.data());
+        for (size_t i = 0; i < listSize; i++) {
+            if (dists[i] > radius) continue;
+            if (filter && !filter->contains(list.ids[i])) continue;
+            result.push(list.ids[i], dists[i]);
         }
     }
+    result.sort();
+}
 
-    if (candidates.size() > static_cast<size_t>(k)) {
-        std::partial_sort(candidates.begin(),
-                          candidates.begin() + k,
-                          candidates.end());
-        candidates.resize(k);
-    } else {
-        std::sort(candidates.begin(), candidates.end());
+void IVFIndex::searchBatch(const float* queries, int nQueries, int k,
+                          int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    if (nQueries <= 0 || k <= 0) return;
+    if (!trained_) {
+        std::fill(resultIds, resultIds + static_cast<size_t>(nQueries) * k, -1);
+        std::fill(resultDistances, resultDistances + static_cast<size_t>(nQueries) * k, -1.0f);
+        return;
     }
 
-    int count = std::min(k, static_cast<int>(candidates.size()));
-    for (int i = 0; i < count; i++) {
-        resultDistances[i] = candidates[i].first;
-        resultIds[i] = candidates[i].second;
+    const int dim = dimension_;
+
+    // Larger blocks share more list scans per GEMM, so tasks are whole blocks
+    ThreadPool::instance().parallelFor(0, nQueries, IVF_QUERY_BLOCK, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i += IVF_QUERY_BLOCK) {
+            const int count = static_cast<int>(std::min<int64_t>(IVF_QUERY_BLOCK, end - i));
+            // Every query of a block finishes with the block's GEMM, so each one reports the block's time
+            SearchStats blockStats;
+            {
+                SearchStatsScope scope(queryStats ? &blockStats : nullptr, false);
+                searchBlock(queries + static_cast<size_t>(i) * dim, count, k,
+                            resultIds + static_cast<size_t>(i) * k, resultDistances + static_cast<size_t>(i) * k);
+            }
+            if (queryStats) std::fill_n(queryStats + i, count, blockStats);
+        }
+    }, numThreads_);
+}
+
+void IVFIndex::searchBlock(const float* queries, int nQueries, int k,
+                           int* resultIds, float* resultDistances) const {
+    const int dim = dimension_;
+    const int nLists = config_.nLists;
+    const int nProbes = std::min(config_.nProbes, nLists);
+
+    std::vector<float> block(static_cast<size_t>(nQueries) * dim);
+    std::vector<float> queryNorms(nQueries);
+    for (int q = 0; q < nQueries; q++) {
+        const float* query = queries + static_cast<size_t>(q) * dim;
+        float* row = block.data() + static_cast<size_t>(q) * dim;
+        if (config_.metric == Metric::COSINE) {
+            normalizeVector(query, dim, row);
+        } else {
+            std::copy(query, query + dim, row);
+        }
+    }
+    computeRowNormsSquared(block.data(), nQueries, dim, queryNorms.data());
+
+    // Coarse step: one GEMM against all centroids, then the nProbes closest per query
+    std::vector<float> coarse(static_cast<size_t>(nQueries) * nLists);
+    matrixMultiply(block.data(), centroids_.data(), coarse.data(), nQueries, nLists, dim);
+
+    std::vector<int> listCounts(nLists + 1, 0);
+    std::vector<int> probes(static_cast<size_t>(nQueries) * nProbes);
+    std::vector<std::pair<float, int>> order(nLists);
+    for (int q = 0; q < nQueries; q++) {
+        const float* row = coarse.data() + static_cast<size_t>(q) * nLists;
+        for (int l = 0; l < nLists; l++) {
+            order[l] = {distanceFromDot(Metric::L2, row[l], queryNorms[q], centroidNorms_[l]), l};
+        }
+        std::partial_sort(order.begin(), order.begin() + nProbes, order.end());
+        for (int p = 0; p < nProbes; p++) {
+            probes[static_cast<size_t>(q) * nProbes + p] = order[p].second;
+            listCounts[order[p].second + 1]++;
+        }
+    }
+
+    // Group queries by probed list (CSR)
+    for (int l = 0; l < nLists; l++) {
+        listCounts[l + 1] += listCounts[l];
+    }
+    std::vector<int> listQueries(listCounts[nLists]);
+    std::vector<int> fill(listCounts.begin(), listCounts.end() - 1);
+    for (int q = 0; q < nQueries; q++) {
+        for (int p = 0; p < nProbes; p++) {
+            listQueries[fill[probes[static_cast<size_t>(q) * nProbes + p]]++] = q;
+        }
+    }
+
+    std::vector<std::vector<std::pair<float, int>>> heaps(nQueries);
+    for (auto& heap : heaps) {
+        heap.reserve(k + 1);
+    }
+
+    std::vector<float> group;
+    std::vector<float> dots;
+    for (int l = 0; l < nLists; l++) {
+        const InvertedList& list = lists_[l];
+        const int listSize = static_cast<int>(list.ids.size());
+        const int groupSize = listCounts[l + 1] - listCounts[l];
+        if (listSize == 0 || groupSize == 0) continue;
+        const int* members = listQueries.data() + listCounts[l];
+
+        group.resize(static_cast<size_t>(groupSize) * dim);
+        for (int g = 0; g < groupSize; g++) {
+            const float* row = block.data() + static_cast<size_t>(members[g]) * dim;
+            std::copy(row, row + dim, group.data() + static_cast<size_t>(g) * dim);
+        }
+
+        const int tileRows = static_cast<int>(std::min<size_t>(
+            listSize, std::max<size_t>(1, IVF_GEMM_TILE_FLOATS / groupSize)));
+        dots.resize(static_cast<size_t>(groupSize) * tileRows);
+        for (int start = 0; start < listSize; start += tileRows) {
+            const int rows = std::min(tileRows, listSize - start);
+            matrixMultiply(group.data(), list.vectors.data() + static_cast<size_t>(start) * dim,
+                           dots.data(), groupSize, rows, dim);
+
+            for (int g = 0; g < groupSize; g++) {
+                const int q = members[g];
+                auto& heap = heaps[q];
+                const float* row = dots.data() + static_cast<size_t>(g) * rows;
+                for (int j = 0; j < rows; j++) {
+                    const float dist = distanceFromDot(config_.metric, row[j], queryNorms[q],
+                                                       list.norms[start + j]);
+                    if (static_cast<int>(heap.size()) < k) {
+                        heap.emplace_back(dist, list.ids[start + j]);
+                        std::push_heap(heap.begin(), heap.end());
+                    } else if (dist < heap.front().first) {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.back() = {dist, list.ids[start + j]};
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+            }
+        }
+    }
+
+    for (int q = 0; q < nQueries; q++) {
+        auto& heap = heaps[q];
+        std::sort_heap(heap.begin(), heap.end());
+        int* ids = resultIds + static_cast<size_t>(q) * k;
+        float* dists = resultDistances + static_cast<size_t>(q) * k;
+        const int count = static_cast<int>(heap.size());
+        for (int i = 0; i < count; i++) {
+            dists[i] = heap[i].first;
+            ids[i] = heap[i].second;
+        }
+        for (int i = count; i < k; i++) {
+            ids[i] = -1;
+            dists[i] = -1.0f;
+        }
     }
-    *resultCount = count;
 }
 
-int IVFIndex::findNearestCentroid(const float* vector) {
-    const int dim = vectorStore_.dimension();
+int IVFIndex::findNearestCentroid(const float* vector, float* distance) {
+    const int dim = dimension_;
     int nearest = 0;
     float minDist = std::numeric_limits<float>::max();
 
     for (int i = 0; i < config_.nLists; i++) {
-        float dist = distanceFunc_(vector, centroids_.data() + static_cast<size_t>(i) * dim, dim);
+        float dist = centroidDistanceFunc_(vector, centroids_.data() + static_cast<size_t>(i) * dim, dim);
         if (dist < minDist) {
             minDist = dist;
             nearest = i;
         }
     }
 
+    if (distance) *distance = minDist;
     return nearest;
 }
 
-void IVFIndex::save(const std::string& /*path*/) {}
-void IVFIndex::load(const std::string& /*path*/) {}
+void IVFIndex::updateCentroidNorms() {
+    centroidNorms_.resize(config_.nLists);
+    computeRowNormsSquared(centroids_.data(), config_.nLists, dimension_, centroidNorms_.data());
+}
+
+void IVFIndex::computeListRadii() {
+    listRadii_.assign(config_.nLists, 0.0f);
+    std::vector<float> dists;
+    for (int l = 0; l < config_.nLists; l++) {
+        const InvertedList& list = lists_[l];
+        const size_t listSize = list.ids.size();
+        if (listSize == 0) continue;
+
+        const float* centroid = centroids_.data() + static_cast<size_t>(l) * dimension_;
+        dists.resize(listSize);
+        if (config_.metric == Metric::COSINE) {
+            // Lists keep the raw vectors, measure their normalized copies: |x/|x| - c|^2
+            batchInnerProduct(centroid, list.vectors.data(), listSize, dimension_, dists.data());
+            for (size_t i = 0; i < listSize; i++) {
+                const float normSq = list.norms[i];
+                dists[i] = normSq > 0.0f
+                    ? 1.0f + centroidNorms_[l] - 2.0f * dists[i] / std::sqrt(normSq)
+                    : centroidNorms_[l];
+            }
+        } else {
+            batchEuclideanDistance(centroid, list.vectors.data(), list.norms.data(),
+                                   listSize, dimension_, dists.data());
+        }
+
+        float maxDist = 0.0f;
+        for (size_t i = 0; i < listSize; i++) {
+            maxDist = std::max(maxDist, dists[i]);
+        }
+        listRadii_[l] = std::sqrt(maxDist);
+    }
+}
+
+const float* IVFIndex::prepareVector(const float* vector, std::vector<float>& buffer) const {
+    if (config_.metric != Metric::COSINE) return vector;
+    buffer.resize(dimension_);
+    normalizeVector(vector, dimension_, buffer.data());
+    return buffer.data();
+}
+
+namespace {
+
+struct IVFFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t trained;
+    int32_t nLists;
+    int32_t nProbes;
+    int32_t maxIterations;
+    int32_t metric;
+    int32_t reserved;
+};
+
+} // namespace
+
+void IVFIndex::save(const std::string& path) {
+    const int dim = dimension_;
+    IndexFileWriter writer(path, IndexType::IVF, dim);
+
+    IVFFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = size_;
+    meta.capacity = maxElements_;
+    meta.trained = trained_ ? 1 : 0;
+    meta.nLists = config_.nLists;
+    meta.nProbes = config_.nProbes;
+    meta.maxIterations = config_.maxIterations;
+    meta.metric = static_cast<int32_t>(config_.metric);
+    writer.writeSection(SectionType::IVFMeta, &meta, sizeof(meta));
+
+    writer.writeSection(SectionType::IVFCentroids, centroids_.data(),
+                        centroids_.size() * sizeof(float));
+
+    // Lists are concatenated in list order, so each one stays a contiguous slice once mapped
+    writer.beginSection(SectionType::IVFListOffsets);
+    uint64_t offset = 0;
+    writer.writePod(offset);
+    for (const auto& list : lists_) {
+        offset += list.ids.size();
+        writer.writePod(offset);
+    }
+    writer.endSection();
+
+    writer.beginSection(SectionType::IVFListVectors);
+    for (const auto& list : lists_) {
+        writer.write(list.vectors.data(), list.vectors.size() * sizeof(float));
+    }
+    writer.endSection();
+
+    writer.beginSection(SectionType::IVFListIds);
+    for (const auto& list : lists_) {
+        writer.write(list.ids.data(), list.ids.size() * sizeof(int32_t));
+    }
+    writer.endSection();
+
+    writer.beginSection(SectionType::IVFListNorms);
+    for (const auto& list : lists_) {
+        writer.write(list.norms.data(), list.norms.size() * sizeof(float));
+    }
+    writer.endSection();
+
+    writer.writeSection(SectionType::IVFListRadii, listRadii_.data(), listRadii_.size() * sizeof(float));
+
+    writer.finish();
+}
+
+void IVFIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::IVF);
+    const int dim = dimension_;
+    if (file->dimension() != dim) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+
+    const auto* meta = file->sectionAs<IVFFileMeta>(SectionType::IVFMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->nLists <= 0 || !isValidMetric(meta->metric)) {
+        throw std::runtime_error("Corrupted IVF index file: " + path);
+    }
+
+    const size_t count = static_cast<size_t>(n);
+    const float* centroids = file->sectionAs<float>(SectionType::IVFCentroids,
+                                                    static_cast<size_t>(meta->nLists) * dim);
+    const uint64_t* offsets = file->sectionAs<uint64_t>(SectionType::IVFListOffsets,
+                                                        static_cast<size_t>(meta->nLists) + 1);
+    if (offsets[0] != 0 || offsets[meta->nLists] != count) {
+        throw std::runtime_error("Corrupted IVF index file: " + path);
+    }
+    for (int l = 0; l < meta->nLists; l++) {
+        if (offsets[l] > offsets[l + 1]) {
+            throw std::runtime_error("Corrupted IVF index file: " + path);
+        }
+    }
+
+    std::vector<InvertedList> lists(meta->nLists);
+    float* vectors = file->sectionAs<float>(SectionType::IVFListVectors, count * dim);
+    int32_t* ids = file->sectionAs<int32_t>(SectionType::IVFListIds, count);
+    float* norms = file->sectionAs<float>(SectionType::IVFListNorms, count);
+    for (int l = 0; l < meta->nLists; l++) {
+        const size_t begin = offsets[l];
+        const size_t listSize = offsets[l + 1] - begin;
+        lists[l].vectors.attach(vectors + begin * dim, listSize * dim);
+        lists[l].ids.attach(ids + begin, listSize);
+        lists[l].norms.attach(norms + begin, listSize);
+    }
+
+    config_.nLists = meta->nLists;
+    config_.nProbes = meta->nProbes;
+    config_.maxIterations = meta->maxIterations;
+    config_.metric = static_cast<Metric>(meta->metric);
+    centroids_.assign(centroids, centroids + static_cast<size_t>(meta->nLists) * dim);
+    updateCentroidNorms();
+    lists_.swap(lists);
+    if (file->hasSection(SectionType::IVFListRadii)) {
+        const float* radii = file->sectionAs<float>(SectionType::IVFListRadii, meta->nLists);
+        listRadii_.assign(radii, radii + meta->nLists);
+    } else {
+        computeListRadii();
+    }
+    maxElements_ = std::max(maxElements_, n);
+    mappedFile_ = std::move(file);
+
+    trained_ = meta->trained != 0;
+    size_ = n;
+    rebuildLocations();
+}
+
+void IVFIndex::detachMapping() {
+    if (!mappedFile_) return;
+    for (auto& list : lists_) {
+        list.vectors.detach();
+        list.ids.detach();
+        list.norms.detach();
+    }
+    mappedFile_.reset();
+}
 
-} // namespace vectordb
\ No newline at end of file
+} // namespace vectordb
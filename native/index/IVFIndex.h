@@ -1,8 +1,14 @@
 #pragma once
 #include "VectorIndex.h"
-#include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/MappedArray.h"
+#include "../core/AlignedAllocator.h"
 #include "../compute/DistanceUtils.h"
 #include <vector>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 
 namespace vectordb {
 
@@ -10,8 +16,20 @@ struct IVFConfig {
     int nLists = 100;
     int nProbes = 10;
     int maxIterations = 25;
+    // k-means 训练: 样本超过 nLists * maxPointsPerCentroid 时先下采样 (0 为不限)；
+    // kmeansBatchSize > 0 时改用 mini-batch，maxIterations 按遍历样本的轮数计
+    int maxPointsPerCentroid = 256;
+    int kmeansBatchSize = 0;
+    // 列表内的距离度量；粗聚类始终按 L2 (k-means)，COSINE 时在归一化后的向量上聚类
+    Metric metric = Metric::L2;
 };
 
+/**
+ * IVF 倒排索引
+ * 每个倒排表自带一段连续的向量块 [listSize][dimension] 及对应的 id 和模长，
+ * 插入时追加到所属列表末尾；查询时对每个探测列表整段做一次 GEMV (batchEuclideanDistance)，
+ * 不再按下标逐个回查 VectorStore
+ */
 class IVFIndex : public VectorIndex {
 public:
     IVFIndex(int dimension, int maxElements);
@@ -20,28 +38,80 @@ public:
     void add(int id, const float* vector) override;
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
-               int* resultCount) override;
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    // 列表扫描时跳过被过滤的条目；nProbes 个列表凑不满 k 个结果时按质心距离继续探测
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
+    // 精确结果: 逐个扫描列表，按质心距离与列表覆盖半径 (三角不等式) 跳过不可能命中的列表；
+    // INNER_PRODUCT 不满足三角不等式，扫描全部列表
+    void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                     const IDFilter* filter = nullptr) override;
     void save(const std::string& path) override;
     void load(const std::string& path) override;
     int size() const override { return size_; }
-    int dimension() const override { return vectorStore_.dimension(); }
-    int capacity() const override { return vectorStore_.capacity(); }
+    int dimension() const override { return dimension_; }
+    int capacity() const override { return maxElements_; }
 
     void train(int nSamples, const float* samples);
     bool isTrained() const { return trained_; }
-    void addBatch(const float* vectors, const int* ids, int n);
+    void addBatch(const float* vectors, const int* ids, int n) override;
+    // 删除直接把列表末尾的条目换到空位上，没有删除标记，也不需要 compact；
+    // update 沿用基类的删除后重新添加 (向量可能换到别的列表)
+    bool remove(int id) override;
+    // 按探测列表把查询分组，每组查询与列表向量块做一次 GEMM；结果不足 k 个时以 -1 补齐
+    void searchBatch(const float* queries, int nQueries, int k,
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+    // 调整每次查询探测的列表数 (超过 nLists 时按 nLists 计)
+    void setNProbes(int nProbes) { config_.nProbes = nProbes > 0 ? nProbes : 1; }
+
+    int listSize(int listId) const { return static_cast<int>(lists_[listId].ids.size()); }
 
 private:
-    VectorStore vectorStore_;
+    // load 之后各数组直接引用映射文件中对应列表的切片
+    struct InvertedList {
+        MappedArray<float, AlignedAllocator<float>> vectors;  // [listSize][dimension]
+        MappedArray<int32_t> ids;                             // [listSize] 外部 id
+        MappedArray<float> norms;                             // [listSize] 模长平方
+    };
+
+    int dimension_;
+    int maxElements_;
     IVFConfig config_;
     int size_ = 0;
     bool trained_ = false;
-    std::vector<float> centroids_;
-    std::vector<std::vector<int>> invertedLists_;
-    std::vector<int> idToList_;
-    DistanceFunc distanceFunc_;
+    std::vector<float> centroids_;       // [nLists][dimension]
+    std::vector<float> centroidNorms_;   // [nLists] 模长平方，供批量选探测列表
+    // [nLists] 列表成员到质心的最大 L2 距离 (非平方，聚类空间中)，只增不减，remove 后仍是上界
+    std::vector<float> listRadii_;
+    std::vector<InvertedList> lists_;
+    // 外部 id → (列表, 列表内位置)，同一 id 添加多次时指向最后一次
+    std::unordered_map<int, std::pair<int, int>> locations_;
+    DistanceFunc centroidDistanceFunc_;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
 
-    int findNearestCentroid(const float* vector);
+    // distance 非空时写入到最近质心的平方 L2 距离
+    int findNearestCentroid(const float* vector, float* distance = nullptr);
+    void updateCentroidNorms();
+    void computeListRadii();
+    // 列表全部条目到 query 的距离写入 dists [listSize]
+    void listDistances(const InvertedList& list, const float* query, float* dists) const;
+    // 对整个列表批量计算距离，通过 filter 的条目并入保存最优 k 个的最大堆
+    void scanList(const InvertedList& list, const float* query,
+                  std::vector<std::pair<float, int>>& heap, int k,
+                  const IDFilter* filter = nullptr) const;
+    void searchBlock(const float* queries, int nQueries, int k,
+                     int* resultIds, float* resultDistances) const;
+    // COSINE 时把向量归一化到 buffer 并返回它，否则原样返回
+    const float* prepareVector(const float* vector, std::vector<float>& buffer) const;
+    void detachMapping();
+    void rebuildLocations();
 };
 
 } // namespace vectordb
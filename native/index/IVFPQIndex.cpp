@@ -0,0 +1,540 @@
+#include "IVFPQIndex.h"
+#include "../compute/ADCUtils.h"
+#include "../compute/KMeans.h"
+#include "../core/ThreadPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+namespace vectordb {
+
+IVFPQIndex::IVFPQIndex(int dimension, int maxElements)
+    : IVFPQIndex(dimension, maxElements, IVFPQConfig{}) {}
+
+IVFPQIndex::IVFPQIndex(int dimension, int maxElements, const IVFPQConfig& config)
+    : vectorStore_(dimension, maxElements), config_(config) {
+    if (config.nLists <= 0) {
+        throw std::invalid_argument("nLists must be positive");
+    }
+    if (config.pqM <= 0 || dimension % config.pqM != 0) {
+        throw std::invalid_argument("Dimension must be divisible by pqM");
+    }
+    if (config.nBits < 1 || config.nBits > 8) {
+        throw std::invalid_argument("nBits must be between 1 and 8");
+    }
+    if (config.nBits == 4 && config.pqM > FASTSCAN_MAX_M) {
+        throw std::invalid_argument("4-bit fast scan supports at most 256 subspaces");
+    }
+
+    subDim_ = dimension / config.pqM;
+    nCentroids_ = 1 << config.nBits;
+    centroids_.resize(static_cast<size_t>(config.nLists) * dimension);
+    codebooks_.resize(static_cast<size_t>(config.pqM) * nCentroids_ * subDim_);
+    lists_.resize(config.nLists);
+
+    distanceFunc_ = getDistanceFunc(config.metric);
+    l2Func_ = getEuclideanDistanceFunc();
+    fastScanFunc_ = getFastScanFunc();
+}
+
+void IVFPQIndex::train(int nSamples, const float* samples) {
+    if (nSamples <= 0 || samples == nullptr) {
+        throw std::invalid_argument("Invalid training samples");
+    }
+
+    const int dim = vectorStore_.dimension();
+    const int nLists = config_.nLists;
+
+    std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(static_cast<size_t>(nSamples) * dim);
+        for (int i = 0; i < nSamples; i++) {
+            normalizeVector(samples + static_cast<size_t>(i) * dim, dim,
+                            normalized.data() + static_cast<size_t>(i) * dim);
+        }
+        samples = normalized.data();
+    }
+
+    // Coarse quantizer: plain k-means over the full vectors, same as IVFIndex
+    KMeansConfig kmeans;
+    kmeans.k = nLists;
+    kmeans.maxIterations = config_.maxIterations;
+    kmeans.maxPointsPerCentroid = config_.maxPointsPerCentroid;
+    kmeans.batchSize = config_.kmeansBatchSize;
+    trainKMeans(samples, nSamples, dim, kmeans, centroids_.data());
+
+    // The last update may have moved the centroids, reassign before taking residuals
+    std::vector<int> assignments(nSamples);
+    assignNearestCentroids(samples, nSamples, centroids_.data(), nullptr, nLists, dim, assignments.data());
+    std::vector<float> residuals(static_cast<size_t>(nSamples) * dim);
+    for (int i = 0; i < nSamples; i++) {
+        const float* sample = samples + static_cast<size_t>(i) * dim;
+        const float* centroid = centroids_.data() + static_cast<size_t>(assignments[i]) * dim;
+        float* residual = residuals.data() + static_cast<size_t>(i) * dim;
+        for (int d = 0; d < dim; d++) {
+            residual[d] = sample[d] - centroid[d];
+        }
+    }
+
+    trainCodebooks(nSamples, residuals.data());
+    trained_ = true;
+}
+
+void IVFPQIndex::trainCodebooks(int nSamples, const float* residuals) {
+    const int dim = vectorStore_.dimension();
+    std::vector<float> subData(static_cast<size_t>(nSamples) * subDim_);
+
+    for (int m = 0; m < config_.pqM; m++) {
+        for (int i = 0; i < nSamples; i++) {
+            const float* sub = residuals + static_cast<size_t>(i) * dim + static_cast<size_t>(m) * subDim_;
+            std::copy(sub, sub + subDim_, subData.data() + static_cast<size_t>(i) * subDim_);
+        }
+
+        KMeansConfig kmeans;
+        kmeans.k = nCentroids_;
+        kmeans.maxIterations = config_.maxIterations;
+        kmeans.seed = 42 + m;
+        trainKMeans(subData.data(), nSamples, subDim_, kmeans,
+                    codebooks_.data() + static_cast<size_t>(m) * nCentroids_ * subDim_);
+    }
+}
+
+int IVFPQIndex::findNearestCentroid(const float* vector) const {
+    const int dim = vectorStore_.dimension();
+    int nearest = 0;
+    float minDist = std::numeric_limits<float>::max();
+
+    for (int i = 0; i < config_.nLists; i++) {
+        float dist = l2Func_(vector, centroids_.data() + static_cast<size_t>(i) * dim, dim);
+        if (dist < minDist) {
+            minDist = dist;
+            nearest = i;
+        }
+    }
+
+    return nearest;
+}
+
+int IVFPQIndex::findNearestCode(int subspaceIdx, const float* subVector) const {
+    const float* codebook = codebooks_.data() + static_cast<size_t>(subspaceIdx) * nCentroids_ * subDim_;
+    int nearest = 0;
+    float minDist = std::numeric_limits<float>::max();
+
+    for (int c = 0; c < nCentroids_; c++) {
+        float dist = l2Func_(subVector, codebook + static_cast<size_t>(c) * subDim_, subDim_);
+        if (dist < minDist) {
+            minDist = dist;
+            nearest = c;
+        }
+    }
+
+    return nearest;
+}
+
+int IVFPQIndex::encode(const float* vector, uint8_t* codes) const {
+    const int dim = vectorStore_.dimension();
+    const int listId = findNearestCentroid(vector);
+    const float* centroid = centroids_.data() + static_cast<size_t>(listId) * dim;
+
+    thread_local std::vector<float> residual;
+    residual.resize(dim);
+    for (int d = 0; d < dim; d++) {
+        residual[d] = vector[d] - centroid[d];
+    }
+    for (int m = 0; m < config_.pqM; m++) {
+        codes[m] = static_cast<uint8_t>(findNearestCode(m, residual.data() + static_cast<size_t>(m) * subDim_));
+    }
+    return listId;
+}
+
+void IVFPQIndex::append(int listId, int index, const uint8_t* codes) {
+    InvertedList& list = lists_[listId];
+    const int position = static_cast<int>(list.indices.size());
+    list.indices.push_back(index);
+    list.codes.insert(list.codes.end(), codes, codes + config_.pqM);
+
+    if (useFastScan()) {
+        const size_t needed = (static_cast<size_t>(position) / FASTSCAN_BLOCK + 1) *
+                              fastScanBlockBytes(config_.pqM);
+        if (list.packed.size() < needed) {
+            list.packed.resize(needed, 0);
+        }
+        packFastScanCode(codes, config_.pqM, position, list.packed.data());
+    }
+}
+
+void IVFPQIndex::add(int id, const float* vector) {
+    if (!trained_) {
+        throw std::runtime_error("IVFPQ index must be trained before adding vectors");
+    }
+
+    detachMapping();
+
+    std::vector<float> normalized;
+    std::vector<uint8_t> codes(config_.pqM);
+    int listId = encode(prepareVector(vector, normalized), codes.data());
+
+    int index = vectorStore_.add(id, vector);
+    append(listId, index, codes.data());
+    size_++;
+}
+
+void IVFPQIndex::addBatch(const float* vectors, const int* ids, int n) {
+    if (!trained_) {
+        throw std::runtime_error("IVFPQ index must be trained before adding vectors");
+    }
+    if (n <= 0) return;
+
+    detachMapping();
+
+    const int dim = vectorStore_.dimension();
+    std::vector<uint8_t> batchCodes(static_cast<size_t>(n) * config_.pqM);
+    std::vector<int> batchLists(n);
+
+    ThreadPool::instance().parallelFor(0, n, 64, [&](int64_t start, int64_t end) {
+        std::vector<float> normalized;
+        for (int64_t i = start; i < end; i++) {
+            const float* vec = prepareVector(vectors + static_cast<size_t>(i) * dim, normalized);
+            batchLists[i] = encode(vec, batchCodes.data() + static_cast<size_t>(i) * config_.pqM);
+        }
+    }, numThreads_);
+
+    for (int i = 0; i < n; i++) {
+        int index = vectorStore_.add(ids[i], vectors + static_cast<size_t>(i) * dim);
+        append(batchLists[i], index, batchCodes.data() + static_cast<size_t>(i) * config_.pqM);
+        size_++;
+    }
+}
+
+void IVFPQIndex::search(const float* query, int k,
+                       int* resultIds, float* resultDistances,
+                       int* resultCount) {
+    if (!trained_ || k <= 0) {
+        *resultCount = 0;
+        return;
+    }
+
+    SearchStatsScope scope;
+    const int dim = vectorStore_.dimension();
+    std::vector<float> normalized;
+    query = prepareVector(query, normalized);
+
+    const int nProbes = std::min(config_.nProbes, config_.nLists);
+    VECTORDB_STATS_ADD(distanceComputations, config_.nLists);
+    std::vector<std::pair<float, int>> centroidDists(config_.nLists);
+    for (int i = 0; i < config_.nLists; i++) {
+        centroidDists[i] = {l2Func_(query, centroids_.data() + static_cast<size_t>(i) * dim, dim), i};
+    }
+    std::partial_sort(centroidDists.begin(), centroidDists.begin() + nProbes, centroidDists.end());
+
+    const bool rerank = config_.rerankWithVectors && vectorStore_.hasVectors();
+    const int keep = rerank ? std::max(k, k * config_.rerankFactor) : k;
+
+    // Tables for IP/COSINE do not depend on the list, only the -<q, c> offset does
+    std::vector<float> table(static_cast<size_t>(config_.pqM) * nCentroids_);
+    std::vector<float> residual;
+    if (config_.metric == Metric::L2) {
+        residual.resize(dim);
+    } else {
+        buildADCTable(config_.metric, query, codebooks_.data(), config_.pqM, nCentroids_, subDim_,
+                      table.data());
+    }
+    const float cosineOffset = config_.metric == Metric::COSINE ? 1.0f : 0.0f;
+
+    // Max-heap of (distance, vector index) holding the best `keep` so far
+    std::vector<std::pair<float, int>> heap;
+    heap.reserve(keep + 1);
+
+    for (int p = 0; p < nProbes; p++) {
+        const int listId = centroidDists[p].second;
+        if (lists_[listId].indices.empty()) continue;
+        const float* centroid = centroids_.data() + static_cast<size_t>(listId) * dim;
+
+        float offset = cosineOffset;
+        if (config_.metric == Metric::L2) {
+            for (int d = 0; d < dim; d++) {
+                residual[d] = query[d] - centroid[d];
+            }
+            buildADCTable(Metric::L2, residual.data(), codebooks_.data(), config_.pqM, nCentroids_,
+                          subDim_, table.data());
+        } else {
+            offset += distanceFunc_(query, centroid, dim);
+        }
+        VECTORDB_STATS_ADD(hops, 1);
+        VECTORDB_STATS_ADD(visitedNodes, lists_[listId].indices.size());
+        VECTORDB_STATS_ADD(distanceComputations, lists_[listId].indices.size());
+        scanList(listId, table.data(), offset, heap, keep);
+    }
+
+    if (rerank) {
+        VECTORDB_STATS_ADD(distanceComputations, heap.size());
+        for (auto& entry : heap) {
+            float dist = distanceFunc_(query, vectorStore_.getVector(entry.second), dim);
+            if (config_.metric == Metric::COSINE) {
+                dist = cosineFromNegDot(dist, 1.0f, vectorStore_.getNorm(entry.second));
+            }
+            entry.first = dist;
+        }
+    }
+
+    const int count = std::min(k, static_cast<int>(heap.size()));
+    std::partial_sort(heap.begin(), heap.begin() + count, heap.end());
+    for (int i = 0; i < count; i++) {
+        resultDistances[i] = heap[i].first;
+        resultIds[i] = vectorStore_.getId(heap[i].second);
+    }
+    *resultCount = count;
+}
+
+void IVFPQIndex::scanList(int listId, const float* table, float offset,
+                          std::vector<std::pair<float, int>>& heap, int keep) const {
+    const InvertedList& list = lists_[listId];
+    const int M = config_.pqM;
+    const int listSize = static_cast<int>(list.indices.size());
+
+    auto push = [&heap, keep](float dist, int index) {
+        if (static_cast<int>(heap.size()) < keep) {
+            heap.emplace_back(dist, index);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (dist < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = {dist, index};
+            std::push_heap(heap.begin(), heap.end());
+        }
+    };
+
+    if (!useFastScan()) {
+        ADCDistanceBatchFunc adcBatch = getADCDistanceBatchFunc();
+        constexpr int chunk = 256;
+        float dists[chunk];
+        for (int start = 0; start < listSize; start += chunk) {
+            const int count = std::min(chunk, listSize - start);
+            adcBatch(table, list.codes.data() + static_cast<size_t>(start) * M, count, M, nCentroids_, dists);
+            for (int i = 0; i < count; i++) {
+                push(dists[i] + offset, list.indices[start + i]);
+            }
+        }
+        return;
+    }
+
+    // Quantized sums are only comparable within one list (each table has its own bias/scale),
+    // so pick local candidates by sum and let the exact float ADC compete globally
+    const int paddedM = fastScanPaddedM(M);
+    thread_local std::vector<uint8_t> lut;
+    thread_local std::vector<uint16_t> sums;
+    lut.resize(static_cast<size_t>(paddedM) * 16);
+    float bias, scale;
+    quantizeFastScanLUT(table, M, lut.data(), &bias, &scale);
+
+    const size_t nBlocks = (static_cast<size_t>(listSize) + FASTSCAN_BLOCK - 1) / FASTSCAN_BLOCK;
+    sums.resize(nBlocks * FASTSCAN_BLOCK);
+    fastScanFunc_(list.packed.data(), nBlocks, paddedM, lut.data(), sums.data());
+
+    const int localCount = std::min(listSize, std::max(keep, keep * config_.fastScanRerankFactor));
+    std::vector<std::pair<uint16_t, int>> local;
+    local.reserve(localCount + 1);
+    for (int i = 0; i < listSize; i++) {
+        if (static_cast<int>(local.size()) < localCount) {
+            local.emplace_back(sums[i], i);
+            std::push_heap(local.begin(), local.end());
+        } else if (sums[i] < local.front().first) {
+            std::pop_heap(local.begin(), local.end());
+            local.back() = {sums[i], i};
+            std::push_heap(local.begin(), local.end());
+        }
+    }
+
+    for (const auto& entry : local) {
+        const int position = entry.second;
+        const float dist = adcDistanceScalar(table, list.codes.data() + static_cast<size_t>(position) * M,
+                                             M, nCentroids_);
+        push(dist + offset, list.indices[position]);
+    }
+}
+
+void IVFPQIndex::searchBatch(const float* queries, int nQueries, int k,
+                            int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    const int dim = vectorStore_.dimension();
+
+    ThreadPool::instance().parallelFor(0, nQueries, 1, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            int* ids = resultIds + static_cast<size_t>(i) * k;
+            float* dists = resultDistances + static_cast<size_t>(i) * k;
+            int count;
+            SearchStatsScope scope(queryStats ? queryStats + i : nullptr, queryStats == nullptr);
+            search(queries + static_cast<size_t>(i) * dim, k, ids, dists, &count);
+            for (int j = count; j < k; j++) {
+                ids[j] = -1;
+                dists[j] = -1.0f;
+            }
+        }
+    }, numThreads_);
+}
+
+const float* IVFPQIndex::prepareVector(const float* vector, std::vector<float>& buffer) const {
+    if (config_.metric != Metric::COSINE) return vector;
+    buffer.resize(vectorStore_.dimension());
+    normalizeVector(vector, vectorStore_.dimension(), buffer.data());
+    return buffer.data();
+}
+
+namespace {
+
+struct IVFPQFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t trained;
+    int32_t nLists;
+    int32_t nProbes;
+    int32_t maxIterations;
+    int32_t pqM;
+    int32_t nBits;
+    int32_t subDim;
+    int32_t nCentroids;
+    int32_t metric;
+    int32_t rerankWithVectors;
+    int32_t rerankFactor;
+    int32_t fastScanRerankFactor;
+    int32_t hasRawVectors;
+    int32_t reserved;
+};
+
+} // namespace
+
+void IVFPQIndex::save(const std::string& path) {
+    const int dim = vectorStore_.dimension();
+    IndexFileWriter writer(path, IndexType::IVFPQ, dim);
+
+    IVFPQFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = size_;
+    meta.capacity = vectorStore_.capacity();
+    meta.trained = trained_ ? 1 : 0;
+    meta.nLists = config_.nLists;
+    meta.nProbes = config_.nProbes;
+    meta.maxIterations = config_.maxIterations;
+    meta.pqM = config_.pqM;
+    meta.nBits = config_.nBits;
+    meta.subDim = subDim_;
+    meta.nCentroids = nCentroids_;
+    meta.metric = static_cast<int32_t>(config_.metric);
+    meta.rerankWithVectors = config_.rerankWithVectors ? 1 : 0;
+    meta.rerankFactor = config_.rerankFactor;
+    meta.fastScanRerankFactor = config_.fastScanRerankFactor;
+    meta.hasRawVectors = config_.saveRawVectors && vectorStore_.hasVectors() ? 1 : 0;
+    writer.writeSection(SectionType::IVFPQMeta, &meta, sizeof(meta));
+
+    writer.writeSection(SectionType::IVFCentroids, centroids_.data(),
+                        centroids_.size() * sizeof(float));
+    writer.writeSection(SectionType::PQCodebooks, codebooks_.data(),
+                        codebooks_.size() * sizeof(float));
+
+    writer.beginSection(SectionType::IVFListOffsets);
+    uint64_t offset = 0;
+    writer.writePod(offset);
+    for (const auto& list : lists_) {
+        offset += list.indices.size();
+        writer.writePod(offset);
+    }
+    writer.endSection();
+
+    writer.beginSection(SectionType::IVFListEntries);
+    for (const auto& list : lists_) {
+        writer.write(list.indices.data(), list.indices.size() * sizeof(int));
+    }
+    writer.endSection();
+
+    writer.beginSection(SectionType::PQCodes);
+    for (const auto& list : lists_) {
+        writer.write(list.codes.data(), list.codes.size());
+    }
+    writer.endSection();
+
+    vectorStore_.writeSections(writer, meta.hasRawVectors != 0);
+
+    writer.finish();
+}
+
+void IVFPQIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::IVFPQ);
+    const int dim = vectorStore_.dimension();
+    if (file->dimension() != dim) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+
+    const auto* meta = file->sectionAs<IVFPQFileMeta>(SectionType::IVFPQMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->nLists <= 0 || meta->pqM <= 0 || meta->subDim * meta->pqM != dim ||
+        meta->nBits < 1 || meta->nBits > 8 || meta->nCentroids != (1 << meta->nBits) ||
+        (meta->nBits == 4 && meta->pqM > FASTSCAN_MAX_M) || !isValidMetric(meta->metric)) {
+        throw std::runtime_error("Corrupted IVFPQ index file: " + path);
+    }
+
+    const size_t codebookCount = static_cast<size_t>(meta->pqM) * meta->nCentroids * meta->subDim;
+    const float* centroids = file->sectionAs<float>(SectionType::IVFCentroids,
+                                                    static_cast<size_t>(meta->nLists) * dim);
+    const float* codebooks = file->sectionAs<float>(SectionType::PQCodebooks, codebookCount);
+    const uint64_t* offsets = file->sectionAs<uint64_t>(SectionType::IVFListOffsets,
+                                                        static_cast<size_t>(meta->nLists) + 1);
+    const int32_t* entries = file->sectionAs<int32_t>(SectionType::IVFListEntries, n);
+    const uint8_t* codes = file->sectionAs<uint8_t>(SectionType::PQCodes,
+                                                    static_cast<size_t>(n) * meta->pqM);
+    if (offsets[0] != 0 || offsets[meta->nLists] != static_cast<uint64_t>(n)) {
+        throw std::runtime_error("Corrupted IVFPQ index file: " + path);
+    }
+    for (int l = 0; l < meta->nLists; l++) {
+        if (offsets[l] > offsets[l + 1]) {
+            throw std::runtime_error("Corrupted IVFPQ index file: " + path);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (entries[i] < 0 || entries[i] >= n) {
+            throw std::runtime_error("Corrupted IVFPQ index file: " + path);
+        }
+    }
+
+    config_.nLists = meta->nLists;
+    config_.nProbes = meta->nProbes;
+    config_.maxIterations = meta->maxIterations;
+    config_.pqM = meta->pqM;
+    config_.nBits = meta->nBits;
+    config_.metric = static_cast<Metric>(meta->metric);
+    config_.rerankFactor = meta->rerankFactor;
+    config_.fastScanRerankFactor = meta->fastScanRerankFactor;
+    subDim_ = meta->subDim;
+    nCentroids_ = meta->nCentroids;
+    distanceFunc_ = getDistanceFunc(config_.metric);
+    centroids_.assign(centroids, centroids + static_cast<size_t>(meta->nLists) * dim);
+    codebooks_.assign(codebooks, codebooks + codebookCount);
+
+    // Lists are scanned on every query and grow on add, keep private copies; the packed
+    // fast-scan layout is rebuilt from the codes
+    lists_.assign(meta->nLists, InvertedList{});
+    for (int l = 0; l < meta->nLists; l++) {
+        for (uint64_t e = offsets[l]; e < offsets[l + 1]; e++) {
+            append(l, entries[e], codes + e * meta->pqM);
+        }
+    }
+
+    vectorStore_.attachSections(*file, n);
+    mappedFile_ = std::move(file);
+    config_.rerankWithVectors = meta->rerankWithVectors != 0 && vectorStore_.hasVectors();
+    config_.saveRawVectors = vectorStore_.hasVectors();
+
+    trained_ = meta->trained != 0;
+    size_ = n;
+}
+
+void IVFPQIndex::detachMapping() {
+    if (!mappedFile_) return;
+    if (!vectorStore_.hasVectors()) {
+        throw std::runtime_error("IVFPQ index was loaded without raw vectors and is read-only");
+    }
+
+    vectorStore_.detach();
+    mappedFile_.reset();
+}
+
+} // namespace vectordb
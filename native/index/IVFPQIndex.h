@@ -0,0 +1,105 @@
+#pragma once
+#include "VectorIndex.h"
+#include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../compute/DistanceUtils.h"
+#include "../compute/FastScan.h"
+#include <vector>
+#include <cstdint>
+#include <memory>
+
+namespace vectordb {
+
+struct IVFPQConfig {
+    // 粗量化 (同 IVFConfig)
+    int nLists = 100;
+    int nProbes = 10;
+    int maxIterations = 25;
+    int maxPointsPerCentroid = 256;  // 同 IVFConfig，只作用于粗聚类
+    int kmeansBatchSize = 0;
+    // 残差 PQ: 每个向量编码为 x - centroid(list)，nBits == 4 时列表内使用快速扫描
+    int pqM = 8;
+    int nBits = 8;
+    Metric metric = Metric::L2;  // COSINE 时在归一化后的向量上聚类和编码
+    // 为 true 时先按 PQ 距离取 k * rerankFactor 个候选，再用 VectorStore 中的原向量精确重排
+    bool rerankWithVectors = false;
+    int rerankFactor = 4;
+    // nBits == 4 时每个列表先按量化距离表取 fastScanRerankFactor 倍候选，再用 float 距离表重算
+    int fastScanRerankFactor = 4;
+    bool saveRawVectors = true;  // false 时 save 只写中心、码本和编码，加载后只读且不能重排
+};
+
+/**
+ * IVF-PQ 复合索引
+ * 粗聚类中心划分倒排表，表内存放残差 PQ 编码，按列表连续存储 [listSize][pqM]；
+ * 查询时每个探测列表计算一张距离表 (L2 在 q - centroid 上构建，
+ * INNER_PRODUCT/COSINE 的表与列表无关，只差一个 -<q, centroid> 常数)，
+ * 再对整段编码做批量 ADC
+ */
+class IVFPQIndex : public VectorIndex {
+public:
+    IVFPQIndex(int dimension, int maxElements);
+    IVFPQIndex(int dimension, int maxElements, const IVFPQConfig& config);
+
+    void add(int id, const float* vector) override;
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount) override;
+    using VectorIndex::search;  // 带过滤的重载使用基类的放大 k 实现
+    void save(const std::string& path) override;
+    void load(const std::string& path) override;
+    int size() const override { return size_; }
+    int dimension() const override { return vectorStore_.dimension(); }
+    int capacity() const override { return vectorStore_.capacity(); }
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override { return vectorStore_.setMemoryPolicy(policy); }
+
+    // 先训练粗聚类中心，再在训练样本的残差上训练 PQ 码本
+    void train(int nSamples, const float* samples);
+    bool isTrained() const { return trained_; }
+    void addBatch(const float* vectors, const int* ids, int n) override;
+    void searchBatch(const float* queries, int nQueries, int k,
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+
+    int listSize(int listId) const { return static_cast<int>(lists_[listId].indices.size()); }
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+    // 调整每次查询探测的列表数 (超过 nLists 时按 nLists 计)
+    void setNProbes(int nProbes) { config_.nProbes = nProbes > 0 ? nProbes : 1; }
+
+private:
+    struct InvertedList {
+        std::vector<int> indices;        // 向量在 VectorStore 中的下标
+        std::vector<uint8_t> codes;      // [indices.size()][pqM] 残差 PQ 编码
+        std::vector<uint8_t> packed;     // nBits == 4 时的快速扫描布局，由 codes 派生
+    };
+
+    VectorStore vectorStore_;
+    IVFPQConfig config_;
+    int size_ = 0;
+    bool trained_ = false;
+    int subDim_ = 0;
+    int nCentroids_ = 0;
+    std::vector<float> centroids_;   // [nLists][dimension]
+    std::vector<float> codebooks_;   // [pqM][nCentroids][subDim]
+    std::vector<InvertedList> lists_;
+    DistanceFunc distanceFunc_;
+    DistanceFunc l2Func_;
+    FastScanFunc fastScanFunc_;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+
+    bool useFastScan() const { return config_.nBits == 4; }
+    int findNearestCentroid(const float* vector) const;
+    int findNearestCode(int subspaceIdx, const float* subVector) const;
+    void trainCodebooks(int nSamples, const float* residuals);
+    // vector 已按度量预处理；返回所属列表并写出残差编码
+    int encode(const float* vector, uint8_t* codes) const;
+    void append(int listId, int index, const uint8_t* codes);
+    void scanList(int listId, const float* table, float offset,
+                  std::vector<std::pair<float, int>>& heap, int keep) const;
+    const float* prepareVector(const float* vector, std::vector<float>& buffer) const;
+    void detachMapping();
+};
+
+} // namespace vectordb
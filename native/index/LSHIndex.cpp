@@ -1,75 +1,196 @@
 #include "LSHIndex.h"
 #include "../compute/DistanceUtils.h"
+#include "../compute/BatchDistance.h"
+#include "../core/SearchContext.h"
 #include <random>
+#include <chrono>
 #include <algorithm>
-#include <unordered_map>
+#include <cstring>
+#include <stdexcept>
 
 namespace vectordb {
 
+namespace {
+
+constexpr size_t kInitialSlotCapacity = 1024;
+
+inline uint64_t mixKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// One perturbation set during probe generation: flipped key bits, cost,
+// and the last (in margin order) position it contains
+struct ProbeSet {
+    float score;
+    uint64_t flips;
+    int last;
+    bool operator>(const ProbeSet& other) const { return score > other.score; }
+};
+
+} // namespace
+
 LSHIndex::LSHIndex(int dimension, int maxElements)
-    : LSHIndex(dimension, maxElements, 10, 20) {}
+    : LSHIndex(dimension, maxElements, LSHConfig()) {}
 
 LSHIndex::LSHIndex(int dimension, int maxElements, int numHashTables, int numHashFunctions)
-    : dimension_(dimension), maxElements_(maxElements), numHashTables_(numHashTables), numHashFunctions_(numHashFunctions),
+    : LSHIndex(dimension, maxElements, LSHConfig{numHashTables, numHashFunctions, 1}) {}
+
+LSHIndex::LSHIndex(int dimension, int maxElements, const LSHConfig& config)
+    : dimension_(dimension), maxElements_(maxElements), config_(config),
       vectorStore_(dimension, maxElements) {
+    if (config_.numHashTables <= 0 || config_.numHashFunctions <= 0 || config_.numHashFunctions > 64) {
+        throw std::invalid_argument("LSH needs at least one table and 1-64 hash functions per table");
+    }
+    if (config_.numProbes <= 0) config_.numProbes = 1;
 
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     rng_.seed(seed);
 
     generateHashFunctions();
-    hashTables_.resize(numHashTables);
+    rehash(kInitialSlotCapacity);
 }
 
 void LSHIndex::generateHashFunctions() {
-    hashFunctions_.resize(numHashTables_);
-    hashBiases_.resize(numHashTables_);
+    const size_t hashCount = static_cast<size_t>(config_.numHashTables) * config_.numHashFunctions;
+    projections_.resize(hashCount * dimension_);
+    biases_.resize(hashCount);
 
     std::normal_distribution<float> dist(0.0, 1.0);
 
-    for (int t = 0; t < numHashTables_; t++) {
-        hashFunctions_[t].resize(numHashFunctions_);
-        hashBiases_[t].resize(numHashFunctions_);
-
-        for (int h = 0; h < numHashFunctions_; h++) {
-            hashFunctions_[t][h].resize(dimension_);
-            for (int d = 0; d < dimension_; d++) {
-                hashFunctions_[t][h][d] = dist(rng_);
-            }
-            hashBiases_[t][h] = dist(rng_) * 0.5f;
+    // Same draw order as one table after another, hyperplane then bias
+    for (size_t h = 0; h < hashCount; h++) {
+        float* row = projections_.data() + h * dimension_;
+        for (int d = 0; d < dimension_; d++) {
+            row[d] = dist(rng_);
         }
+        biases_[h] = dist(rng_) * 0.5f;
     }
 }
 
-std::vector<int> LSHIndex::computeHash(const float* vector, int tableIdx) {
-    std::vector<int> hash(numHashFunctions_);
+void LSHIndex::project(const float* vector, float* out) const {
+    const size_t hashCount = biases_.size();
+    batchInnerProduct(vector, projections_.data(), hashCount, dimension_, out);
+    for (size_t h = 0; h < hashCount; h++) {
+        out[h] += biases_[h];
+    }
+}
 
-    for (int h = 0; h < numHashFunctions_; h++) {
-        float dot = 0.0f;
-        for (int d = 0; d < dimension_; d++) {
-            dot += vector[d] * hashFunctions_[tableIdx][h][d];
+uint64_t LSHIndex::bucketKey(const float* projection) const {
+    // First hash function is the most significant bit
+    uint64_t key = 0;
+    for (int h = 0; h < config_.numHashFunctions; h++) {
+        key = (key << 1) | (projection[h] > 0 ? 1 : 0);
+    }
+    return key;
+}
+
+size_t LSHIndex::findSlot(int table, uint64_t key) const {
+    const Slot* base = slots_.data() + static_cast<size_t>(table) * slotCapacity_;
+    const size_t mask = slotCapacity_ - 1;
+    size_t i = mixKey(key) & mask;
+    while (base[i].count != 0 && base[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void LSHIndex::insert(int table, uint64_t key, int index) {
+    // Keep every table at most half full so probe sequences stay short
+    if ((bucketCounts_[table] + 1) * 2 > slotCapacity_) {
+        rehash(slotCapacity_ * 2);
+    }
+
+    Slot& slot = slots_[static_cast<size_t>(table) * slotCapacity_ + findSlot(table, key)];
+    if (slot.count == 0) {
+        slot.key = key;
+        slot.head = -1;
+        bucketCounts_[table]++;
+    }
+    chains_[static_cast<size_t>(index) * config_.numHashTables + table] = slot.head;
+    slot.head = index;
+    slot.count++;
+}
+
+void LSHIndex::rehash(size_t slotCapacity) {
+    std::vector<Slot> old(slots_.data(), slots_.data() + slots_.size());
+    const size_t oldCapacity = slotCapacity_;
+
+    slots_.clear();
+    slots_.resize(static_cast<size_t>(config_.numHashTables) * slotCapacity, Slot{0, -1, 0});
+    slotCapacity_ = slotCapacity;
+    bucketCounts_.assign(config_.numHashTables, 0);
+
+    for (int t = 0; t < config_.numHashTables; t++) {
+        const Slot* oldBase = old.data() + static_cast<size_t>(t) * oldCapacity;
+        Slot* base = slots_.data() + static_cast<size_t>(t) * slotCapacity_;
+        for (size_t i = 0; i < oldCapacity; i++) {
+            if (oldBase[i].count == 0) continue;
+            base[findSlot(t, oldBase[i].key)] = oldBase[i];
+            bucketCounts_[t]++;
         }
-        hash[h] = (dot + hashBiases_[tableIdx][h] > 0) ? 1 : 0;
     }
+}
+
+void LSHIndex::probeKeys(const float* projection, int numProbes, std::vector<uint64_t>& keys) const {
+    const int numFunctions = config_.numHashFunctions;
+    const uint64_t base = bucketKey(projection);
+    keys.clear();
+    keys.push_back(base);
+    if (numProbes <= 1) return;
+
+    // Flipping bit h moves the query projection[h]^2 away (up to the hyperplane norm);
+    // probe sets are generated in increasing total cost (Lv et al., multi-probe LSH)
+    thread_local std::vector<std::pair<float, int>> order;
+    thread_local std::vector<ProbeSet> heap;
+    order.clear();
+    for (int h = 0; h < numFunctions; h++) {
+        order.emplace_back(projection[h] * projection[h], h);
+    }
+    std::sort(order.begin(), order.end());
+    auto flipBit = [&](int position) {
+        return uint64_t(1) << (numFunctions - 1 - order[position].second);
+    };
 
-    return hash;
+    heap.clear();
+    heap.push_back({order[0].first, flipBit(0), 0});
+    while (static_cast<int>(keys.size()) < numProbes && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<ProbeSet>());
+        ProbeSet set = heap.back();
+        heap.pop_back();
+        keys.push_back(base ^ set.flips);
+
+        int next = set.last + 1;
+        if (next < numFunctions) {
+            // shift: replace the last flipped position with the next one
+            heap.push_back({set.score - order[set.last].first + order[next].first,
+                            set.flips ^ flipBit(set.last) ^ flipBit(next), next});
+            std::push_heap(heap.begin(), heap.end(), std::greater<ProbeSet>());
+            // expand: additionally flip the next position
+            heap.push_back({set.score + order[next].first, set.flips ^ flipBit(next), next});
+            std::push_heap(heap.begin(), heap.end(), std::greater<ProbeSet>());
+        }
+    }
 }
 
 void LSHIndex::add(int id, const float* vector) {
+    detachMapping();
+
     int index = size_;
     vectorStore_.add(id, vector);
 
-    for (int t = 0; t < numHashTables_; t++) {
-        std::vector<int> hash = computeHash(vector, t);
+    thread_local std::vector<float> projection;
+    projection.resize(biases_.size());
+    project(vector, projection.data());
 
-        int bucketIdx = 0;
-        for (int h = 0; h < numHashFunctions_; h++) {
-            bucketIdx = (bucketIdx << 1) | hash[h];
-        }
-
-        if (bucketIdx >= static_cast<int>(hashTables_[t].size())) {
-            hashTables_[t].resize(bucketIdx + 1);
-        }
-        hashTables_[t][bucketIdx].push_back(index);
+    const int numTables = config_.numHashTables;
+    chains_.resize(static_cast<size_t>(index + 1) * numTables, -1);
+    for (int t = 0; t < numTables; t++) {
+        insert(t, bucketKey(projection.data() + static_cast<size_t>(t) * config_.numHashFunctions), index);
     }
 
     size_++;
@@ -78,50 +199,152 @@ void LSHIndex::add(int id, const float* vector) {
 void LSHIndex::search(const float* query, int k,
                      int* resultIds, float* resultDistances,
                      int* resultCount) {
+    if (size_ == 0 || k <= 0) {
+        *resultCount = 0;
+        return;
+    }
 
     DistanceFunc distFunc = getEuclideanDistanceFunc();
-    std::unordered_map<int, int> candidates;
+    const int numTables = config_.numHashTables;
 
-    for (int t = 0; t < numHashTables_; t++) {
-        std::vector<int> hash = computeHash(query, t);
+    thread_local std::vector<float> projection;
+    thread_local std::vector<uint64_t> keys;
+    projection.resize(biases_.size());
+    project(query, projection.data());
 
-        int bucketIdx = 0;
-        for (int h = 0; h < numHashFunctions_; h++) {
-            bucketIdx = (bucketIdx << 1) | hash[h];
-        }
+    SearchContext& context = SearchContext::local();
+    auto& results = context.results;
+    results.reset(k);
+    auto visited = visitedPool_.acquire(size_);
 
-        if (bucketIdx < static_cast<int>(hashTables_[t].size())) {
-            for (int idx : hashTables_[t][bucketIdx]) {
-                candidates[idx]++;
+    for (int t = 0; t < numTables; t++) {
+        probeKeys(projection.data() + static_cast<size_t>(t) * config_.numHashFunctions,
+                  config_.numProbes, keys);
+        const Slot* base = slots_.data() + static_cast<size_t>(t) * slotCapacity_;
+        for (uint64_t key : keys) {
+            const Slot& slot = base[findSlot(t, key)];
+            if (slot.count == 0) continue;
+            for (int idx = slot.head; idx >= 0; idx = chains_[static_cast<size_t>(idx) * numTables + t]) {
+                if (!visited->tryVisit(idx)) continue;
+                float dist = distFunc(query, vectorStore_.getVector(idx), dimension_);
+                results.push({dist, idx});
             }
         }
     }
 
-    std::vector<std::pair<float, int>> scoredCandidates;
-    for (const auto& pair : candidates) {
-        const float* vec = vectorStore_.getVector(pair.first);
-        float dist = distFunc(query, vec, dimension_);
-        scoredCandidates.emplace_back(dist, vectorStore_.getId(pair.first));
-    }
-
-    std::partial_sort(scoredCandidates.begin(),
-                      scoredCandidates.begin() + std::min(k, static_cast<int>(scoredCandidates.size())),
-                      scoredCandidates.end());
-
-    int count = std::min(k, static_cast<int>(scoredCandidates.size()));
+    const auto& sorted = results.sortAscending();
+    int count = static_cast<int>(sorted.size());
     for (int i = 0; i < count; i++) {
-        resultDistances[i] = scoredCandidates[i].first;
-        resultIds[i] = scoredCandidates[i].second;
+        resultDistances[i] = sorted[i].first;
+        resultIds[i] = vectorStore_.getId(sorted[i].second);
     }
     *resultCount = count;
 }
 
-void LSHIndex::save(const std::string& /*path*/) {
-    // TODO: Implement save
+size_t LSHIndex::getTableMemoryUsage() const {
+    return slots_.size() * sizeof(Slot) + chains_.size() * sizeof(int32_t);
+}
+
+namespace {
+
+struct LSHFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t numHashTables;
+    int32_t numHashFunctions;
+};
+
+} // namespace
+
+void LSHIndex::save(const std::string& path) {
+    IndexFileWriter writer(path, IndexType::LSH, dimension_);
+
+    LSHFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = size_;
+    meta.capacity = maxElements_;
+    meta.numHashTables = config_.numHashTables;
+    meta.numHashFunctions = config_.numHashFunctions;
+    writer.writeSection(SectionType::LSHMeta, &meta, sizeof(meta));
+
+    writer.writeSection(SectionType::LSHHyperplanes, projections_.data(), projections_.size() * sizeof(float));
+    writer.writeSection(SectionType::LSHBiases, biases_.data(), biases_.size() * sizeof(float));
+    // Both tables are POD and are served straight from the mapping after load
+    writer.writeSection(SectionType::LSHSlots, slots_.data(), slots_.size() * sizeof(Slot));
+    writer.writeSection(SectionType::LSHChains, chains_.data(), chains_.size() * sizeof(int32_t));
+
+    vectorStore_.writeSections(writer);
+
+    writer.finish();
+}
+
+void LSHIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::LSH);
+    if (file->dimension() != dimension_) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+    const std::string corrupted = "Corrupted LSH index file: " + path;
+
+    const auto* meta = file->sectionAs<LSHFileMeta>(SectionType::LSHMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->numHashTables <= 0 || meta->numHashFunctions <= 0 ||
+        meta->numHashFunctions > 64) {
+        throw std::runtime_error(corrupted);
+    }
+    const int numTables = meta->numHashTables;
+    const int numFunctions = meta->numHashFunctions;
+    const size_t hashCount = static_cast<size_t>(numTables) * numFunctions;
+
+    const float* hyperplanes = file->sectionAs<float>(SectionType::LSHHyperplanes, hashCount * dimension_);
+    const float* biases = file->sectionAs<float>(SectionType::LSHBiases, hashCount);
+
+    size_t slotCount = file->sectionSize(SectionType::LSHSlots) / sizeof(Slot);
+    size_t slotCapacity = slotCount / numTables;
+    if (slotCapacity == 0 || slotCapacity * numTables != slotCount ||
+        (slotCapacity & (slotCapacity - 1)) != 0) {
+        throw std::runtime_error(corrupted);
+    }
+    Slot* slots = file->sectionAs<Slot>(SectionType::LSHSlots, slotCount);
+    int32_t* chains = file->sectionAs<int32_t>(SectionType::LSHChains, static_cast<size_t>(n) * numTables);
+
+    std::vector<size_t> bucketCounts(numTables, 0);
+    for (size_t i = 0; i < slotCount; i++) {
+        const Slot& slot = slots[i];
+        if (slot.count < 0 || slot.count > n || (slot.count == 0) != (slot.head < 0) || slot.head >= n) {
+            throw std::runtime_error(corrupted);
+        }
+        if (slot.count > 0) bucketCounts[i / slotCapacity]++;
+    }
+    // Chains always point to an earlier index, which also rules out cycles
+    for (size_t i = 0; i < static_cast<size_t>(n) * numTables; i++) {
+        if (chains[i] < -1 || chains[i] >= static_cast<int32_t>(i / numTables)) {
+            throw std::runtime_error(corrupted);
+        }
+    }
+
+    slots_.attach(slots, slotCount);
+    chains_.attach(chains, static_cast<size_t>(n) * numTables);
+    slotCapacity_ = slotCapacity;
+    bucketCounts_.swap(bucketCounts);
+    config_.numHashTables = numTables;
+    config_.numHashFunctions = numFunctions;
+
+    projections_.assign(hyperplanes, hyperplanes + hashCount * dimension_);
+    biases_.assign(biases, biases + hashCount);
+
+    vectorStore_.attachSections(*file, n);
+    mappedFile_ = std::move(file);
+
+    maxElements_ = std::max(maxElements_, n);
+    size_ = n;
 }
 
-void LSHIndex::load(const std::string& /*path*/) {
-    // TODO: Implement load
+void LSHIndex::detachMapping() {
+    if (!mappedFile_) return;
+    vectorStore_.detach();
+    slots_.detach();
+    chains_.detach();
+    mappedFile_.reset();
 }
 
-} // namespace vectordb
\ No newline at end of file
+} // namespace vectordb
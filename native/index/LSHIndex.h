@@ -1,42 +1,94 @@
 #pragma once
 #include "VectorIndex.h"
 #include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/MappedArray.h"
+#include "../core/VisitedPool.h"
 #include <vector>
 #include <random>
+#include <memory>
 
 namespace vectordb {
 
+struct LSHConfig {
+    int numHashTables = 10;
+    int numHashFunctions = 20;  // 每张表的超平面数，即桶键位数 (最多 64)
+    // 每张表探测的桶数 (多探测 LSH)：1 为只查查询所在的桶，
+    // 其余按翻转位的投影间隔平方和从小到大依次探测相邻桶
+    int numProbes = 1;
+};
+
+/**
+ * 随机超平面 LSH 索引
+ * 所有表的超平面连成一个 [numTables * numFunctions][dimension] 矩阵，一次 GEMV 算出全部投影；
+ * 每张表的桶键按位打包成 uint64，经开放寻址表 (线性探测) 找到桶，
+ * 桶内向量以链表串在 chains_ 中 (每个向量每张表一个 next 下标)，插入无需单独分配；
+ * 这两个数组都是 POD，save 后可以 mmap 原样使用。
+ */
 class LSHIndex : public VectorIndex {
 public:
     LSHIndex(int dimension, int maxElements);
     LSHIndex(int dimension, int maxElements, int numHashTables, int numHashFunctions);
+    LSHIndex(int dimension, int maxElements, const LSHConfig& config);
 
     void add(int id, const float* vector) override;
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
                int* resultCount) override;
+    using VectorIndex::search;  // 带过滤的重载使用基类的放大 k 实现
     void save(const std::string& path) override;
     void load(const std::string& path) override;
     int size() const override { return size_; }
     int dimension() const override { return dimension_; }
     int capacity() const override { return maxElements_; }
 
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
+
+    // 查询时每张表探测的桶数，不影响已建好的表
+    void setNumProbes(int numProbes) { config_.numProbes = numProbes > 0 ? numProbes : 1; }
+    int getNumProbes() const { return config_.numProbes; }
+
+    // 哈希表与桶链占用的字节数 (不含原始向量)
+    size_t getTableMemoryUsage() const;
+
 private:
+    // 开放寻址表的一个槽: count == 0 为空槽
+    struct Slot {
+        uint64_t key;
+        int32_t head;   // 桶内最后插入的向量下标，沿 chains_ 向前
+        int32_t count;
+    };
+
     int dimension_;
     int maxElements_;
-    int numHashTables_;
-    int numHashFunctions_;
+    LSHConfig config_;
     int size_ = 0;
 
     VectorStore vectorStore_;
-    std::vector<std::vector<std::vector<float>>> hashFunctions_;
-    std::vector<std::vector<float>> hashBiases_;
-    std::vector<std::vector<std::vector<int>>> hashTables_;
+    std::vector<float> projections_;  // [numTables * numFunctions][dimension]
+    std::vector<float> biases_;       // [numTables * numFunctions]
+
+    MappedArray<Slot> slots_;         // [numTables][slotCapacity_]
+    MappedArray<int32_t> chains_;     // [size][numTables] 同一桶中的上一个向量，-1 结束
+    size_t slotCapacity_ = 0;         // 每张表的槽数，2 的幂
+    std::vector<size_t> bucketCounts_;  // 每张表的非空桶数
 
     std::mt19937 rng_;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+    mutable VisitedPool visitedPool_;
 
     void generateHashFunctions();
-    std::vector<int> computeHash(const float* vector, int tableIdx);
+    void detachMapping();
+    // 一次 GEMV 算出 vector 在全部超平面上的投影 (已加偏置)，写入 out [numTables * numFunctions]
+    void project(const float* vector, float* out) const;
+    uint64_t bucketKey(const float* projection) const;
+    // key 所在的槽，或应插入的空槽
+    size_t findSlot(int table, uint64_t key) const;
+    void insert(int table, uint64_t key, int index);
+    void rehash(size_t slotCapacity);
+    // 按探测代价从小到大生成一张表的 numProbes 个桶键
+    void probeKeys(const float* projection, int numProbes, std::vector<uint64_t>& keys) const;
 };
 
 } // namespace vectordb
@@ -1,11 +1,13 @@
 #include "PQIndex.h"
+#include "../compute/ADCUtils.h"
+#include "../compute/KMeans.h"
+#include "../core/ThreadPool.h"
 #include <stdexcept>
-#include <random>
 #include <algorithm>
 #include <cmath>
 #include <limits>
 #include <thread>
-#include <future>
+#include <cstring>
 
 namespace vectordb {
 
@@ -18,12 +20,16 @@ PQIndex::PQIndex(int dimension, int maxElements, const PQConfig& config)
     if (dimension % config.M != 0) {
         throw std::invalid_argument("Dimension must be divisible by M");
     }
+    if (config.nBits == 4 && config.M > FASTSCAN_MAX_M) {
+        throw std::invalid_argument("4-bit fast scan supports at most 256 subspaces");
+    }
 
     subDim_ = dimension / config.M;
     nCentroids_ = 1 << config.nBits;
 
     codebooks_.resize(static_cast<size_t>(config.M) * nCentroids_ * subDim_);
     distanceFunc_ = getEuclideanDistanceFunc();
+    fastScanFunc_ = getFastScanFunc();
 }
 
 void PQIndex::train(int nSamples, const float* samples) {
@@ -31,6 +37,18 @@ void PQIndex::train(int nSamples, const float* samples) {
         throw std::invalid_argument("Invalid training samples");
     }
 
+    // Codebooks for COSINE are learned on the unit sphere, where IP over codes approximates cosine
+    std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        const int dim = vectorStore_.dimension();
+        normalized.resize(static_cast<size_t>(nSamples) * dim);
+        for (int i = 0; i < nSamples; i++) {
+            normalizeVector(samples + static_cast<size_t>(i) * dim, dim,
+                            normalized.data() + static_cast<size_t>(i) * dim);
+        }
+        samples = normalized.data();
+    }
+
     for (int m = 0; m < config_.M; m++) {
         trainSubspace(m, nSamples, samples);
     }
@@ -49,59 +67,11 @@ void PQIndex::trainSubspace(int subspaceIdx, int nSamples, const float* samples)
         std::copy(vec, vec + subDim, subData.data() + static_cast<size_t>(i) * subDim);
     }
 
-    std::mt19937 rng(42 + subspaceIdx);
-    std::uniform_int_distribution<int> dist(0, nSamples - 1);
-
-    for (int i = 0; i < nCentroids; i++) {
-        int sampleIdx = dist(rng);
-        float* centroid = getCodebookCentroid(subspaceIdx, i);
-        const float* sample = subData.data() + static_cast<size_t>(sampleIdx) * subDim;
-        std::copy(sample, sample + subDim, centroid);
-    }
-
-    std::vector<int> assignments(nSamples);
-    std::vector<int> clusterSizes(nCentroids);
-
-    for (int iter = 0; iter < config_.maxIterations; iter++) {
-        bool changed = false;
-        for (int i = 0; i < nSamples; i++) {
-            const float* sample = subData.data() + static_cast<size_t>(i) * subDim;
-            int nearest = findNearestCentroid(subspaceIdx, sample);
-            if (assignments[i] != nearest) {
-                assignments[i] = nearest;
-                changed = true;
-            }
-        }
-
-        if (!changed) break;
-
-        std::fill(clusterSizes.begin(), clusterSizes.end(), 0);
-        for (int i = 0; i < nCentroids; i++) {
-            float* centroid = getCodebookCentroid(subspaceIdx, i);
-            std::fill(centroid, centroid + subDim, 0.0f);
-        }
-
-        for (int i = 0; i < nSamples; i++) {
-            int cluster = assignments[i];
-            float* centroid = getCodebookCentroid(subspaceIdx, cluster);
-            const float* sample = subData.data() + static_cast<size_t>(i) * subDim;
-
-            for (int d = 0; d < subDim; d++) {
-                centroid[d] += sample[d];
-            }
-            clusterSizes[cluster]++;
-        }
-
-        for (int i = 0; i < nCentroids; i++) {
-            if (clusterSizes[i] > 0) {
-                float* centroid = getCodebookCentroid(subspaceIdx, i);
-                float invSize = 1.0f / clusterSizes[i];
-                for (int d = 0; d < subDim; d++) {
-                    centroid[d] *= invSize;
-                }
-            }
-        }
-    }
+    KMeansConfig kmeans;
+    kmeans.k = nCentroids;
+    kmeans.maxIterations = config_.maxIterations;
+    kmeans.seed = 42 + subspaceIdx;
+    trainKMeans(subData.data(), nSamples, subDim, kmeans, getCodebookCentroid(subspaceIdx, 0));
 }
 
 int PQIndex::findNearestCentroid(int subspaceIdx, const float* subVector) {
@@ -125,6 +95,8 @@ void PQIndex::add(int id, const float* vector) {
         throw std::runtime_error("PQ index must be trained before adding vectors");
     }
 
+    detachMapping();
+
     std::vector<uint8_t> codes(config_.M);
     encode(vector, codes.data());
 
@@ -132,11 +104,35 @@ void PQIndex::add(int id, const float* vector) {
 
     codes_.resize(static_cast<size_t>(index + 1) * config_.M);
     std::copy(codes.begin(), codes.end(), codes_.data() + static_cast<size_t>(index) * config_.M);
+    packCode(index);
 
     size_++;
 }
 
+bool PQIndex::remove(int id) {
+    const int index = vectorStore_.findIndex(id);
+    return index >= 0 && vectorStore_.markDeleted(index);
+}
+
+void PQIndex::packCode(int index) {
+    if (!useFastScan()) return;
+    const size_t blockBytes = fastScanBlockBytes(config_.M);
+    const size_t needed = (static_cast<size_t>(index) / FASTSCAN_BLOCK + 1) * blockBytes;
+    if (packedCodes_.size() < needed) {
+        packedCodes_.resize(needed, 0);
+    }
+    packFastScanCode(codes_.data() + static_cast<size_t>(index) * config_.M, config_.M, index,
+                     packedCodes_.data());
+}
+
 void PQIndex::encode(const float* vector, uint8_t* codes) {
+    thread_local std::vector<float> normalized;
+    if (config_.metric == Metric::COSINE) {
+        normalized.resize(vectorStore_.dimension());
+        normalizeVector(vector, vectorStore_.dimension(), normalized.data());
+        vector = normalized.data();
+    }
+
     for (int m = 0; m < config_.M; m++) {
         const float* subVector = vector + static_cast<size_t>(m) * subDim_;
         codes[m] = static_cast<uint8_t>(findNearestCentroid(m, subVector));
@@ -145,24 +141,39 @@ void PQIndex::encode(const float* vector, uint8_t* codes) {
 
 void PQIndex::search(const float* query, int k,
                     int* resultIds, float* resultDistances,
-                    int* resultCount) {
+                    int* resultCount, const IDFilter* filter) {
     if (!trained_) {
         *resultCount = 0;
         return;
     }
 
-    std::vector<float> distanceTable(static_cast<size_t>(config_.M) * nCentroids_);
-    BatchDistanceFunc batchDistFunc = getBatchEuclideanDistanceFunc();
-
-    for (int m = 0; m < config_.M; m++) {
-        const float* querySub = query + static_cast<size_t>(m) * subDim_;
-        float* distTableSub = distanceTable.data() + static_cast<size_t>(m) * nCentroids_;
-        const float* codebookStart = codebooks_.data() +
-            static_cast<size_t>(m) * nCentroids_ * subDim_;
-        batchDistFunc(querySub, codebookStart, nCentroids_, subDim_, distTableSub);
+    std::vector<float> normalizedQuery;
+    if (config_.metric == Metric::COSINE) {
+        normalizedQuery.resize(vectorStore_.dimension());
+        normalizeVector(query, vectorStore_.dimension(), normalizedQuery.data());
+        query = normalizedQuery.data();
     }
 
+    std::vector<float> distanceTable(static_cast<size_t>(config_.M) * nCentroids_);
+    buildADCTable(config_.metric, query, codebooks_.data(), config_.M, nCentroids_, subDim_,
+                  distanceTable.data());
+    // Table sums are -<q, x> for COSINE, shift to 1 - cos
+    const float distanceOffset = config_.metric == Metric::COSINE ? 1.0f : 0.0f;
+
     std::vector<std::pair<float, int>> distances;
+    if (useFastScan()) {
+        scanFastScan(distanceTable.data(), k, filter, distances);
+        for (auto& entry : distances) {
+            entry.first += distanceOffset;
+        }
+        int count = std::min(k, static_cast<int>(distances.size()));
+        for (int i = 0; i < count; i++) {
+            resultDistances[i] = distances[i].first;
+            resultIds[i] = distances[i].second;
+        }
+        *resultCount = count;
+        return;
+    }
     distances.reserve(size_);
 
     std::vector<const float*> distTableRows(config_.M);
@@ -175,6 +186,8 @@ void PQIndex::search(const float* query, int k,
         int blockEnd = std::min(blockStart + blockSize, size_);
 
         for (int i = blockStart; i < blockEnd; i++) {
+            if (vectorStore_.isDeleted(i)) continue;
+            if (filter && !filter->contains(vectorStore_.getId(i))) continue;
             float dist = 0.0f;
             const uint8_t* codePtr = codes_.data() + static_cast<size_t>(i) * config_.M;
 
@@ -193,7 +206,7 @@ void PQIndex::search(const float* query, int k,
                 dist += distTableRows[m][codePtr[m]];
             }
 
-            distances.emplace_back(dist, vectorStore_.getId(i));
+            distances.emplace_back(dist + distanceOffset, vectorStore_.getId(i));
         }
     }
 
@@ -212,11 +225,66 @@ void PQIndex::search(const float* query, int k,
     *resultCount = count;
 }
 
+void PQIndex::scanFastScan(const float* distanceTable, int k, const IDFilter* filter,
+                           std::vector<std::pair<float, int>>& distances) const {
+    const int M = config_.M;
+    const int paddedM = fastScanPaddedM(M);
+    std::vector<uint8_t> lut(static_cast<size_t>(paddedM) * 16);
+    float bias, scale;
+    quantizeFastScanLUT(distanceTable, M, lut.data(), &bias, &scale);
+
+    // Keep the best rerankCount by quantized sum; ties with the current worst are dropped
+    const int rerankCount = std::min(size_, std::max(k, k * config_.fastScanRerankFactor));
+    std::vector<std::pair<uint16_t, int>> heap;
+    heap.reserve(rerankCount + 1);
+
+    // Scan a few blocks per call so the sums stay in L1
+    constexpr size_t blocksPerChunk = 8;
+    uint16_t sums[blocksPerChunk * FASTSCAN_BLOCK];
+    const size_t blockBytes = fastScanBlockBytes(M);
+    const size_t nBlocks = (static_cast<size_t>(size_) + FASTSCAN_BLOCK - 1) / FASTSCAN_BLOCK;
+
+    for (size_t chunk = 0; chunk < nBlocks; chunk += blocksPerChunk) {
+        const size_t count = std::min(blocksPerChunk, nBlocks - chunk);
+        fastScanFunc_(packedCodes_.data() + chunk * blockBytes, count, paddedM, lut.data(), sums);
+
+        const int base = static_cast<int>(chunk * FASTSCAN_BLOCK);
+        const int valid = std::min(static_cast<int>(count * FASTSCAN_BLOCK), size_ - base);
+        for (int i = 0; i < valid; i++) {
+            if (vectorStore_.isDeleted(base + i)) continue;
+            if (filter && !filter->contains(vectorStore_.getId(base + i))) continue;
+            if (static_cast<int>(heap.size()) < rerankCount) {
+                heap.emplace_back(sums[i], base + i);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (sums[i] < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = {sums[i], base + i};
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+    }
+
+    // Exact ADC over the float table for the survivors
+    distances.clear();
+    distances.reserve(heap.size());
+    for (const auto& entry : heap) {
+        const int index = entry.second;
+        const float dist = adcDistanceScalar(distanceTable, codes_.data() + static_cast<size_t>(index) * M,
+                                             M, nCentroids_);
+        distances.emplace_back(dist, vectorStore_.getId(index));
+    }
+    const size_t keep = std::min(static_cast<size_t>(k), distances.size());
+    std::partial_sort(distances.begin(), distances.begin() + keep, distances.end());
+    distances.resize(keep);
+}
+
 void PQIndex::addBatch(const float* vectors, const int* ids, int n) {
     if (!trained_) {
         throw std::runtime_error("PQ index must be trained before adding vectors");
     }
 
+    detachMapping();
+
     const int dim = vectorStore_.dimension();
 
     std::vector<std::vector<uint8_t>> batchCodes(n);
@@ -224,25 +292,11 @@ void PQIndex::addBatch(const float* vectors, const int* ids, int n) {
         batchCodes[i].resize(config_.M);
     }
 
-    int nThreads = std::min(4, n);
-    int chunkSize = (n + nThreads - 1) / nThreads;
-    std::vector<std::future<void>> futures;
-
-    for (int t = 0; t < nThreads; t++) {
-        int start = t * chunkSize;
-        int end = std::min(start + chunkSize, n);
-        if (start >= end) break;
-
-        futures.push_back(std::async(std::launch::async, [this, vectors, &batchCodes, dim, start, end]() {
-            for (int i = start; i < end; i++) {
-                encode(vectors + static_cast<size_t>(i) * dim, batchCodes[i].data());
-            }
-        }));
-    }
-
-    for (auto& f : futures) {
-        f.get();
-    }
+    ThreadPool::instance().parallelFor(0, n, 64, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            encode(vectors + static_cast<size_t>(i) * dim, batchCodes[i].data());
+        }
+    }, numThreads_);
 
     for (int i = 0; i < n; i++) {
         const float* vec = vectors + static_cast<size_t>(i) * dim;
@@ -251,12 +305,13 @@ void PQIndex::addBatch(const float* vectors, const int* ids, int n) {
         codes_.resize(static_cast<size_t>(index + 1) * config_.M);
         std::copy(batchCodes[i].begin(), batchCodes[i].end(),
                   codes_.data() + static_cast<size_t>(index) * config_.M);
+        packCode(index);
         size_++;
     }
 }
 
 void PQIndex::searchBatch(const float* queries, int nQueries, int k,
-                         int* resultIds, float* resultDistances) {
+                         int* resultIds, float* resultDistances, SearchStats* queryStats) {
     if (!trained_) {
         for (int i = 0; i < nQueries; i++) {
             int* ids = resultIds + static_cast<size_t>(i) * k;
@@ -271,32 +326,116 @@ void PQIndex::searchBatch(const float* queries, int nQueries, int k,
 
     const int dim = vectorStore_.dimension();
 
-    int nThreads = std::min(4, nQueries);
-    int chunkSize = (nQueries + nThreads - 1) / nThreads;
-    std::vector<std::future<void>> futures;
-
-    for (int t = 0; t < nThreads; t++) {
-        int start = t * chunkSize;
-        int end = std::min(start + chunkSize, nQueries);
-        if (start >= end) break;
-
-        futures.push_back(std::async(std::launch::async, [this, queries, k, resultIds, resultDistances, dim, start, end]() {
-            for (int i = start; i < end; i++) {
-                const float* query = queries + static_cast<size_t>(i) * dim;
-                int* ids = resultIds + static_cast<size_t>(i) * k;
-                float* dists = resultDistances + static_cast<size_t>(i) * k;
-                int count;
-                search(query, k, ids, dists, &count);
+    ThreadPool::instance().parallelFor(0, nQueries, 1, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) {
+            const float* query = queries + static_cast<size_t>(i) * dim;
+            int* ids = resultIds + static_cast<size_t>(i) * k;
+            float* dists = resultDistances + static_cast<size_t>(i) * k;
+            int count;
+            SearchStatsScope scope(queryStats ? queryStats + i : nullptr, queryStats == nullptr);
+            search(query, k, ids, dists, &count);
+            for (int j = count; j < k; j++) {
+                ids[j] = -1;
+                dists[j] = -1.0f;
             }
-        }));
+        }
+    }, numThreads_);
+}
+
+namespace {
+
+struct PQFileMeta {
+    int32_t size;
+    int32_t capacity;
+    int32_t trained;
+    int32_t M;
+    int32_t nBits;
+    int32_t maxIterations;
+    int32_t subDim;
+    int32_t nCentroids;
+    int32_t hasRawVectors;
+    int32_t metric;
+};
+
+} // namespace
+
+void PQIndex::save(const std::string& path) {
+    IndexFileWriter writer(path, IndexType::PQ, vectorStore_.dimension());
+
+    PQFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.size = size_;
+    meta.capacity = vectorStore_.capacity();
+    meta.trained = trained_ ? 1 : 0;
+    meta.M = config_.M;
+    meta.nBits = config_.nBits;
+    meta.maxIterations = config_.maxIterations;
+    meta.subDim = subDim_;
+    meta.nCentroids = nCentroids_;
+    meta.hasRawVectors = config_.saveRawVectors ? 1 : 0;
+    meta.metric = static_cast<int32_t>(config_.metric);
+    writer.writeSection(SectionType::PQMeta, &meta, sizeof(meta));
+
+    writer.writeSection(SectionType::PQCodebooks, codebooks_.data(),
+                        codebooks_.size() * sizeof(float));
+    writer.writeSection(SectionType::PQCodes, codes_.data(),
+                        static_cast<size_t>(size_) * config_.M);
+    vectorStore_.writeSections(writer, config_.saveRawVectors);
+
+    writer.finish();
+}
+
+void PQIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::PQ);
+    const int dim = vectorStore_.dimension();
+    if (file->dimension() != dim) {
+        throw std::runtime_error("Index file dimension mismatch");
     }
 
-    for (auto& f : futures) {
-        f.get();
+    const auto* meta = file->sectionAs<PQFileMeta>(SectionType::PQMeta, 1);
+    const int n = meta->size;
+    if (n < 0 || meta->M <= 0 || meta->subDim * meta->M != dim ||
+        meta->nCentroids != (1 << meta->nBits) || !isValidMetric(meta->metric) ||
+        (meta->nBits == 4 && meta->M > FASTSCAN_MAX_M)) {
+        throw std::runtime_error("Corrupted PQ index file: " + path);
+    }
+
+    const size_t codebookCount = static_cast<size_t>(meta->M) * meta->nCentroids * meta->subDim;
+    const float* codebooks = file->sectionAs<float>(SectionType::PQCodebooks, codebookCount);
+    uint8_t* codes = file->sectionAs<uint8_t>(SectionType::PQCodes, static_cast<size_t>(n) * meta->M);
+
+    config_.M = meta->M;
+    config_.nBits = meta->nBits;
+    config_.maxIterations = meta->maxIterations;
+    config_.metric = static_cast<Metric>(meta->metric);
+    subDim_ = meta->subDim;
+    nCentroids_ = meta->nCentroids;
+
+    // Codebooks are small and read on every query, keep a private copy
+    codebooks_.assign(codebooks, codebooks + codebookCount);
+    codes_.attach(codes, static_cast<size_t>(n) * meta->M);
+    vectorStore_.attachSections(*file, n);
+    mappedFile_ = std::move(file);
+
+    trained_ = meta->trained != 0;
+    size_ = n;
+
+    // The packed layout is derived data, rebuilt from the mapped codes
+    packedCodes_.clear();
+    for (int i = 0; i < n; i++) {
+        packCode(i);
     }
 }
 
-void PQIndex::save(const std::string& /*path*/) {}
-void PQIndex::load(const std::string& /*path*/) {}
+void PQIndex::detachMapping() {
+    if (!mappedFile_) return;
+    if (!vectorStore_.hasVectors()) {
+        throw std::runtime_error("PQ index was loaded without raw vectors and is read-only");
+    }
+
+    vectorStore_.detach();
+    codes_.detach();
+    mappedFile_.reset();
+}
 
 } // namespace vectordb
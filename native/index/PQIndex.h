@@ -1,9 +1,13 @@
 #pragma once
 #include "VectorIndex.h"
 #include "../core/VectorStore.h"
+#include "../core/IndexFile.h"
+#include "../core/MappedArray.h"
 #include "../compute/DistanceUtils.h"
+#include "../compute/FastScan.h"
 #include <vector>
 #include <cstdint>
+#include <memory>
 
 namespace vectordb {
 
@@ -11,6 +15,11 @@ struct PQConfig {
     int M = 8;
     int nBits = 8;
     int maxIterations = 25;
+    bool saveRawVectors = true;  // false 时 save 只写码本和 PQ 编码，加载后只读
+    Metric metric = Metric::L2;  // COSINE 时在归一化后的向量上训练和编码
+    // nBits == 4 时使用快速扫描: 先按量化距离表选出 k * fastScanRerankFactor 个候选，
+    // 再用 float 距离表重算排序
+    int fastScanRerankFactor = 4;
 };
 
 class PQIndex : public VectorIndex {
@@ -21,18 +30,31 @@ public:
     void add(int id, const float* vector) override;
     void search(const float* query, int k,
                int* resultIds, float* resultDistances,
-               int* resultCount) override;
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    // 扫描编码时直接跳过被过滤的向量
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
     void save(const std::string& path) override;
     void load(const std::string& path) override;
-    int size() const override { return size_; }
+    int size() const override { return size_ - vectorStore_.deletedCount(); }
     int dimension() const override { return vectorStore_.dimension(); }
     int capacity() const override { return vectorStore_.capacity(); }
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override { return vectorStore_.setMemoryPolicy(policy); }
 
     void train(int nSamples, const float* samples);
     bool isTrained() const { return trained_; }
-    void addBatch(const float* vectors, const int* ids, int n);
+    void addBatch(const float* vectors, const int* ids, int n) override;
+    // 删除只打标记，扫描编码时跳过；update 沿用基类的删除后重新添加
+    bool remove(int id) override;
+    // 结果不足 k 个时以 id = -1、距离 = -1 补齐
     void searchBatch(const float* queries, int nQueries, int k,
-                    int* resultIds, float* resultDistances);
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+
+    // 是否直接在 mmap 映射上提供服务 (load 之后、首次写入之前)
+    bool isMapped() const { return mappedFile_ != nullptr; }
 
 private:
     VectorStore vectorStore_;
@@ -42,12 +64,22 @@ private:
     int subDim_ = 0;
     int nCentroids_ = 0;
     std::vector<float> codebooks_;
-    std::vector<uint8_t> codes_;
+    MappedArray<uint8_t> codes_;
     DistanceFunc distanceFunc_;
+    std::shared_ptr<MappedIndexFile> mappedFile_;
+
+    // 快速扫描布局的编码副本，由 codes_ 派生，不写入文件
+    std::vector<uint8_t> packedCodes_;
+    FastScanFunc fastScanFunc_;
+    bool useFastScan() const { return config_.nBits == 4; }
+    void packCode(int index);
+    void scanFastScan(const float* distanceTable, int k, const IDFilter* filter,
+                      std::vector<std::pair<float, int>>& distances) const;
 
     void trainSubspace(int subspaceIdx, int nSamples, const float* samples);
     int findNearestCentroid(int subspaceIdx, const float* subVector);
     void encode(const float* vector, uint8_t* codes);
+    void detachMapping();
     float* getCodebookCentroid(int subspaceIdx, int centroidIdx) {
         return codebooks_.data() +
                (static_cast<size_t>(subspaceIdx) * nCentroids_ + centroidIdx) * subDim_;
@@ -0,0 +1,340 @@
+#include "ShardedIndex.h"
+#include "../core/IndexFile.h"
+#include "../core/ThreadPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace vectordb {
+
+namespace {
+
+struct ShardedFileMeta {
+    int32_t numShards;
+    int32_t size;
+};
+
+// Murmur3 finalizer, so that consecutive ids spread evenly over the shards
+inline uint32_t mixId(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16;
+    return x;
+}
+
+} // namespace
+
+ShardedIndex::ShardedIndex(std::vector<std::unique_ptr<VectorIndex>> shards)
+    : shards_(std::move(shards)) {
+    if (shards_.empty()) {
+        throw std::invalid_argument("ShardedIndex needs at least one shard");
+    }
+    for (const auto& shard : shards_) {
+        if (!shard || shard->dimension() != shards_.front()->dimension()) {
+            throw std::invalid_argument("All shards must be non-null and share one dimension");
+        }
+    }
+}
+
+ShardedIndex::ShardedIndex(int numShards, const ShardFactory& factory)
+    : ShardedIndex([&] {
+          std::vector<std::unique_ptr<VectorIndex>> shards;
+          for (int i = 0; i < numShards; i++) {
+              shards.push_back(factory(i));
+          }
+          return shards;
+      }()) {}
+
+int ShardedIndex::shardOf(int id) const {
+    return static_cast<int>(mixId(static_cast<uint32_t>(id)) % shards_.size());
+}
+
+std::string ShardedIndex::shardPath(const std::string& path, int shard) {
+    return path + ".shard" + std::to_string(shard);
+}
+
+void ShardedIndex::add(int id, const float* vector) {
+    shards_[shardOf(id)]->add(id, vector);
+}
+
+bool ShardedIndex::remove(int id) {
+    return shards_[shardOf(id)]->remove(id);
+}
+
+bool ShardedIndex::update(int id, const float* vector) {
+    return shards_[shardOf(id)]->update(id, vector);
+}
+
+int ShardedIndex::compact() {
+    int reclaimed = 0;
+    for (auto& shard : shards_) {
+        reclaimed += shard->compact();
+    }
+    return reclaimed;
+}
+
+void ShardedIndex::optimize() {
+    for (auto& shard : shards_) {
+        shard->optimize();
+    }
+}
+
+int ShardedIndex::size() const {
+    int total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->size();
+    }
+    return total;
+}
+
+int ShardedIndex::capacity() const {
+    int total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->capacity();
+    }
+    return total;
+}
+
+MemoryPolicy ShardedIndex::setMemoryPolicy(const MemoryPolicy& policy) {
+    MemoryPolicy applied;
+    for (auto& shard : shards_) {
+        applied = shard->setMemoryPolicy(policy);
+    }
+    return applied;
+}
+
+int ShardedIndex::mergeResults(const int* shardIds, const float* shardDists, const int* shardCounts,
+                               int numShards, int k, int* resultIds, float* resultDistances) {
+    // Min-heap of (distance, shard, position) over the head of every shard's sorted list
+    std::vector<std::tuple<float, int, int>> heap;
+    heap.reserve(numShards);
+    for (int s = 0; s < numShards; s++) {
+        if (shardCounts[s] > 0) {
+            heap.emplace_back(shardDists[static_cast<size_t>(s) * k], s, 0);
+        }
+    }
+    auto greater = std::greater<std::tuple<float, int, int>>();
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    int count = 0;
+    while (count < k && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        auto [dist, s, pos] = heap.back();
+        heap.pop_back();
+
+        resultIds[count] = shardIds[static_cast<size_t>(s) * k + pos];
+        resultDistances[count] = dist;
+        count++;
+
+        if (++pos < shardCounts[s]) {
+            heap.emplace_back(shardDists[static_cast<size_t>(s) * k + pos], s, pos);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    return count;
+}
+
+void ShardedIndex::search(const float* query, int k,
+                         int* resultIds, float* resultDistances,
+                         int* resultCount, const IDFilter* filter) {
+    if (k <= 0) {
+        *resultCount = 0;
+        return;
+    }
+
+    SearchStatsScope scope;
+    const int numShards = static_cast<int>(shards_.size());
+    std::vector<int> ids(static_cast<size_t>(numShards) * k);
+    std::vector<float> dists(static_cast<size_t>(numShards) * k);
+    std::vector<int> counts(numShards, 0);
+    std::vector<SearchStats> shardStats(numShards);
+
+    ThreadPool::instance().parallelFor(0, numShards, 1, [&](int64_t start, int64_t end) {
+        for (int64_t s = start; s < end; s++) {
+            SearchStatsScope shardScope(&shardStats[s], false);
+            shards_[s]->search(query, k, ids.data() + s * k, dists.data() + s * k, &counts[s], filter);
+        }
+    }, numThreads_);
+    mergeShardStats(shardStats);
+
+    *resultCount = mergeResults(ids.data(), dists.data(), counts.data(), numShards, k,
+                                resultIds, resultDistances);
+}
+
+void ShardedIndex::rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                               const IDFilter* filter) {
+    SearchStatsScope scope;
+    result.clear();
+    const int numShards = static_cast<int>(shards_.size());
+    std::vector<RangeSearchResult> partial(numShards);
+    std::vector<SearchStats> shardStats(numShards);
+
+    ThreadPool::instance().parallelFor(0, numShards, 1, [&](int64_t start, int64_t end) {
+        for (int64_t s = start; s < end; s++) {
+            SearchStatsScope shardScope(&shardStats[s], false);
+            shards_[s]->rangeSearch(query, radius, partial[s], filter);
+        }
+    }, numThreads_);
+    mergeShardStats(shardStats);
+
+    // Shards hold disjoint ids, concatenating and re-sorting is the whole merge
+    for (const auto& part : partial) {
+        result.ids.insert(result.ids.end(), part.ids.begin(), part.ids.end());
+        result.distances.insert(result.distances.end(), part.distances.begin(), part.distances.end());
+    }
+    result.sort();
+}
+
+void ShardedIndex::mergeShardStats(const std::vector<SearchStats>& shardStats) {
+    for (const SearchStats& part : shardStats) {
+        searchstats::merge(part);
+    }
+}
+
+void ShardedIndex::recordBatchStats(const std::vector<SearchStats>& shardStats, int nQueries,
+                                    SearchStats* queryStats) {
+    if (shardStats.empty()) {
+        if (queryStats) std::fill_n(queryStats, nQueries, SearchStats{});
+        return;
+    }
+
+    const size_t numShards = shardStats.size() / nQueries;
+    for (int q = 0; q < nQueries; q++) {
+        // Shards search in parallel, so a query takes as long as its slowest shard
+        SearchStats query;
+        for (size_t s = 0; s < numShards; s++) {
+            const SearchStats& part = shardStats[s * nQueries + q];
+            query.distanceComputations += part.distanceComputations;
+            query.hops += part.hops;
+            query.visitedNodes += part.visitedNodes;
+            query.lockWaitNanos += part.lockWaitNanos;
+            query.latencyNanos = std::max(query.latencyNanos, part.latencyNanos);
+        }
+        if (queryStats) {
+            queryStats[q] = query;
+        } else {
+            searchstats::record(query);
+        }
+    }
+}
+
+void ShardedIndex::searchBatch(const float* queries, int nQueries, int k,
+                              int* resultIds, float* resultDistances, SearchStats* queryStats) {
+    if (nQueries <= 0 || k <= 0) return;
+
+    const int numShards = static_cast<int>(shards_.size());
+    const size_t perShard = static_cast<size_t>(nQueries) * k;
+    std::vector<int> ids(perShard * numShards);
+    std::vector<float> dists(perShard * numShards);
+
+    // Shards report per-query counts without recording them; each query is recorded once below
+    std::vector<SearchStats> shardStats(searchstats::enabled() ? static_cast<size_t>(nQueries) * numShards : 0);
+    SearchStats* statsBase = shardStats.empty() ? nullptr : shardStats.data();
+
+    // Each shard runs its own (already parallel) batch search; nesting on the pool is safe
+    ThreadPool::instance().parallelFor(0, numShards, 1, [&](int64_t start, int64_t end) {
+        for (int64_t s = start; s < end; s++) {
+            shards_[s]->searchBatch(queries, nQueries, k, ids.data() + s * perShard, dists.data() + s * perShard,
+                                    statsBase ? statsBase + s * nQueries : nullptr);
+        }
+    }, numThreads_);
+    recordBatchStats(shardStats, nQueries, queryStats);
+
+    ThreadPool::instance().parallelFor(0, nQueries, 64, [&](int64_t start, int64_t end) {
+        std::vector<int> queryIds(static_cast<size_t>(numShards) * k);
+        std::vector<float> queryDists(static_cast<size_t>(numShards) * k);
+        std::vector<int> counts(numShards);
+        for (int64_t q = start; q < end; q++) {
+            // Gather this query's padded per-shard lists side by side
+            for (int s = 0; s < numShards; s++) {
+                const size_t offset = s * perShard + static_cast<size_t>(q) * k;
+                std::copy_n(ids.data() + offset, k, queryIds.data() + static_cast<size_t>(s) * k);
+                std::copy_n(dists.data() + offset, k, queryDists.data() + static_cast<size_t>(s) * k);
+                counts[s] = static_cast<int>(std::find(ids.data() + offset, ids.data() + offset + k, -1) -
+                                             (ids.data() + offset));
+            }
+
+            int* outIds = resultIds + q * k;
+            float* outDists = resultDistances + q * k;
+            int count = mergeResults(queryIds.data(), queryDists.data(), counts.data(), numShards, k,
+                                     outIds, outDists);
+            for (int j = count; j < k; j++) {
+                outIds[j] = -1;
+                outDists[j] = -1.0f;
+            }
+        }
+    }, numThreads_);
+}
+
+void ShardedIndex::addBatch(const float* vectors, const int* ids, int n) {
+    if (n <= 0) return;
+
+    const int numShards = static_cast<int>(shards_.size());
+    const int dim = dimension();
+
+    // Counting sort of the rows by shard, then one contiguous batch per shard
+    std::vector<int> shardOfRow(n);
+    std::vector<size_t> offsets(numShards + 1, 0);
+    for (int i = 0; i < n; i++) {
+        shardOfRow[i] = shardOf(ids[i]);
+        offsets[shardOfRow[i] + 1]++;
+    }
+    for (int s = 0; s < numShards; s++) {
+        offsets[s + 1] += offsets[s];
+    }
+
+    std::vector<float> grouped(static_cast<size_t>(n) * dim);
+    std::vector<int> groupedIds(n);
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < n; i++) {
+        size_t row = cursor[shardOfRow[i]]++;
+        std::memcpy(grouped.data() + row * dim, vectors + static_cast<size_t>(i) * dim, sizeof(float) * dim);
+        groupedIds[row] = ids[i];
+    }
+
+    ThreadPool::instance().parallelFor(0, numShards, 1, [&](int64_t start, int64_t end) {
+        for (int64_t s = start; s < end; s++) {
+            const size_t begin = offsets[s];
+            const int count = static_cast<int>(offsets[s + 1] - begin);
+            if (count > 0) {
+                shards_[s]->addBatch(grouped.data() + begin * dim, groupedIds.data() + begin, count);
+            }
+        }
+    }, numThreads_);
+}
+
+void ShardedIndex::save(const std::string& path) {
+    const int numShards = static_cast<int>(shards_.size());
+    for (int s = 0; s < numShards; s++) {
+        shards_[s]->save(shardPath(path, s));
+    }
+
+    // The manifest is written last, so a complete manifest implies complete shards
+    IndexFileWriter writer(path, IndexType::Sharded, dimension());
+    ShardedFileMeta meta;
+    std::memset(&meta, 0, sizeof(meta));
+    meta.numShards = numShards;
+    meta.size = size();
+    writer.writeSection(SectionType::ShardedMeta, &meta, sizeof(meta));
+    writer.finish();
+}
+
+void ShardedIndex::load(const std::string& path) {
+    auto file = MappedIndexFile::open(path, IndexType::Sharded);
+    if (file->dimension() != dimension()) {
+        throw std::runtime_error("Index file dimension mismatch");
+    }
+    const auto* meta = file->sectionAs<ShardedFileMeta>(SectionType::ShardedMeta, 1);
+    if (meta->numShards != static_cast<int32_t>(shards_.size())) {
+        throw std::runtime_error("Shard count mismatch in " + path);
+    }
+
+    for (size_t s = 0; s < shards_.size(); s++) {
+        shards_[s]->load(shardPath(path, static_cast<int>(s)));
+    }
+}
+
+} // namespace vectordb
@@ -0,0 +1,78 @@
+#pragma once
+#include "VectorIndex.h"
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace vectordb {
+
+/**
+ * 分片索引: 把 N 个子索引 (HNSW、IVF 等，类型可以不同但维度必须相同) 组合成一个索引
+ * 插入、删除按 id 的哈希路由到固定分片；查询在共享线程池上并行发给所有分片，
+ * 再用 k 路堆合并各分片的 top-k。每个分片有自己的锁与容量，
+ * 并发语义与子索引相同 (例如 HNSW 分片可以并发 add 与 search)。
+ *
+ * save(path) 在 path 写一个清单文件，第 i 个分片保存在 path + ".shard<i>"；
+ * load 要求分片数与清单一致，子索引的类型与参数由构造时决定。
+ */
+class ShardedIndex : public VectorIndex {
+public:
+    using ShardFactory = std::function<std::unique_ptr<VectorIndex>(int shard)>;
+
+    explicit ShardedIndex(std::vector<std::unique_ptr<VectorIndex>> shards);
+    ShardedIndex(int numShards, const ShardFactory& factory);
+
+    void add(int id, const float* vector) override;
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount) override {
+        search(query, k, resultIds, resultDistances, resultCount, nullptr);
+    }
+    void search(const float* query, int k,
+               int* resultIds, float* resultDistances,
+               int* resultCount, const IDFilter* filter) override;
+    // 各分片并行做范围搜索后拼接并重新排序
+    void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                     const IDFilter* filter = nullptr) override;
+    void save(const std::string& path) override;
+    void load(const std::string& path) override;
+    int size() const override;
+    int dimension() const override { return shards_.front()->dimension(); }
+    int capacity() const override;
+    MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) override;
+
+    // 按分片分组后各分片并行调用子索引的 addBatch
+    void addBatch(const float* vectors, const int* ids, int n) override;
+    // 各分片并行调用子索引的 searchBatch，再逐条查询合并；结果不足 k 个时以 id = -1、距离 = -1 补齐
+    // 开启查询统计时各分片只输出逐条查询的计数，合并后每条查询计入一次 (耗时取最慢的分片)
+    void searchBatch(const float* queries, int nQueries, int k,
+                    int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) override;
+
+    bool remove(int id) override;
+    bool update(int id, const float* vector) override;
+    int compact() override;
+    void optimize() override;
+
+    int numShards() const { return static_cast<int>(shards_.size()); }
+    VectorIndex& shard(int i) { return *shards_[i]; }
+    // id 所属的分片，只取决于 id 与分片数
+    int shardOf(int id) const;
+
+    // 第 shard 个分片的文件路径
+    static std::string shardPath(const std::string& path, int shard);
+
+private:
+    std::vector<std::unique_ptr<VectorIndex>> shards_;
+
+    // 把在工作线程上完成的各分片搜索计数并入调用线程的查询
+    static void mergeShardStats(const std::vector<SearchStats>& shardStats);
+    // shardStats 为 [numShards][nQueries]: 逐条查询把各分片的计数相加、耗时取最大，
+    // 写入 queryStats (非空时) 或计入聚合直方图；shardStats 为空 (未开启统计) 时 queryStats 清零
+    static void recordBatchStats(const std::vector<SearchStats>& shardStats, int nQueries, SearchStats* queryStats);
+
+    // 每个分片 k 个已排序结果 (count 个有效) 合并为全局 top-k
+    static int mergeResults(const int* shardIds, const float* shardDists, const int* shardCounts,
+                            int numShards, int k, int* resultIds, float* resultDistances);
+};
+
+} // namespace vectordb
@@ -1,8 +1,43 @@
 #pragma once
+#include "../core/IDFilter.h"
+#include "../core/MemoryAllocator.h"
+#include "../core/SearchStats.h"
 #include <string>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <utility>
 
 namespace vectordb {
 
+/**
+ * 范围搜索的结果，按距离升序；可在多次搜索间复用以保留容量
+ */
+struct RangeSearchResult {
+    std::vector<int> ids;
+    std::vector<float> distances;
+
+    void clear() {
+        ids.clear();
+        distances.clear();
+    }
+    size_t size() const { return ids.size(); }
+    void push(int id, float distance) {
+        ids.push_back(id);
+        distances.push_back(distance);
+    }
+    // 按距离升序排列 (内部收集阶段可以无序)
+    void sort() {
+        std::vector<std::pair<float, int>> entries(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) entries[i] = {distances[i], ids[i]};
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < entries.size(); i++) {
+            distances[i] = entries[i].first;
+            ids[i] = entries[i].second;
+        }
+    }
+};
+
 /**
  * 向量索引基类接口
  */
@@ -18,20 +53,160 @@ public:
                        int* resultIds, float* resultDistances,
                        int* resultCount) = 0;
 
+    /**
+     * 带过滤的搜索: 只返回 filter 接受的 id，filter 为 nullptr 时等同于上面的 search
+     * 默认实现按 4 倍逐步放大 k 再过滤；HNSW / IVF / PQ 等索引在遍历中直接跳过被过滤的向量
+     */
+    virtual void search(const float* query, int k,
+                       int* resultIds, float* resultDistances,
+                       int* resultCount, const IDFilter* filter) {
+        if (!filter) {
+            search(query, k, resultIds, resultDistances, resultCount);
+            return;
+        }
+
+        std::vector<int> ids;
+        std::vector<float> dists;
+        int count = 0;
+        for (int fetch = k * 4;; fetch *= 4) {
+            fetch = std::min(fetch, std::max(k, size()));
+            ids.resize(fetch);
+            dists.resize(fetch);
+            int found = 0;
+            search(query, fetch, ids.data(), dists.data(), &found);
+
+            count = 0;
+            for (int i = 0; i < found && count < k; i++) {
+                if (filter->contains(ids[i])) {
+                    resultIds[count] = ids[i];
+                    resultDistances[count] = dists[i];
+                    count++;
+                }
+            }
+            if (count == k || found < fetch || fetch >= size()) break;
+        }
+        *resultCount = count;
+    }
+
+    /**
+     * 同 search，并把这次查询的距离计算次数、跳数、访问节点数、锁等待与耗时写入 stats
+     * HNSW / HNSWPQ / IVF / IVFPQ 的 search 自身也会计数并计入聚合直方图 (searchstats::snapshot)；
+     * 其余索引只有耗时。未以 ENABLE_SEARCH_STATS 编译时 stats 全部为 0
+     */
+    void searchWithStats(const float* query, int k,
+                         int* resultIds, float* resultDistances,
+                         int* resultCount, SearchStats* stats, const IDFilter* filter = nullptr) {
+        SearchStatsScope scope(stats);
+        search(query, k, resultIds, resultDistances, resultCount, filter);
+    }
+
+    /**
+     * 范围搜索: 把与 query 距离不超过 radius 的全部向量按距离升序写入 result (先清空)
+     * radius 与 search 返回的距离同一口径 (L2 为平方距离)；filter 非空时只返回它接受的 id
+     * 默认实现按 4 倍逐步放大 k，直到结果中出现超出 radius 的距离；
+     * HNSW 只在半径内扩展图，IVF 按质心距离与列表覆盖半径 (三角不等式) 跳过整张列表
+     */
+    virtual void rangeSearch(const float* query, float radius, RangeSearchResult& result,
+                             const IDFilter* filter = nullptr) {
+        result.clear();
+        const int total = size();
+        if (total <= 0) return;
+
+        std::vector<int> ids;
+        std::vector<float> dists;
+        for (int fetch = std::min(16, total);; fetch = std::min(fetch * 4, total)) {
+            ids.resize(fetch);
+            dists.resize(fetch);
+            int found = 0;
+            search(query, fetch, ids.data(), dists.data(), &found, filter);
+
+            int inside = 0;
+            while (inside < found && dists[inside] <= radius) inside++;
+            if (inside < found || found < fetch || fetch >= total) {
+                for (int i = 0; i < inside; i++) result.push(ids[i], dists[i]);
+                return;
+            }
+        }
+    }
+
+    /**
+     * 按外部 id 删除向量，id 不存在或索引不支持删除时返回 false
+     * 多数索引只打删除标记，搜索时跳过，空间由 compact() 回收
+     */
+    virtual bool remove(int id) { (void)id; return false; }
+
+    // 替换 id 对应的向量，id 不存在时返回 false；默认实现为删除后重新添加
+    virtual bool update(int id, const float* vector) {
+        if (!remove(id)) return false;
+        add(id, vector);
+        return true;
+    }
+
+    // 回收已删除向量占用的槽位并修复受影响的结构，返回回收的个数；
+    // 可在后台线程调用，与 search / add 并发执行的索引会在头文件中说明
+    virtual int compact() { return 0; }
+
+    // 重排内部布局以提高搜索的访存局部性 (如图索引按 BFS / Gorder 重新编号节点)，不改变搜索结果；
+    // 适合在批量构建完成后调用一次，不支持的索引为空操作
+    virtual void optimize() {}
+
     // 保存索引
     virtual void save(const std::string& path) = 0;
 
     // 加载索引
     virtual void load(const std::string& path) = 0;
 
-    // 获取当前向量数量
+    // 获取当前向量数量 (不含已删除的)
     virtual int size() const = 0;
 
     // 获取向量维度
     virtual int dimension() const = 0;
 
-    // 获取最大容量
+    // 获取当前容量；基于 VectorStore 分块存储的索引在 add 时自动增长，其余索引以此为上限
     virtual int capacity() const = 0;
+
+    // 批量添加，默认逐条调用 add；vectors 为 n * dimension 的行主序数组
+    virtual void addBatch(const float* vectors, const int* ids, int n) {
+        const int dim = dimension();
+        for (int i = 0; i < n; i++) {
+            add(ids[i], vectors + static_cast<size_t>(i) * dim);
+        }
+    }
+
+    /**
+     * 批量搜索，默认逐条调用 search；结果不足 k 个时以 id = -1、距离 = -1 补齐
+     * queryStats 非空时 (nQueries 个，由调用方清零) 把每条查询的计数写入 queryStats[i]、不计入聚合直方图，
+     * 由调用方合并后再记录 (如分片索引)；按查询块做 GEMM 的索引 (Flat / IVF) 每条查询写入所在块的耗时
+     */
+    virtual void searchBatch(const float* queries, int nQueries, int k,
+                             int* resultIds, float* resultDistances, SearchStats* queryStats = nullptr) {
+        const int dim = dimension();
+        for (int i = 0; i < nQueries; i++) {
+            int* ids = resultIds + static_cast<size_t>(i) * k;
+            float* dists = resultDistances + static_cast<size_t>(i) * k;
+            int count = 0;
+            SearchStatsScope scope(queryStats ? queryStats + i : nullptr, queryStats == nullptr);
+            search(queries + static_cast<size_t>(i) * dim, k, ids, dists, &count);
+            for (int j = count; j < k; j++) {
+                ids[j] = -1;
+                dists[j] = -1.0f;
+            }
+        }
+    }
+
+    /**
+     * 设置向量、邻接表等大数组的页面模式 (显式大页 / 透明大页) 与 NUMA 绑定或交错，
+     * 须在添加向量之前调用，否则抛出 std::logic_error；返回实际生效的模式 (不可用时逐级回退)
+     * 不支持的索引忽略 policy，返回默认模式
+     */
+    virtual MemoryPolicy setMemoryPolicy(const MemoryPolicy& policy) { (void)policy; return MemoryPolicy{}; }
+
+    // 批量搜索 / 批量添加最多使用的线程数 (含调用线程)，<= 0 表示使用线程池的全部线程
+    void setNumThreads(int numThreads) { numThreads_ = numThreads > 0 ? numThreads : 0; }
+    int getNumThreads() const { return numThreads_; }
+
+protected:
+    int numThreads_ = 0;
 };
 
 } // namespace vectordb
@@ -0,0 +1,45 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vectordb_jni_NativeAsyncHnswIndex */
+
+#ifndef _Included_com_vectordb_jni_NativeAsyncHnswIndex
+#define _Included_com_vectordb_jni_NativeAsyncHnswIndex
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vectordb_jni_NativeAsyncHnswIndex
+ * Method:    nativeCreateAsyncHNSW
+ * Signature: (IIIIIII)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeCreateAsyncHNSW
+  (JNIEnv *, jclass, jint, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     com_vectordb_jni_NativeAsyncHnswIndex
+ * Method:    nativeIngest
+ * Signature: (JI[F)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeIngest
+  (JNIEnv *, jobject, jlong, jint, jfloatArray);
+
+/*
+ * Class:     com_vectordb_jni_NativeAsyncHnswIndex
+ * Method:    nativeVisibleSequence
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeVisibleSequence
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_vectordb_jni_NativeAsyncHnswIndex
+ * Method:    nativeWaitVisible
+ * Signature: (JJ)V
+ */
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeAsyncHnswIndex_nativeWaitVisible
+  (JNIEnv *, jobject, jlong, jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
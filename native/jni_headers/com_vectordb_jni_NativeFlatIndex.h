@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vectordb_jni_NativeFlatIndex */
+
+#ifndef _Included_com_vectordb_jni_NativeFlatIndex
+#define _Included_com_vectordb_jni_NativeFlatIndex
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vectordb_jni_NativeFlatIndex
+ * Method:    nativeCreateFlat
+ * Signature: (II)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeFlatIndex_nativeCreateFlat
+  (JNIEnv *, jclass, jint, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -31,6 +31,78 @@ JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearch
 JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeDestroy
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeSearchFiltered
+ * Signature: (J[FI[J[I[F)I
+ */
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearchFiltered
+  (JNIEnv *, jobject, jlong, jfloatArray, jint, jlongArray, jintArray, jfloatArray);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeRemove
+ * Signature: (JI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeIndex_nativeRemove
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeUpdate
+ * Signature: (JI[F)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeIndex_nativeUpdate
+  (JNIEnv *, jobject, jlong, jint, jfloatArray);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeCompact
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeCompact
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeOptimize
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeOptimize
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeSetMemoryPolicy
+ * Signature: (JIII)I
+ */
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSetMemoryPolicy
+  (JNIEnv *, jobject, jlong, jint, jint, jint);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeRangeSearch
+ * Signature: (J[FF)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_com_vectordb_jni_NativeIndex_nativeRangeSearch
+  (JNIEnv *, jobject, jlong, jfloatArray, jfloat);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeAddDirect
+ * Signature: (JILjava/nio/ByteBuffer;)V
+ */
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIndex_nativeAddDirect
+  (JNIEnv *, jobject, jlong, jint, jobject);
+
+/*
+ * Class:     com_vectordb_jni_NativeIndex
+ * Method:    nativeSearchDirect
+ * Signature: (JLjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_vectordb_jni_NativeIndex_nativeSearchDirect
+  (JNIEnv *, jobject, jlong, jobject, jint, jobject, jobject);
+
 /*
  * Class:     com_vectordb_jni_NativeIndex
  * Method:    nativeAddBatch
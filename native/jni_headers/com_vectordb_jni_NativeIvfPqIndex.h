@@ -0,0 +1,29 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vectordb_jni_NativeIvfPqIndex */
+
+#ifndef _Included_com_vectordb_jni_NativeIvfPqIndex
+#define _Included_com_vectordb_jni_NativeIvfPqIndex
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vectordb_jni_NativeIvfPqIndex
+ * Method:    nativeCreateIVFPQ
+ * Signature: (IIIIII)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeIvfPqIndex_nativeCreateIVFPQ
+  (JNIEnv *, jclass, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     com_vectordb_jni_NativeIvfPqIndex
+ * Method:    nativeTrain
+ * Signature: (JI[F)V
+ */
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeIvfPqIndex_nativeTrain
+  (JNIEnv *, jobject, jlong, jint, jfloatArray);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,37 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vectordb_jni_NativeSearchStats */
+
+#ifndef _Included_com_vectordb_jni_NativeSearchStats
+#define _Included_com_vectordb_jni_NativeSearchStats
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vectordb_jni_NativeSearchStats
+ * Method:    nativeEnabled
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeEnabled
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     com_vectordb_jni_NativeSearchStats
+ * Method:    nativeSnapshot
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeSnapshot
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     com_vectordb_jni_NativeSearchStats
+ * Method:    nativeReset
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_com_vectordb_jni_NativeSearchStats_nativeReset
+  (JNIEnv *, jclass);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
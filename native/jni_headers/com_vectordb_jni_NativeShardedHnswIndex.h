@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vectordb_jni_NativeShardedHnswIndex */
+
+#ifndef _Included_com_vectordb_jni_NativeShardedHnswIndex
+#define _Included_com_vectordb_jni_NativeShardedHnswIndex
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vectordb_jni_NativeShardedHnswIndex
+ * Method:    nativeCreateShardedHNSW
+ * Signature: (IIIIII)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vectordb_jni_NativeShardedHnswIndex_nativeCreateShardedHNSW
+  (JNIEnv *, jclass, jint, jint, jint, jint, jint, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -2,11 +2,33 @@
 #include "index/HNSWIndex.h"
 #include "index/PQIndex.h"
 #include "index/IVFIndex.h"
+#include "index/IVFPQIndex.h"
+#include "index/FlatIndex.h"
+#include "index/HNSWPQIndex.h"
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
 
 using namespace vectordb;
 
+// Counting replacement for the global allocator, enabled per thread by the allocation tests
+namespace {
+thread_local bool countAllocations = false;
+thread_local long allocationCount = 0;
+}
+
+void* operator new(std::size_t size) {
+    if (countAllocations) allocationCount++;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
 class HNSWTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -81,6 +103,242 @@ TEST_F(HNSWTest, BatchSearch) {
     }
 }
 
+TEST_F(HNSWTest, ConcurrentAddBatch) {
+    HNSWIndex index(dimension, nVectors * 2);
+    index.setNumThreads(4);
+
+    std::vector<float> flat(static_cast<size_t>(nVectors) * dimension);
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        std::copy(vectors[i].begin(), vectors[i].end(), flat.begin() + static_cast<size_t>(i) * dimension);
+        ids[i] = i;
+    }
+
+    std::vector<int> failed(nVectors);
+    int failedCount = -1;
+    index.addBatch(flat.data(), ids.data(), nVectors, failed.data(), &failedCount);
+    EXPECT_EQ(failedCount, 0);
+    EXPECT_EQ(index.size(), nVectors);
+
+    // Concurrent linking must keep the graph about as navigable as sequential inserts
+    int found = 0;
+    for (int i = 0; i < nVectors; i += 10) {
+        int id;
+        float d;
+        int count;
+        index.search(vectors[i].data(), 1, &id, &d, &count);
+        if (count == 1 && id == i) found++;
+    }
+    EXPECT_GE(found, nVectors / 10 * 85 / 100);
+}
+
+TEST_F(HNSWTest, InnerProductMatchesBruteForce) {
+    HNSWConfig config;
+    config.metric = Metric::INNER_PRODUCT;
+    // Inner product is not a metric, the expansion cap cuts the search short
+    config.useEarlyTermination = false;
+    HNSWIndex index(dimension, nVectors * 2, config);
+    for (int i = 0; i < nVectors; i++) {
+        index.add(i, vectors[i].data());
+    }
+
+    const int k = 10;
+    int hits = 0;
+    for (int q = 0; q < 20; q++) {
+        std::vector<float> query(dimension);
+        for (auto& v : query) v = dist(rng);
+
+        std::vector<std::pair<float, int>> exact;
+        for (int i = 0; i < nVectors; i++) {
+            float dot = 0.0f;
+            for (int d = 0; d < dimension; d++) dot += query[d] * vectors[i][d];
+            exact.emplace_back(-dot, i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+
+        std::vector<int> ids(k);
+        std::vector<float> dists(k);
+        int count;
+        index.search(query.data(), k, ids.data(), dists.data(), &count);
+        ASSERT_EQ(count, k);
+        // The graph may miss the true best, but can never beat it
+        EXPECT_GE(dists[0], exact[0].first - 1e-3f * std::abs(exact[0].first));
+        for (int i = 0; i < k; i++) {
+            if (std::find(ids.begin(), ids.end(), exact[i].second) != ids.end()) hits++;
+        }
+    }
+    EXPECT_GE(hits, 20 * k * 8 / 10);
+}
+
+TEST_F(HNSWTest, HeuristicSelectionKeepsRecallAboveDim128) {
+    // Above 128 dimensions with M > 16 the heuristic diversifies by angle instead of distance
+    const int dim = 256;
+    HNSWIndex index(dim, nVectors);
+    std::vector<std::vector<float>> data(nVectors, std::vector<float>(dim));
+    for (int i = 0; i < nVectors; i++) {
+        for (auto& v : data[i]) v = dist(rng);
+        index.add(i, data[i].data());
+    }
+
+    const int k = 10;
+    int hits = 0;
+    for (int q = 0; q < 20; q++) {
+        std::vector<float> query(dim);
+        for (auto& v : query) v = dist(rng);
+
+        std::vector<std::pair<float, int>> exact;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dim; j++) d += (query[j] - data[i][j]) * (query[j] - data[i][j]);
+            exact.emplace_back(d, i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+
+        std::vector<int> ids(k);
+        std::vector<float> dists(k);
+        int count;
+        index.search(query.data(), k, ids.data(), dists.data(), &count);
+        ASSERT_EQ(count, k);
+        for (int i = 0; i < k; i++) {
+            if (std::find(ids.begin(), ids.end(), exact[i].second) != ids.end()) hits++;
+        }
+    }
+    EXPECT_GE(hits, 20 * k * 9 / 10);
+}
+
+TEST_F(HNSWTest, CosineIsScaleInvariant) {
+    HNSWConfig config;
+    config.metric = Metric::COSINE;
+    HNSWIndex index(dimension, nVectors * 2, config);
+    for (int i = 0; i < nVectors; i++) {
+        index.add(i, vectors[i].data());
+    }
+
+    const int k = 5;
+    int selfHits = 0;
+    for (int q = 0; q < 10; q++) {
+        std::vector<float> scaled(vectors[q]);
+        for (auto& v : scaled) v *= 7.5f;
+
+        std::vector<int> ids(k), scaledIds(k);
+        std::vector<float> dists(k), scaledDists(k);
+        int count, scaledCount;
+        index.search(vectors[q].data(), k, ids.data(), dists.data(), &count);
+        index.search(scaled.data(), k, scaledIds.data(), scaledDists.data(), &scaledCount);
+
+        ASSERT_EQ(count, scaledCount);
+        if (ids[0] == q) {
+            selfHits++;
+            EXPECT_NEAR(dists[0], 0.0f, 1e-4f);
+        }
+        for (int i = 0; i < count; i++) {
+            EXPECT_EQ(ids[i], scaledIds[i]);
+            EXPECT_NEAR(dists[i], scaledDists[i], 1e-4f);
+        }
+    }
+    EXPECT_GE(selfHits, 8);
+}
+
+TEST_F(HNSWTest, CosineAcrossIndexTypes) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    PQConfig pqConfig;
+    pqConfig.metric = Metric::COSINE;
+    PQIndex pq(dimension, nVectors * 2, pqConfig);
+    pq.train(nVectors, flat.data());
+
+    IVFConfig ivfConfig;
+    ivfConfig.metric = Metric::COSINE;
+    ivfConfig.nLists = 16;
+    ivfConfig.nProbes = 16;
+    IVFIndex ivf(dimension, nVectors * 2, ivfConfig);
+    ivf.train(nVectors, flat.data());
+
+    for (int i = 0; i < nVectors; i++) {
+        pq.add(i, vectors[i].data());
+        ivf.add(i, vectors[i].data());
+    }
+
+    // Exhaustive IVF probing is exact, PQ distances stay in the cosine range
+    std::vector<float> scaled(vectors[3]);
+    for (auto& v : scaled) v *= 0.1f;
+    const int k = 5;
+    std::vector<int> ids(k);
+    std::vector<float> dists(k);
+    int count;
+
+    ivf.search(scaled.data(), k, ids.data(), dists.data(), &count);
+    ASSERT_GT(count, 0);
+    EXPECT_EQ(ids[0], 3);
+    EXPECT_NEAR(dists[0], 0.0f, 1e-4f);
+
+    pq.search(scaled.data(), k, ids.data(), dists.data(), &count);
+    ASSERT_GT(count, 0);
+    for (int i = 0; i < count; i++) {
+        EXPECT_GE(dists[i], -0.1f);
+        EXPECT_LE(dists[i], 2.1f);
+    }
+}
+
+TEST_F(HNSWTest, QuantizedStorageKeepsRecall) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    for (VectorEncoding storage : {VectorEncoding::FP16, VectorEncoding::SQ8}) {
+        for (bool rerank : {true, false}) {
+            HNSWConfig config;
+            config.storage = storage;
+            config.rerankWithVectors = rerank;
+            HNSWIndex index(dimension, nVectors * 2, config);
+            index.train(nVectors, flat.data());
+            for (int i = 0; i < nVectors; i++) {
+                index.add(i, vectors[i].data());
+            }
+
+            int found = 0;
+            for (int i = 0; i < nVectors; i += 10) {
+                int id;
+                float d;
+                int count;
+                index.search(vectors[i].data(), 1, &id, &d, &count);
+                if (count == 1 && id == i) {
+                    found++;
+                    // Reranked distances are exact, code distances only approximate
+                    if (rerank) EXPECT_FLOAT_EQ(d, 0.0f);
+                    else EXPECT_LT(d, 0.05f);
+                }
+            }
+            EXPECT_GE(found, nVectors / 10 * 85 / 100)
+                << "storage " << static_cast<int>(storage) << " rerank " << rerank;
+        }
+    }
+}
+
+TEST_F(HNSWTest, SQ8StorageRequiresTraining) {
+    HNSWConfig config;
+    config.storage = VectorEncoding::SQ8;
+    HNSWIndex index(dimension, nVectors, config);
+    EXPECT_THROW(index.add(0, vectors[0].data()), std::runtime_error);
+    EXPECT_EQ(index.size(), 0);
+
+    // addBatch trains on the batch itself
+    std::vector<float> flat;
+    std::vector<int> ids;
+    for (int i = 0; i < 100; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+        ids.push_back(i);
+    }
+    int failedCount = -1;
+    index.addBatch(flat.data(), ids.data(), 100, nullptr, &failedCount);
+    EXPECT_EQ(failedCount, 0);
+    EXPECT_EQ(index.size(), 100);
+}
+
 TEST_F(HNSWTest, PQIndexBasic) {
     PQIndex index(dimension, nVectors * 2);
 
@@ -110,6 +368,44 @@ TEST_F(HNSWTest, PQIndexBasic) {
     EXPECT_GT(count, 0);
 }
 
+TEST_F(HNSWTest, PQFastScanMatchesFullRerank) {
+    PQConfig config;
+    config.M = 32;
+    config.nBits = 4;
+    PQIndex fast(dimension, nVectors * 2, config);
+    // Reranking every vector gives the exact float-table ADC order
+    config.fastScanRerankFactor = nVectors;
+    PQIndex exact(dimension, nVectors * 2, config);
+
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+    fast.train(nVectors, flat.data());
+    exact.train(nVectors, flat.data());
+    for (int i = 0; i < nVectors; i++) {
+        fast.add(i, vectors[i].data());
+        exact.add(i, vectors[i].data());
+    }
+
+    const int k = 10;
+    int hits = 0;
+    for (int q = 0; q < 20; q++) {
+        std::vector<int> fastIds(k), exactIds(k);
+        std::vector<float> fastDists(k), exactDists(k);
+        int fastCount, exactCount;
+        fast.search(vectors[q].data(), k, fastIds.data(), fastDists.data(), &fastCount);
+        exact.search(vectors[q].data(), k, exactIds.data(), exactDists.data(), &exactCount);
+        ASSERT_EQ(fastCount, k);
+        ASSERT_EQ(exactCount, k);
+        EXPECT_TRUE(std::is_sorted(fastDists.begin(), fastDists.end()));
+        for (int id : fastIds) {
+            if (std::find(exactIds.begin(), exactIds.end(), id) != exactIds.end()) hits++;
+        }
+    }
+    EXPECT_GE(hits, 20 * k * 9 / 10);
+}
+
 TEST_F(HNSWTest, IVFIndexBasic) {
     IVFIndex index(dimension, nVectors * 2);
 
@@ -138,3 +434,488 @@ TEST_F(HNSWTest, IVFIndexBasic) {
 
     EXPECT_GT(count, 0);
 }
+
+// IVF tests share the random vectors of the HNSW fixture
+class IVFTest : public HNSWTest {};
+
+TEST_F(IVFTest, ExhaustiveProbeMatchesBruteForce) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    IVFConfig config;
+    config.nLists = 16;
+    config.nProbes = 16;
+    IVFIndex index(dimension, nVectors * 2, config);
+    index.train(nVectors, flat.data());
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    index.addBatch(flat.data(), ids.data(), nVectors);
+
+    int total = 0;
+    for (int l = 0; l < config.nLists; l++) {
+        total += index.listSize(l);
+    }
+    EXPECT_EQ(total, nVectors);
+
+    const int k = 10;
+    for (int q = 0; q < 10; q++) {
+        std::vector<std::pair<float, int>> exact;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dimension; j++) {
+                float diff = vectors[q][j] - vectors[i][j];
+                d += diff * diff;
+            }
+            exact.emplace_back(d, i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+
+        std::vector<int> resultIds(k);
+        std::vector<float> resultDists(k);
+        int count;
+        index.search(vectors[q].data(), k, resultIds.data(), resultDists.data(), &count);
+        ASSERT_EQ(count, k);
+        EXPECT_EQ(resultIds[0], q);
+        for (int i = 0; i < k; i++) {
+            EXPECT_NEAR(resultDists[i], exact[i].first, 1e-2f);
+            if (i > 0) {
+                EXPECT_LE(resultDists[i - 1], resultDists[i]);
+            }
+        }
+    }
+}
+
+TEST_F(HNSWTest, IVFSearchBatchMatchesSingleQuery) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    for (Metric metric : {Metric::L2, Metric::INNER_PRODUCT, Metric::COSINE}) {
+        IVFConfig config;
+        config.nLists = 16;
+        config.nProbes = 4;
+        config.metric = metric;
+        IVFIndex index(dimension, nVectors * 2, config);
+        index.train(nVectors, flat.data());
+        std::vector<int> ids(nVectors);
+        std::iota(ids.begin(), ids.end(), 0);
+        index.addBatch(flat.data(), ids.data(), nVectors);
+
+        const int nQueries = 50;
+        const int k = 10;
+        std::vector<int> batchIds(nQueries * k);
+        std::vector<float> batchDists(nQueries * k);
+        index.searchBatch(flat.data(), nQueries, k, batchIds.data(), batchDists.data());
+
+        for (int q = 0; q < nQueries; q++) {
+            std::vector<int> resultIds(k);
+            std::vector<float> resultDists(k);
+            int count;
+            index.search(vectors[q].data(), k, resultIds.data(), resultDists.data(), &count);
+            ASSERT_EQ(count, k);
+            for (int i = 0; i < k; i++) {
+                EXPECT_NEAR(batchDists[q * k + i], resultDists[i], 1e-3f);
+            }
+            EXPECT_EQ(batchIds[q * k], resultIds[0]);
+        }
+    }
+}
+
+TEST_F(HNSWTest, FlatIndexIsExact) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    FlatIndex index(dimension, nVectors);
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    index.addBatch(flat.data(), ids.data(), nVectors);
+
+    const int nQueries = 20;
+    const int k = 10;
+    std::vector<int> batchIds(nQueries * k);
+    std::vector<float> batchDists(nQueries * k);
+    index.searchBatch(flat.data(), nQueries, k, batchIds.data(), batchDists.data());
+
+    for (int q = 0; q < nQueries; q++) {
+        std::vector<std::pair<float, int>> exact;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dimension; j++) {
+                float diff = vectors[q][j] - vectors[i][j];
+                d += diff * diff;
+            }
+            exact.emplace_back(d, i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+
+        std::vector<int> resultIds(k);
+        std::vector<float> resultDists(k);
+        int count;
+        index.search(vectors[q].data(), k, resultIds.data(), resultDists.data(), &count);
+        ASSERT_EQ(count, k);
+        EXPECT_EQ(resultIds[0], q);
+        EXPECT_EQ(batchIds[q * k], q);
+        for (int i = 0; i < k; i++) {
+            EXPECT_NEAR(resultDists[i], exact[i].first, 1e-2f);
+            EXPECT_NEAR(batchDists[q * k + i], exact[i].first, 1e-2f);
+        }
+    }
+}
+
+TEST_F(HNSWTest, IVFPQRecallWithRerank) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    IVFPQConfig config;
+    config.nLists = 16;
+    config.nProbes = 4;
+    config.pqM = 16;
+    config.rerankWithVectors = true;
+    config.rerankFactor = 10;
+    IVFPQIndex index(dimension, nVectors * 2, config);
+    index.train(nVectors, flat.data());
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    index.addBatch(flat.data(), ids.data(), nVectors);
+    ASSERT_EQ(index.size(), nVectors);
+
+    int total = 0;
+    for (int l = 0; l < config.nLists; l++) {
+        total += index.listSize(l);
+    }
+    EXPECT_EQ(total, nVectors);
+
+    // Reranked distances are exact, so the query itself comes back at distance 0
+    const int k = 10;
+    int selfHits = 0;
+    for (int q = 0; q < 20; q++) {
+        std::vector<int> resultIds(k);
+        std::vector<float> dists(k);
+        int count;
+        index.search(vectors[q].data(), k, resultIds.data(), dists.data(), &count);
+        ASSERT_EQ(count, k);
+        EXPECT_TRUE(std::is_sorted(dists.begin(), dists.end()));
+        if (resultIds[0] == q) {
+            selfHits++;
+            EXPECT_NEAR(dists[0], 0.0f, 1e-4f);
+        }
+    }
+    EXPECT_GE(selfHits, 18);
+}
+
+TEST_F(HNSWTest, IVFPQFastScanMatchesFullRerank) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+
+    IVFPQConfig config;
+    config.nLists = 8;
+    config.nProbes = 8;
+    config.pqM = 32;
+    config.nBits = 4;
+    IVFPQIndex fast(dimension, nVectors * 2, config);
+    // Reranking whole lists gives the exact float-table ADC order
+    config.fastScanRerankFactor = nVectors;
+    IVFPQIndex exact(dimension, nVectors * 2, config);
+    fast.train(nVectors, flat.data());
+    exact.train(nVectors, flat.data());
+    for (int i = 0; i < nVectors; i++) {
+        fast.add(i, vectors[i].data());
+        exact.add(i, vectors[i].data());
+    }
+
+    const int k = 10;
+    int hits = 0;
+    for (int q = 0; q < 20; q++) {
+        std::vector<int> fastIds(k), exactIds(k);
+        std::vector<float> fastDists(k), exactDists(k);
+        int fastCount, exactCount;
+        fast.search(vectors[q].data(), k, fastIds.data(), fastDists.data(), &fastCount);
+        exact.search(vectors[q].data(), k, exactIds.data(), exactDists.data(), &exactCount);
+        ASSERT_EQ(fastCount, k);
+        ASSERT_EQ(exactCount, k);
+        for (int id : fastIds) {
+            if (std::find(exactIds.begin(), exactIds.end(), id) != exactIds.end()) hits++;
+        }
+    }
+    EXPECT_GE(hits, 20 * k * 9 / 10);
+}
+
+TEST_F(HNSWTest, FilteredSearchReturnsOnlyAllowedIds) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+
+    HNSWIndex hnsw(dimension, nVectors);
+    hnsw.addBatch(flat.data(), ids.data(), nVectors);
+    FlatIndex exact(dimension, nVectors);
+    exact.addBatch(flat.data(), ids.data(), nVectors);
+    IVFConfig ivfConfig;
+    ivfConfig.nLists = 16;
+    ivfConfig.nProbes = 2;
+    IVFIndex ivf(dimension, nVectors, ivfConfig);
+    ivf.train(nVectors, flat.data());
+    ivf.addBatch(flat.data(), ids.data(), nVectors);
+    PQConfig pqConfig;
+    pqConfig.M = 16;
+    PQIndex pq(dimension, nVectors, pqConfig);
+    pq.train(nVectors, flat.data());
+    pq.addBatch(flat.data(), ids.data(), nVectors);
+
+    // Every third id goes through the graph, one in a hundred falls back to a scan
+    BitsetFilter everyThird(nVectors);
+    for (int i = 0; i < nVectors; i += 3) everyThird.set(i);
+    PredicateFilter rare([](int id) { return id % 100 == 7; });
+
+    const int k = 10;
+    std::vector<int> resultIds(k), expectedIds(k);
+    std::vector<float> resultDists(k), expectedDists(k);
+    for (const IDFilter* filter : {static_cast<const IDFilter*>(&everyThird), static_cast<const IDFilter*>(&rare)}) {
+        int hits = 0;
+        for (int q = 0; q < 20; q++) {
+            const float* query = vectors[q * 7].data();
+            int expectedCount;
+            exact.search(query, k, expectedIds.data(), expectedDists.data(), &expectedCount, filter);
+            ASSERT_EQ(expectedCount, k);
+            for (int i = 0; i < k; i++) {
+                ASSERT_TRUE(filter->contains(expectedIds[i]));
+            }
+
+            int count;
+            hnsw.search(query, k, resultIds.data(), resultDists.data(), &count, filter);
+            ASSERT_EQ(count, k);
+            for (int i = 0; i < k; i++) {
+                ASSERT_TRUE(filter->contains(resultIds[i]));
+                hits += std::count(expectedIds.begin(), expectedIds.end(), resultIds[i]);
+            }
+
+            // Two probes rarely hold k allowed ids on their own, IVF keeps probing
+            ivf.search(query, k, resultIds.data(), resultDists.data(), &count, filter);
+            ASSERT_EQ(count, k);
+            for (int i = 0; i < k; i++) {
+                ASSERT_TRUE(filter->contains(resultIds[i]));
+            }
+
+            pq.search(query, k, resultIds.data(), resultDists.data(), &count, filter);
+            ASSERT_EQ(count, k);
+            for (int i = 0; i < k; i++) {
+                ASSERT_TRUE(filter->contains(resultIds[i]));
+            }
+        }
+        EXPECT_GE(hits, 20 * k * 9 / 10);
+    }
+}
+
+TEST_F(HNSWTest, RemoveUpdateAndCompactReuseSlots) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+
+    // Full to capacity, so the later inserts only fit into reclaimed slots
+    HNSWIndex hnsw(dimension, nVectors);
+    hnsw.addBatch(flat.data(), ids.data(), nVectors);
+    FlatIndex exact(dimension, nVectors);
+    exact.addBatch(flat.data(), ids.data(), nVectors);
+    IVFConfig ivfConfig;
+    ivfConfig.nLists = 16;
+    IVFIndex ivf(dimension, nVectors, ivfConfig);
+    ivf.train(nVectors, flat.data());
+    ivf.addBatch(flat.data(), ids.data(), nVectors);
+    PQConfig pqConfig;
+    pqConfig.M = 16;
+    PQIndex pq(dimension, nVectors, pqConfig);
+    pq.train(nVectors, flat.data());
+    pq.addBatch(flat.data(), ids.data(), nVectors);
+
+    const int removed = nVectors / 5;
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&hnsw, &exact, &ivf, &pq}) {
+        for (int i = 0; i < nVectors; i += 5) {
+            ASSERT_TRUE(index->remove(i));
+        }
+        EXPECT_FALSE(index->remove(0));
+        EXPECT_EQ(index->size(), nVectors - removed);
+    }
+
+    const int k = 10;
+    std::vector<int> resultIds(k), expectedIds(k);
+    std::vector<float> resultDists(k), expectedDists(k);
+    auto expectNoRemoved = [&](VectorIndex& index) {
+        for (int q = 0; q < 20; q++) {
+            int count;
+            index.search(vectors[q * 5].data(), k, resultIds.data(), resultDists.data(), &count);
+            ASSERT_EQ(count, k);
+            for (int i = 0; i < count; i++) {
+                ASSERT_NE(resultIds[i] % 5, 0) << "removed id " << resultIds[i] << " returned";
+            }
+        }
+    };
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&hnsw, &exact, &ivf, &pq}) {
+        expectNoRemoved(*index);
+    }
+
+    std::vector<float> moved(dimension);
+    for (auto& x : moved) x = dist(rng);
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&hnsw, &exact, &ivf}) {
+        ASSERT_TRUE(index->update(1, moved.data()));
+        EXPECT_FALSE(index->update(0, moved.data()));
+        int count;
+        index->search(moved.data(), 1, resultIds.data(), resultDists.data(), &count);
+        ASSERT_EQ(count, 1);
+        EXPECT_EQ(resultIds[0], 1);
+    }
+
+    EXPECT_EQ(hnsw.compact(), removed);
+    EXPECT_EQ(hnsw.compact(), 0);
+    EXPECT_EQ(exact.compact(), removed);
+    EXPECT_EQ(exact.size(), nVectors - removed);
+    expectNoRemoved(hnsw);
+    expectNoRemoved(exact);
+
+    // Repaired graph keeps its recall against the exact scan (about 0.9 before any removal)
+    int hits = 0;
+    for (int q = 0; q < 50; q++) {
+        const float* query = vectors[q * 7 + 1].data();
+        int count;
+        exact.search(query, k, expectedIds.data(), expectedDists.data(), &count);
+        hnsw.search(query, k, resultIds.data(), resultDists.data(), &count);
+        for (int i = 0; i < count; i++) {
+            hits += std::count(expectedIds.begin(), expectedIds.end(), resultIds[i]);
+        }
+    }
+    EXPECT_GE(hits, 50 * k * 8 / 10);
+
+    // New ids land in the freed slots and are reachable
+    std::vector<std::vector<float>> fresh(removed, std::vector<float>(dimension));
+    for (int i = 0; i < removed; i++) {
+        for (auto& x : fresh[i]) x = dist(rng);
+        hnsw.add(nVectors + i, fresh[i].data());
+    }
+    EXPECT_EQ(hnsw.size(), nVectors);
+    int found = 0;
+    for (int i = 0; i < removed; i++) {
+        int count;
+        hnsw.search(fresh[i].data(), 1, resultIds.data(), resultDists.data(), &count);
+        found += count == 1 && resultIds[0] == nVectors + i;
+    }
+    EXPECT_GE(found, removed * 95 / 100);
+}
+
+TEST_F(HNSWTest, ReorderKeepsResultsAndPersists) {
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) ids[i] = i * 3 + 7;
+
+    HNSWIndex hnsw(dimension, nVectors);
+    hnsw.addBatch(flat.data(), ids.data(), nVectors);
+    for (int i = 0; i < nVectors; i += 10) {
+        ASSERT_TRUE(hnsw.remove(ids[i]));
+    }
+
+    const int k = 10, nQueries = 50;
+    auto searchAll = [&](HNSWIndex& index) {
+        std::vector<int> results(static_cast<size_t>(nQueries) * k);
+        std::vector<float> distances(results.size());
+        for (int q = 0; q < nQueries; q++) {
+            int count;
+            index.search(vectors[q * 13 + 1].data(), k, &results[q * k], &distances[q * k], &count);
+            EXPECT_EQ(count, k);
+        }
+        return results;
+    };
+    // Batched distances may round differently once rows move, so allow the odd swapped tie
+    auto overlap = [&](const std::vector<int>& a, const std::vector<int>& b) {
+        int same = 0;
+        for (int q = 0; q < nQueries; q++) {
+            for (int i = 0; i < k; i++) {
+                same += std::count(b.begin() + q * k, b.begin() + (q + 1) * k, a[q * k + i]);
+            }
+        }
+        return static_cast<double>(same) / (nQueries * k);
+    };
+
+    const std::vector<int> before = searchAll(hnsw);
+    for (GraphOrder order : {GraphOrder::BFS, GraphOrder::RCM, GraphOrder::GORDER}) {
+        hnsw.reorder(order);
+        const std::vector<int> after = searchAll(hnsw);
+        EXPECT_GE(overlap(before, after), 0.99) << "order " << static_cast<int>(order);
+        for (int id : after) {
+            ASSERT_NE((id - 7) / 3 % 10, 0) << "removed id " << id << " returned";
+        }
+        EXPECT_EQ(hnsw.size(), nVectors - nVectors / 10);
+    }
+
+    // The permuted layout is what gets saved, and the loaded index keeps accepting writes
+    const std::string path = "/tmp/hnsw_reorder_test.idx";
+    hnsw.save(path);
+    HNSWIndex loaded(dimension, nVectors);
+    loaded.load(path);
+    std::remove(path.c_str());
+    EXPECT_GE(overlap(before, searchAll(loaded)), 0.99);
+
+    EXPECT_EQ(loaded.compact(), nVectors / 10);
+    std::vector<float> fresh(dimension);
+    for (auto& x : fresh) x = dist(rng);
+    loaded.add(-1, fresh.data());
+    loaded.optimize();
+    int id, count;
+    float distance;
+    loaded.search(fresh.data(), 1, &id, &distance, &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_EQ(id, -1);
+}
+
+TEST_F(HNSWTest, SteadyStateSearchDoesNotAllocate) {
+    HNSWIndex hnsw(dimension, nVectors);
+    HNSWConfig cosineConfig;
+    cosineConfig.metric = Metric::COSINE;
+    HNSWIndex cosine(dimension, nVectors, cosineConfig);
+    HNSWPQConfig pqConfig;
+    pqConfig.pqM = 16;
+    HNSWPQIndex hnswPq(dimension, nVectors, pqConfig);
+
+    std::vector<float> flat;
+    for (int i = 0; i < nVectors; i++) {
+        flat.insert(flat.end(), vectors[i].begin(), vectors[i].end());
+    }
+    hnswPq.train(nVectors, flat.data());
+    for (int i = 0; i < nVectors; i++) {
+        hnsw.add(i, vectors[i].data());
+        cosine.add(i, vectors[i].data());
+        hnswPq.add(i, vectors[i].data());
+    }
+
+    const int k = 10;
+    std::vector<int> ids(k);
+    std::vector<float> dists(k);
+    int count;
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&hnsw, &cosine, &hnswPq}) {
+        // The first pass grows the thread's search context and visited table to their working size
+        for (int pass = 0; pass < 2; pass++) {
+            countAllocations = pass == 1;
+            allocationCount = 0;
+            for (int q = 0; q < 100; q++) {
+                index->search(vectors[q].data(), k, ids.data(), dists.data(), &count);
+            }
+            countAllocations = false;
+            EXPECT_EQ(count, k);
+        }
+        EXPECT_EQ(allocationCount, 0);
+    }
+}
@@ -6,6 +6,9 @@
 #include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <string>
 
 using namespace vectordb;
 
@@ -212,3 +215,302 @@ TEST_F(HNSWPQTest, CompareWithHNSW) {
     std::cout << "HNSW memory: " << nVectors * dim * sizeof(float) / 1024 << " KB (estimated)" << std::endl;
     std::cout << "HNSWPQ memory: " << hnswPqIndex.getMemoryUsage() / 1024 << " KB" << std::endl;
 }
+
+TEST_F(HNSWPQTest, BulkAddBatch) {
+    const int dim = 32;
+    const int nVectors = 2000;
+
+    HNSWPQConfig config;
+    config.pqM = 8;
+    HNSWPQIndex index(dim, nVectors, config);
+
+    std::vector<float> data;
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        auto vec = generateRandomVector(dim);
+        data.insert(data.end(), vec.begin(), vec.end());
+        ids[i] = i + 100;
+    }
+
+    index.train(nVectors, data.data());
+    // First half into an empty index, second half into an existing graph
+    index.addBatch(data.data(), ids.data(), nVectors / 2);
+    index.addBatch(data.data() + static_cast<size_t>(nVectors / 2) * dim,
+                   ids.data() + nVectors / 2, nVectors / 2);
+    EXPECT_EQ(index.size(), nVectors);
+
+    // Same vectors through the one-at-a-time path as the baseline for the bulk path
+    HNSWPQIndex incremental(dim, nVectors, config);
+    incremental.train(nVectors, data.data());
+    for (int i = 0; i < nVectors; i++) {
+        incremental.add(ids[i], data.data() + static_cast<size_t>(i) * dim);
+    }
+
+    // Recall@10 over fresh queries; the graph RNG is clock-seeded, so the bound leaves a real margin
+    const int k = 10;
+    const int nQueries = 100;
+    int batchHits = 0, incrementalHits = 0;
+    for (int q = 0; q < nQueries; q++) {
+        auto query = generateRandomVector(dim);
+        std::vector<std::pair<float, int>> truth;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dim; j++) {
+                const float diff = query[j] - data[static_cast<size_t>(i) * dim + j];
+                d += diff * diff;
+            }
+            truth.emplace_back(d, ids[i]);
+        }
+        std::partial_sort(truth.begin(), truth.begin() + k, truth.end());
+
+        std::vector<int> batchIds(k), incrementalIds(k);
+        std::vector<float> dists(k);
+        int count;
+        index.search(query.data(), k, batchIds.data(), dists.data(), &count);
+        incremental.search(query.data(), k, incrementalIds.data(), dists.data(), &count);
+        for (int i = 0; i < k; i++) {
+            batchHits += std::count(batchIds.begin(), batchIds.end(), truth[i].second);
+            incrementalHits += std::count(incrementalIds.begin(), incrementalIds.end(), truth[i].second);
+        }
+    }
+    std::cout << "\nHNSWPQ Recall@" << k << " addBatch: " << batchHits / float(nQueries * k)
+              << ", add: " << incrementalHits / float(nQueries * k) << std::endl;
+    EXPECT_GE(batchHits, nQueries * k * 75 / 100);
+    EXPECT_GE(incrementalHits, nQueries * k * 75 / 100);
+    // The bulk path builds a graph as good as repeated add
+    EXPECT_GE(batchHits, incrementalHits - nQueries * k * 5 / 100);
+
+    // Full index: the overflow is skipped rather than thrown
+    EXPECT_NO_THROW(index.addBatch(data.data(), ids.data(), 10));
+    EXPECT_EQ(index.size(), nVectors);
+}
+
+TEST_F(HNSWPQTest, ReorderKeepsResults) {
+    const int dim = 32;
+    const int nVectors = 2000;
+    const int k = 10;
+
+    HNSWPQConfig config;
+    config.pqM = 8;
+    HNSWPQIndex index(dim, nVectors, config);
+
+    std::vector<float> data;
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        auto vec = generateRandomVector(dim);
+        data.insert(data.end(), vec.begin(), vec.end());
+        ids[i] = nVectors - i;
+    }
+    index.train(nVectors, data.data());
+    index.addBatch(data.data(), ids.data(), nVectors);
+
+    const int nQueries = 50;
+    std::vector<int> before(static_cast<size_t>(nQueries) * k), after(before.size());
+    std::vector<float> dists(before.size());
+    std::vector<float> queries;
+    for (int q = 0; q < nQueries; q++) {
+        auto vec = generateRandomVector(dim);
+        queries.insert(queries.end(), vec.begin(), vec.end());
+    }
+    index.searchBatch(queries.data(), nQueries, k, before.data(), dists.data());
+
+    index.optimize();
+    EXPECT_EQ(index.size(), nVectors);
+    index.searchBatch(queries.data(), nQueries, k, after.data(), dists.data());
+    int same = 0;
+    for (int q = 0; q < nQueries; q++) {
+        for (int i = 0; i < k; i++) {
+            same += std::count(after.begin() + q * k, after.begin() + (q + 1) * k, before[q * k + i]);
+        }
+    }
+    EXPECT_GE(same, nQueries * k * 99 / 100);
+
+    // External ids follow their vectors
+    int found = 0;
+    for (int i = 0; i < nVectors; i += 20) {
+        int id;
+        float d;
+        int count;
+        index.search(data.data() + static_cast<size_t>(i) * dim, 1, &id, &d, &count);
+        if (count == 1 && id == ids[i]) found++;
+    }
+    EXPECT_GE(found, nVectors / 20 * 85 / 100);
+}
+
+TEST_F(HNSWPQTest, DiskResidentSearch) {
+    const int dim = 32;
+    const int nVectors = 2000;
+    const int k = 10;
+
+    HNSWPQConfig config;
+    config.pqM = 8;
+    config.adcSearch = true;
+    HNSWPQIndex memory(dim, nVectors, config);
+
+    std::vector<float> data;
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        auto vec = generateRandomVector(dim);
+        data.insert(data.end(), vec.begin(), vec.end());
+        ids[i] = i;
+    }
+    memory.train(nVectors, data.data());
+    memory.addBatch(data.data(), ids.data(), nVectors);
+    memory.optimize();
+
+    const std::string path = "/tmp/hnswpq_disk_resident.idx";
+    memory.saveDiskResident(path);
+    HNSWPQIndex disk(dim, nVectors, config);
+    disk.load(path);
+    config.diskDirectIO = false;
+    HNSWPQIndex buffered(dim, nVectors, config);
+    buffered.load(path);
+    std::remove(path.c_str());
+    ASSERT_TRUE(disk.isDiskResident());
+    EXPECT_FALSE(memory.isDiskResident());
+    EXPECT_FALSE(disk.hasRawVectors());
+    EXPECT_EQ(disk.size(), nVectors);
+
+    const int nQueries = 50;
+    std::vector<float> queries;
+    for (int q = 0; q < nQueries; q++) {
+        auto vec = generateRandomVector(dim);
+        queries.insert(queries.end(), vec.begin(), vec.end());
+    }
+    std::vector<int> batchIds(static_cast<size_t>(nQueries) * k);
+    std::vector<float> batchDists(static_cast<size_t>(nQueries) * k);
+    disk.searchBatch(queries.data(), nQueries, k, batchIds.data(), batchDists.data());
+
+    int diskHits = 0, memoryHits = 0, batchMatches = 0, bufferedMatches = 0;
+    for (int q = 0; q < nQueries; q++) {
+        const float* query = queries.data() + static_cast<size_t>(q) * dim;
+        std::vector<std::pair<float, int>> truth;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dim; j++) {
+                const float diff = query[j] - data[static_cast<size_t>(i) * dim + j];
+                d += diff * diff;
+            }
+            truth.emplace_back(d, i);
+        }
+        std::partial_sort(truth.begin(), truth.begin() + k, truth.end());
+
+        std::vector<int> diskIds(k), memoryIds(k), bufferedIds(k);
+        std::vector<float> diskDists(k), memoryDists(k), bufferedDists(k);
+        int diskCount, memoryCount, bufferedCount;
+        disk.search(query, k, diskIds.data(), diskDists.data(), &diskCount);
+        memory.search(query, k, memoryIds.data(), memoryDists.data(), &memoryCount);
+        buffered.search(query, k, bufferedIds.data(), bufferedDists.data(), &bufferedCount);
+        ASSERT_EQ(diskCount, k);
+        ASSERT_EQ(memoryCount, k);
+        ASSERT_EQ(bufferedCount, k);
+        // Distances come from the full vectors in the blocks
+        EXPECT_TRUE(std::is_sorted(diskDists.begin(), diskDists.end()));
+        for (const auto& t : truth) {
+            if (t.second == diskIds[0]) {
+                EXPECT_NEAR(diskDists[0], t.first, 1e-4f);
+            }
+        }
+        for (int i = 0; i < k; i++) {
+            auto hit = [&](const std::vector<int>& found) {
+                return std::find(found.begin(), found.end(), truth[i].second) != found.end();
+            };
+            diskHits += hit(diskIds);
+            memoryHits += hit(memoryIds);
+            batchMatches += batchIds[static_cast<size_t>(q) * k + i] == diskIds[i];
+            bufferedMatches += bufferedIds[i] == diskIds[i];
+        }
+    }
+
+    std::cout << "\nHNSWPQ Recall@" << k << " in memory: " << memoryHits / float(nQueries * k)
+              << ", disk-resident: " << diskHits / float(nQueries * k)
+              << (BlockReader::usesIoUring() ? " (io_uring)" : " (pread)") << std::endl;
+    EXPECT_GE(diskHits, memoryHits * 9 / 10);
+    EXPECT_EQ(batchMatches, nQueries * k);
+    EXPECT_EQ(bufferedMatches, nQueries * k);
+
+    // Read-only: level 0 and the vectors are not in memory
+    EXPECT_THROW(disk.add(nVectors, data.data()), std::runtime_error);
+    EXPECT_THROW(disk.save(path), std::runtime_error);
+}
+
+TEST_F(HNSWPQTest, ADCSearchRerankKeepsRecall) {
+    const int dim = 32;
+    const int nVectors = 2000;
+    const int k = 10;
+
+    HNSWPQConfig config;
+    config.pqM = 8;
+    HNSWPQIndex exact(dim, nVectors, config);
+
+    std::vector<float> data;
+    std::vector<int> ids(nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        auto vec = generateRandomVector(dim);
+        data.insert(data.end(), vec.begin(), vec.end());
+        ids[i] = i;
+    }
+    exact.train(nVectors, data.data());
+    exact.addBatch(data.data(), ids.data(), nVectors);
+
+    // Same graph, searched with ADC traversal and exact rerank
+    const std::string path = "/tmp/hnswpq_adc_search.idx";
+    exact.save(path);
+    config.adcSearch = true;
+    HNSWPQIndex adc(dim, nVectors, config);
+    adc.load(path);
+    std::remove(path.c_str());
+
+    const int nQueries = 50;
+    std::vector<float> queries;
+    for (int q = 0; q < nQueries; q++) {
+        auto vec = generateRandomVector(dim);
+        queries.insert(queries.end(), vec.begin(), vec.end());
+    }
+    std::vector<int> batchIds(static_cast<size_t>(nQueries) * k);
+    std::vector<float> batchDists(static_cast<size_t>(nQueries) * k);
+    adc.searchBatch(queries.data(), nQueries, k, batchIds.data(), batchDists.data());
+
+    int adcHits = 0, exactHits = 0, batchMatches = 0;
+    for (int q = 0; q < nQueries; q++) {
+        const float* query = queries.data() + static_cast<size_t>(q) * dim;
+        std::vector<std::pair<float, int>> truth;
+        for (int i = 0; i < nVectors; i++) {
+            float d = 0.0f;
+            for (int j = 0; j < dim; j++) {
+                const float diff = query[j] - data[static_cast<size_t>(i) * dim + j];
+                d += diff * diff;
+            }
+            truth.emplace_back(d, i);
+        }
+        std::partial_sort(truth.begin(), truth.begin() + k, truth.end());
+
+        std::vector<int> adcIds(k), exactIds(k);
+        std::vector<float> adcDists(k), exactDists(k);
+        int adcCount, exactCount;
+        adc.search(query, k, adcIds.data(), adcDists.data(), &adcCount);
+        exact.search(query, k, exactIds.data(), exactDists.data(), &exactCount);
+        ASSERT_EQ(adcCount, k);
+        ASSERT_EQ(exactCount, k);
+        // Reranked distances are exact
+        EXPECT_TRUE(std::is_sorted(adcDists.begin(), adcDists.end()));
+        for (const auto& t : truth) {
+            if (t.second == adcIds[0]) {
+                EXPECT_NEAR(adcDists[0], t.first, 1e-4f);
+            }
+        }
+        for (int i = 0; i < k; i++) {
+            auto hit = [&](const std::vector<int>& found) {
+                return std::find(found.begin(), found.end(), truth[i].second) != found.end();
+            };
+            adcHits += hit(adcIds);
+            exactHits += hit(exactIds);
+            batchMatches += batchIds[static_cast<size_t>(q) * k + i] == adcIds[i];
+        }
+    }
+
+    std::cout << "\nHNSWPQ Recall@" << k << " exact traversal: " << exactHits / float(nQueries * k)
+              << ", ADC traversal + rerank: " << adcHits / float(nQueries * k) << std::endl;
+    EXPECT_GE(adcHits, exactHits * 9 / 10);
+    EXPECT_GE(batchMatches, nQueries * k * 95 / 100);
+}
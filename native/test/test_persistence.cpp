@@ -0,0 +1,598 @@
+#include <gtest/gtest.h>
+#include "index/HNSWIndex.h"
+#include "index/HNSWPQIndex.h"
+#include "index/PQIndex.h"
+#include "index/IVFIndex.h"
+#include "index/IVFPQIndex.h"
+#include "index/LSHIndex.h"
+#include "index/AnnoyIndex.h"
+#include "index/FlatIndex.h"
+#include "index/ShardedIndex.h"
+#include "core/IndexFile.h"
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <memory>
+
+using namespace vectordb;
+
+class PersistenceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dimension = 32;
+        nVectors = 500;
+        rng.seed(42);
+
+        vectors.resize(static_cast<size_t>(nVectors) * dimension);
+        for (auto& v : vectors) {
+            v = dist(rng);
+        }
+        path = ::testing::TempDir() + "vectordb_persistence_" +
+               ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".idx";
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    const float* vec(int i) const { return vectors.data() + static_cast<size_t>(i) * dimension; }
+
+    void expectSameResults(VectorIndex& a, VectorIndex& b, int k = 10) {
+        for (int q = 0; q < 20; q++) {
+            std::vector<int> idsA(k), idsB(k);
+            std::vector<float> distsA(k), distsB(k);
+            int countA, countB;
+            a.search(vec(q), k, idsA.data(), distsA.data(), &countA);
+            b.search(vec(q), k, idsB.data(), distsB.data(), &countB);
+
+            ASSERT_EQ(countA, countB);
+            for (int i = 0; i < countA; i++) {
+                EXPECT_EQ(idsA[i], idsB[i]);
+                EXPECT_FLOAT_EQ(distsA[i], distsB[i]);
+            }
+        }
+    }
+
+    int dimension;
+    int nVectors;
+    std::vector<float> vectors;
+    std::string path;
+    std::mt19937 rng;
+    std::uniform_real_distribution<float> dist{0.0f, 1.0f};
+};
+
+TEST_F(PersistenceTest, HNSWSaveLoadRoundTrip) {
+    HNSWIndex original(dimension, nVectors * 2);
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i + 1000, vec(i));
+    }
+    original.save(path);
+
+    HNSWIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors);
+
+    const int k = 10;
+    for (int q = 0; q < 20; q++) {
+        std::vector<int> idsA(k), idsB(k);
+        std::vector<float> distsA(k), distsB(k);
+        int countA, countB;
+        original.search(vec(q), k, idsA.data(), distsA.data(), &countA);
+        loaded.search(vec(q), k, idsB.data(), distsB.data(), &countB);
+
+        ASSERT_EQ(countA, countB);
+        for (int i = 0; i < countA; i++) {
+            EXPECT_EQ(idsA[i], idsB[i]);
+            EXPECT_FLOAT_EQ(distsA[i], distsB[i]);
+        }
+        EXPECT_GE(idsB[0], 1000);
+    }
+}
+
+TEST_F(PersistenceTest, HNSWAddAfterLoad) {
+    HNSWIndex original(dimension, nVectors * 2);
+    for (int i = 0; i < nVectors / 2; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    HNSWIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    for (int i = nVectors / 2; i < nVectors; i++) {
+        loaded.add(i, vec(i));
+    }
+
+    EXPECT_FALSE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors);
+
+    std::vector<int> ids(5);
+    std::vector<float> dists(5);
+    int count;
+    loaded.search(vec(nVectors - 1), 5, ids.data(), dists.data(), &count);
+    ASSERT_GT(count, 0);
+    EXPECT_EQ(ids[0], nVectors - 1);
+}
+
+TEST_F(PersistenceTest, HNSWRejectsDimensionMismatch) {
+    HNSWIndex original(dimension, 100);
+    original.add(0, vec(0));
+    original.save(path);
+
+    HNSWIndex other(dimension * 2, 100);
+    EXPECT_THROW(other.load(path), std::runtime_error);
+}
+
+TEST_F(PersistenceTest, CorruptedHeaderIsRejected) {
+    HNSWIndex original(dimension, 100);
+    for (int i = 0; i < 50; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(20);
+        char garbage = 0x7f;
+        file.write(&garbage, 1);
+    }
+
+    HNSWIndex loaded(dimension, 100);
+    EXPECT_THROW(loaded.load(path), std::runtime_error);
+}
+
+TEST_F(PersistenceTest, SectionChecksumsVerify) {
+    HNSWIndex original(dimension, 100);
+    for (int i = 0; i < 50; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    auto file = MappedIndexFile::open(path, IndexType::HNSW);
+    EXPECT_NO_THROW(file->verifyChecksums());
+    EXPECT_EQ(file->dimension(), dimension);
+
+    // Flip one float inside the vector section
+    file->section(SectionType::Vectors)[0] ^= 0x01;
+    EXPECT_THROW(file->verifyChecksums(), std::runtime_error);
+}
+
+static long fileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return static_cast<long>(file.tellg());
+}
+
+TEST_F(PersistenceTest, HNSWPQSaveLoadRoundTrip) {
+    HNSWPQConfig config;
+    config.pqM = 8;
+    HNSWPQIndex original(dimension, nVectors * 2, config);
+    original.train(nVectors, vectors.data());
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    HNSWPQIndex loaded(dimension, nVectors * 2, config);
+    loaded.load(path);
+
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_TRUE(loaded.isTrained());
+    EXPECT_TRUE(loaded.hasRawVectors());
+    EXPECT_EQ(loaded.size(), nVectors);
+
+    const int k = 10;
+    for (int q = 0; q < 20; q++) {
+        std::vector<int> idsA(k), idsB(k);
+        std::vector<float> distsA(k), distsB(k);
+        int countA, countB;
+        original.search(vec(q), k, idsA.data(), distsA.data(), &countA);
+        loaded.search(vec(q), k, idsB.data(), distsB.data(), &countB);
+
+        ASSERT_EQ(countA, countB);
+        for (int i = 0; i < countA; i++) {
+            EXPECT_EQ(idsA[i], idsB[i]);
+        }
+    }
+
+    // Writes copy the mapping out and keep working
+    std::vector<float> extra(dimension, 0.5f);
+    loaded.add(nVectors, extra.data());
+    EXPECT_FALSE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors + 1);
+}
+
+TEST_F(PersistenceTest, HNSWPQCodesOnlyFile) {
+    HNSWPQConfig config;
+    config.pqM = 8;
+    HNSWPQIndex original(dimension, nVectors * 2, config);
+    original.train(nVectors, vectors.data());
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+
+    const std::string fullPath = path + ".full";
+    original.save(fullPath, true);
+    original.save(path, false);
+    // Raw vector section is omitted
+    const long rawBytes = static_cast<long>(nVectors) * dimension * sizeof(float);
+    EXPECT_LE(fileSize(path) + rawBytes, fileSize(fullPath));
+    std::remove(fullPath.c_str());
+
+    HNSWPQIndex loaded(dimension, nVectors * 2, config);
+    loaded.load(path);
+    EXPECT_FALSE(loaded.hasRawVectors());
+    EXPECT_EQ(loaded.size(), nVectors);
+
+    std::vector<int> ids(10);
+    std::vector<float> dists(10);
+    int count;
+    loaded.search(vec(0), 10, ids.data(), dists.data(), &count);
+    EXPECT_GT(count, 0);
+    for (int i = 1; i < count; i++) {
+        EXPECT_LE(dists[i - 1], dists[i]);
+    }
+
+    EXPECT_THROW(loaded.add(nVectors, vec(0)), std::runtime_error);
+}
+
+TEST_F(PersistenceTest, PQSaveLoadRoundTrip) {
+    PQIndex original(dimension, nVectors * 2);
+    original.train(nVectors, vectors.data());
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    PQIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_TRUE(loaded.isTrained());
+    EXPECT_EQ(loaded.size(), nVectors);
+    expectSameResults(original, loaded);
+
+    loaded.add(nVectors, vec(0));
+    EXPECT_FALSE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors + 1);
+}
+
+TEST_F(PersistenceTest, PQCodesOnlyFileIsReadOnly) {
+    PQConfig config;
+    config.saveRawVectors = false;
+    PQIndex original(dimension, nVectors, config);
+    original.train(nVectors, vectors.data());
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    original.addBatch(vectors.data(), ids.data(), nVectors);
+    original.save(path);
+
+    PQIndex loaded(dimension, nVectors, config);
+    loaded.load(path);
+    expectSameResults(original, loaded);
+    EXPECT_THROW(loaded.add(0, vec(0)), std::runtime_error);
+}
+
+TEST_F(PersistenceTest, IVFSaveLoadRoundTrip) {
+    IVFConfig config;
+    config.nLists = 16;
+    config.nProbes = 4;
+    IVFIndex original(dimension, nVectors * 2, config);
+    original.train(nVectors, vectors.data());
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    IVFIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors);
+    expectSameResults(original, loaded);
+
+    // List radii are persisted, so pruned range searches agree after load
+    for (int q = 0; q < 20; q++) {
+        RangeSearchResult a, b;
+        original.rangeSearch(vec(q), 3.0f, a);
+        loaded.rangeSearch(vec(q), 3.0f, b);
+        EXPECT_EQ(a.ids, b.ids);
+        EXPECT_EQ(a.distances, b.distances);
+    }
+
+    std::vector<float> extra(dimension, 0.25f);
+    loaded.add(nVectors, extra.data());
+    original.add(nVectors, extra.data());
+    EXPECT_FALSE(loaded.isMapped());
+    expectSameResults(original, loaded);
+}
+
+TEST_F(PersistenceTest, FlatSaveLoadRoundTrip) {
+    FlatConfig config;
+    config.metric = Metric::COSINE;
+    FlatIndex original(dimension, nVectors * 2, config);
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    original.addBatch(vectors.data(), ids.data(), nVectors);
+    original.save(path);
+
+    FlatIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors);
+    expectSameResults(original, loaded);
+
+    std::vector<float> extra(dimension, 0.25f);
+    loaded.add(nVectors, extra.data());
+    original.add(nVectors, extra.data());
+    EXPECT_FALSE(loaded.isMapped());
+    expectSameResults(original, loaded);
+}
+
+TEST_F(PersistenceTest, IVFPQSaveLoadRoundTrip) {
+    for (int nBits : {8, 4}) {
+        IVFPQConfig config;
+        config.nLists = 8;
+        config.nProbes = 4;
+        config.pqM = 8;
+        config.nBits = nBits;
+        config.rerankWithVectors = true;
+        IVFPQIndex original(dimension, nVectors * 2, config);
+        original.train(nVectors, vectors.data());
+        for (int i = 0; i < nVectors; i++) {
+            original.add(i, vec(i));
+        }
+        original.save(path);
+
+        IVFPQIndex loaded(dimension, nVectors * 2);
+        loaded.load(path);
+        EXPECT_TRUE(loaded.isMapped());
+        EXPECT_EQ(loaded.size(), nVectors);
+        expectSameResults(original, loaded);
+
+        std::vector<float> extra(dimension, 0.25f);
+        loaded.add(nVectors, extra.data());
+        original.add(nVectors, extra.data());
+        EXPECT_FALSE(loaded.isMapped());
+        expectSameResults(original, loaded);
+    }
+}
+
+TEST_F(PersistenceTest, IVFPQCodesOnlyFileIsReadOnly) {
+    IVFPQConfig config;
+    config.nLists = 8;
+    config.saveRawVectors = false;
+    config.rerankWithVectors = true;
+    IVFPQIndex original(dimension, nVectors, config);
+    original.train(nVectors, vectors.data());
+    std::vector<int> ids(nVectors);
+    std::iota(ids.begin(), ids.end(), 0);
+    original.addBatch(vectors.data(), ids.data(), nVectors);
+    original.save(path);
+
+    // Without raw vectors the loaded index answers from PQ distances only
+    IVFPQIndex loaded(dimension, nVectors, config);
+    loaded.load(path);
+    const int k = 5;
+    std::vector<int> resultIds(k);
+    std::vector<float> dists(k);
+    int count;
+    loaded.search(vec(0), k, resultIds.data(), dists.data(), &count);
+    EXPECT_EQ(count, k);
+    EXPECT_THROW(loaded.add(0, vec(0)), std::runtime_error);
+}
+
+TEST_F(PersistenceTest, HNSWQuantizedStorageRoundTrip) {
+    for (bool rerank : {true, false}) {
+        HNSWConfig config;
+        config.storage = VectorEncoding::SQ8;
+        config.rerankWithVectors = rerank;
+        HNSWIndex original(dimension, nVectors * 2, config);
+        original.train(nVectors, vectors.data());
+        for (int i = 0; i < nVectors; i++) {
+            original.add(i, vec(i));
+        }
+        original.save(path);
+
+        // Encoding, ranges and codes all come from the file
+        HNSWIndex loaded(dimension, nVectors * 2);
+        loaded.load(path);
+        EXPECT_TRUE(loaded.isMapped());
+        expectSameResults(original, loaded);
+
+        // Detaching copies the codes out and keeps encoding new vectors
+        std::vector<float> extra(dimension, 0.5f);
+        loaded.add(nVectors, extra.data());
+        EXPECT_FALSE(loaded.isMapped());
+        std::vector<int> ids(1);
+        std::vector<float> dists(1);
+        int count;
+        loaded.search(extra.data(), 1, ids.data(), dists.data(), &count);
+        ASSERT_EQ(count, 1);
+        EXPECT_EQ(ids[0], nVectors);
+    }
+}
+
+TEST_F(PersistenceTest, MetricSurvivesSaveLoad) {
+    HNSWPQConfig config;
+    config.metric = Metric::COSINE;
+    config.pqM = 8;
+    HNSWPQIndex original(dimension, nVectors * 2, config);
+    original.train(nVectors, vectors.data());
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    // The loaded index is configured as L2 and must pick up COSINE from the file
+    config.metric = Metric::L2;
+    HNSWPQIndex loaded(dimension, nVectors * 2, config);
+    loaded.load(path);
+    expectSameResults(original, loaded);
+
+    // Under L2 a scaled copy would be far from every stored vector
+    std::vector<float> scaled(vec(7), vec(7) + dimension);
+    for (auto& v : scaled) v *= 3.0f;
+    std::vector<int> ids(1);
+    std::vector<float> dists(1);
+    int count;
+    loaded.search(scaled.data(), 1, ids.data(), dists.data(), &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_LT(dists[0], 0.5f);
+}
+
+TEST_F(PersistenceTest, LSHSaveLoadRoundTrip) {
+    LSHIndex original(dimension, nVectors * 2, 6, 8);
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.save(path);
+
+    LSHIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors);
+    expectSameResults(original, loaded);
+
+    std::vector<int> ids(1);
+    std::vector<float> dists(1);
+    int count;
+    loaded.search(vec(3), 1, ids.data(), dists.data(), &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_EQ(ids[0], 3);
+
+    // Inserting after load works on the detached copy of the bucket tables
+    std::vector<float> extra(dimension, 5.0f);
+    loaded.add(nVectors, extra.data());
+    EXPECT_FALSE(loaded.isMapped());
+    loaded.search(extra.data(), 1, ids.data(), dists.data(), &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_EQ(ids[0], nVectors);
+}
+
+TEST_F(PersistenceTest, AnnoySaveLoadRoundTrip) {
+    AnnoyIndex original(dimension, nVectors * 2, 8);
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+    }
+    original.build();
+    original.save(path);
+
+    AnnoyIndex loaded(dimension, nVectors * 2);
+    loaded.load(path);
+    EXPECT_TRUE(loaded.isMapped());
+    EXPECT_TRUE(loaded.isBuilt());
+    EXPECT_EQ(loaded.size(), nVectors);
+    expectSameResults(original, loaded);
+
+    // Rebuilding after new inserts works on the detached copy
+    loaded.add(nVectors, vec(0));
+    loaded.build();
+    EXPECT_FALSE(loaded.isMapped());
+    EXPECT_EQ(loaded.size(), nVectors + 1);
+}
+
+TEST_F(PersistenceTest, ShardedSaveLoadRoundTrip) {
+    const int numShards = 3;
+    auto makeShard = [&](int) { return std::make_unique<HNSWIndex>(dimension, nVectors); };
+    ShardedIndex original(numShards, makeShard);
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i + 1000, vec(i));
+    }
+    original.save(path);
+
+    ShardedIndex loaded(numShards, makeShard);
+    loaded.load(path);
+    EXPECT_EQ(loaded.size(), nVectors);
+    for (int s = 0; s < numShards; s++) {
+        EXPECT_EQ(loaded.shard(s).size(), original.shard(s).size());
+    }
+    expectSameResults(original, loaded);
+
+    ShardedIndex mismatched(numShards + 1, makeShard);
+    EXPECT_THROW(mismatched.load(path), std::runtime_error);
+
+    for (int s = 0; s < numShards; s++) {
+        std::remove(ShardedIndex::shardPath(path, s).c_str());
+    }
+}
+
+TEST_F(PersistenceTest, TombstonesSurviveSaveLoad) {
+    HNSWIndex original(dimension, nVectors);
+    FlatIndex flat(dimension, nVectors);
+    for (int i = 0; i < nVectors; i++) {
+        original.add(i, vec(i));
+        flat.add(i, vec(i));
+    }
+    for (int i = 0; i < nVectors; i += 2) {
+        original.remove(i);
+        flat.remove(i);
+    }
+
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&original, &flat}) {
+        index->save(path);
+        std::unique_ptr<VectorIndex> loaded;
+        if (index == &original) {
+            loaded.reset(new HNSWIndex(dimension, nVectors));
+        } else {
+            loaded.reset(new FlatIndex(dimension, nVectors));
+        }
+        loaded->load(path);
+        EXPECT_EQ(loaded->size(), nVectors / 2);
+        expectSameResults(*index, *loaded);
+
+        // Ids resolve again after loading, removed ones stay gone
+        EXPECT_FALSE(loaded->remove(0));
+        EXPECT_TRUE(loaded->remove(1));
+        EXPECT_EQ(loaded->compact(), nVectors / 2 + 1);
+        EXPECT_EQ(loaded->size(), nVectors / 2 - 1);
+    }
+}
+
+TEST_F(PersistenceTest, GrownIndexesSpanChunksAcrossSaveLoad) {
+    // Well past the initial reservation and across a store chunk boundary
+    const int n = VectorStore::CHUNK_ROWS + 904;
+    vectors.resize(static_cast<size_t>(n) * dimension);
+    for (auto& v : vectors) {
+        v = dist(rng);
+    }
+
+    HNSWIndex hnsw(dimension, 16);
+    FlatIndex flat(dimension, 16);
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; i++) ids[i] = i;
+    hnsw.setNumThreads(4);
+    hnsw.addBatch(vectors.data(), ids.data(), n);
+    flat.addBatch(vectors.data(), ids.data(), n);
+    EXPECT_EQ(hnsw.size(), n);
+    EXPECT_GE(hnsw.capacity(), n);
+    EXPECT_EQ(flat.size(), n);
+
+    // Rows on both sides of the boundary are found exactly
+    for (int i : {0, VectorStore::CHUNK_ROWS - 1, VectorStore::CHUNK_ROWS, n - 1}) {
+        int id;
+        float d;
+        int count;
+        flat.search(vec(i), 1, &id, &d, &count);
+        ASSERT_EQ(count, 1);
+        EXPECT_EQ(id, i);
+    }
+
+    for (VectorIndex* index : std::initializer_list<VectorIndex*>{&hnsw, &flat}) {
+        index->save(path);
+        std::unique_ptr<VectorIndex> loaded;
+        if (index == &hnsw) {
+            loaded.reset(new HNSWIndex(dimension, 16));
+        } else {
+            loaded.reset(new FlatIndex(dimension, 16));
+        }
+        loaded->load(path);
+        EXPECT_EQ(loaded->size(), n);
+        expectSameResults(*index, *loaded);
+
+        // The first add copies every mapped chunk out and keeps growing
+        loaded->add(n, vec(0));
+        EXPECT_EQ(loaded->size(), n + 1);
+    }
+}
@@ -1,7 +1,30 @@
 #include <gtest/gtest.h>
 #include "index/HNSWIndex.h"
+#include "index/LSHIndex.h"
+#include "index/AnnoyIndex.h"
+#include "index/ShardedIndex.h"
+#include "index/AsyncIngestIndex.h"
+#include "index/FlatIndex.h"
+#include "index/IVFIndex.h"
+#include "core/VisitedPool.h"
+#include "core/ChunkedArray.h"
+#include "core/MemoryAllocator.h"
+#include "compute/DistanceUtils.h"
+#include "compute/FastScan.h"
+#include "compute/ADCUtils.h"
+#include "compute/BatchDistance.h"
+#include "compute/KMeans.h"
+#include "core/ThreadPool.h"
+#include "core/HandleRegistry.h"
+#include "core/SearchStats.h"
+#include "core/GraphReorder.h"
 #include <vector>
 #include <random>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 using namespace vectordb;
 
@@ -43,4 +66,934 @@ TEST(HNSWSimpleTest, SearchOnEmptyIndex) {
     index.search(query.data(), k, ids.data(), distances.data(), &count);
 
     EXPECT_EQ(count, 0);
-}
\ No newline at end of file
+}
+
+TEST(VisitedPoolTest, ResetClearsMarksAcrossEpochWraparound) {
+    VisitedPool pool;
+    auto table = pool.acquire(16);
+
+    // Run past the uint16 epoch range to hit the wraparound path
+    for (int i = 0; i < 70000; i++) {
+        table->reset();
+        EXPECT_TRUE(table->tryVisit(i % 16));
+        EXPECT_FALSE(table->tryVisit(i % 16));
+        if (table->isVisited((i + 1) % 16)) {
+            FAIL() << "stale mark survived reset at iteration " << i;
+        }
+    }
+
+    table->ensureCapacity(64);
+    EXPECT_FALSE(table->isVisited(63));
+}
+
+
+TEST(ChunkedArrayTest, GrowthKeepsRowAddresses) {
+    ChunkedArray<int32_t> array(3, 8);
+    array.reserve(5);
+    EXPECT_EQ(array.capacity(), 8u);
+    for (size_t i = 0; i < 5; i++) {
+        EXPECT_EQ(array.row(i)[0], 0);  // fresh chunks are zeroed
+        array.row(i)[2] = static_cast<int32_t>(i);
+    }
+    const int32_t* first = array.row(0);
+    const int32_t* fourth = array.row(4);
+
+    array.reserve(100);
+    EXPECT_EQ(array.capacity(), 104u);
+    EXPECT_EQ(array.row(0), first);
+    EXPECT_EQ(array.row(4), fourth);
+    EXPECT_EQ(array.contiguousRows(5), 3u);
+
+    // Runs follow chunk boundaries
+    std::vector<size_t> runs;
+    array.forEachRun(20, [&](const int32_t*, size_t n) { runs.push_back(n); });
+    EXPECT_EQ(runs, (std::vector<size_t>{8, 8, 4}));
+
+    // Attached memory is copied out on detach and can then grow
+    std::vector<int32_t> external(3 * 10);
+    for (size_t i = 0; i < external.size(); i++) external[i] = static_cast<int32_t>(i);
+    array.attach(external.data(), 10);
+    EXPECT_EQ(array.row(9), external.data() + 27);
+    EXPECT_THROW(array.reserve(20), std::logic_error);
+    array.detach(10);
+    EXPECT_NE(array.row(9), external.data() + 27);
+    EXPECT_EQ(array.row(9)[1], 28);
+    array.reserve(20);
+    EXPECT_EQ(array.row(9)[1], 28);
+}
+
+TEST(MemoryAllocatorTest, FallsBackAndReportsEffectiveMode) {
+    // Whatever the host offers, allocations succeed zeroed and the report never exceeds the request
+    const size_t bytes = size_t(3) << 20;
+    for (PageMode mode : {PageMode::Default, PageMode::Transparent, PageMode::Huge2MB, PageMode::Huge1GB}) {
+        MemoryPolicy policy;
+        policy.pages = mode;
+        policy.numa = NumaMode::Interleave;
+        MemoryAllocator allocator(policy);
+        auto* memory = static_cast<uint8_t*>(allocator.allocate(bytes));
+        ASSERT_NE(memory, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(memory) % 64, 0u);
+        EXPECT_EQ(memory[0], 0);
+        EXPECT_EQ(memory[bytes - 1], 0);
+        memory[bytes - 1] = 1;
+        allocator.deallocate(memory, bytes);
+
+        // 3MB is below half a 1GB page, so that request is reported as what served it
+        const MemoryPolicy effective = allocator.effective();
+        EXPECT_LE(static_cast<int>(effective.pages), std::min(static_cast<int>(mode), 2));
+        EXPECT_NE(effective.numa, NumaMode::Bind);
+    }
+
+    // Binding to a node that does not exist leaves the default placement and says so
+    MemoryPolicy policy;
+    policy.numa = NumaMode::Bind;
+    policy.numaNode = 1000;
+    MemoryAllocator allocator(policy);
+    void* memory = allocator.allocate(bytes);
+    allocator.deallocate(memory, bytes);
+    EXPECT_EQ(allocator.effective().numa, NumaMode::None);
+}
+
+TEST(MemoryAllocatorTest, IndexesApplyPolicyBeforeFirstAdd) {
+    MemoryPolicy policy;
+    policy.pages = PageMode::Huge2MB;
+    policy.numa = NumaMode::Interleave;
+
+    // 128-d vectors fill a 2MB chunk, so the report covers the vector storage
+    HNSWIndex index(128, 100);
+    const MemoryPolicy effective = index.setMemoryPolicy(policy);
+    EXPECT_LE(static_cast<int>(effective.pages), static_cast<int>(PageMode::Huge2MB));
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> vec(128);
+    for (int i = 0; i < 200; i++) {
+        for (float& v : vec) v = dist(rng);
+        index.add(i, vec.data());
+    }
+    int id;
+    float d;
+    int count;
+    index.search(vec.data(), 1, &id, &d, &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_EQ(id, 199);
+
+    EXPECT_THROW(index.setMemoryPolicy(policy), std::logic_error);
+}
+
+TEST(DistanceKernelTest, EveryAvailableISAMatchesScalar) {
+    const DistanceKernels* scalar = getDistanceKernels(ISA::SCALAR);
+    ASSERT_NE(scalar, nullptr);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // Every length up to 70 exercises the full-width loops and each tail size
+    for (ISA isa : {ISA::AVX2, ISA::AVX512, ISA::NEON}) {
+        const DistanceKernels* kernels = getDistanceKernels(isa);
+        if (!kernels) continue;
+
+        for (size_t dim = 1; dim <= 70; dim++) {
+            std::vector<float> a(dim), b(dim * 3);
+            for (auto& v : a) v = dist(rng);
+            for (auto& v : b) v = dist(rng);
+
+            const float tol = 1e-4f * dim;
+            EXPECT_NEAR(kernels->euclidean(a.data(), b.data(), dim),
+                        scalar->euclidean(a.data(), b.data(), dim), tol) << "dim " << dim;
+            EXPECT_NEAR(kernels->innerProduct(a.data(), b.data(), dim),
+                        scalar->innerProduct(a.data(), b.data(), dim), tol) << "dim " << dim;
+            EXPECT_NEAR(kernels->cosine(a.data(), b.data(), dim),
+                        scalar->cosine(a.data(), b.data(), dim), tol) << "dim " << dim;
+
+            float batch[3], expected[3];
+            kernels->batchEuclidean(a.data(), b.data(), 3, dim, batch);
+            scalar->batchEuclidean(a.data(), b.data(), 3, dim, expected);
+            for (int i = 0; i < 3; i++) {
+                EXPECT_NEAR(batch[i], expected[i], tol) << "dim " << dim;
+            }
+
+            std::vector<uint8_t> sq8(dim);
+            std::vector<uint16_t> fp16(dim);
+            std::vector<float> vmin(dim), scale(dim);
+            for (size_t i = 0; i < dim; i++) {
+                sq8[i] = static_cast<uint8_t>(rng() & 0xff);
+                fp16[i] = floatToHalf(b[i]);
+                vmin[i] = -1.0f + 0.01f * (i % 7);
+                scale[i] = 2.0f / 255.0f;
+            }
+            EXPECT_NEAR(kernels->sq8Euclidean(a.data(), sq8.data(), vmin.data(), scale.data(), dim),
+                        scalar->sq8Euclidean(a.data(), sq8.data(), vmin.data(), scale.data(), dim), tol)
+                << "dim " << dim;
+            EXPECT_NEAR(kernels->sq8InnerProduct(a.data(), sq8.data(), vmin.data(), scale.data(), dim),
+                        scalar->sq8InnerProduct(a.data(), sq8.data(), vmin.data(), scale.data(), dim), tol)
+                << "dim " << dim;
+            EXPECT_NEAR(kernels->fp16Euclidean(a.data(), fp16.data(), dim),
+                        scalar->fp16Euclidean(a.data(), fp16.data(), dim), tol) << "dim " << dim;
+            EXPECT_NEAR(kernels->fp16InnerProduct(a.data(), fp16.data(), dim),
+                        scalar->fp16InnerProduct(a.data(), fp16.data(), dim), tol) << "dim " << dim;
+        }
+    }
+
+    // The dispatched function must come from a set the CPU supports
+    EXPECT_NE(getEuclideanDistanceFunc(), nullptr);
+    EXPECT_NE(getInnerProductDistanceFunc(), nullptr);
+}
+
+TEST(DistanceKernelTest, HalfConversionRoundTrips) {
+    // Every finite half converts to float and back unchanged
+    for (uint32_t h = 0; h < 0x10000u; h++) {
+        if ((h & 0x7c00u) == 0x7c00u) continue;
+        EXPECT_EQ(floatToHalf(halfToFloat(static_cast<uint16_t>(h))), h) << "half " << h;
+    }
+
+    EXPECT_EQ(halfToFloat(floatToHalf(1.0f)), 1.0f);
+    EXPECT_EQ(halfToFloat(floatToHalf(-2.5f)), -2.5f);
+    EXPECT_EQ(halfToFloat(floatToHalf(65504.0f)), 65504.0f);
+    EXPECT_TRUE(std::isinf(halfToFloat(floatToHalf(1e6f))));
+    // 1 + 2^-11 lies halfway between two halves and rounds to the even one
+    EXPECT_EQ(halfToFloat(floatToHalf(1.0f + 1.0f / 2048.0f)), 1.0f);
+    EXPECT_NEAR(halfToFloat(floatToHalf(0.1f)), 0.1f, 1e-4f);
+}
+
+TEST(DistanceKernelTest, FastScanMatchesUnpackedLookup) {
+    std::mt19937 rng(11);
+    for (int pqM : {1, 2, 7, 16, 33}) {
+        const int n = 70;  // two full blocks and a partial one
+        const int paddedM = fastScanPaddedM(pqM);
+        const size_t nBlocks = (n + FASTSCAN_BLOCK - 1) / FASTSCAN_BLOCK;
+
+        std::vector<uint8_t> codes(static_cast<size_t>(n) * pqM);
+        for (auto& c : codes) c = static_cast<uint8_t>(rng() & 0x0f);
+        std::vector<uint8_t> packed(nBlocks * fastScanBlockBytes(pqM), 0);
+        for (int i = 0; i < n; i++) {
+            packFastScanCode(codes.data() + static_cast<size_t>(i) * pqM, pqM, i, packed.data());
+        }
+
+        std::vector<float> table(static_cast<size_t>(pqM) * 16);
+        for (auto& t : table) t = static_cast<float>(rng() % 1000) / 10.0f;
+        std::vector<uint8_t> lut(static_cast<size_t>(paddedM) * 16);
+        float bias, scale;
+        quantizeFastScanLUT(table.data(), pqM, lut.data(), &bias, &scale);
+
+        std::vector<uint16_t> expected(nBlocks * FASTSCAN_BLOCK), actual(nBlocks * FASTSCAN_BLOCK);
+        fastScanScalar(packed.data(), nBlocks, paddedM, lut.data(), expected.data());
+        getFastScanFunc()(packed.data(), nBlocks, paddedM, lut.data(), actual.data());
+
+        for (int i = 0; i < n; i++) {
+            uint32_t sum = 0;
+            float exact = 0.0f;
+            for (int m = 0; m < pqM; m++) {
+                const uint8_t c = codes[static_cast<size_t>(i) * pqM + m];
+                sum += lut[static_cast<size_t>(m) * 16 + c];
+                exact += table[static_cast<size_t>(m) * 16 + c];
+            }
+            EXPECT_EQ(expected[i], sum) << "M " << pqM << " vector " << i;
+            EXPECT_EQ(actual[i], sum) << "M " << pqM << " vector " << i;
+            EXPECT_NEAR(bias + scale * sum, exact, pqM * scale * 0.5f + 1e-3f);
+        }
+    }
+}
+
+TEST(DistanceKernelTest, BatchADCAndGemmTablesMatchScalar) {
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    const int nCentroids = 256;
+    for (int pqM : {4, 8, 16, 33}) {
+        const int subDim = 3;
+        const int n = 21;  // two full batches of 8 and a tail
+
+        std::vector<float> table(static_cast<size_t>(pqM) * nCentroids);
+        for (auto& t : table) t = static_cast<float>(rng() % 1000) / 10.0f;
+        std::vector<uint8_t> codes(static_cast<size_t>(n) * pqM);
+        for (auto& c : codes) c = static_cast<uint8_t>(rng());
+        std::vector<float> batch(n);
+        getADCDistanceBatchFunc()(table.data(), codes.data(), n, pqM, nCentroids, batch.data());
+        for (int i = 0; i < n; i++) {
+            EXPECT_FLOAT_EQ(batch[i], adcDistanceScalar(table.data(), codes.data() + static_cast<size_t>(i) * pqM,
+                                                        pqM, nCentroids)) << "M " << pqM << " code " << i;
+        }
+
+        // GEMM-built tables for a block of queries agree with the per-query kernel build
+        const int nQueries = 5;
+        std::vector<float> codebooks(static_cast<size_t>(pqM) * nCentroids * subDim);
+        for (auto& x : codebooks) x = uniform(rng);
+        std::vector<float> norms(static_cast<size_t>(pqM) * nCentroids);
+        computeRowNormsSquared(codebooks.data(), norms.size(), subDim, norms.data());
+        std::vector<float> queries(static_cast<size_t>(nQueries) * pqM * subDim);
+        for (auto& x : queries) x = uniform(rng);
+
+        for (Metric metric : {Metric::L2, Metric::INNER_PRODUCT}) {
+            std::vector<float> tables(static_cast<size_t>(nQueries) * table.size());
+            buildADCTables(metric, queries.data(), nQueries, codebooks.data(), norms.data(),
+                           pqM, nCentroids, subDim, tables.data());
+            for (int q = 0; q < nQueries; q++) {
+                std::vector<float> expected(table.size());
+                buildADCTable(metric, queries.data() + static_cast<size_t>(q) * pqM * subDim, codebooks.data(),
+                              pqM, nCentroids, subDim, expected.data());
+                for (size_t j = 0; j < expected.size(); j++) {
+                    ASSERT_NEAR(tables[q * table.size() + j], expected[j], 1e-4f) << "M " << pqM << " query " << q;
+                }
+            }
+        }
+    }
+}
+
+TEST(KMeansTest, RecoversSeparatedClustersWithEveryMode) {
+    const int dim = 8;
+    const int k = 4;
+    const int perCluster = 200;
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+
+    std::vector<float> samples;
+    for (int i = 0; i < perCluster; i++) {
+        for (int c = 0; c < k; c++) {
+            for (int d = 0; d < dim; d++) {
+                samples.push_back((d == c ? 10.0f : 0.0f) + noise(rng));
+            }
+        }
+    }
+    const int n = perCluster * k;
+
+    for (int mode = 0; mode < 3; mode++) {
+        KMeansConfig config;
+        config.k = k;
+        config.init = mode == 1 ? KMeansInit::KMEANS_PLUS_PLUS : KMeansInit::RANDOM;
+        config.batchSize = mode == 2 ? 64 : 0;
+        std::vector<float> centroids(static_cast<size_t>(k) * dim);
+        double objective = trainKMeans(samples.data(), n, dim, config, centroids.data());
+        EXPECT_LT(objective / n, 0.1);
+
+        std::vector<int> assignments(n);
+        assignNearestCentroids(samples.data(), n, centroids.data(), nullptr, k, dim, assignments.data());
+        for (int i = 0; i < n; i++) {
+            EXPECT_EQ(assignments[i], assignments[i % k]);
+        }
+    }
+}
+
+TEST(KMeansTest, SplitsEmptyClusters) {
+    // Two tight blobs for eight centroids: random seeding leaves clusters empty, splitting refills them
+    const int dim = 4;
+    const int k = 8;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    std::vector<float> samples;
+    for (int i = 0; i < 400; i++) {
+        for (int d = 0; d < dim; d++) {
+            samples.push_back((i < 390 ? 1.0f : -1.0f) + noise(rng));
+        }
+    }
+
+    KMeansConfig config;
+    config.k = k;
+    std::vector<float> centroids(static_cast<size_t>(k) * dim);
+    trainKMeans(samples.data(), 400, dim, config, centroids.data());
+
+    std::vector<int> assignments(400);
+    assignNearestCentroids(samples.data(), 400, centroids.data(), nullptr, k, dim, assignments.data());
+    std::vector<int> sizes(k, 0);
+    for (int a : assignments) sizes[a]++;
+    for (int c = 0; c < k; c++) {
+        EXPECT_GT(sizes[c], 0) << "centroid " << c;
+    }
+}
+
+TEST(ThreadPoolTest, CoversEveryIndexOnceIncludingNestedCalls) {
+    ThreadPool pool(3);
+    const int n = 1000;
+    std::vector<std::atomic<int>> hits(n * 8);
+    for (auto& h : hits) h.store(0);
+
+    pool.parallelFor(0, n, 7, [&](int64_t start, int64_t end) {
+        EXPECT_LE(end - start, 7);
+        for (int64_t i = start; i < end; i++) {
+            // Nested call from a worker must not deadlock
+            pool.parallelFor(0, 8, 1, [&](int64_t s, int64_t e) {
+                for (int64_t j = s; j < e; j++) hits[i * 8 + j]++;
+            });
+        }
+    });
+    for (int i = 0; i < n * 8; i++) {
+        ASSERT_EQ(hits[i].load(), 1) << "index " << i;
+    }
+
+    // A per-call limit of one thread runs everything on the caller
+    const auto caller = std::this_thread::get_id();
+    pool.parallelFor(0, 100, 1, [&](int64_t, int64_t) {
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+    }, 1);
+}
+
+TEST(ThreadPoolTest, RethrowsFirstException) {
+    ThreadPool pool(3);
+    std::atomic<int> calls{0};
+    EXPECT_THROW(pool.parallelFor(0, 10000, 1, [&](int64_t start, int64_t) {
+        calls++;
+        if (start == 5000) throw std::runtime_error("boom");
+    }), std::runtime_error);
+
+    // The pool stays usable after a failed call
+    std::atomic<int64_t> sum{0};
+    pool.parallelFor(0, 100, 3, [&](int64_t start, int64_t end) {
+        for (int64_t i = start; i < end; i++) sum += i;
+    });
+    EXPECT_EQ(sum.load(), 4950);
+}
+
+TEST(HandleRegistryTest, StaleHandlesNeverResolve) {
+    HandleRegistry<int> registry(2);
+    const int64_t a = registry.add(std::make_unique<int>(1));
+    const int64_t b = registry.add(std::make_unique<int>(2));
+    EXPECT_NE(a, 0);
+    EXPECT_NE(b, 0);
+    EXPECT_EQ(registry.add(std::make_unique<int>(3)), 0);  // Full
+
+    {
+        EpochDomain::Guard guard;
+        ASSERT_NE(registry.get(a), nullptr);
+        EXPECT_EQ(*registry.get(a), 1);
+        EXPECT_EQ(*registry.get(b), 2);
+        EXPECT_EQ(registry.get(0), nullptr);
+    }
+
+    EXPECT_TRUE(registry.remove(a));
+    EXPECT_FALSE(registry.remove(a));
+
+    // The freed slot is reused under a new generation
+    const int64_t c = registry.add(std::make_unique<int>(4));
+    EXPECT_NE(c, a);
+    EpochDomain::Guard guard;
+    EXPECT_EQ(registry.get(a), nullptr);
+    EXPECT_EQ(*registry.get(c), 4);
+}
+
+TEST(HandleRegistryTest, RemoveDefersDestructionUntilReadersLeave) {
+    struct Tracked {
+        std::atomic<bool>* destroyed;
+        ~Tracked() { destroyed->store(true); }
+    };
+    std::atomic<bool> destroyed{false};
+    HandleRegistry<Tracked> registry(4);
+    const int64_t handle = registry.add(std::unique_ptr<Tracked>(new Tracked{&destroyed}));
+
+    std::atomic<bool> inside{false};
+    std::atomic<bool> release{false};
+    std::atomic<bool> sawLiveObject{true};
+    std::thread reader([&]() {
+        EpochDomain::Guard guard;
+        Tracked* object = registry.get(handle);
+        inside = true;
+        while (!release) std::this_thread::yield();
+        sawLiveObject = object != nullptr && !destroyed.load();
+    });
+
+    while (!inside) std::this_thread::yield();
+    // Returns at once even though a reader still holds the object
+    EXPECT_TRUE(registry.remove(handle));
+    EXPECT_EQ(registry.reclaim(), 1u);
+    EXPECT_FALSE(destroyed.load());
+    {
+        EpochDomain::Guard guard;
+        EXPECT_EQ(registry.get(handle), nullptr);
+    }
+
+    release = true;
+    reader.join();
+    EXPECT_TRUE(sawLiveObject.load());
+    EXPECT_EQ(registry.reclaim(), 0u);
+    EXPECT_TRUE(destroyed.load());
+}
+
+TEST(HandleRegistryTest, PinKeepsObjectAliveOutsideGuard) {
+    struct Tracked {
+        std::atomic<bool>* destroyed;
+        ~Tracked() { destroyed->store(true); }
+    };
+    std::atomic<bool> destroyed{false};
+    std::atomic<bool> otherDestroyed{false};
+    HandleRegistry<Tracked> registry(4);
+    const int64_t handle = registry.add(std::unique_ptr<Tracked>(new Tracked{&destroyed}));
+    const int64_t other = registry.add(std::unique_ptr<Tracked>(new Tracked{&otherDestroyed}));
+
+    HandleRegistry<Tracked>::Pinned pinned;
+    {
+        EpochDomain::Guard guard;
+        pinned = registry.pin(handle);
+    }
+    ASSERT_TRUE(pinned);
+
+    // No reader is inside a Guard, so only the pinned object waits
+    EXPECT_TRUE(registry.remove(other));
+    EXPECT_TRUE(otherDestroyed.load());
+    EXPECT_TRUE(registry.remove(handle));
+    EXPECT_EQ(registry.reclaim(), 1u);
+    EXPECT_FALSE(destroyed.load());
+    {
+        EpochDomain::Guard guard;
+        EXPECT_FALSE(registry.pin(handle));
+    }
+
+    // Dropping the last pin of a removed object destroys it
+    pinned = HandleRegistry<Tracked>::Pinned();
+    EXPECT_TRUE(destroyed.load());
+    EXPECT_EQ(registry.reclaim(), 0u);
+}
+
+TEST(LSHTest, MultiProbeMatchesRecallWithFewerTables) {
+    const int dim = 32, n = 4000, nq = 50, k = 10;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    std::vector<float> centers(100 * dim);
+    for (auto& c : centers) c = gauss(rng) * 2.0f;
+    auto sample = [&](float* out) {
+        int c = rng() % 100;
+        for (int d = 0; d < dim; d++) out[d] = centers[c * dim + d] + 0.7f * gauss(rng);
+    };
+    std::vector<float> data(static_cast<size_t>(n) * dim), queries(nq * dim);
+    for (int i = 0; i < n; i++) sample(&data[static_cast<size_t>(i) * dim]);
+    for (int i = 0; i < nq; i++) sample(&queries[i * dim]);
+
+    FlatIndex flat(dim, n);
+    LSHIndex wide(dim, n, 40, 12);
+    LSHConfig config;
+    config.numHashTables = 10;
+    config.numHashFunctions = 12;
+    config.numProbes = 8;
+    LSHIndex probed(dim, n, config);
+    for (int i = 0; i < n; i++) {
+        flat.add(i, &data[static_cast<size_t>(i) * dim]);
+        wide.add(i, &data[static_cast<size_t>(i) * dim]);
+        probed.add(i, &data[static_cast<size_t>(i) * dim]);
+    }
+
+    auto recall = [&](LSHIndex& index) {
+        int hits = 0;
+        std::vector<int> truth(k), ids(k);
+        std::vector<float> dists(k);
+        for (int q = 0; q < nq; q++) {
+            int count;
+            flat.search(&queries[q * dim], k, truth.data(), dists.data(), &count);
+            index.search(&queries[q * dim], k, ids.data(), dists.data(), &count);
+            for (int i = 0; i < count; i++) {
+                hits += std::count(truth.begin(), truth.end(), ids[i]) > 0;
+            }
+        }
+        return hits / static_cast<double>(nq * k);
+    };
+
+    double wideRecall = recall(wide);
+    double probedRecall = recall(probed);
+    EXPECT_GE(probedRecall, wideRecall - 0.02);
+    EXPECT_LT(probed.getTableMemoryUsage() * 2, wide.getTableMemoryUsage());
+
+    // A single probe on the same tables finds fewer neighbors
+    probed.setNumProbes(1);
+    EXPECT_LT(recall(probed), probedRecall);
+}
+
+TEST(AnnoyTest, BestFirstSearchUsesAllTrees) {
+    const int dim = 32, n = 5000, nq = 50, k = 10;
+    std::mt19937 rng(13);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    std::vector<float> centers(100 * dim);
+    for (auto& c : centers) c = gauss(rng) * 2.0f;
+    auto sample = [&](float* out) {
+        int c = rng() % 100;
+        for (int d = 0; d < dim; d++) out[d] = centers[c * dim + d] + 0.7f * gauss(rng);
+    };
+    std::vector<float> data(static_cast<size_t>(n) * dim), queries(nq * dim);
+    for (int i = 0; i < n; i++) sample(&data[static_cast<size_t>(i) * dim]);
+    for (int i = 0; i < nq; i++) sample(&queries[i * dim]);
+
+    FlatIndex flat(dim, n);
+    AnnoyIndex annoy(dim, n, 30);
+    for (int i = 0; i < n; i++) {
+        flat.add(i, &data[static_cast<size_t>(i) * dim]);
+        annoy.add(i, &data[static_cast<size_t>(i) * dim]);
+    }
+    annoy.build();
+
+    // The candidate budget (2 * k per tree) is shared by all trees, so recall
+    // only gets this high when the search spreads it over the whole forest
+    int hits = 0;
+    std::vector<int> truth(k), ids(k);
+    std::vector<float> dists(k);
+    for (int q = 0; q < nq; q++) {
+        int count;
+        flat.search(&queries[q * dim], k, truth.data(), dists.data(), &count);
+        annoy.search(&queries[q * dim], k, ids.data(), dists.data(), &count);
+        ASSERT_EQ(count, k);
+        for (int i = 1; i < count; i++) {
+            EXPECT_LE(dists[i - 1], dists[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            hits += std::count(truth.begin(), truth.end(), ids[i]) > 0;
+        }
+    }
+    EXPECT_GT(hits / static_cast<double>(nq * k), 0.8);
+}
+
+TEST(ShardedIndexTest, ExactShardsMatchSingleIndex) {
+    const int dim = 16, n = 2000, nq = 20, k = 10, numShards = 4;
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim), queries(nq * dim);
+    for (auto& v : data) v = uniform(rng);
+    for (auto& v : queries) v = uniform(rng);
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; i++) ids[i] = i * 3 + 1;
+
+    FlatIndex single(dim, n);
+    single.addBatch(data.data(), ids.data(), n);
+    ShardedIndex sharded(numShards, [&](int) { return std::make_unique<FlatIndex>(dim, n); });
+    sharded.addBatch(data.data(), ids.data(), n / 2);
+    for (int i = n / 2; i < n; i++) {
+        sharded.add(ids[i], &data[static_cast<size_t>(i) * dim]);
+    }
+
+    ASSERT_EQ(sharded.size(), n);
+    for (int s = 0; s < numShards; s++) {
+        // Hash routing keeps the shards roughly balanced
+        EXPECT_GT(sharded.shard(s).size(), n / numShards / 2);
+    }
+
+    std::vector<int> expectIds(nq * k), gotIds(nq * k);
+    std::vector<float> expectDists(nq * k), gotDists(nq * k);
+    single.searchBatch(queries.data(), nq, k, expectIds.data(), expectDists.data());
+    sharded.searchBatch(queries.data(), nq, k, gotIds.data(), gotDists.data());
+    for (int i = 0; i < nq * k; i++) {
+        EXPECT_EQ(gotIds[i], expectIds[i]);
+        EXPECT_FLOAT_EQ(gotDists[i], expectDists[i]);
+    }
+
+    PredicateFilter even([](int id) { return id % 2 == 0; });
+    for (int q = 0; q < nq; q++) {
+        int expectCount, gotCount;
+        single.search(&queries[q * dim], k, expectIds.data(), expectDists.data(), &expectCount, &even);
+        sharded.search(&queries[q * dim], k, gotIds.data(), gotDists.data(), &gotCount, &even);
+        ASSERT_EQ(gotCount, expectCount);
+        for (int i = 0; i < gotCount; i++) {
+            EXPECT_EQ(gotIds[i], expectIds[i]);
+        }
+    }
+
+    // Removal goes to the owning shard
+    int count;
+    sharded.search(&data[0], 1, gotIds.data(), gotDists.data(), &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_EQ(gotIds[0], ids[0]);
+    EXPECT_TRUE(sharded.remove(ids[0]));
+    EXPECT_FALSE(sharded.remove(ids[0]));
+    EXPECT_EQ(sharded.size(), n - 1);
+    sharded.search(&data[0], 1, gotIds.data(), gotDists.data(), &count);
+    ASSERT_EQ(count, 1);
+    EXPECT_NE(gotIds[0], ids[0]);
+}
+
+TEST(AsyncIngestTest, WritesAreSearchableBeforeTheyAreIndexed) {
+    const int dim = 16, perThread = 500, numThreads = 4, n = perThread * numThreads;
+    std::mt19937 rng(19);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim);
+    for (auto& v : data) v = uniform(rng);
+
+    AsyncIngestConfig config;
+    config.queueCapacity = 64;
+    config.batchSize = 16;
+    AsyncIngestIndex index(std::make_unique<FlatIndex>(dim, n), config);
+
+    std::atomic<int> misses{0};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < numThreads; t++) {
+        producers.emplace_back([&, t] {
+            for (int i = t * perThread; i < (t + 1) * perThread; i++) {
+                const float* vec = &data[static_cast<size_t>(i) * dim];
+                EXPECT_GT(index.ingest(i, vec), 0u);
+                // Read-your-writes: the vector is found whether it is still queued or already indexed
+                int id, count;
+                float dist;
+                index.search(vec, 1, &id, &dist, &count);
+                if (count != 1 || id != i) misses++;
+            }
+        });
+    }
+    for (auto& producer : producers) producer.join();
+    EXPECT_EQ(misses.load(), 0);
+
+    index.flush();
+    EXPECT_EQ(index.visibleSequence(), static_cast<uint64_t>(n));
+    EXPECT_EQ(index.pendingCount(), 0u);
+    EXPECT_EQ(index.index().size(), n);
+
+    FlatIndex reference(dim, n);
+    for (int i = 0; i < n; i++) reference.add(i, &data[static_cast<size_t>(i) * dim]);
+    const int k = 5;
+    std::vector<int> expectIds(k), gotIds(k);
+    std::vector<float> expectDists(k), gotDists(k);
+    for (int q = 0; q < 10; q++) {
+        int expectCount, gotCount;
+        reference.search(&data[static_cast<size_t>(q) * dim], k, expectIds.data(), expectDists.data(), &expectCount);
+        index.search(&data[static_cast<size_t>(q) * dim], k, gotIds.data(), gotDists.data(), &gotCount);
+        ASSERT_EQ(gotCount, expectCount);
+        EXPECT_EQ(gotIds, expectIds);
+    }
+}
+
+TEST(AsyncIngestTest, BackgroundFailureIsReportedByWaitVisible) {
+    struct FailingIndex : FlatIndex {
+        using FlatIndex::FlatIndex;
+        void addBatch(const float*, const int*, int) override { throw std::runtime_error("index full"); }
+    };
+
+    AsyncIngestIndex index(std::make_unique<FailingIndex>(4, 16));
+    std::vector<float> vec(4, 1.0f);
+    uint64_t sequence = index.ingest(7, vec.data());
+    EXPECT_THROW(index.waitVisible(sequence), std::runtime_error);
+    // Reported once, the failed write no longer blocks later waits
+    EXPECT_NO_THROW(index.flush());
+}
+
+TEST(RangeSearchTest, IndexesMatchExactScan) {
+    const int dim = 16, n = 3000, nq = 20;
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim);
+    for (auto& v : data) v = uniform(rng);
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; i++) ids[i] = i * 2 + 5;
+
+    for (Metric metric : {Metric::L2, Metric::COSINE}) {
+        FlatConfig flatConfig;
+        flatConfig.metric = metric;
+        FlatIndex flat(dim, n, flatConfig);
+        flat.addBatch(data.data(), ids.data(), n);
+
+        IVFConfig ivfConfig;
+        ivfConfig.nLists = 32;
+        ivfConfig.metric = metric;
+        IVFIndex ivf(dim, n, ivfConfig);
+        ivf.train(n, data.data());
+        ivf.addBatch(data.data(), ids.data(), n);
+
+        HNSWConfig hnswConfig;
+        hnswConfig.metric = metric;
+        HNSWIndex hnsw(dim, n, hnswConfig);
+        hnsw.addBatch(data.data(), ids.data(), n);
+
+        ShardedIndex sharded(3, [&](int) { return std::make_unique<FlatIndex>(dim, n, flatConfig); });
+        sharded.addBatch(data.data(), ids.data(), n);
+
+        size_t expected = 0, hnswHits = 0;
+        for (int q = 0; q < nq; q++) {
+            const float* query = &data[static_cast<size_t>(q) * 97 * dim];
+            // Radius of the 30th neighbour, so every query has a few dozen hits
+            std::vector<int> knnIds(30);
+            std::vector<float> knnDists(30);
+            int count;
+            flat.search(query, 30, knnIds.data(), knnDists.data(), &count);
+            ASSERT_EQ(count, 30);
+            const float radius = knnDists[29];
+
+            RangeSearchResult exact;
+            flat.rangeSearch(query, radius, exact);
+            ASSERT_GE(exact.size(), 30u);
+            for (size_t i = 0; i < exact.size(); i++) {
+                EXPECT_LE(exact.distances[i], radius);
+                if (i > 0) {
+                    EXPECT_LE(exact.distances[i - 1], exact.distances[i]);
+                }
+            }
+            expected += exact.size();
+
+            // The default implementation grows k until it steps outside the radius
+            RangeSearchResult grown;
+            flat.VectorIndex::rangeSearch(query, radius, grown);
+            EXPECT_EQ(grown.ids, exact.ids);
+
+            // IVF only skips lists the triangle inequality rules out, so it stays exact
+            RangeSearchResult fromIvf;
+            ivf.rangeSearch(query, radius, fromIvf);
+            EXPECT_EQ(fromIvf.ids, exact.ids);
+
+            RangeSearchResult fromShards;
+            sharded.rangeSearch(query, radius, fromShards);
+            EXPECT_EQ(fromShards.ids, exact.ids);
+
+            RangeSearchResult fromHnsw;
+            hnsw.rangeSearch(query, radius, fromHnsw);
+            for (size_t i = 0; i < fromHnsw.size(); i++) {
+                EXPECT_LE(fromHnsw.distances[i], radius);
+                if (std::find(exact.ids.begin(), exact.ids.end(), fromHnsw.ids[i]) != exact.ids.end()) hnswHits++;
+            }
+
+            PredicateFilter oneModFour([](int id) { return id % 4 == 1; });
+            RangeSearchResult filtered, filteredIvf;
+            flat.rangeSearch(query, radius, filtered, &oneModFour);
+            ivf.rangeSearch(query, radius, filteredIvf, &oneModFour);
+            EXPECT_EQ(filteredIvf.ids, filtered.ids);
+            for (int id : filtered.ids) EXPECT_EQ(id % 4, 1);
+        }
+        EXPECT_GT(static_cast<double>(hnswHits) / expected, 0.95);
+    }
+}
+
+TEST(RangeSearchTest, AsyncIngestSeesQueuedWrites) {
+    const int dim = 8, n = 400;
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim);
+    for (auto& v : data) v = uniform(rng);
+
+    FlatIndex reference(dim, n);
+    AsyncIngestIndex index(std::make_unique<FlatIndex>(dim, n));
+    for (int i = 0; i < n; i++) {
+        const float* vec = &data[static_cast<size_t>(i) * dim];
+        reference.add(i, vec);
+        index.ingest(i, vec);
+
+        // Queued or indexed, every write inside the radius is reported exactly once
+        RangeSearchResult expected, got;
+        reference.rangeSearch(&data[0], 0.3f, expected);
+        index.rangeSearch(&data[0], 0.3f, got);
+        ASSERT_EQ(got.ids, expected.ids);
+    }
+}
+
+TEST(SearchStatsTest, CountsHotPathWhenEnabled) {
+    const int dim = 16, n = 2000;
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim);
+    for (auto& v : data) v = uniform(rng);
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; i++) ids[i] = i;
+
+    HNSWIndex hnsw(dim, n);
+    hnsw.addBatch(data.data(), ids.data(), n);
+
+    IVFConfig ivfConfig;
+    ivfConfig.nLists = 16;
+    ivfConfig.nProbes = 4;
+    IVFIndex ivf(dim, n, ivfConfig);
+    ivf.train(n, data.data());
+    ivf.addBatch(data.data(), ids.data(), n);
+
+    searchstats::reset();
+    std::vector<int> resultIds(10);
+    std::vector<float> resultDists(10);
+    int count;
+
+    SearchStats hnswStats, ivfStats;
+    hnsw.searchWithStats(&data[0], 10, resultIds.data(), resultDists.data(), &count, &hnswStats);
+    ASSERT_EQ(count, 10);
+    ivf.searchWithStats(&data[0], 10, resultIds.data(), resultDists.data(), &count, &ivfStats);
+    ASSERT_EQ(count, 10);
+
+    const SearchStatsSnapshot snapshot = searchstats::snapshot();
+    if (!searchstats::enabled()) {
+        EXPECT_EQ(hnswStats.distanceComputations, 0u);
+        EXPECT_EQ(ivfStats.hops, 0u);
+        EXPECT_EQ(snapshot.queries, 0u);
+        return;
+    }
+
+    EXPECT_GT(hnswStats.distanceComputations, 0u);
+    EXPECT_GT(hnswStats.hops, 0u);
+    EXPECT_GE(hnswStats.visitedNodes, 10u);
+    EXPECT_GT(hnswStats.latencyNanos, 0u);
+
+    // Every centroid plus every vector in the probed lists
+    EXPECT_EQ(ivfStats.hops, 4u);
+    EXPECT_EQ(ivfStats.distanceComputations, 16u + ivfStats.visitedNodes);
+
+    EXPECT_EQ(snapshot.queries, 2u);
+    EXPECT_EQ(snapshot.sums[SearchStatsSnapshot::HOPS], hnswStats.hops + ivfStats.hops);
+    EXPECT_GE(snapshot.percentile(SearchStatsSnapshot::DISTANCE_COMPUTATIONS, 1.0),
+              std::max(hnswStats.distanceComputations, ivfStats.distanceComputations));
+
+    searchstats::reset();
+    EXPECT_EQ(searchstats::snapshot().queries, 0u);
+}
+
+TEST(SearchStatsTest, ShardedSearchCountsOnceAcrossShards) {
+    const int dim = 16, n = 2000, numShards = 3, nQueries = 5;
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> data(static_cast<size_t>(n) * dim);
+    for (auto& v : data) v = uniform(rng);
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; i++) ids[i] = i;
+
+    IVFConfig ivfConfig;
+    ivfConfig.nLists = 16;
+    ivfConfig.nProbes = 4;
+    ShardedIndex sharded(numShards, [&](int) { return std::make_unique<IVFIndex>(dim, n, ivfConfig); });
+    for (int s = 0; s < numShards; s++) {
+        static_cast<IVFIndex&>(sharded.shard(s)).train(n, data.data());
+    }
+    sharded.addBatch(data.data(), ids.data(), n);
+
+    searchstats::reset();
+    std::vector<int> resultIds(static_cast<size_t>(nQueries) * 10);
+    std::vector<float> resultDists(resultIds.size());
+    int count;
+    SearchStats stats;
+    sharded.searchWithStats(&data[0], 10, resultIds.data(), resultDists.data(), &count, &stats);
+    ASSERT_EQ(count, 10);
+    if (!searchstats::enabled()) {
+        EXPECT_EQ(stats.hops, 0u);
+        EXPECT_EQ(searchstats::snapshot().queries, 0u);
+        return;
+    }
+
+    // Each shard probes 4 lists, whichever thread ran it
+    EXPECT_EQ(stats.hops, 4u * numShards);
+    EXPECT_EQ(stats.distanceComputations, 16u * numShards + stats.visitedNodes);
+    SearchStatsSnapshot snapshot = searchstats::snapshot();
+    EXPECT_EQ(snapshot.queries, 1u);
+    EXPECT_EQ(snapshot.sums[SearchStatsSnapshot::HOPS], stats.hops);
+
+    RangeSearchResult range;
+    sharded.rangeSearch(&data[0], 0.5f, range);
+    sharded.searchBatch(data.data(), nQueries, 10, resultIds.data(), resultDists.data());
+    snapshot = searchstats::snapshot();
+    // One query each for the range search and every batch row, not one per shard
+    EXPECT_EQ(snapshot.queries, 2u + nQueries);
+    EXPECT_GE(snapshot.sums[SearchStatsSnapshot::HOPS], stats.hops);
+
+    // Given an output array the batch reports each query's counts and records none of them
+    std::vector<SearchStats> queryStats(nQueries);
+    sharded.searchBatch(data.data(), nQueries, 10, resultIds.data(), resultDists.data(), queryStats.data());
+    EXPECT_EQ(searchstats::snapshot().queries, 2u + nQueries);
+    for (const SearchStats& query : queryStats) {
+        EXPECT_GT(query.latencyNanos, 0u);
+    }
+}
+
+TEST(GraphReorderTest, OrdersArePermutations) {
+    // Two chains 0-1-2-3 and 4-5 plus an isolated node 6
+    CSRGraph graph;
+    const std::vector<std::vector<int32_t>> edges = {{1}, {0, 2}, {1, 3}, {2}, {5}, {4}, {}};
+    for (const auto& e : edges) graph.addNode(e.data(), static_cast<int>(e.size()));
+
+    for (GraphOrder order : {GraphOrder::NONE, GraphOrder::BFS, GraphOrder::RCM, GraphOrder::GORDER}) {
+        std::vector<int32_t> result = computeGraphOrder(graph, order, 2);
+        ASSERT_EQ(result.size(), edges.size());
+        std::vector<int32_t> sorted = result;
+        std::sort(sorted.begin(), sorted.end());
+        for (int i = 0; i < static_cast<int>(sorted.size()); i++) {
+            ASSERT_EQ(sorted[i], i) << "order " << static_cast<int>(order);
+        }
+        if (order == GraphOrder::BFS || order == GraphOrder::GORDER) {
+            EXPECT_EQ(result[0], 2);
+            // The start's component comes before anything unreachable from it
+            std::vector<int32_t> head(result.begin(), result.begin() + 4);
+            std::sort(head.begin(), head.end());
+            EXPECT_EQ(head, (std::vector<int32_t>{0, 1, 2, 3}));
+        }
+    }
+    EXPECT_EQ(computeGraphOrder(graph, GraphOrder::BFS, 2),
+              (std::vector<int32_t>{2, 1, 3, 0, 4, 5, 6}));
+}
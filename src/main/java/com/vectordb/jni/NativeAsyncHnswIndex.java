@@ -0,0 +1,62 @@
+package com.vectordb.jni;
+
+/**
+ * 异步写入的HNSW索引Native实现
+ * ingest/add 把向量放入Native无锁队列后立即返回，后台线程按批建图；
+ * 每次写入返回一个序号，visibleSequence() 之前的写入都已进入图中。
+ * 尚未建图的写入在搜索时以暴力扫描补上，因此写入返回后立刻可以被搜到
+ */
+public class NativeAsyncHnswIndex extends NativeIndex {
+
+    public NativeAsyncHnswIndex(int dimension, int maxElements, int M, int efConstruction, int ef,
+                                int queueCapacity, int batchSize) {
+        super(dimension, nativeCreateAsyncHNSW(dimension, maxElements, M, efConstruction, ef,
+                                               queueCapacity, batchSize));
+    }
+
+    /**
+     * 使用默认HNSW参数、8192槽队列、每批256条创建索引
+     */
+    public NativeAsyncHnswIndex(int dimension, int maxElements) {
+        this(dimension, maxElements, 32, 64, 64, 8192, 256);
+    }
+
+    /**
+     * 入队一条写入并返回其序号；队列满时等待后台线程腾出空间
+     */
+    public long ingest(int id, float[] vector) {
+        if (vector.length != dimension) {
+            throw new IllegalArgumentException(
+                "Vector dimension mismatch: expected " + dimension + ", got " + vector.length);
+        }
+        return nativeIngest(nativeHandle, id, vector);
+    }
+
+    /**
+     * 序号不超过该值的写入都已进入图中
+     */
+    public long visibleSequence() {
+        return nativeVisibleSequence(nativeHandle);
+    }
+
+    /**
+     * 阻塞到序号为 sequence 的写入进入图中；后台建图出错时抛出 RuntimeException
+     */
+    public void waitVisible(long sequence) {
+        nativeWaitVisible(nativeHandle, sequence);
+    }
+
+    /**
+     * 等待此前所有写入进入图中
+     */
+    public void flush() {
+        nativeWaitVisible(nativeHandle, Long.MAX_VALUE);
+    }
+
+    // Native方法
+    private static native long nativeCreateAsyncHNSW(int dimension, int maxElements, int M, int efConstruction, int ef,
+                                                     int queueCapacity, int batchSize);
+    private native long nativeIngest(long handle, int id, float[] vector);
+    private native long nativeVisibleSequence(long handle);
+    private native void nativeWaitVisible(long handle, long sequence);
+}
@@ -0,0 +1,15 @@
+package com.vectordb.jni;
+
+/**
+ * 精确暴力检索的Native实现
+ * 批量搜索按查询块与向量块做矩阵乘法，适合大批量离线查询
+ */
+public class NativeFlatIndex extends NativeIndex {
+
+    public NativeFlatIndex(int dimension, int maxElements) {
+        super(dimension, nativeCreateFlat(dimension, maxElements));
+    }
+
+    // Native方法
+    private static native long nativeCreateFlat(int dimension, int maxElements);
+}
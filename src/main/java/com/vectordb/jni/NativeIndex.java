@@ -9,6 +9,7 @@ import java.nio.ByteOrder;
 import java.nio.FloatBuffer;
 import java.nio.IntBuffer;
 import java.util.ArrayList;
+import java.util.BitSet;
 import java.util.List;
 
 /**
@@ -16,6 +17,17 @@ import java.util.List;
  * 提供JNI调用的统一接口
  */
 public abstract class NativeIndex implements VectorIndex {
+    /** setMemoryPolicy 的页面模式 */
+    public static final int PAGES_DEFAULT = 0;
+    public static final int PAGES_TRANSPARENT = 1;
+    public static final int PAGES_HUGE_2MB = 2;
+    public static final int PAGES_HUGE_1GB = 3;
+
+    /** setMemoryPolicy 的 NUMA 模式 */
+    public static final int NUMA_NONE = 0;
+    public static final int NUMA_BIND = 1;
+    public static final int NUMA_INTERLEAVE = 2;
+
     protected final long nativeHandle;
     protected final int dimension;
 
@@ -46,8 +58,51 @@ public abstract class NativeIndex implements VectorIndex {
 
     @Override
     public boolean removeVector(int id) {
-        // Native implementation may not support direct removal
-        return false;
+        // LSH / Annoy / HNSWPQ / IVFPQ do not support removal and return false
+        return nativeRemove(nativeHandle, id);
+    }
+
+    /**
+     * 替换已有向量
+     * @param id 向量ID
+     * @param vector 新的向量数据
+     * @return id 不存在或索引不支持更新时返回 false
+     */
+    public boolean updateVector(int id, float[] vector) {
+        if (vector.length != dimension) {
+            throw new IllegalArgumentException(
+                "Vector dimension mismatch: expected " + dimension + ", got " + vector.length);
+        }
+        return nativeUpdate(nativeHandle, id, vector);
+    }
+
+    /**
+     * 回收已删除向量占用的空间 (HNSW 同时修复图中指向它们的边)，可在后台线程调用
+     * @return 回收的向量个数
+     */
+    public int compact() {
+        return nativeCompact(nativeHandle);
+    }
+
+    /**
+     * 重排内部布局以提高搜索的访存局部性 (HNSW / HNSWPQ 按 Gorder 重新编号图节点)，
+     * 搜索结果不变；适合在批量构建完成后调用一次，期间搜索会被阻塞
+     */
+    public void optimize() {
+        nativeOptimize(nativeHandle);
+    }
+
+    /**
+     * 设置向量与图结构等大数组的大页 / NUMA 策略，须在添加向量之前调用；
+     * 申请的模式不可用时逐级回退 (1GB → 2MB → 透明大页 → 普通页)，不支持的索引保持默认
+     * @param pageMode PAGES_* 之一
+     * @param numaMode NUMA_* 之一
+     * @param numaNode NUMA_BIND 时绑定的节点
+     * @return {实际生效的页面模式, 实际生效的 NUMA 模式}
+     */
+    public int[] setMemoryPolicy(int pageMode, int numaMode, int numaNode) {
+        int effective = nativeSetMemoryPolicy(nativeHandle, pageMode, numaMode, numaNode);
+        return new int[] {effective & 0xff, effective >> 8};
     }
 
     @Override
@@ -126,6 +181,101 @@ public abstract class NativeIndex implements VectorIndex {
         return results;
     }
 
+    /**
+     * 过滤搜索：只返回 allowedIds 中置位的 ID
+     * 被过滤的向量在索引内部直接跳过，不需要放大 k 后在 Java 侧过滤
+     * @param query 查询向量
+     * @param k 返回结果数量
+     * @param allowedIds 允许返回的向量ID集合
+     * @return 搜索结果列表
+     */
+    public List<SearchResult> search(float[] query, int k, BitSet allowedIds) {
+        if (query.length != dimension) {
+            throw new IllegalArgumentException(
+                "Query dimension mismatch: expected " + dimension + ", got " + query.length);
+        }
+        if (k <= 0) {
+            throw new IllegalArgumentException("k must be positive");
+        }
+
+        int[] ids = new int[k];
+        float[] distances = new float[k];
+
+        int count = nativeSearchFiltered(nativeHandle, query, k, allowedIds.toLongArray(), ids, distances);
+
+        List<SearchResult> results = new ArrayList<>(count);
+        for (int i = 0; i < count; i++) {
+            results.add(new SearchResult(ids[i], distances[i]));
+        }
+        return results;
+    }
+
+    /**
+     * 范围搜索：返回与查询距离不超过 radius 的全部向量，按距离升序
+     * radius 与 search 返回的距离同一口径 (L2 为平方距离)
+     * @param query 查询向量
+     * @param radius 距离上限
+     * @return 搜索结果列表
+     */
+    public List<SearchResult> rangeSearch(float[] query, float radius) {
+        if (query.length != dimension) {
+            throw new IllegalArgumentException(
+                "Query dimension mismatch: expected " + dimension + ", got " + query.length);
+        }
+
+        // 每个元素高 32 位为 id，低 32 位为距离的 float 位模式
+        long[] packed = nativeRangeSearch(nativeHandle, query, radius);
+        if (packed == null) {
+            return new ArrayList<>();
+        }
+        List<SearchResult> results = new ArrayList<>(packed.length);
+        for (long entry : packed) {
+            results.add(new SearchResult((int) (entry >>> 32), Float.intBitsToFloat((int) entry)));
+        }
+        return results;
+    }
+
+    /**
+     * 添加向量（零拷贝接口）
+     * @param id 向量ID
+     * @param vector 本地字节序的 DirectByteBuffer，从 position 0 起存放 dimension 个 float
+     */
+    public void addVector(int id, ByteBuffer vector) {
+        checkDirect(vector, dimension, "vector");
+        nativeAddDirect(nativeHandle, id, vector);
+    }
+
+    /**
+     * 搜索（零拷贝接口），高 QPS 场景下可复用同一组缓冲区
+     * @param query 本地字节序的 DirectByteBuffer，存放 dimension 个 float
+     * @param k 返回结果数量
+     * @param resultIds 至少容纳 k 个 int 的 DirectByteBuffer
+     * @param resultDistances 至少容纳 k 个 float 的 DirectByteBuffer
+     * @return 实际写入的结果数
+     */
+    public int search(ByteBuffer query, int k, ByteBuffer resultIds, ByteBuffer resultDistances) {
+        if (k <= 0) {
+            throw new IllegalArgumentException("k must be positive");
+        }
+        checkDirect(query, dimension, "query");
+        checkDirect(resultIds, k, "resultIds");
+        checkDirect(resultDistances, k, "resultDistances");
+        return nativeSearchDirect(nativeHandle, query, k, resultIds, resultDistances);
+    }
+
+    private static void checkDirect(ByteBuffer buffer, int elements, String name) {
+        if (buffer == null || !buffer.isDirect()) {
+            throw new IllegalArgumentException(name + " must be a direct ByteBuffer");
+        }
+        if (buffer.order() != ByteOrder.nativeOrder()) {
+            throw new IllegalArgumentException(name + " must use native byte order");
+        }
+        if (buffer.capacity() < (long) elements * 4) {
+            throw new IllegalArgumentException(
+                name + " too small: need " + elements + " elements, capacity " + buffer.capacity() / 4);
+        }
+    }
+
     /**
      * 关闭索引，释放Native资源
      */
@@ -137,6 +287,19 @@ public abstract class NativeIndex implements VectorIndex {
     protected native void nativeAdd(long handle, int id, float[] vector);
     protected native int nativeSearch(long handle, float[] query, int k, int[] resultIds, float[] resultDistances);
     protected native void nativeDestroy(long handle);
+    protected native boolean nativeRemove(long handle, int id);
+    protected native boolean nativeUpdate(long handle, int id, float[] vector);
+    protected native int nativeCompact(long handle);
+    protected native void nativeOptimize(long handle);
+    protected native int nativeSetMemoryPolicy(long handle, int pageMode, int numaMode, int numaNode);
+    protected native long[] nativeRangeSearch(long handle, float[] query, float radius);
+    protected native int nativeSearchFiltered(long handle, float[] query, int k, long[] allowedIds,
+                                              int[] resultIds, float[] resultDistances);
+
+    // 单条操作（DirectByteBuffer，本地代码直接读写缓冲区）
+    protected native void nativeAddDirect(long handle, int id, ByteBuffer vector);
+    protected native int nativeSearchDirect(long handle, ByteBuffer query, int k,
+                                            ByteBuffer resultIds, ByteBuffer resultDistances);
 
     // 批量操作（使用DirectByteBuffer实现零拷贝）
     protected native void nativeAddBatch(long handle, ByteBuffer ids, ByteBuffer vectors,
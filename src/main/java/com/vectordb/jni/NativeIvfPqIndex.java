@@ -0,0 +1,28 @@
+package com.vectordb.jni;
+
+/**
+ * IVF-PQ索引的Native实现
+ * 倒排表内存放残差PQ编码，需先训练聚类中心和码本
+ */
+public class NativeIvfPqIndex extends NativeIndex {
+
+    public NativeIvfPqIndex(int dimension, int maxElements, int nLists, int nProbes, int pqM, int nBits) {
+        super(dimension, nativeCreateIVFPQ(dimension, maxElements, nLists, nProbes, pqM, nBits));
+    }
+
+    public NativeIvfPqIndex(int dimension, int maxElements) {
+        this(dimension, maxElements, 100, 10, 8, 8);
+    }
+
+    /**
+     * 训练聚类中心和残差码本
+     */
+    public void train(int nSamples, float[] samples) {
+        nativeTrain(nativeHandle, nSamples, samples);
+    }
+
+    // Native方法
+    private static native long nativeCreateIVFPQ(int dimension, int maxElements, int nLists, int nProbes,
+                                                 int pqM, int nBits);
+    private native void nativeTrain(long handle, int nSamples, float[] samples);
+}
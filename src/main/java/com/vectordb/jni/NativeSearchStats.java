@@ -0,0 +1,92 @@
+package com.vectordb.jni;
+
+/**
+ * Native查询统计的快照
+ * 只有Native库以 -DENABLE_SEARCH_STATS=ON 编译时才会计数，否则各项均为 0；
+ * 统计覆盖进程内所有Native索引的查询
+ */
+public final class NativeSearchStats {
+    /** 计数项，与 Native 端 SearchStatsSnapshot::Field 一致 */
+    public static final int LATENCY_NANOS = 0;
+    public static final int DISTANCE_COMPUTATIONS = 1;
+    public static final int HOPS = 2;
+    public static final int VISITED_NODES = 3;
+    public static final int LOCK_WAIT_NANOS = 4;
+
+    private static final int NUM_FIELDS = 5;
+    private static final int NUM_BUCKETS = 64;
+
+    static {
+        if (!NativeLoader.load()) {
+            throw new RuntimeException("Failed to load native library");
+        }
+    }
+
+    private final long[] data;
+
+    private NativeSearchStats(long[] data) {
+        this.data = data;
+    }
+
+    /**
+     * Native库是否在编译时开启了查询统计
+     */
+    public static boolean enabled() {
+        return nativeEnabled();
+    }
+
+    /**
+     * 汇总当前所有线程的统计
+     */
+    public static NativeSearchStats snapshot() {
+        return new NativeSearchStats(nativeSnapshot());
+    }
+
+    /**
+     * 清空所有统计
+     */
+    public static void reset() {
+        nativeReset();
+    }
+
+    public long queries() {
+        return data[0];
+    }
+
+    public double mean(int field) {
+        checkField(field);
+        return queries() == 0 ? 0.0 : (double) data[1 + field] / queries();
+    }
+
+    /**
+     * 第 p (0..1) 分位所在 log2 桶的上界
+     */
+    public long percentile(int field, double p) {
+        checkField(field);
+        long queries = queries();
+        if (queries == 0) {
+            return 0;
+        }
+        double target = p * queries;
+        long seen = 0;
+        int base = 1 + NUM_FIELDS + field * NUM_BUCKETS;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            seen += data[base + b];
+            if (seen > 0 && seen >= target) {
+                return b == 0 ? 0 : (b >= 63 ? Long.MAX_VALUE : (1L << b) - 1);
+            }
+        }
+        return Long.MAX_VALUE;
+    }
+
+    private static void checkField(int field) {
+        if (field < 0 || field >= NUM_FIELDS) {
+            throw new IllegalArgumentException("Unknown search stats field: " + field);
+        }
+    }
+
+    // Native方法
+    private static native boolean nativeEnabled();
+    private static native long[] nativeSnapshot();
+    private static native void nativeReset();
+}
@@ -0,0 +1,28 @@
+package com.vectordb.jni;
+
+/**
+ * 分片HNSW索引的Native实现
+ * 向量按id哈希分布到numShards个独立的HNSW分片，查询在Native线程池上并行发往所有分片后合并top-k，
+ * 取代在Java侧手动维护多个索引再合并结果的做法
+ */
+public class NativeShardedHnswIndex extends NativeIndex {
+
+    /**
+     * 创建分片HNSW索引，每个分片的容量为maxElementsPerShard
+     */
+    public NativeShardedHnswIndex(int dimension, int maxElementsPerShard, int numShards,
+                                  int M, int efConstruction, int ef) {
+        super(dimension, nativeCreateShardedHNSW(dimension, maxElementsPerShard, numShards, M, efConstruction, ef));
+    }
+
+    /**
+     * 使用默认HNSW参数创建分片索引
+     */
+    public NativeShardedHnswIndex(int dimension, int maxElementsPerShard, int numShards) {
+        this(dimension, maxElementsPerShard, numShards, 32, 64, 64);
+    }
+
+    // Native方法
+    private static native long nativeCreateShardedHNSW(int dimension, int maxElementsPerShard, int numShards,
+                                                       int M, int efConstruction, int ef);
+}